@@ -0,0 +1,29 @@
+#ifndef DMELL_ARITH_H
+#define DMELL_ARITH_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include "dmell_vars.h"
+
+/**
+ * @file dmell_arith.h
+ * @brief Integer evaluator of arithmetic expansions - "$((expression))".
+ */
+
+/**
+ * @brief Maximum nesting of parentheses and unary operators in an expression.
+ */
+#ifndef DMELL_ARITH_MAX_DEPTH
+#   define DMELL_ARITH_MAX_DEPTH    32
+#endif
+
+/**
+ * @brief Size of a buffer that can hold any formatted result.
+ */
+#define DMELL_ARITH_RESULT_SIZE     24
+
+extern bool dmell_arith_is_expansion    ( const char* cmd, size_t len, const char** out_expr, size_t* out_expr_len );
+extern int  dmell_arith_eval            ( const dmell_vars_t* vars, const char* expr, size_t len, long* out_value );
+extern int  dmell_arith_expand          ( const dmell_vars_t* vars, const char* expr, size_t len, char* dst, size_t dst_size );
+
+#endif // DMELL_ARITH_H
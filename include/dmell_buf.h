@@ -0,0 +1,30 @@
+#ifndef DMELL_BUF_H
+#define DMELL_BUF_H
+
+#include <stddef.h>
+
+/**
+ * @file dmell_buf.h
+ * @brief Growable character buffer used by the dmell module.
+ */
+
+/**
+ * @brief Growable, null terminated character buffer.
+ * 
+ * A zero initialized structure is a valid empty buffer. Clearing the buffer
+ * keeps its memory, so a buffer reused for many lines stops allocating once
+ * it reached the size of the longest line.
+ */
+typedef struct 
+{
+    char*   data;       /**< Buffer content (null terminated when not NULL) */
+    size_t  length;     /**< Number of characters in the buffer */
+    size_t  capacity;   /**< Number of bytes allocated for the buffer */
+} dmell_buf_t;
+
+extern int  dmell_buf_reserve   ( dmell_buf_t* buf, size_t extra );
+extern int  dmell_buf_append    ( dmell_buf_t* buf, const char* str, size_t len );
+extern void dmell_buf_clear     ( dmell_buf_t* buf );
+extern void dmell_buf_free      ( dmell_buf_t* buf );
+
+#endif // DMELL_BUF_H
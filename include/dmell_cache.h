@@ -0,0 +1,31 @@
+#ifndef DMELL_CACHE_H
+#define DMELL_CACHE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "dmell_prog.h"
+
+/**
+ * @file dmell_cache.h
+ * @brief Cache of compiled script programs (.dmec files).
+ *
+ * The compiled form of a script is stored next to the script, or in the
+ * directory named by the DMELL_CACHE_DIR environment variable when it is
+ * set. Setting DMELL_CACHE to 0 disables the cache.
+ */
+
+/**
+ * @brief Version of the cache file format - has to change with the layout of the compiled program.
+ */
+#define DMELL_CACHE_VERSION     2
+
+/**
+ * @brief Extension of cache files.
+ */
+#define DMELL_CACHE_EXTENSION   ".dmec"
+
+extern char*            dmell_cache_get_path    ( const char* script_path );
+extern dmell_prog_t*    dmell_cache_load        ( const char* cache_path, uint32_t source_size, uint32_t source_hash );
+extern int              dmell_cache_store       ( const char* cache_path, const dmell_prog_t* prog, uint32_t source_size, uint32_t source_hash );
+
+#endif // DMELL_CACHE_H
@@ -2,6 +2,7 @@
 #define DMELL_CMD_H
 
 #include <stddef.h>
+#include <stdbool.h>
 
 /** 
  * @file dmell_cmd.h
@@ -9,6 +10,13 @@
  */
 typedef int (*dmell_cmd_handler_t)(int argc, char** argv);
 
+/**
+ * @brief Function that tells if the default handler runs a command inside the shell.
+ * 
+ * Only the output of commands that run inside the shell can be captured.
+ */
+typedef bool (*dmell_cmd_capture_check_t)(const char* cmd_name);
+
 /** 
  * @brief Structure defining a command for the dmell module.
  */
@@ -18,20 +26,37 @@ typedef struct
     dmell_cmd_handler_t handler;        /**< Function pointer to the command handler */
 } dmell_cmd_t;
 
+/** 
+ * @brief Output redirections of a parsed command.
+ */
+typedef struct 
+{
+    const char* output;         /**< File of the standard output, NULL if it is not redirected */
+    const char* error;          /**< File of the standard error, NULL if it is not redirected */
+    bool        output_append;  /**< Append to the file of the standard output instead of truncating it */
+    bool        error_append;   /**< Append to the file of the standard error instead of truncating it */
+} dmell_redirect_t;
+
 typedef struct 
 {
     const char* program_name; /**< Name of the program */
     int argc;       /**< Number of arguments */
     char** argv;    /**< Array of argument strings */
+    dmell_redirect_t redirect;  /**< Output redirections (not included in argv) */
 } dmell_argv_t;
 
 extern int                  dmell_set_default_handler   (dmell_cmd_handler_t handler);
+extern int                  dmell_set_capture_check     (dmell_cmd_capture_check_t check);
+extern bool                 dmell_is_output_captured    (const char* cmd_name);
 extern int                  dmell_register_command      (const dmell_cmd_t* command);
 extern int                  dmell_register_command_handler(const char* command_name, dmell_cmd_handler_t handler);
+extern int                  dmell_register_static_commands(const dmell_cmd_t* commands, size_t count);
 extern const dmell_cmd_t*   dmell_find_command          (const char* command_name);
+extern const dmell_cmd_t*   dmell_next_command          (size_t* iterator);
 extern int                  dmell_unregister_command    (const dmell_cmd_t* command);
 extern int                  dmell_run_command           (const char* cmd_name, int argc, char** argv);
 extern int                  dmell_run_command_string    (const char* cmd, size_t len);
 extern int                  dmell_parse_command         ( const char* cmd, size_t len, dmell_argv_t* out_argv );
+extern void                 dmell_free_argv             ( dmell_argv_t* argv );
 
 #endif // DMELL_CMD_H
\ No newline at end of file
@@ -0,0 +1,45 @@
+#ifndef DMELL_ENV_H
+#define DMELL_ENV_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @file dmell_env.h
+ * @brief Cache of environment variable lookups.
+ *
+ * Reading the environment walks the global environment list, so names
+ * that are not shell variables (like $PATH or $HOSTNAME) are looked up
+ * once and then served from the cache. Names that are not set at all are
+ * cached as well. The values are copied into the cache, so a change of the
+ * environment never leaves a dangling entry, and values that do not fit
+ * are read from the environment every time. The cache is invalidated by a
+ * generation counter: every change of the environment has to be reported
+ * with dmell_env_changed, which drops all entries at once.
+ */
+
+#ifndef DMELL_ENV_CACHE_SIZE
+/**
+ * @brief Number of entries of the environment cache (power of 2).
+ */
+#   define DMELL_ENV_CACHE_SIZE     16
+#endif
+
+#ifndef DMELL_ENV_CACHE_NAME_LEN
+/**
+ * @brief Size of the name buffer of a cache entry - longer names are not cached.
+ */
+#   define DMELL_ENV_CACHE_NAME_LEN 24
+#endif
+
+#ifndef DMELL_ENV_CACHE_VALUE_LEN
+/**
+ * @brief Size of the value buffer of a cache entry - longer values are not cached.
+ */
+#   define DMELL_ENV_CACHE_VALUE_LEN 32
+#endif
+
+extern const char*  dmell_env_get       ( const char* name, size_t name_len, uint32_t hash );
+extern void         dmell_env_changed   ( void );
+
+#endif // DMELL_ENV_H
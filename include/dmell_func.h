@@ -0,0 +1,34 @@
+#ifndef DMELL_FUNC_H
+#define DMELL_FUNC_H
+
+#include "dmell_cmd.h"
+#include "dmell_prog.h"
+#include "dmell_script.h"
+
+/**
+ * @file dmell_func.h
+ * @brief Shell functions defined with 'function NAME { ... }'.
+ */
+
+/**
+ * @brief Maximum depth of nested function calls.
+ */
+#ifndef DMELL_FUNC_MAX_DEPTH
+#   define DMELL_FUNC_MAX_DEPTH     32
+#endif
+
+/**
+ * @brief Shell function registered in the command table.
+ *
+ * The name of the function is stored right after the structure.
+ */
+typedef struct
+{
+    dmell_cmd_t     command;    /**< Command entry of the function */
+    dmell_prog_t*   body;       /**< Compiled body of the function */
+} dmell_func_t;
+
+extern int                  dmell_func_define       ( const char* name, dmell_prog_t* body );
+extern bool                 dmell_func_is_function  ( const dmell_cmd_t* command );
+
+#endif // DMELL_FUNC_H
@@ -15,9 +15,17 @@ extern int dmell_handler_exit( int argc, char** argv );
 extern int dmell_handler_setloglevel( int argc, char** argv );
 extern int dmell_handler_module( int argc, char** argv );
 extern int dmell_handler_uptime( int argc, char** argv );
+extern int dmell_handler_hash( int argc, char** argv );
+extern int dmell_handler_jobs( int argc, char** argv );
+extern int dmell_handler_wait( int argc, char** argv );
+extern int dmell_handler_kill( int argc, char** argv );
+extern int dmell_handler_parallel( int argc, char** argv );
+extern int dmell_handler_test( int argc, char** argv );
 
 extern int dmell_handler_default( int argc, char** argv );
+extern bool dmell_handler_default_captures( const char* cmd_name );
 
 extern int dmell_register_handlers( void );
+extern int dmell_register_linked_commands( void );
 
 #endif // DMELL_HANDLERS_H
\ No newline at end of file
@@ -2,6 +2,8 @@
 #define DMELL_HLP_H
 
 #include <stddef.h>
+#include <stdbool.h>
+#include <stdint.h>
 
 /**
  * @brief Helper function to skip whitespaces in a command string.
@@ -52,4 +54,47 @@ static inline size_t dmell_add_to_string( char* dst, char* end_dst, const char*
     return len;
 }
 
+/**
+ * @brief Helper function to find the start of a comment in a script line.
+ * 
+ * A '#' that names the $# parameter ("$#" or "${#}") does not start a comment.
+ * 
+ * @param str Current position in the script line
+ * @param end_ptr Pointer to the end of the script line
+ * @return const char* Pointer to the position of the comment start, or end_ptr if none found
+ */
+static inline const char* dmell_find_comment_start( const char* str, const char* end_ptr )
+{
+    const char* ptr = str;
+    while( ptr < end_ptr )
+    {
+        bool is_param = ( ptr > str && ptr[-1] == '$' ) ||
+                        ( ptr - 1 > str && ptr[-1] == '{' && ptr[-2] == '$' );
+        if( *ptr == '#' && !is_param )
+        {
+            return ptr;
+        }
+        ptr++;
+    }
+    return end_ptr;
+}
+
+/**
+ * @brief Helper function to calculate the hash of a name (32-bit FNV-1a).
+ * 
+ * @param str Name to hash
+ * @param len Length of the name
+ * @return uint32_t Hash of the name
+ */
+static inline uint32_t dmell_hash_name( const char* str, size_t len )
+{
+    uint32_t hash = 2166136261u;
+    for( size_t i = 0; i < len; i++ )
+    {
+        hash ^= (uint8_t)str[i];
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
 #endif // DMELL_HLP_H
\ No newline at end of file
@@ -0,0 +1,124 @@
+#ifndef DMELL_IO_H
+#define DMELL_IO_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <dmod.h>
+
+/**
+ * @file dmell_io.h
+ * @brief Standard streams of the commands run by dmell.
+ *
+ * Built-in and linked commands write their output through this layer
+ * instead of calling Dmod_Printf directly, so the shell can send it to the
+ * console, into a pipe, into a file or into memory.
+ */
+
+/**
+ * @brief Size of the stack buffer used to format output that is not sent to the console.
+ */
+#ifndef DMELL_IO_FORMAT_SIZE
+#   define DMELL_IO_FORMAT_SIZE     256
+#endif
+
+/**
+ * @brief Enumeration of stream kinds.
+ */
+typedef enum
+{
+    dmell_io_console,       //!< Console of the DMOD environment
+    dmell_io_pipe,          //!< Pipe (dmell_pipe_t)
+    dmell_io_file,          //!< Buffered file writer (dmell_writer_t)
+    dmell_io_buffer,        //!< Growable memory buffer (dmell_buf_t)
+
+    dmell_io_kind_max       //!< Maximum value for validation
+} dmell_io_kind_t;
+
+/**
+ * @brief Stream of a command.
+ */
+typedef struct
+{
+    uint32_t    kind;       /**< Kind of the stream (dmell_io_kind_t) */
+    void*       object;     /**< Object behind the stream, NULL for the console */
+} dmell_io_stream_t;
+
+/**
+ * @brief Set of the streams of a command.
+ *
+ * A zero initialized structure connects everything to the console.
+ */
+typedef struct
+{
+    dmell_io_stream_t   output;     /**< Standard output */
+    dmell_io_stream_t   error;      /**< Standard error, the DMOD error log when it is the console */
+    dmell_io_stream_t   input;      /**< Standard input */
+} dmell_io_t;
+
+extern void dmell_io_save               ( dmell_io_t* out_io );
+extern void dmell_io_restore            ( const dmell_io_t* io );
+extern void dmell_io_set_output         ( dmell_io_kind_t kind, void* object );
+extern void dmell_io_set_input          ( dmell_io_kind_t kind, void* object );
+extern void dmell_io_set_error          ( dmell_io_kind_t kind, void* object );
+extern bool dmell_io_output_is_console  ( void );
+extern bool dmell_io_input_is_console   ( void );
+extern int  dmell_io_write              ( const char* data, size_t len );
+extern int  dmell_io_puts               ( const char* str );
+extern int  dmell_io_write_error        ( const char* data, size_t len );
+extern int  dmell_io_read               ( char* buffer, size_t size );
+extern int  dmell_io_getc               ( void );
+
+/**
+ * @brief Formats text and passes it to a write function.
+ *
+ * The text is formatted into a stack buffer, or into a heap buffer when it
+ * does not fit.
+ */
+#define DMELL_IO_FORMAT( write_fn, ... ) \
+    do \
+    { \
+        char _dmell_io_text[DMELL_IO_FORMAT_SIZE]; \
+        int _dmell_io_len = Dmod_SnPrintf( _dmell_io_text, sizeof(_dmell_io_text), __VA_ARGS__ ); \
+        if( _dmell_io_len >= 0 && (size_t)_dmell_io_len < sizeof(_dmell_io_text) ) \
+        { \
+            write_fn( _dmell_io_text, (size_t)_dmell_io_len ); \
+        } \
+        else if( _dmell_io_len > 0 ) \
+        { \
+            char* _dmell_io_big = (char*)Dmod_Malloc( (size_t)_dmell_io_len + 1 ); \
+            if( _dmell_io_big != NULL ) \
+            { \
+                Dmod_SnPrintf( _dmell_io_big, (size_t)_dmell_io_len + 1, __VA_ARGS__ ); \
+                write_fn( _dmell_io_big, (size_t)_dmell_io_len ); \
+                Dmod_Free( _dmell_io_big ); \
+            } \
+        } \
+    } while( 0 )
+
+/**
+ * @brief Prints formatted output to the standard output of the current command.
+ *
+ * Console output goes straight to Dmod_Printf. The parentheses around
+ * Dmod_Printf keep the call away from a function-like macro that redirects
+ * Dmod_Printf here.
+ */
+#define dmell_printf( ... ) \
+    do \
+    { \
+        if( dmell_io_output_is_console() ) \
+        { \
+            (Dmod_Printf)( __VA_ARGS__ ); \
+        } \
+        else \
+        { \
+            DMELL_IO_FORMAT( dmell_io_write, __VA_ARGS__ ); \
+        } \
+    } while( 0 )
+
+/**
+ * @brief Prints a formatted error message to the standard error of the current command.
+ */
+#define dmell_eprintf( ... )    DMELL_IO_FORMAT( dmell_io_write_error, __VA_ARGS__ )
+
+#endif // DMELL_IO_H
@@ -0,0 +1,41 @@
+#ifndef DMELL_JOBS_H
+#define DMELL_JOBS_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <dmosi.h>
+
+/**
+ * @file dmell_jobs.h
+ * @brief Table of the modules started in the background with '&'.
+ */
+
+/**
+ * @brief Maximum number of background jobs.
+ */
+#ifndef DMELL_JOBS_MAX
+#   define DMELL_JOBS_MAX   16
+#endif
+
+/**
+ * @brief Background job.
+ */
+typedef struct
+{
+    uint32_t            id;         /**< Job number shown to the user, 0 for a free entry */
+    int                 pid;        /**< Identifier of the dmosi process */
+    dmosi_process_t     process;    /**< Process running the module */
+    char*               command;    /**< Name of the module */
+} dmell_job_t;
+
+extern bool                 dmell_jobs_is_background    ( void );
+extern bool                 dmell_jobs_set_background   ( bool background );
+extern int                  dmell_jobs_spawn            ( const char* module, int argc, char** argv, const dmell_job_t** out_job );
+extern const dmell_job_t*   dmell_jobs_find             ( int pid );
+extern const dmell_job_t*   dmell_jobs_next             ( size_t* iterator );
+extern bool                 dmell_jobs_is_running       ( const dmell_job_t* job );
+extern int                  dmell_jobs_wait             ( int pid );
+extern int                  dmell_jobs_kill             ( int pid );
+
+#endif // DMELL_JOBS_H
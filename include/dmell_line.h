@@ -1,7 +1,11 @@
 #ifndef DMELL_LINE_H
 #define DMELL_LINE_H
 
+#include <stdbool.h>
+#include <stdint.h>
 #include "dmell_cmd.h"
+#include "dmell_io.h"
+#include "dmell_pipe.h"
 
 /**
  * @brief Enumeration of command line separators.
@@ -12,11 +16,41 @@ typedef enum
     dmell_line_sep_and,     //!< '&&' separator
     dmell_line_sep_or,      //!< '||' separator
     dmell_line_sep_seq,     //!< Semicolon or newline separator
+    dmell_line_sep_pipe,    //!< '|' separator
+    dmell_line_sep_background, //!< '&' separator - the command before it runs in the background
 
     dmell_line_sep_max      //!< Maximum value for validation
 } dmell_line_sep_t;
 
+/**
+ * @brief State of a pipeline while its commands run.
+ *
+ * The commands of a pipeline run one after another. Each one writes its
+ * output into a pipe that becomes the input of the next one, so two pipes
+ * used alternately are enough for a pipeline of any length. A pipe is
+ * released as soon as its reader finished. Only commands that run inside
+ * the shell take part in a pipeline - others are rejected (see
+ * dmell_is_output_captured). The state also tracks if the running command
+ * was followed by '&'. A zero initialized structure is a valid pipeline.
+ */
+typedef struct
+{
+    dmell_pipe_t    pipes[2];   /**< Pipes between the commands, used alternately */
+    uint8_t         current;    /**< Index of the pipe written by the running command */
+    bool            ran;        /**< The last command was executed */
+    bool            background; /**< Background mode saved when the running command started */
+    dmell_io_t      saved;      /**< Streams saved when the running command started */
+} dmell_line_pipeline_t;
+
 extern int dmell_run_line(const char* line, size_t len);
 extern int dmell_run_args_line(int argc, char** argv);
+extern const char* dmell_line_find_separator(const char* str, const char* end_ptr, dmell_line_sep_t* out_sep);
+extern const char* dmell_line_skip_separator(const char* str, const char* end_ptr, dmell_line_sep_t sep);
+extern int dmell_line_join_results(int last_exit_code, int current_exit_code, dmell_line_sep_t sep);
+extern bool dmell_line_should_execute(int last_exit_code, dmell_line_sep_t sep);
+extern bool dmell_line_pipeline_should_execute(dmell_line_pipeline_t* pipeline, int last_exit_code, dmell_line_sep_t prev_sep);
+extern void dmell_line_pipeline_begin(dmell_line_pipeline_t* pipeline, dmell_line_sep_t prev_sep, dmell_line_sep_t next_sep);
+extern int dmell_line_pipeline_end(dmell_line_pipeline_t* pipeline, dmell_line_sep_t prev_sep, dmell_line_sep_t next_sep, int exit_code);
+extern void dmell_line_pipeline_free(dmell_line_pipeline_t* pipeline);
 
 #endif // DMELL_LINE_H
\ No newline at end of file
@@ -0,0 +1,23 @@
+#ifndef DMELL_LINKED_IO_H
+#define DMELL_LINKED_IO_H
+
+/**
+ * @file dmell_linked_io.h
+ * @brief Redirects the console of command modules linked into dmell.
+ *
+ * This header is force-included into the sources of the linked command
+ * modules. dmod.h is included first, so the declarations are not affected
+ * by the macros below. Error messages go to the standard error stream, so
+ * they follow a '2>' redirection.
+ */
+
+#include <dmod.h>
+#include "dmell_io.h"
+
+#define Dmod_Printf( ... )  dmell_printf( __VA_ARGS__ )
+#define Dmod_Getc()         dmell_io_getc()
+
+#undef  DMOD_LOG_ERROR
+#define DMOD_LOG_ERROR( ... )   dmell_eprintf( __VA_ARGS__ )
+
+#endif // DMELL_LINKED_IO_H
@@ -0,0 +1,52 @@
+#ifndef DMELL_PIPE_H
+#define DMELL_PIPE_H
+
+#include <stddef.h>
+
+/**
+ * @file dmell_pipe.h
+ * @brief In-memory ring buffer that connects the commands of a pipeline.
+ */
+
+/**
+ * @brief Initial capacity of a pipe.
+ */
+#ifndef DMELL_PIPE_MIN_CAPACITY
+#   define DMELL_PIPE_MIN_CAPACITY  256
+#endif
+
+/**
+ * @brief Default limit of data that a pipe can hold.
+ *
+ * The commands of a pipeline run one after another, so a pipe holds the
+ * whole output of a command. Two pipes can exist at once, so the limit is
+ * kept small for targets with little RAM. The DMELL_PIPE_LIMIT environment
+ * variable sets another limit for the pipes of a pipeline.
+ */
+#ifndef DMELL_PIPE_DEFAULT_LIMIT
+#   define DMELL_PIPE_DEFAULT_LIMIT (8 * 1024)
+#endif
+
+/**
+ * @brief Bounded ring buffer.
+ *
+ * A zero initialized structure is a valid empty pipe with the default limit.
+ * The storage grows on demand up to the limit, so short outputs do not
+ * reserve the whole limit up front.
+ */
+typedef struct
+{
+    char*   data;       /**< Ring storage */
+    size_t  capacity;   /**< Number of bytes allocated for the storage */
+    size_t  head;       /**< Index of the oldest byte in the storage */
+    size_t  length;     /**< Number of bytes waiting to be read */
+    size_t  limit;      /**< Maximum number of bytes the pipe can hold, 0 for the default */
+    int     error;      /**< First error of a write, 0 if all data was written */
+} dmell_pipe_t;
+
+extern int      dmell_pipe_write    ( dmell_pipe_t* pipe, const char* data, size_t len );
+extern size_t   dmell_pipe_read     ( dmell_pipe_t* pipe, char* buffer, size_t size );
+extern int      dmell_pipe_getc     ( dmell_pipe_t* pipe );
+extern void     dmell_pipe_free     ( dmell_pipe_t* pipe );
+
+#endif // DMELL_PIPE_H
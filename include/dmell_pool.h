@@ -0,0 +1,71 @@
+#ifndef DMELL_POOL_H
+#define DMELL_POOL_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @file dmell_pool.h
+ * @brief Pool of command modules kept loaded between invocations.
+ *
+ * Modules of external commands are loaded and enabled once and stay
+ * resident, so running the same command again does not load and relocate
+ * the module. The least recently used modules are released when the pool
+ * exceeds its size or its memory budget. The budget is measured in module
+ * file sizes, which only approximates the memory of a loaded module.
+ *
+ * The pool releases only the modules it loaded itself. Modules loaded with
+ * the 'module' command are marked as external and are never taken over.
+ * The pool is disabled by default ('module pool size <count>' enables it).
+ */
+
+#ifndef DMELL_POOL_DEFAULT_SIZE
+/**
+ * @brief Default maximum number of modules in the pool (0 disables the pool).
+ */
+#   define DMELL_POOL_DEFAULT_SIZE      0
+#endif
+
+#ifndef DMELL_POOL_DEFAULT_BUDGET
+/**
+ * @brief Default memory budget of the pool in bytes.
+ */
+#   define DMELL_POOL_DEFAULT_BUDGET    ( 8 * 1024 )
+#endif
+
+/**
+ * @brief Module kept in the pool.
+ */
+typedef struct dmell_pool_entry_s
+{
+    char*                       name;   /**< Name of the module */
+    uint32_t                    hash;   /**< Hash of the module name */
+    size_t                      size;   /**< Size of the module file (used for the budget) */
+    struct dmell_pool_entry_s*  prev;   /**< More recently used module */
+    struct dmell_pool_entry_s*  next;   /**< Less recently used module */
+} dmell_pool_entry_t;
+
+/**
+ * @brief Statistics of the pool.
+ */
+typedef struct
+{
+    size_t      hits;           /**< Number of runs of a module that was already resident */
+    size_t      misses;         /**< Number of runs that had to load the module */
+    size_t      evictions;      /**< Number of modules released to make room */
+    size_t      count;          /**< Number of resident modules */
+    size_t      resident_bytes; /**< Size of the resident modules */
+    size_t      max_count;      /**< Maximum number of modules */
+    size_t      budget;         /**< Memory budget in bytes */
+} dmell_pool_stats_t;
+
+extern bool                         dmell_pool_acquire  ( const char* name, const char* path );
+extern void                         dmell_pool_release  ( const char* name );
+extern void                         dmell_pool_set_external( const char* name, bool external );
+extern void                         dmell_pool_flush    ( void );
+extern void                         dmell_pool_configure( size_t max_count, size_t budget );
+extern void                         dmell_pool_get_stats( dmell_pool_stats_t* out_stats );
+extern const dmell_pool_entry_t*    dmell_pool_first    ( void );
+
+#endif // DMELL_POOL_H
@@ -0,0 +1,148 @@
+#ifndef DMELL_PROG_H
+#define DMELL_PROG_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "dmell_line.h"
+#include "dmell_script.h"
+
+/**
+ * @file dmell_prog.h
+ * @brief Compiled form of dmell scripts.
+ *
+ * A script is compiled once into a flat instruction stream. Literal text is
+ * kept in a string pool, variable references are turned into slots and
+ * segments without variables are tokenized at compile time, so running the
+ * program does not need to parse the script text again. Command
+ * substitutions are kept as parts that run their command when the segment
+ * is expanded, and arithmetic expansions as parts that evaluate their
+ * expression. The 'if', 'while' and 'for' blocks are compiled into jumps,
+ * so the body of a loop runs from the same instructions in every iteration,
+ * and the body of a function is compiled into a program of its own.
+ */
+
+/**
+ * @brief Target of a jump that was not resolved yet.
+ */
+#define DMELL_PROG_NO_TARGET    UINT32_MAX
+
+/**
+ * @brief Enumeration of program instructions.
+ */
+typedef enum
+{
+    dmell_prog_op_cmd,        //!< Run a command segment
+    dmell_prog_op_status,     //!< End of a script line - publish the exit code of the line
+    dmell_prog_op_jump,       //!< Jump to the instruction in 'first' (only if the last command allows it after '&&' or '||')
+    dmell_prog_op_jump_false, //!< Jump to the instruction in 'first' if the condition failed
+    dmell_prog_op_for_init,   //!< Start a 'for' loop - the words of the loop are a segment like the one of a command
+    dmell_prog_op_for_next,   //!< Set the variable of slot 'first' to the next word, or jump to 'count' after the last one
+    dmell_prog_op_define,     //!< Define the function compiled into program 'first', named by the pool offset in 'count'
+    dmell_prog_op_return,     //!< Leave the function - the exit code is the segment, or the exit code of the last command
+
+    dmell_prog_op_max         //!< Maximum value for validation
+} dmell_prog_op_t;
+
+/**
+ * @brief Enumeration of command segment parts.
+ */
+typedef enum
+{
+    dmell_prog_part_text,   //!< Literal text from the string pool
+    dmell_prog_part_var,    //!< Reference to a variable slot
+    dmell_prog_part_cmd,    //!< Command substitution - command text from the string pool
+    dmell_prog_part_arith,  //!< Arithmetic expansion - expression text from the string pool
+
+    dmell_prog_part_max     //!< Maximum value for validation
+} dmell_prog_part_kind_t;
+
+/**
+ * @brief Part of a command segment that has to be expanded before running.
+ */
+typedef struct
+{
+    uint32_t kind;          /**< Kind of the part (dmell_prog_part_kind_t) */
+    uint32_t value;         /**< Offset of the text in the pool, or index of the variable slot */
+    uint32_t length;        /**< Length of the text */
+} dmell_prog_part_t;
+
+/**
+ * @brief Variable referenced by the program.
+ */
+typedef struct
+{
+    uint32_t name;          /**< Offset of the NUL terminated variable name in the pool */
+    uint32_t length;        /**< Length of the variable name */
+    uint32_t hash;          /**< Hash of the variable name */
+} dmell_prog_slot_t;
+
+/**
+ * @brief Single program instruction.
+ */
+typedef struct
+{
+    uint8_t  op;            /**< Operation (dmell_prog_op_t) */
+    uint8_t  sep;           /**< Separator that precedes the segment, or that ends the line for a status instruction (dmell_line_sep_t) */
+    uint16_t argc;          /**< Number of pre-tokenized arguments, 0 if the segment has to be expanded */
+    uint32_t line;          /**< Line number in the script */
+    uint32_t first;         /**< Index of the first argument when tokenized, or of the first part otherwise */
+    uint32_t count;         /**< Number of parts of the segment */
+} dmell_prog_instr_t;
+
+/**
+ * @brief Block ('if', 'while' or 'for') that is open while the program is compiled.
+ */
+typedef struct
+{
+    uint8_t  kind;          /**< Keyword that opened the block */
+    uint8_t  stage;         /**< Part of the block that is being compiled */
+    uint32_t start;         /**< Instruction that 'continue' jumps to */
+    uint32_t test;          /**< Instruction that leaves the condition, or DMELL_PROG_NO_TARGET */
+    uint32_t exits;         /**< Chain of jumps to the end of the block, linked through their targets */
+} dmell_prog_block_t;
+
+/**
+ * @brief Compiled script program.
+ */
+typedef struct dmell_prog_s
+{
+    int                 refs;           /**< Reference counter */
+    dmell_prog_instr_t* instrs;         /**< Instruction stream */
+    uint32_t            instr_count;    /**< Number of instructions */
+    uint32_t            instr_capacity; /**< Capacity of the instruction stream */
+    dmell_prog_part_t*  parts;          /**< Parts of the segments that need expansion */
+    uint32_t            part_count;     /**< Number of parts */
+    uint32_t            part_capacity;  /**< Capacity of the parts array */
+    dmell_prog_slot_t*  slots;          /**< Variable slots */
+    uint32_t            slot_count;     /**< Number of variable slots */
+    uint32_t            slot_capacity;  /**< Capacity of the slots array */
+    uint32_t*           args;           /**< Pool offsets of pre-tokenized arguments (UINT32_MAX terminates each argv) */
+    uint32_t            arg_count;      /**< Number of entries in args */
+    uint32_t            arg_capacity;   /**< Capacity of the args array */
+    char**              argv_table;     /**< Argument pointers built from args when the program is finished */
+    char*               pool;           /**< String pool */
+    uint32_t            pool_size;      /**< Used size of the string pool */
+    uint32_t            pool_capacity;  /**< Capacity of the string pool */
+    uint32_t            line_count;     /**< Number of compiled lines */
+    uint32_t            loop_count;     /**< Number of 'for' loops */
+    dmell_prog_block_t* blocks;         /**< Blocks that are open while compiling */
+    uint32_t            block_count;    /**< Number of open blocks */
+    uint32_t            block_capacity; /**< Capacity of the blocks array */
+    struct dmell_prog_s** funcs;        /**< Bodies of the functions defined in the program */
+    uint32_t            func_count;     /**< Number of functions */
+    uint32_t            func_capacity;  /**< Capacity of the funcs array */
+    struct dmell_prog_s* body;          /**< Body of the function that is being compiled, NULL if none */
+    uint32_t            body_name;      /**< Pool offset of the name of the function that is being compiled */
+    bool                is_function;    /**< True for the body of a function */
+} dmell_prog_t;
+
+extern dmell_prog_t*    dmell_prog_create       ( void );
+extern int              dmell_prog_add_line     ( dmell_prog_t* prog, const char* line, size_t len );
+extern int              dmell_prog_finish       ( dmell_prog_t* prog );
+extern dmell_prog_t*    dmell_prog_compile      ( const char* text, size_t len );
+extern dmell_prog_t*    dmell_prog_retain       ( dmell_prog_t* prog );
+extern void             dmell_prog_release      ( dmell_prog_t* prog );
+extern int              dmell_prog_run          ( dmell_prog_t* prog, dmell_script_ctx_t* ctx );
+
+#endif // DMELL_PROG_H
@@ -0,0 +1,51 @@
+#ifndef DMELL_READER_H
+#define DMELL_READER_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "dmell_buf.h"
+
+/**
+ * @file dmell_reader.h
+ * @brief Line reader of script files that reads the file in large chunks.
+ */
+
+/**
+ * @brief Number of bytes read from the file at once.
+ */
+#ifndef DMELL_READER_CHUNK_SIZE
+#   define DMELL_READER_CHUNK_SIZE      1024
+#endif
+
+/**
+ * @brief Largest file that is read with a single read into a single allocation.
+ */
+#ifndef DMELL_READER_WHOLE_FILE_MAX
+#   define DMELL_READER_WHOLE_FILE_MAX  32768
+#endif
+
+/**
+ * @brief Script file reader.
+ *
+ * Lines are found in the buffered chunks and returned in place. The buffer
+ * grows only when a single line does not fit into it. Files up to
+ * DMELL_READER_WHOLE_FILE_MAX bytes are loaded whole when they are opened,
+ * so every line is a slice of the same buffer. A zero initialized structure
+ * is a closed reader.
+ */
+typedef struct
+{
+    void*       file;       /**< File handle, NULL when the reader is closed */
+    dmell_buf_t buffer;     /**< Data read from the file */
+    size_t      start;      /**< Offset of the next line in the buffer */
+    uint32_t    line;       /**< Number of the first file line of the last returned line */
+    uint32_t    next_line;  /**< Number of the file line where the next line starts */
+    bool        eof;        /**< True when the whole file was read */
+} dmell_reader_t;
+
+extern int  dmell_reader_open       ( dmell_reader_t* reader, const char* path );
+extern int  dmell_reader_next_line  ( dmell_reader_t* reader, const char** out_line, size_t* out_len );
+extern void dmell_reader_close      ( dmell_reader_t* reader );
+
+#endif // DMELL_READER_H
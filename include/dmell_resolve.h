@@ -0,0 +1,53 @@
+#ifndef DMELL_RESOLVE_H
+#define DMELL_RESOLVE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @file dmell_resolve.h
+ * @brief Cache of the resolution of external command names.
+ *
+ * Resolving a command that is not a built-in requires file system checks
+ * (file availability, shebang, module search). The result is cached per
+ * command name until the cache is invalidated (working directory change or
+ * module management).
+ */
+
+#ifndef DMELL_RESOLVE_CACHE_SIZE
+/**
+ * @brief Number of entries of the resolution cache (power of 2).
+ */
+#   define DMELL_RESOLVE_CACHE_SIZE 64
+#endif
+
+/**
+ * @brief Enumeration of command resolution results.
+ */
+typedef enum
+{
+    dmell_resolve_not_found,    //!< Command is not available
+    dmell_resolve_script,       //!< File is a dmell script
+    dmell_resolve_shebang,      //!< File has to be run by the interpreter from its shebang
+    dmell_resolve_file,         //!< Module file given by its path
+    dmell_resolve_module,       //!< Module found by the module search, its file is at the target path
+
+    dmell_resolve_max           //!< Maximum value for validation
+} dmell_resolve_kind_t;
+
+/**
+ * @brief Resolution of a command name.
+ */
+typedef struct
+{
+    char*       name;           /**< Command name, NULL if the entry is empty */
+    const char* target;         /**< Path of the file/module, or interpreter for shebang scripts */
+    uint32_t    hash;           /**< Hash of the command name */
+    uint32_t    kind;           /**< Kind of the resolution (dmell_resolve_kind_t) */
+} dmell_resolve_t;
+
+extern const dmell_resolve_t*   dmell_resolve_command       ( const char* name );
+extern void                     dmell_resolve_invalidate    ( void );
+extern const dmell_resolve_t*   dmell_resolve_next          ( size_t* iterator );
+
+#endif // DMELL_RESOLVE_H
@@ -3,11 +3,7 @@
 
 #include "dmell_line.h"
 #include "dmell_vars.h"
-
-/** 
- * @brief Maximum length of a script line.
- */
-#define DMELL_MAX_SCRIPT_LINE_LENGTH    512 
+#include "dmell_buf.h"
 
 /** 
  * @brief Context structure for command line execution.
@@ -15,11 +11,18 @@
 typedef struct 
 {
     int last_exit_code;      /**< Exit code of the last executed command */
-    dmell_var_t* variables;  /**< Pointer to the head of the variable list */
+    dmell_vars_t variables;  /**< Variables of the script */
+    dmell_buf_t scratch;     /**< Buffer reused for expanding lines (see dmell_script_take_scratch) */
 } dmell_script_ctx_t;
 
 extern dmell_script_ctx_t g_dmell_global_script_ctx;
 
+extern dmell_script_ctx_t* dmell_script_set_current( dmell_script_ctx_t* ctx );
+extern dmell_script_ctx_t* dmell_script_get_current( void );
+extern void dmell_script_set_exit_code( dmell_script_ctx_t* ctx, int exit_code );
+extern void dmell_script_take_scratch( dmell_script_ctx_t* ctx, dmell_buf_t* out_buf );
+extern void dmell_script_give_scratch( dmell_script_ctx_t* ctx, dmell_buf_t* buf );
+extern int dmell_script_substitute( const dmell_vars_t* vars, const char* cmd, size_t len, dmell_buf_t* out );
 extern int dmell_run_script_line( dmell_script_ctx_t* ctx, const char* line, size_t len );
 extern int dmell_run_script_file(const char* file_path, int argc, char** argv);
 
@@ -1,7 +1,10 @@
 #ifndef DMELL_VARS_H
 #define DMELL_VARS_H
 
+#include <stdbool.h>
 #include <stddef.h>
+#include <stdint.h>
+#include "dmell_buf.h"
 
 #ifndef DMELL_MAX_VAR_NAME_LEN
 /**
@@ -10,20 +13,108 @@
 #   define DMELL_MAX_VAR_NAME_LEN 256
 #endif
 
+/**
+ * @brief Size of a buffer for the formatted value of a special parameter ($? or $#).
+ */
+#define DMELL_VARS_SPECIAL_SIZE 12
+
+#ifndef DMELL_VAR_INLINE_VALUE_SIZE
+/**
+ * @brief Minimum size of the value storage that is allocated together with a variable.
+ */
+#   define DMELL_VAR_INLINE_VALUE_SIZE 16
+#endif
+
+/**
+ * @brief Variable.
+ * 
+ * A variable of a store is a single allocation: the structure is followed
+ * by the name and by the storage of the value. A new value that fits into
+ * the storage is copied in place. A longer value is moved to a separate
+ * block, which is also reused by the next values that fit.
+ */
 typedef struct dmell_var_s
 {
     char* name;                 /**< Name of the variable */
     char* value;                /**< Value of the variable */
-    struct dmell_var_s* next;   /**< Pointer to the next variable in the list */
+    uint32_t hash;              /**< Hash of the name */
+    uint32_t capacity;          /**< Size of the storage of the value */
+    struct dmell_var_s* next;   /**< Next variable in the insertion order */
+    struct dmell_var_s* prev;   /**< Previous variable in the insertion order */
 } dmell_var_t;
 
-extern dmell_var_t* dmell_add_variable( dmell_var_t* head, const char* name, const char* value);
-extern dmell_var_t* dmell_find_variable( dmell_var_t* head, const char* name );
-extern dmell_var_t* dmell_remove_variable( dmell_var_t* head, const char* name );
-extern dmell_var_t* dmell_add_argv_variables( dmell_var_t* head, int argc, char** argv );
-extern void dmell_free_variables( dmell_var_t* head );
-extern dmell_var_t* dmell_set_variable( dmell_var_t* head, const char* name, const char* value );
-extern const char* dmell_get_variable_value( dmell_var_t* head, const char* name );
-extern int dmell_expand_variables( dmell_var_t* head, const char* str, size_t str_len, char* dst, size_t dst_size );
+#ifndef DMELL_VARS_ARENA_CHUNK_SIZE
+/**
+ * @brief Size of a chunk of the arena that the variables of a scope are allocated from.
+ */
+#   define DMELL_VARS_ARENA_CHUNK_SIZE 256
+#endif
+
+/**
+ * @brief Arena of a scope (defined in dmell_vars.c).
+ */
+typedef struct dmell_vars_arena_s dmell_vars_arena_t;
+
+/**
+ * @brief Variable store.
+ * 
+ * Variables are indexed by an open addressing hash table (linear probing)
+ * and linked in the insertion order for listing. A zero initialized
+ * structure is a valid empty store.
+ * 
+ * A store with a parent is a frame. The frame of a function call holds
+ * only the positional parameters ($0, $1, ...) of the call, other variables
+ * are read from and written to the parent, so it owns no memory. A frame
+ * that is a scope (a nested script) also holds its own variables. They are
+ * allocated from an arena of the scope, so ending the scope with
+ * dmell_free_variables releases them all at once. Memory of removed
+ * variables and replaced values is kept in free lists of the arena by
+ * size, so a loop that sets variables again and again reuses it. Lookups
+ * walk the frames up to the store without a parent.
+ * 
+ * The special parameters $? and $# are kept as numbers and formatted only
+ * when they are expanded.
+ */
+typedef struct dmell_vars_s
+{
+    dmell_var_t*    head;       /**< First variable in the insertion order */
+    dmell_var_t*    tail;       /**< Last variable in the insertion order */
+    dmell_var_t**   slots;      /**< Hash table */
+    size_t          capacity;   /**< Number of slots (power of 2) */
+    size_t          count;      /**< Number of variables */
+    size_t          used;       /**< Number of occupied slots, including removed ones */
+    struct dmell_vars_s* parent;/**< Store of the caller for a frame, NULL otherwise */
+    dmell_var_t*    params;     /**< Positional parameters of a frame */
+    size_t          param_count;/**< Number of positional parameters, including $0 */
+    int             status;     /**< Exit code of the last command ($?), kept by the nearest scope */
+    bool            is_scope;   /**< The frame holds its own variables */
+    struct dmell_vars_arena_s* arena; /**< Arena of a scope */
+} dmell_vars_t;
+
+/**
+ * @brief Handler that runs the command of a command substitution.
+ * 
+ * The handler appends the output of the command to the buffer and returns
+ * a negative value on error.
+ */
+typedef int (*dmell_subst_handler_t)( const dmell_vars_t* vars, const char* cmd, size_t len, dmell_buf_t* out );
+
+extern int dmell_add_variable( dmell_vars_t* vars, const char* name, const char* value);
+extern dmell_var_t* dmell_find_variable( const dmell_vars_t* vars, const char* name );
+extern dmell_var_t* dmell_find_variable_n( const dmell_vars_t* vars, const char* name, size_t name_len, uint32_t hash );
+extern int dmell_remove_variable( dmell_vars_t* vars, const char* name );
+extern int dmell_add_argv_variables( dmell_vars_t* vars, int argc, char** argv );
+extern void dmell_free_variables( dmell_vars_t* vars );
+extern void* dmell_vars_alloc( dmell_vars_t* vars, size_t size );
+extern int dmell_set_variable( dmell_vars_t* vars, const char* name, const char* value );
+extern const char* dmell_get_variable_value( const dmell_vars_t* vars, const char* name );
+extern const char* dmell_get_variable_value_n( const dmell_vars_t* vars, const char* name, size_t name_len, uint32_t hash, char* special );
+extern void dmell_set_status( dmell_vars_t* vars, int status );
+extern const char* dmell_find_next_variable( const char* str, const char* end_ptr, const char** out_name, size_t* out_name_len, const char** out_ref_end );
+extern const char* dmell_find_next_reference( const char* str, const char* end_ptr, bool* out_is_cmd, const char** out_name, size_t* out_name_len, const char** out_ref_end );
+extern void dmell_set_substitution_handler( dmell_subst_handler_t handler );
+extern int dmell_substitute_command( const dmell_vars_t* vars, const char* cmd, size_t len, dmell_buf_t* buf );
+extern int dmell_expand_variables( const dmell_vars_t* vars, const char* str, size_t str_len, char* dst, size_t dst_size );
+extern int dmell_expand_variables_to_buf( const dmell_vars_t* vars, const char* str, size_t str_len, dmell_buf_t* buf );
 
 #endif // DMELL_VARS_H
\ No newline at end of file
@@ -0,0 +1,38 @@
+#ifndef DMELL_WRITER_H
+#define DMELL_WRITER_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/**
+ * @file dmell_writer.h
+ * @brief Buffered file writer used for the output of commands.
+ */
+
+/**
+ * @brief Size of the buffer of a file writer.
+ */
+#ifndef DMELL_WRITER_BUFFER_SIZE
+#   define DMELL_WRITER_BUFFER_SIZE     1024
+#endif
+
+/**
+ * @brief File writer that collects small writes into large blocks.
+ *
+ * A zero initialized structure is a closed writer.
+ */
+typedef struct
+{
+    void*   file;       /**< File handle, NULL when the writer is closed */
+    char*   buffer;     /**< Data waiting to be written */
+    size_t  length;     /**< Number of bytes in the buffer */
+    int     error;      /**< First error that occurred while writing */
+} dmell_writer_t;
+
+extern int  dmell_writer_attach ( dmell_writer_t* writer, void* file );
+extern int  dmell_writer_open   ( dmell_writer_t* writer, const char* path, bool append );
+extern int  dmell_writer_write  ( dmell_writer_t* writer, const char* data, size_t len );
+extern int  dmell_writer_flush  ( dmell_writer_t* writer );
+extern int  dmell_writer_close  ( dmell_writer_t* writer );
+
+#endif // DMELL_WRITER_H
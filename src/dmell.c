@@ -1,6 +1,7 @@
 #include "dmell.h"
 #include <string.h>
 #include "dmell_handlers.h"
+#include "dmell_pool.h"
 
 /**
  * @brief Helper function to print help information.
@@ -45,7 +46,6 @@ int main(int argc, char** argv)
     {
         const char* script_file = argv[1];
         dmell_register_handlers();
-        g_dmell_global_script_ctx.variables = dmell_add_argv_variables( g_dmell_global_script_ctx.variables, argc - 1, &argv[1] );
         result = dmell_run_script_file( script_file, argc - 1, &argv[1] );
     }
     else if(argc == 3 && strcmp( argv[1], "-c" ) == 0 )
@@ -65,6 +65,7 @@ int main(int argc, char** argv)
 
         result = -1;
     }
+    dmell_pool_flush();
     Dmod_EnvCtx_Pop();
     return result;
 }
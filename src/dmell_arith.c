@@ -0,0 +1,538 @@
+#include <errno.h>
+#include <string.h>
+#include <stdbool.h>
+#include <limits.h>
+#include "dmell_arith.h"
+#include "dmell_hlp.h"
+#include "dmod.h"
+
+/**
+ * @brief Binary operators.
+ */
+typedef enum
+{
+    arith_op_none,
+    arith_op_or,
+    arith_op_and,
+    arith_op_bit_or,
+    arith_op_bit_xor,
+    arith_op_bit_and,
+    arith_op_eq,
+    arith_op_ne,
+    arith_op_le,
+    arith_op_ge,
+    arith_op_lt,
+    arith_op_gt,
+    arith_op_shl,
+    arith_op_shr,
+    arith_op_add,
+    arith_op_sub,
+    arith_op_mul,
+    arith_op_div,
+    arith_op_mod,
+} arith_op_t;
+
+/**
+ * @brief Definition of a binary operator.
+ */
+typedef struct
+{
+    const char* text;       /**< Text of the operator */
+    arith_op_t  op;         /**< Operator */
+    int         precedence; /**< Precedence, higher binds stronger */
+} arith_op_def_t;
+
+/**
+ * @brief Binary operators - longer operators are before their prefixes.
+ */
+static const arith_op_def_t g_ops[] = {
+    { "||", arith_op_or,        1 },
+    { "&&", arith_op_and,       2 },
+    { "|",  arith_op_bit_or,    3 },
+    { "^",  arith_op_bit_xor,   4 },
+    { "&",  arith_op_bit_and,   5 },
+    { "==", arith_op_eq,        6 },
+    { "!=", arith_op_ne,        6 },
+    { "<<", arith_op_shl,       8 },
+    { ">>", arith_op_shr,       8 },
+    { "<=", arith_op_le,        7 },
+    { ">=", arith_op_ge,        7 },
+    { "<",  arith_op_lt,        7 },
+    { ">",  arith_op_gt,        7 },
+    { "+",  arith_op_add,       9 },
+    { "-",  arith_op_sub,       9 },
+    { "*",  arith_op_mul,       10 },
+    { "/",  arith_op_div,       10 },
+    { "%",  arith_op_mod,       10 },
+};
+
+/**
+ * @brief State of the evaluation.
+ */
+typedef struct
+{
+    const dmell_vars_t* vars;       /**< Variable store */
+    const char*         ptr;        /**< Current position in the expression */
+    const char*         end_ptr;    /**< End of the expression */
+    const char*         expr;       /**< Start of the expression, for error messages */
+    int                 depth;      /**< Current nesting */
+    int                 skip;       /**< Greater than 0 in the operand that '&&' or '||' does not need */
+    int                 error;      /**< First error, or 0 */
+} arith_state_t;
+
+static long parse_expression( arith_state_t* state, int min_precedence );
+
+/**
+ * @brief Helper function to report an error in the expression.
+ *
+ * Only the first error is kept.
+ *
+ * @param state State of the evaluation
+ * @param error Negative error code
+ * @param message Description of the error
+ */
+static void set_error( arith_state_t* state, int error, const char* message )
+{
+    if( state->error == 0 )
+    {
+        DMOD_LOG_ERROR("Arithmetic error: %s in '%.*s'\n", message, (int)( state->end_ptr - state->expr ), state->expr);
+        state->error = error;
+    }
+}
+
+/**
+ * @brief Helper function to check if a character can start a variable name.
+ *
+ * @param c Character to check
+ * @return true If the character is a letter or '_'
+ * @return false Otherwise
+ */
+static bool is_name_start( char c )
+{
+    return ( c >= 'A' && c <= 'Z' ) || ( c >= 'a' && c <= 'z' ) || c == '_';
+}
+
+/**
+ * @brief Helper function to get the value of a digit in any base up to 16.
+ *
+ * @param c Character to check
+ * @return int Value of the digit, or -1 if it is not a digit
+ */
+static int digit_value( char c )
+{
+    if( c >= '0' && c <= '9' )
+    {
+        return c - '0';
+    }
+    if( c >= 'a' && c <= 'f' )
+    {
+        return c - 'a' + 10;
+    }
+    if( c >= 'A' && c <= 'F' )
+    {
+        return c - 'A' + 10;
+    }
+    return -1;
+}
+
+/**
+ * @brief Helper function to parse an integer - decimal, or hexadecimal after '0x'.
+ *
+ * @param str Start of the number
+ * @param end_ptr End of the text
+ * @param out_value Output parameter to hold the value
+ * @return const char* Position after the number, or NULL if it is not a valid number
+ */
+static const char* parse_number( const char* str, const char* end_ptr, long* out_value )
+{
+    const char* ptr = str;
+    int base = 10;
+    if( end_ptr - ptr > 2 && ptr[0] == '0' && ( ptr[1] == 'x' || ptr[1] == 'X' ) )
+    {
+        base = 16;
+        ptr += 2;
+    }
+
+    const char* digits = ptr;
+    unsigned long value = 0;
+    for( int digit = 0; ptr < end_ptr && ( digit = digit_value( *ptr ) ) >= 0 && digit < base; ptr++ )
+    {
+        value = value * (unsigned long)base + (unsigned long)digit;
+    }
+    if( ptr == digits || ( ptr < end_ptr && ( is_name_start( *ptr ) || digit_value( *ptr ) >= 0 ) ) )
+    {
+        return NULL;
+    }
+    *out_value = (long)value;
+    return ptr;
+}
+
+/**
+ * @brief Helper function to get the value of a variable as a number.
+ *
+ * A variable that is not set, or is empty, is 0.
+ *
+ * @param state State of the evaluation
+ * @param name Name of the variable
+ * @param name_len Length of the name
+ * @return long Value of the variable
+ */
+static long get_variable( arith_state_t* state, const char* name, size_t name_len )
+{
+    if( name_len == 0 || name_len >= DMELL_MAX_VAR_NAME_LEN )
+    {
+        set_error( state, -EINVAL, "invalid variable name" );
+        return 0;
+    }
+
+    char special[DMELL_VARS_SPECIAL_SIZE];
+    const char* value = dmell_get_variable_value_n( state->vars, name, name_len, dmell_hash_name( name, name_len ), special );
+    if( value == NULL )
+    {
+        return 0;
+    }
+
+    const char* end_ptr = value + strlen( value );
+    const char* ptr = dmell_skip_whitespaces( value, end_ptr );
+    if( ptr == end_ptr )
+    {
+        return 0;
+    }
+    bool negative = ( *ptr == '-' );
+    ptr += ( *ptr == '-' || *ptr == '+' ) ? 1 : 0;
+
+    long number = 0;
+    ptr = parse_number( ptr, end_ptr, &number );
+    if( ptr == NULL || dmell_skip_whitespaces( ptr, end_ptr ) != end_ptr )
+    {
+        set_error( state, -EINVAL, "variable is not a number" );
+        return 0;
+    }
+    return negative ? (long)( 0UL - (unsigned long)number ) : number;
+}
+
+/**
+ * @brief Helper function to parse a variable reference - NAME, $NAME, ${NAME} or $1.
+ *
+ * @param state State of the evaluation
+ * @return long Value of the variable
+ */
+static long parse_variable( arith_state_t* state )
+{
+    const char* ptr = state->ptr;
+    bool braced = false;
+    if( *ptr == '$' )
+    {
+        ptr++;
+        braced = ( ptr < state->end_ptr && *ptr == '{' );
+        ptr += braced ? 1 : 0;
+    }
+
+    const char* name = ptr;
+    if( ptr < state->end_ptr && *ptr >= '0' && *ptr <= '9' && name != state->ptr )
+    {
+        while( ptr < state->end_ptr && *ptr >= '0' && *ptr <= '9' )
+        {
+            ptr++;
+        }
+    }
+    else if( ptr < state->end_ptr && is_name_start( *ptr ) )
+    {
+        while( ptr < state->end_ptr && ( is_name_start( *ptr ) || ( *ptr >= '0' && *ptr <= '9' ) ) )
+        {
+            ptr++;
+        }
+    }
+    const char* name_end = ptr;
+    if( braced )
+    {
+        if( ptr >= state->end_ptr || *ptr != '}' )
+        {
+            set_error( state, -EINVAL, "missing '}'" );
+            return 0;
+        }
+        ptr++;
+    }
+
+    state->ptr = ptr;
+    return get_variable( state, name, name_end - name );
+}
+
+/**
+ * @brief Helper function to parse an operand - a number, a variable, an expression in parentheses or a unary operator.
+ *
+ * @param state State of the evaluation
+ * @return long Value of the operand
+ */
+static long parse_operand( arith_state_t* state )
+{
+    state->ptr = dmell_skip_whitespaces( state->ptr, state->end_ptr );
+    if( state->ptr >= state->end_ptr )
+    {
+        set_error( state, -EINVAL, "missing operand" );
+        return 0;
+    }
+    if( state->depth >= DMELL_ARITH_MAX_DEPTH )
+    {
+        set_error( state, -EINVAL, "expression nested too deeply" );
+        return 0;
+    }
+
+    long value = 0;
+    char c = *state->ptr;
+    state->depth++;
+    if( c == '(' )
+    {
+        state->ptr++;
+        value = parse_expression( state, 1 );
+        state->ptr = dmell_skip_whitespaces( state->ptr, state->end_ptr );
+        if( state->ptr < state->end_ptr && *state->ptr == ')' )
+        {
+            state->ptr++;
+        }
+        else
+        {
+            set_error( state, -EINVAL, "missing ')'" );
+        }
+    }
+    else if( c == '-' || c == '+' || c == '!' || c == '~' )
+    {
+        state->ptr++;
+        value = parse_operand( state );
+        value = ( c == '-' ) ? (long)( 0UL - (unsigned long)value ) :
+                ( c == '!' ) ? !value :
+                ( c == '~' ) ? ~value : value;
+    }
+    else if( c >= '0' && c <= '9' )
+    {
+        const char* ptr = parse_number( state->ptr, state->end_ptr, &value );
+        if( ptr == NULL )
+        {
+            set_error( state, -EINVAL, "invalid number" );
+            ptr = state->end_ptr;
+        }
+        state->ptr = ptr;
+    }
+    else if( c == '$' || is_name_start( c ) )
+    {
+        value = parse_variable( state );
+    }
+    else
+    {
+        set_error( state, -EINVAL, "unexpected character" );
+    }
+    state->depth--;
+    return value;
+}
+
+/**
+ * @brief Helper function to find the binary operator at the current position.
+ *
+ * @param state State of the evaluation
+ * @return const arith_op_def_t* Operator, or NULL if there is none
+ */
+static const arith_op_def_t* peek_operator( arith_state_t* state )
+{
+    state->ptr = dmell_skip_whitespaces( state->ptr, state->end_ptr );
+    size_t left = state->end_ptr - state->ptr;
+    for( size_t i = 0; i < sizeof(g_ops) / sizeof(g_ops[0]); i++ )
+    {
+        size_t len = strlen( g_ops[i].text );
+        if( len <= left && memcmp( state->ptr, g_ops[i].text, len ) == 0 )
+        {
+            return &g_ops[i];
+        }
+    }
+    return NULL;
+}
+
+/**
+ * @brief Helper function to apply a binary operator.
+ *
+ * Addition, subtraction and multiplication wrap around instead of
+ * overflowing.
+ *
+ * @param state State of the evaluation
+ * @param op Operator
+ * @param lhs Left operand
+ * @param rhs Right operand
+ * @return long Result of the operation
+ */
+static long apply_operator( arith_state_t* state, arith_op_t op, long lhs, long rhs )
+{
+    unsigned long shift = (unsigned long)rhs % ( sizeof(long) * CHAR_BIT );
+    switch( op )
+    {
+        case arith_op_or:       return lhs || rhs;
+        case arith_op_and:      return lhs && rhs;
+        case arith_op_bit_or:   return lhs | rhs;
+        case arith_op_bit_xor:  return lhs ^ rhs;
+        case arith_op_bit_and:  return lhs & rhs;
+        case arith_op_eq:       return lhs == rhs;
+        case arith_op_ne:       return lhs != rhs;
+        case arith_op_le:       return lhs <= rhs;
+        case arith_op_ge:       return lhs >= rhs;
+        case arith_op_lt:       return lhs < rhs;
+        case arith_op_gt:       return lhs > rhs;
+        case arith_op_shl:      return (long)( (unsigned long)lhs << shift );
+        case arith_op_shr:      return lhs >> shift;
+        case arith_op_add:      return (long)( (unsigned long)lhs + (unsigned long)rhs );
+        case arith_op_sub:      return (long)( (unsigned long)lhs - (unsigned long)rhs );
+        case arith_op_mul:      return (long)( (unsigned long)lhs * (unsigned long)rhs );
+        case arith_op_div:
+        case arith_op_mod:
+            if( rhs == 0 )
+            {
+                if( state->skip == 0 )
+                {
+                    set_error( state, -EDOM, "division by zero" );
+                }
+                return 0;
+            }
+            if( rhs == -1 )
+            {
+                // Avoids the overflow of LONG_MIN / -1
+                return ( op == arith_op_div ) ? (long)( 0UL - (unsigned long)lhs ) : 0;
+            }
+            return ( op == arith_op_div ) ? lhs / rhs : lhs % rhs;
+        default:
+            return 0;
+    }
+}
+
+/**
+ * @brief Helper function to parse an expression by precedence climbing.
+ *
+ * @param state State of the evaluation
+ * @param min_precedence Lowest precedence of the operators that belong to this expression
+ * @return long Value of the expression
+ */
+static long parse_expression( arith_state_t* state, int min_precedence )
+{
+    long lhs = parse_operand( state );
+    const arith_op_def_t* op = NULL;
+    while( state->error == 0 && ( op = peek_operator( state ) ) != NULL && op->precedence >= min_precedence )
+    {
+        state->ptr += strlen( op->text );
+
+        // The right operand of '&&' and '||' is not needed when the left one decides the result
+        bool skip = ( op->op == arith_op_and && lhs == 0 ) || ( op->op == arith_op_or && lhs != 0 );
+        state->skip += skip ? 1 : 0;
+        long rhs = parse_expression( state, op->precedence + 1 );
+        state->skip -= skip ? 1 : 0;
+        lhs = apply_operator( state, op->op, lhs, rhs );
+    }
+    return lhs;
+}
+
+/**
+ * @brief Checks if the text of a command substitution is an arithmetic expansion.
+ *
+ * The text of "$((expression))" is "(expression)" - it is an arithmetic
+ * expansion when the first parenthesis is closed by the last one.
+ *
+ * @param cmd Text of the command substitution
+ * @param len Length of the text
+ * @param out_expr [optional] Output parameter to hold the start of the expression
+ * @param out_expr_len [optional] Output parameter to hold the length of the expression
+ * @return true If the substitution is an arithmetic expansion
+ * @return false Otherwise
+ */
+bool dmell_arith_is_expansion( const char* cmd, size_t len, const char** out_expr, size_t* out_expr_len )
+{
+    if( cmd == NULL || len < 2 || cmd[0] != '(' || cmd[len - 1] != ')' )
+    {
+        return false;
+    }
+
+    int depth = 0;
+    for( size_t i = 0; i < len - 1; i++ )
+    {
+        depth += ( cmd[i] == '(' ) ? 1 : ( cmd[i] == ')' ) ? -1 : 0;
+        if( depth == 0 )
+        {
+            return false;
+        }
+    }
+    if( out_expr != NULL )
+    {
+        *out_expr = cmd + 1;
+    }
+    if( out_expr_len != NULL )
+    {
+        *out_expr_len = len - 2;
+    }
+    return true;
+}
+
+/**
+ * @brief Evaluates an integer expression.
+ *
+ * Supports decimal and hexadecimal numbers, variables (NAME, $NAME, ${NAME},
+ * $1), parentheses, the unary operators - + ! ~ and the binary operators
+ * * / % + - << >> < <= > >= == != & ^ | && || with the precedence of C.
+ * Nothing is allocated while evaluating.
+ *
+ * @param vars Variable store
+ * @param expr Expression (does not have to be null terminated)
+ * @param len Length of the expression
+ * @param out_value Output parameter to hold the value
+ * @return int 0 on success, negative value on error
+ */
+int dmell_arith_eval( const dmell_vars_t* vars, const char* expr, size_t len, long* out_value )
+{
+    if( expr == NULL || out_value == NULL )
+    {
+        DMOD_LOG_ERROR("Invalid arguments to dmell_arith_eval: %p, %p\n", expr, out_value);
+        return -EINVAL;
+    }
+
+    arith_state_t state = {
+        .vars       = vars,
+        .ptr        = expr,
+        .end_ptr    = expr + len,
+        .expr       = expr,
+        .depth      = 0,
+        .skip       = 0,
+        .error      = 0
+    };
+    long value = parse_expression( &state, 1 );
+    if( state.error == 0 && dmell_skip_whitespaces( state.ptr, state.end_ptr ) < state.end_ptr )
+    {
+        set_error( &state, -EINVAL, "unexpected character" );
+    }
+    if( state.error < 0 )
+    {
+        return state.error;
+    }
+    *out_value = value;
+    return 0;
+}
+
+/**
+ * @brief Evaluates an integer expression and formats its value.
+ *
+ * @param vars Variable store
+ * @param expr Expression (does not have to be null terminated)
+ * @param len Length of the expression
+ * @param dst Destination buffer, DMELL_ARITH_RESULT_SIZE bytes are always enough
+ * @param dst_size Size of the destination buffer
+ * @return int Length of the formatted value, or negative value on error
+ */
+int dmell_arith_expand( const dmell_vars_t* vars, const char* expr, size_t len, char* dst, size_t dst_size )
+{
+    if( dst == NULL || dst_size == 0 )
+    {
+        DMOD_LOG_ERROR("Invalid destination passed to dmell_arith_expand: %p, %zu\n", dst, dst_size);
+        return -EINVAL;
+    }
+
+    long value = 0;
+    int result = dmell_arith_eval( vars, expr, len, &value );
+    if( result < 0 )
+    {
+        return result;
+    }
+    result = Dmod_SnPrintf( dst, dst_size, "%ld", value );
+    return ( result < 0 || (size_t)result >= dst_size ) ? -ENOSPC : result;
+}
@@ -0,0 +1,114 @@
+#include <errno.h>
+#include <string.h>
+#include "dmell_buf.h"
+#include "dmod.h"
+
+/**
+ * @brief Minimum capacity of a buffer.
+ */
+#define DMELL_BUF_MIN_CAPACITY  64
+
+/**
+ * @brief Makes sure that the buffer can hold additional characters.
+ * 
+ * The capacity grows geometrically, so appending many small pieces costs
+ * only a logarithmic number of reallocations.
+ * 
+ * @param buf Buffer to grow
+ * @param extra Number of characters that have to fit after the current content
+ * @return int 0 on success, negative value on error
+ */
+int dmell_buf_reserve( dmell_buf_t* buf, size_t extra )
+{
+    if( buf == NULL )
+    {
+        DMOD_LOG_ERROR("Invalid buffer passed to dmell_buf_reserve\n");
+        return -EINVAL;
+    }
+
+    size_t needed = buf->length + extra + 1;
+    if( needed <= buf->capacity )
+    {
+        return 0;
+    }
+
+    size_t new_capacity = buf->capacity > 0 ? buf->capacity : DMELL_BUF_MIN_CAPACITY;
+    while( new_capacity < needed )
+    {
+        new_capacity *= 2;
+    }
+
+    char* new_data = Dmod_Realloc( buf->data, new_capacity );
+    if( new_data == NULL )
+    {
+        DMOD_LOG_ERROR("Memory allocation failed in dmell_buf_reserve for %zu bytes\n", new_capacity);
+        return -ENOMEM;
+    }
+
+    buf->data = new_data;
+    buf->capacity = new_capacity;
+    buf->data[buf->length] = '\0';
+    return 0;
+}
+
+/**
+ * @brief Appends characters to the buffer.
+ * 
+ * @param buf Buffer to append to
+ * @param str Characters to append
+ * @param len Number of characters to append
+ * @return int 0 on success, negative value on error
+ */
+int dmell_buf_append( dmell_buf_t* buf, const char* str, size_t len )
+{
+    int result = dmell_buf_reserve( buf, len );
+    if( result < 0 )
+    {
+        return result;
+    }
+
+    if( len > 0 )
+    {
+        memcpy( &buf->data[buf->length], str, len );
+        buf->length += len;
+    }
+    buf->data[buf->length] = '\0';
+    return 0;
+}
+
+/**
+ * @brief Removes the content of the buffer, keeping its memory.
+ * 
+ * @param buf Buffer to clear
+ */
+void dmell_buf_clear( dmell_buf_t* buf )
+{
+    if( buf == NULL )
+    {
+        return;
+    }
+
+    buf->length = 0;
+    if( buf->data != NULL )
+    {
+        buf->data[0] = '\0';
+    }
+}
+
+/**
+ * @brief Frees the memory of the buffer.
+ * 
+ * @param buf Buffer to free
+ */
+void dmell_buf_free( dmell_buf_t* buf )
+{
+    if( buf == NULL )
+    {
+        return;
+    }
+
+    Dmod_Free( buf->data );
+    buf->data = NULL;
+    buf->length = 0;
+    buf->capacity = 0;
+}
@@ -0,0 +1,441 @@
+#include <errno.h>
+#include <string.h>
+#include <stdbool.h>
+#include "dmell_cache.h"
+#include "dmell_writer.h"
+#include "dmell_hlp.h"
+#include "dmod.h"
+
+/**
+ * @brief Marker at the start of a cache file ("DMEC").
+ */
+#define DMELL_CACHE_MAGIC       0x43454D44u
+
+/**
+ * @brief Maximum nesting of functions in a cache file.
+ */
+#define DMELL_CACHE_MAX_DEPTH   16
+
+/**
+ * @brief Header of a cache file.
+ */
+typedef struct
+{
+    uint32_t magic;         /**< DMELL_CACHE_MAGIC */
+    uint32_t version;       /**< DMELL_CACHE_VERSION */
+    uint32_t source_size;   /**< Size of the script the program was compiled from */
+    uint32_t source_hash;   /**< Hash of the script the program was compiled from */
+} cache_header_t;
+
+/**
+ * @brief Sizes of the arrays of a program in a cache file.
+ */
+typedef struct
+{
+    uint32_t instr_count;   /**< Number of instructions */
+    uint32_t part_count;    /**< Number of parts */
+    uint32_t slot_count;    /**< Number of variable slots */
+    uint32_t arg_count;     /**< Number of entries in args */
+    uint32_t pool_size;     /**< Size of the string pool */
+    uint32_t line_count;    /**< Number of compiled lines */
+    uint32_t loop_count;    /**< Number of 'for' loops */
+    uint32_t func_count;    /**< Number of functions */
+} cache_prog_t;
+
+/**
+ * @brief Position in a cache file that is being loaded.
+ */
+typedef struct
+{
+    const char* ptr;        /**< Current position */
+    const char* end_ptr;    /**< End of the data */
+} cache_cursor_t;
+
+/**
+ * @brief Gets the path of the cache file of a script.
+ *
+ * "script.dme" is cached as "script.dmec". When DMELL_CACHE_DIR is set, the
+ * cache file is "<dir>/<name>.<hash of the path>.dmec", so scripts on a
+ * read-only filesystem can be cached too.
+ *
+ * @param script_path Path of the script
+ * @return char* Path of the cache file (free with Dmod_Free), or NULL if the cache is disabled
+ */
+char* dmell_cache_get_path( const char* script_path )
+{
+    const char* enabled = Dmod_GetEnv( "DMELL_CACHE" );
+    if( script_path == NULL || ( enabled != NULL && strcmp( enabled, "0" ) == 0 ) )
+    {
+        return NULL;
+    }
+
+    size_t path_len = strlen( script_path );
+    const char* dir = Dmod_GetEnv( "DMELL_CACHE_DIR" );
+    size_t size = path_len + ( dir != NULL ? strlen( dir ) + 10 : 0 ) + sizeof(DMELL_CACHE_EXTENSION);
+    char* cache_path = Dmod_Malloc( size );
+    if( cache_path == NULL )
+    {
+        DMOD_LOG_ERROR("Memory allocation failed in dmell_cache_get_path\n");
+        return NULL;
+    }
+
+    if( dir != NULL && *dir != '\0' )
+    {
+        const char* name = strrchr( script_path, '/' );
+        name = ( name != NULL ) ? name + 1 : script_path;
+        Dmod_SnPrintf( cache_path, size, "%s/%s.%08x%s", dir, name, (unsigned)dmell_hash_name( script_path, path_len ), DMELL_CACHE_EXTENSION );
+    }
+    else if( path_len > 4 && strcmp( &script_path[path_len - 4], ".dme" ) == 0 )
+    {
+        Dmod_SnPrintf( cache_path, size, "%sc", script_path );
+    }
+    else
+    {
+        Dmod_SnPrintf( cache_path, size, "%s%s", script_path, DMELL_CACHE_EXTENSION );
+    }
+    return cache_path;
+}
+
+/**
+ * @brief Helper function to take data from the cache file.
+ *
+ * @param cursor Position in the cache file
+ * @param dst Destination of the data
+ * @param size Number of bytes to take
+ * @return true If the data was taken
+ * @return false If the file is too short
+ */
+static bool read_data( cache_cursor_t* cursor, void* dst, size_t size )
+{
+    if( (size_t)( cursor->end_ptr - cursor->ptr ) < size )
+    {
+        return false;
+    }
+    if( size > 0 )
+    {
+        memcpy( dst, cursor->ptr, size );
+    }
+    cursor->ptr += size;
+    return true;
+}
+
+/**
+ * @brief Helper function to take an array from the cache file.
+ *
+ * @param cursor Position in the cache file
+ * @param out_array Output parameter to hold the allocated array, NULL when it is empty
+ * @param count Number of items
+ * @param item_size Size of a single item
+ * @return true If the array was taken
+ * @return false If the file is too short or the memory cannot be allocated
+ */
+static bool read_array( cache_cursor_t* cursor, void** out_array, uint32_t count, size_t item_size )
+{
+    if( count == 0 )
+    {
+        return true;
+    }
+    if( (size_t)( cursor->end_ptr - cursor->ptr ) / item_size < count )
+    {
+        return false;
+    }
+
+    *out_array = Dmod_Malloc( count * item_size );
+    return *out_array != NULL && read_data( cursor, *out_array, count * item_size );
+}
+
+/**
+ * @brief Helper function to check that a string is in the pool.
+ *
+ * @param prog Loaded program
+ * @param offset Offset of the string
+ * @param length Length of the string
+ * @return true If the string and its terminator are in the pool
+ * @return false Otherwise
+ */
+static bool is_pool_string( const dmell_prog_t* prog, uint32_t offset, uint32_t length )
+{
+    return offset < prog->pool_size && length < prog->pool_size - offset && prog->pool[offset + length] == '\0';
+}
+
+/**
+ * @brief Helper function to check the segment of an instruction.
+ *
+ * @param prog Loaded program
+ * @param instr Instruction with a command segment
+ * @return true If the arguments or the parts of the segment are in the program
+ * @return false Otherwise
+ */
+static bool is_valid_segment( const dmell_prog_t* prog, const dmell_prog_instr_t* instr )
+{
+    if( instr->argc > 0 )
+    {
+        return instr->first < prog->arg_count && instr->argc < prog->arg_count - instr->first &&
+               prog->args[instr->first + instr->argc] == UINT32_MAX;
+    }
+    return instr->first <= prog->part_count && instr->count <= prog->part_count - instr->first;
+}
+
+/**
+ * @brief Helper function to check that a loaded program cannot access memory outside of its arrays.
+ *
+ * @param prog Loaded program
+ * @return true If all indices and offsets are valid
+ * @return false Otherwise
+ */
+static bool is_valid_program( const dmell_prog_t* prog )
+{
+    if( prog->pool_size > 0 && prog->pool[prog->pool_size - 1] != '\0' )
+    {
+        return false;
+    }
+    for( uint32_t i = 0; i < prog->slot_count; i++ )
+    {
+        if( !is_pool_string( prog, prog->slots[i].name, prog->slots[i].length ) )
+        {
+            return false;
+        }
+    }
+    for( uint32_t i = 0; i < prog->arg_count; i++ )
+    {
+        if( prog->args[i] != UINT32_MAX && prog->args[i] >= prog->pool_size )
+        {
+            return false;
+        }
+    }
+    for( uint32_t i = 0; i < prog->part_count; i++ )
+    {
+        const dmell_prog_part_t* part = &prog->parts[i];
+        bool valid = ( part->kind == dmell_prog_part_var ) ? part->value < prog->slot_count
+                                                           : part->kind < dmell_prog_part_max && is_pool_string( prog, part->value, part->length );
+        if( !valid )
+        {
+            return false;
+        }
+    }
+    for( uint32_t i = 0; i < prog->instr_count; i++ )
+    {
+        const dmell_prog_instr_t* instr = &prog->instrs[i];
+        bool valid = false;
+        switch( instr->op )
+        {
+            case dmell_prog_op_cmd:
+            case dmell_prog_op_return:
+                valid = is_valid_segment( prog, instr );
+                break;
+            case dmell_prog_op_for_init:
+                valid = is_valid_segment( prog, instr ) && i + 1 < prog->instr_count &&
+                        prog->instrs[i + 1].op == dmell_prog_op_for_next;
+                break;
+            case dmell_prog_op_for_next:
+                valid = instr->argc < prog->loop_count && instr->first < prog->slot_count && instr->count <= prog->instr_count;
+                break;
+            case dmell_prog_op_jump:
+            case dmell_prog_op_jump_false:
+                valid = instr->first <= prog->instr_count;
+                break;
+            case dmell_prog_op_define:
+                valid = instr->first < prog->func_count && instr->count < prog->pool_size;
+                break;
+            case dmell_prog_op_status:
+                valid = true;
+                break;
+            default:
+                break;
+        }
+        if( !valid )
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * @brief Helper function to load a program and its functions from the cache file.
+ *
+ * @param cursor Position in the cache file
+ * @param depth Nesting of the program
+ * @return dmell_prog_t* Loaded program, or NULL if the data is invalid
+ */
+static dmell_prog_t* load_program( cache_cursor_t* cursor, int depth )
+{
+    cache_prog_t sizes;
+    if( depth > DMELL_CACHE_MAX_DEPTH || !read_data( cursor, &sizes, sizeof(sizes) ) )
+    {
+        return NULL;
+    }
+
+    dmell_prog_t* prog = dmell_prog_create();
+    if( prog == NULL )
+    {
+        return NULL;
+    }
+    prog->instr_count = prog->instr_capacity = sizes.instr_count;
+    prog->part_count  = prog->part_capacity  = sizes.part_count;
+    prog->slot_count  = prog->slot_capacity  = sizes.slot_count;
+    prog->arg_count   = prog->arg_capacity   = sizes.arg_count;
+    prog->pool_size   = prog->pool_capacity  = sizes.pool_size;
+    prog->line_count  = sizes.line_count;
+    prog->loop_count  = sizes.loop_count;
+    prog->is_function = ( depth > 0 );
+
+    bool valid = read_array( cursor, (void**)&prog->instrs, sizes.instr_count, sizeof(dmell_prog_instr_t) ) &&
+                 read_array( cursor, (void**)&prog->parts, sizes.part_count, sizeof(dmell_prog_part_t) ) &&
+                 read_array( cursor, (void**)&prog->slots, sizes.slot_count, sizeof(dmell_prog_slot_t) ) &&
+                 read_array( cursor, (void**)&prog->args, sizes.arg_count, sizeof(uint32_t) ) &&
+                 read_array( cursor, (void**)&prog->pool, sizes.pool_size, sizeof(char) );
+    if( valid && sizes.func_count > 0 )
+    {
+        // Every function takes at least its sizes, which bounds the allocation
+        valid = ( (size_t)( cursor->end_ptr - cursor->ptr ) / sizeof(cache_prog_t) >= sizes.func_count );
+        prog->funcs = valid ? Dmod_Malloc( sizeof(dmell_prog_t*) * sizes.func_count ) : NULL;
+        prog->func_capacity = ( prog->funcs != NULL ) ? sizes.func_count : 0;
+        valid = ( prog->funcs != NULL );
+    }
+    while( valid && prog->func_count < sizes.func_count )
+    {
+        prog->funcs[prog->func_count] = load_program( cursor, depth + 1 );
+        valid = ( prog->funcs[prog->func_count] != NULL );
+        prog->func_count += valid ? 1 : 0;
+    }
+
+    if( !valid || prog->func_count != sizes.func_count || !is_valid_program( prog ) || dmell_prog_finish( prog ) < 0 )
+    {
+        dmell_prog_release( prog );
+        return NULL;
+    }
+    return prog;
+}
+
+/**
+ * @brief Loads a compiled program from a cache file.
+ *
+ * @param cache_path Path of the cache file
+ * @param source_size Size of the current script
+ * @param source_hash Hash of the current script
+ * @return dmell_prog_t* Program, or NULL if there is no valid cache for this version of the script
+ */
+dmell_prog_t* dmell_cache_load( const char* cache_path, uint32_t source_size, uint32_t source_hash )
+{
+    if( cache_path == NULL )
+    {
+        return NULL;
+    }
+
+    void* file = Dmod_FileOpen( cache_path, "rb" );
+    if( file == NULL )
+    {
+        return NULL;
+    }
+    size_t size = Dmod_FileSize( file );
+    char* data = ( size >= sizeof(cache_header_t) ) ? Dmod_Malloc( size ) : NULL;
+    size_t count = ( data != NULL ) ? Dmod_FileRead( data, 1, size, file ) : 0;
+    Dmod_FileClose( file );
+
+    cache_cursor_t cursor = { .ptr = data, .end_ptr = data + count };
+    cache_header_t header;
+    dmell_prog_t* prog = NULL;
+    if( count == size && read_data( &cursor, &header, sizeof(header) ) &&
+        header.magic == DMELL_CACHE_MAGIC && header.version == DMELL_CACHE_VERSION &&
+        header.source_size == source_size && header.source_hash == source_hash )
+    {
+        prog = load_program( &cursor, 0 );
+        if( prog != NULL && cursor.ptr != cursor.end_ptr )
+        {
+            dmell_prog_release( prog );
+            prog = NULL;
+        }
+        if( prog == NULL )
+        {
+            DMOD_LOG_WARN("Invalid compiled script cache: %s\n", cache_path);
+        }
+    }
+    Dmod_Free( data );
+    return prog;
+}
+
+/**
+ * @brief Helper function to write a program and its functions to the cache file.
+ *
+ * @param writer Writer of the cache file
+ * @param prog Program to write
+ * @return int 0 on success, negative value on error
+ */
+static int store_program( dmell_writer_t* writer, const dmell_prog_t* prog )
+{
+    cache_prog_t sizes = {
+        .instr_count    = prog->instr_count,
+        .part_count     = prog->part_count,
+        .slot_count     = prog->slot_count,
+        .arg_count      = prog->arg_count,
+        .pool_size      = prog->pool_size,
+        .line_count     = prog->line_count,
+        .loop_count     = prog->loop_count,
+        .func_count     = prog->func_count
+    };
+    int result = dmell_writer_write( writer, (const char*)&sizes, sizeof(sizes) );
+    result = ( result == 0 ) ? dmell_writer_write( writer, (const char*)prog->instrs, prog->instr_count * sizeof(dmell_prog_instr_t) ) : result;
+    result = ( result == 0 ) ? dmell_writer_write( writer, (const char*)prog->parts, prog->part_count * sizeof(dmell_prog_part_t) ) : result;
+    result = ( result == 0 ) ? dmell_writer_write( writer, (const char*)prog->slots, prog->slot_count * sizeof(dmell_prog_slot_t) ) : result;
+    result = ( result == 0 ) ? dmell_writer_write( writer, (const char*)prog->args, prog->arg_count * sizeof(uint32_t) ) : result;
+    result = ( result == 0 ) ? dmell_writer_write( writer, prog->pool, prog->pool_size ) : result;
+    for( uint32_t i = 0; i < prog->func_count && result == 0; i++ )
+    {
+        result = store_program( writer, prog->funcs[i] );
+    }
+    return result;
+}
+
+/**
+ * @brief Stores a compiled program in a cache file.
+ *
+ * A cache file that cannot be written completely is removed. A cache file
+ * that cannot be created is not an error worth logging - the script just
+ * runs without the cache.
+ *
+ * @param cache_path Path of the cache file
+ * @param prog Finished program to store
+ * @param source_size Size of the script the program was compiled from
+ * @param source_hash Hash of the script the program was compiled from
+ * @return int 0 on success, negative value on error
+ */
+int dmell_cache_store( const char* cache_path, const dmell_prog_t* prog, uint32_t source_size, uint32_t source_hash )
+{
+    if( cache_path == NULL || prog == NULL )
+    {
+        DMOD_LOG_ERROR("Invalid arguments to dmell_cache_store: %p, %p\n", cache_path, prog);
+        return -EINVAL;
+    }
+
+    // A cache that cannot be created (like next to a script on a read-only filesystem) is skipped quietly
+    void* file = Dmod_FileOpen( cache_path, "wb" );
+    if( file == NULL )
+    {
+        return -ENOENT;
+    }
+
+    dmell_writer_t writer = { 0 };
+    int result = dmell_writer_attach( &writer, file );
+    if( result < 0 )
+    {
+        Dmod_FileClose( file );
+        return result;
+    }
+
+    cache_header_t header = {
+        .magic          = DMELL_CACHE_MAGIC,
+        .version        = DMELL_CACHE_VERSION,
+        .source_size    = source_size,
+        .source_hash    = source_hash
+    };
+    result = dmell_writer_write( &writer, (const char*)&header, sizeof(header) );
+    result = ( result == 0 ) ? store_program( &writer, prog ) : result;
+    int close_result = dmell_writer_close( &writer );
+    result = ( result == 0 ) ? close_result : result;
+    if( result < 0 )
+    {
+        Dmod_FileRemove( cache_path );
+    }
+    return result;
+}
@@ -1,22 +1,22 @@
 #include "dmell_hlp.h"
 #include "dmell_cmd.h"
+#include "dmell_io.h"
+#include "dmell_writer.h"
 #include <dmod.h>
 #include <string.h>
 #include <errno.h>
+#include <stdbool.h>
+#include <stdint.h>
 
 /**
- * @brief Global array of registered commands.
- */
-dmell_cmd_t* g_registered_commands = NULL;
-/**
- * @brief Count of registered commands.
+ * @brief Default command handler function pointer.
  */
-size_t g_registered_command_count = 0;
+dmell_cmd_handler_t g_default_command_handler = NULL;
 
 /**
- * @brief Default command handler function pointer.
+ * @brief Function that tells if the default handler runs a command inside the shell.
  */
-dmell_cmd_handler_t g_default_command_handler = NULL;
+static dmell_cmd_capture_check_t g_capture_check = NULL;
 
 /**
  * @brief Helper function to find the next argument in a command string.
@@ -59,202 +59,276 @@ static const char* get_next_arg( const char* str, const char* end_ptr)
 }
 
 /**
- * @brief Helper function to duplicate an argument string.
+ * @brief Helper function to check if an argument is enclosed in quotes.
  * 
- * @param arg Argument string to duplicate
+ * @param arg Argument string
  * @param len Length of the argument string
- * @return char* Duplicated argument string, or NULL on failure
+ * @return true If the argument starts and ends with the same quote character
+ * @return false Otherwise
  */
-static char* duplicate_arg( const char* arg, size_t len )
+static bool is_quoted_arg( const char* arg, size_t len )
 {
-    char* new_arg = Dmod_Malloc( len + 1 );
-    if( new_arg == NULL )
-    {
-        return NULL;
-    }
-    memset( new_arg, 0, len + 1 );
-    if ((arg[0] == '"' && arg[len - 1] == '"') || (arg[0] == '\'' && arg[len - 1] == '\'')) {
-        memcpy(new_arg, arg + 1, len - 2);
-    } else {
-        memcpy(new_arg, arg, len);
-    }
-    return new_arg;
+    return len >= 2 && ( (arg[0] == '"' && arg[len - 1] == '"') || (arg[0] == '\'' && arg[len - 1] == '\'') );
 }
 
 /**
- * @brief Helper function to add an argument to the dmell_argv_t structure.
+ * @brief Helper function to find the bounds of the next argument in a command string.
  * 
- * @param argv Pointer to the dmell_argv_t structure
- * @param arg Argument string to add
- * @param next_arg Pointer to the start of the next argument
+ * @param ptr Current position in the command string
  * @param end_ptr Pointer to the end of the command string
- * @return int 0 on success, negative value on error
+ * @param out_arg Output parameter to hold the start of the argument
+ * @return const char* Pointer to the position after the argument, or NULL if there are no more arguments
  */
-static int add_arg( dmell_argv_t* argv, const char* arg, const char* next_arg, const char* end_ptr )
+static const char* scan_arg( const char* ptr, const char* end_ptr, const char** out_arg )
 {
-    const char* arg_end = (next_arg != NULL) ? next_arg : end_ptr;
-    size_t arg_len = arg_end - arg;
-    char* new_arg = duplicate_arg( arg, arg_len );
-    if( new_arg == NULL )
+    ptr = dmell_skip_whitespaces( ptr, end_ptr );
+    if( ptr >= end_ptr )
     {
-        DMOD_LOG_ERROR("Memory allocation failed in duplicate_arg\n");
-        return -ENOMEM;
+        return NULL;
     }
+    *out_arg = ptr;
+    const char* next_arg = get_next_arg( ptr, end_ptr );
+    return (next_arg != NULL) ? next_arg : end_ptr;
+}
 
-    argv->argv = Dmod_Realloc( argv->argv, sizeof(char*) * (argv->argc + 1) );
-    if( argv->argv == NULL )
+/**
+ * @brief Helper function to copy an argument without its enclosing quotes.
+ * 
+ * @param dst Destination buffer
+ * @param arg Argument string to copy
+ * @param len Length of the argument string
+ * @return size_t Number of bytes used in the destination buffer (including the null terminator)
+ */
+static size_t copy_arg( char* dst, const char* arg, size_t len )
+{
+    if( is_quoted_arg( arg, len ) )
     {
-        Dmod_Free( new_arg );
-        DMOD_LOG_ERROR("Memory allocation failed in Dmod_Realloc\n");
-        return -ENOMEM;
+        arg++;
+        len -= 2;
     }
+    memcpy( dst, arg, len );
+    dst[len] = '\0';
+    return len + 1;
+}
 
-    argv->argv[argv->argc] = new_arg;
-    argv->argc += 1;
+/**
+ * @brief Minimum number of slots in the command table.
+ */
+#define DMELL_CMD_TABLE_MIN_CAPACITY    32
 
-    if(argv->program_name == NULL)
-    {
-        argv->program_name = new_arg;
-    }
+/**
+ * @brief Slot of the command table.
+ */
+typedef struct 
+{
+    const dmell_cmd_t*  command;    /**< Registered command, NULL for an empty slot */
+    uint32_t            hash;       /**< Hash of the command name */
+    bool                owned;      /**< True if the command was copied at registration */
+} cmd_slot_t;
 
-    return 0;
-}
+/**
+ * @brief Marker of a slot whose command was unregistered.
+ */
+static const dmell_cmd_t g_removed_command = { NULL, NULL };
+
+/**
+ * @brief Command table (open addressing with linear probing).
+ */
+static cmd_slot_t* g_command_slots = NULL;
+/**
+ * @brief Number of slots in the command table (power of 2).
+ */
+static size_t g_command_capacity = 0;
+/**
+ * @brief Count of registered commands.
+ */
+static size_t g_registered_command_count = 0;
+/**
+ * @brief Number of occupied slots in the command table, including unregistered ones.
+ */
+static size_t g_command_used_slots = 0;
 
 /**
- * @brief Helper function to free the dmell_argv_t structure.
+ * @brief Helper function to find the slot of a command in the command table.
  * 
- * @param argv Pointer to the dmell_argv_t structure to free
+ * @param name Name of the command
+ * @param hash Hash of the name
+ * @param out_free [optional] Output parameter to hold the first slot that can be used to insert the command
+ * @return cmd_slot_t* Slot of the command, or NULL if not found
  */
-static void free_argv( dmell_argv_t* argv )
+static cmd_slot_t* find_slot( const char* name, uint32_t hash, cmd_slot_t** out_free )
 {
-    if( argv == NULL )
+    if( out_free != NULL )
     {
-        return;
+        *out_free = NULL;
+    }
+    if( g_command_capacity == 0 )
+    {
+        return NULL;
     }
 
-    for( int i = 0; i < argv->argc; i++ )
+    size_t mask = g_command_capacity - 1;
+    for( size_t i = hash & mask; ; i = ( i + 1 ) & mask )
     {
-        Dmod_Free( argv->argv[i] );
+        cmd_slot_t* slot = &g_command_slots[i];
+        if( slot->command == NULL )
+        {
+            if( out_free != NULL && *out_free == NULL )
+            {
+                *out_free = slot;
+            }
+            return NULL;
+        }
+        if( slot->command == &g_removed_command )
+        {
+            if( out_free != NULL && *out_free == NULL )
+            {
+                *out_free = slot;
+            }
+        }
+        else if( slot->hash == hash && strcmp( slot->command->name, name ) == 0 )
+        {
+            return slot;
+        }
     }
-    Dmod_Free( argv->argv );
-    argv->argc = 0;
-    argv->argv = NULL;
 }
 
 /**
- * @brief Helper function to move a command structure.
+ * @brief Helper function to make sure that one more command fits in the command table.
  * 
- * @param dest Destination command structure
- * @param src Source command structure
- */
-static void move_command( dmell_cmd_t* dest, const dmell_cmd_t* src )
-{
-    dest->name = src->name;
-    dest->handler = src->handler;
-}
-
-/**
- * @brief Helper function to copy a command structure.
+ * The capacity is doubled when the table is more than 3/4 full (counting
+ * unregistered slots). Unregistered slots are dropped while rebuilding.
  * 
- * @param dest Destination command structure
- * @param src Source command structure
  * @return int 0 on success, negative value on error
  */
-static int copy_command( dmell_cmd_t* dest, const dmell_cmd_t* src )
+static int reserve_slot( void )
 {
-    dest->name = Dmod_StrDup( src->name );
-    if( dest->name == NULL )
+    if( ( g_command_used_slots + 1 ) * 4 <= g_command_capacity * 3 )
     {
-        DMOD_LOG_ERROR("Memory allocation failed in Dmod_StrDup for command name\n");
+        return 0;
+    }
+
+    size_t capacity = g_command_capacity > 0 ? g_command_capacity : DMELL_CMD_TABLE_MIN_CAPACITY;
+    while( ( g_registered_command_count + 1 ) * 2 > capacity )
+    {
+        capacity *= 2;
+    }
+
+    cmd_slot_t* slots = Dmod_Malloc( capacity * sizeof(cmd_slot_t) );
+    if( slots == NULL )
+    {
+        DMOD_LOG_ERROR("Memory allocation failed for %zu command slots\n", capacity);
         return -ENOMEM;
     }
-    dest->handler = src->handler;
-    return 0;
-}
+    memset( slots, 0, capacity * sizeof(cmd_slot_t) );
 
-/**
- * @brief Helper function to find the index of a command in the registered commands array.
- * 
- * @param command Pointer to the command structure to find
- * @return int Index of the command, or -1 if not found
- */
-static int find_command_index( const dmell_cmd_t* command )
-{
-    for( size_t i = 0; i < g_registered_command_count; i++ )
+    size_t mask = capacity - 1;
+    for( size_t i = 0; i < g_command_capacity; i++ )
     {
-        if( strcmp( g_registered_commands[i].name, command->name ) == 0 && g_registered_commands[i].handler == command->handler )
+        const cmd_slot_t* slot = &g_command_slots[i];
+        if( slot->command != NULL && slot->command != &g_removed_command )
         {
-            return (int)i;
+            size_t index = slot->hash & mask;
+            while( slots[index].command != NULL )
+            {
+                index = ( index + 1 ) & mask;
+            }
+            slots[index] = *slot;
         }
     }
-    return -ENOENT;
+
+    Dmod_Free( g_command_slots );
+    g_command_slots = slots;
+    g_command_capacity = capacity;
+    g_command_used_slots = g_registered_command_count;
+    return 0;
 }
 
 /**
- * @brief Helper function to free a command structure.
+ * @brief Helper function to copy a command structure.
  * 
- * @param command Pointer to the command structure to free
+ * The structure and the name are stored in a single allocation.
+ * 
+ * @param src Source command structure
+ * @return dmell_cmd_t* Copy of the command, or NULL on error
  */
-static void free_command( dmell_cmd_t* command )
+static dmell_cmd_t* copy_command( const dmell_cmd_t* src )
 {
-    if( command == NULL )
+    size_t name_size = strlen( src->name ) + 1;
+    dmell_cmd_t* dest = Dmod_Malloc( sizeof(dmell_cmd_t) + name_size );
+    if( dest == NULL )
     {
-        return;
+        DMOD_LOG_ERROR("Memory allocation failed for command %s\n", src->name);
+        return NULL;
     }
-
-    Dmod_Free( (void*)command->name );
-    command->name = NULL;
-    command->handler = NULL;
+    char* name = (char*)( dest + 1 );
+    memcpy( name, src->name, name_size );
+    dest->name = name;
+    dest->handler = src->handler;
+    return dest;
 }
 
 /**
- * @brief Helper function to shift commands left in the registered commands array.
+ * @brief Helper function to free the command of a slot.
  * 
- * @param start_index Index to start shifting from
+ * @param slot Slot of the command table
  */
-static void shift_commands_left( size_t start_index )
+static void free_command( cmd_slot_t* slot )
 {
-    for( size_t i = start_index; i < g_registered_command_count - 1; i++ )
+    if( slot->owned )
     {
-        move_command( &g_registered_commands[i], &g_registered_commands[i + 1] );
+        Dmod_Free( (void*)slot->command );
     }
-
-    // free the last command slot
-    free_command( &g_registered_commands[g_registered_command_count - 1] );
+    slot->command = NULL;
+    slot->owned = false;
 }
 
 /**
- * @brief Helper function to remove a command at a specific index.
+ * @brief Helper function to add a command to the command table.
  * 
- * @param index Index of the command to remove
+ * A command registered under an existing name replaces the previous one.
+ * 
+ * @param command Command to add
+ * @param copy True if the command has to be copied, false if it stays valid for the lifetime of the program
  * @return int 0 on success, negative value on error
  */
-static int remove_command_at_index( size_t index )
+static int add_command( const dmell_cmd_t* command, bool copy )
 {
-    if( index >= g_registered_command_count )
+    uint32_t hash = dmell_hash_name( command->name, strlen( command->name ) );
+    int result = reserve_slot();
+    if( result < 0 )
     {
-        return -EINVAL;
+        return result;
     }
 
-    shift_commands_left( index );
-
-    dmell_cmd_t* new_commands = NULL;
-    if( g_registered_command_count - 1 > 0 )
+    const dmell_cmd_t* entry = command;
+    if( copy )
     {
-        new_commands = Dmod_Realloc( g_registered_commands, sizeof(dmell_cmd_t) * (g_registered_command_count - 1) );
-        if( new_commands == NULL )
+        entry = copy_command( command );
+        if( entry == NULL )
         {
-            DMOD_LOG_ERROR("Memory allocation failed in dmell_unregister_command\n");
             return -ENOMEM;
         }
     }
+
+    cmd_slot_t* free_slot = NULL;
+    cmd_slot_t* slot = find_slot( command->name, hash, &free_slot );
+    if( slot != NULL )
+    {
+        free_command( slot );
+    }
     else
     {
-        Dmod_Free( g_registered_commands );
+        slot = free_slot;
+        if( slot->command == NULL )
+        {
+            g_command_used_slots++;
+        }
+        g_registered_command_count++;
     }
-
-    g_registered_commands = new_commands;
-    g_registered_command_count -= 1;
+    slot->command = entry;
+    slot->hash = hash;
+    slot->owned = copy;
     return 0;
 }
 
@@ -270,9 +344,49 @@ int dmell_set_default_handler(dmell_cmd_handler_t handler)
     return 0;
 }
 
+/**
+ * @brief Sets the function that tells if the default handler runs a command inside the shell.
+ * 
+ * @param check Function to use, NULL if all commands run inside the shell
+ * @return int 0 on success
+ */
+int dmell_set_capture_check(dmell_cmd_capture_check_t check)
+{
+    g_capture_check = check;
+    return 0;
+}
+
+/**
+ * @brief Checks if the output of a command can be captured.
+ * 
+ * Registered commands write through the dmell I/O functions, so their
+ * output can be sent to a file or a pipe. Other commands are asked about
+ * through the capture check of the default handler - a module that runs
+ * from a file writes straight to the console.
+ * 
+ * @param cmd_name Name of the command
+ * @return true If the output of the command can be captured
+ * @return false Otherwise
+ */
+bool dmell_is_output_captured(const char* cmd_name)
+{
+    if( cmd_name == NULL )
+    {
+        return false;
+    }
+    if( dmell_find_command( cmd_name ) != NULL || g_capture_check == NULL )
+    {
+        return true;
+    }
+    return g_capture_check( cmd_name );
+}
+
 /**
  * @brief Registers a command with the dmell module.
  * 
+ * The command is copied. A command registered under an existing name
+ * replaces the previous one.
+ * 
  * @param command Pointer to the command structure to register
  * @return int 0 on success, negative value on error
  */
@@ -284,22 +398,40 @@ int dmell_register_command(const dmell_cmd_t* command)
         return -EINVAL;
     }
 
-    dmell_cmd_t* new_commands = Dmod_Realloc( g_registered_commands, sizeof(dmell_cmd_t) * (g_registered_command_count + 1) );
-    if( new_commands == NULL )
+    return add_command( command, true );
+}
+
+/**
+ * @brief Registers commands from a table that stays valid for the lifetime of the program.
+ * 
+ * The table entries are referenced directly, neither the structures nor the
+ * names are copied.
+ * 
+ * @param commands Table of commands
+ * @param count Number of commands in the table
+ * @return int 0 on success, negative value on error
+ */
+int dmell_register_static_commands(const dmell_cmd_t* commands, size_t count)
+{
+    if( commands == NULL && count > 0 )
     {
-        DMOD_LOG_ERROR("Memory allocation failed in dmell_register_command\n");
-        return -ENOMEM;
+        DMOD_LOG_ERROR("Invalid command table passed to dmell_register_static_commands: %p\n", commands);
+        return -EINVAL;
     }
 
-    g_registered_commands = new_commands;
-    dmell_cmd_t* new_command = &g_registered_commands[g_registered_command_count];
-    int result = copy_command( new_command, command );
-    if( result < 0 )
+    for( size_t i = 0; i < count; i++ )
     {
-        DMOD_LOG_ERROR("Failed to copy command in dmell_register_command\n");
-        return result;
+        if( commands[i].name == NULL || commands[i].handler == NULL )
+        {
+            DMOD_LOG_ERROR("Invalid command at index %zu in dmell_register_static_commands\n", i);
+            return -EINVAL;
+        }
+        int result = add_command( &commands[i], false );
+        if( result < 0 )
+        {
+            return result;
+        }
     }
-    g_registered_command_count += 1;
     return 0;
 }
 
@@ -340,14 +472,31 @@ const dmell_cmd_t* dmell_find_command(const char* command_name)
         return NULL;
     }
 
-    for( size_t i = 0; i < g_registered_command_count; i++ )
+    const cmd_slot_t* slot = find_slot( command_name, dmell_hash_name( command_name, strlen( command_name ) ), NULL );
+    return slot != NULL ? slot->command : NULL;
+}
+
+/**
+ * @brief Iterates over the registered commands.
+ * 
+ * @param iterator Iteration state, has to be set to 0 before the first call
+ * @return const dmell_cmd_t* Next registered command, or NULL if there are no more commands
+ */
+const dmell_cmd_t* dmell_next_command(size_t* iterator)
+{
+    if( iterator == NULL )
+    {
+        return NULL;
+    }
+
+    while( *iterator < g_command_capacity )
     {
-        if( strcmp( g_registered_commands[i].name, command_name ) == 0 )
+        const dmell_cmd_t* command = g_command_slots[(*iterator)++].command;
+        if( command != NULL && command != &g_removed_command )
         {
-            return &g_registered_commands[i];
+            return command;
         }
     }
-
     return NULL;
 }
 
@@ -365,32 +514,33 @@ int dmell_unregister_command(const dmell_cmd_t* command)
         return -EINVAL;
     }
 
-    int index = find_command_index( command );
-    if( index < 0 )
+    cmd_slot_t* slot = find_slot( command->name, dmell_hash_name( command->name, strlen( command->name ) ), NULL );
+    if( slot == NULL || slot->command->handler != command->handler )
     {
         DMOD_LOG_ERROR("Command not found in dmell_unregister_command: %s\n", command->name);
         return -ENOENT;
     }
 
-    return remove_command_at_index( (size_t)index );
+    free_command( slot );
+    slot->command = &g_removed_command;
+    g_registered_command_count--;
+    return 0;
 }
 
 /**
- * @brief Runs a command by its name.
+ * @brief Helper function to run the handler of a command.
+ * 
+ * While the streams are connected to a pipe, a file or a buffer, a command
+ * whose streams cannot be captured is rejected instead of silently using
+ * the console.
  * 
  * @param cmd_name Name of the command to run
  * @param argc Number of arguments
  * @param argv Array of arguments
  * @return int Exit code of the command
  */
-int dmell_run_command(const char* cmd_name, int argc, char** argv)
+static int run_handler( const char* cmd_name, int argc, char** argv )
 {
-    if( cmd_name == NULL )
-    {
-        DMOD_LOG_ERROR("Invalid command name passed to dmell_run_command: %p\n", cmd_name);
-        return -EINVAL;
-    }
-
     const dmell_cmd_t* command = dmell_find_command( cmd_name );
     if( command != NULL )
     {
@@ -398,6 +548,12 @@ int dmell_run_command(const char* cmd_name, int argc, char** argv)
     }
     else if( g_default_command_handler != NULL )
     {
+        // A command that does not run inside the shell would use the console instead of a pipe, a file or a buffer
+        if( ( !dmell_io_input_is_console() || !dmell_io_output_is_console() ) && !dmell_is_output_captured( cmd_name ) )
+        {
+            DMOD_LOG_ERROR("The streams of '%s' cannot be captured - it is not a built-in or linked command\n", cmd_name);
+            return -ENOTSUP;
+        }
         return g_default_command_handler( argc, argv );
     }
     else
@@ -407,9 +563,109 @@ int dmell_run_command(const char* cmd_name, int argc, char** argv)
     }
 }
 
+/**
+ * @brief File name of a redirection of the standard error to the standard output ("2>&1").
+ */
+#define DMELL_CMD_OUTPUT_TARGET         "&1"
+
+/**
+ * @brief Helper function to run a command with its output redirected to files.
+ * 
+ * The streams of the command are connected to buffered file writers that
+ * are flushed when the command finishes. The standard error redirected to
+ * "&1" goes to the same stream as the standard output. A command whose output cannot be
+ * captured is rejected before any file is opened, so no file is truncated.
+ * 
+ * @param argc Number of arguments
+ * @param argv Array of arguments
+ * @param redirect Redirections of the command
+ * @return int Exit code of the command, or negative value if a file could not be written
+ */
+static int run_redirected( int argc, char** argv, const dmell_redirect_t* redirect )
+{
+    if( !dmell_is_output_captured( argv[0] ) )
+    {
+        DMOD_LOG_ERROR("The output of '%s' cannot be redirected - it is not a built-in or linked command\n", argv[0]);
+        return -ENOTSUP;
+    }
+
+    dmell_writer_t writers[2] = { 0 };  // standard output and standard error
+    int result = 0;
+    if( redirect->output != NULL )
+    {
+        result = dmell_writer_open( &writers[0], redirect->output, redirect->output_append );
+    }
+    bool error_to_output = ( redirect->error != NULL && strcmp( redirect->error, DMELL_CMD_OUTPUT_TARGET ) == 0 );
+    if( result == 0 && redirect->error != NULL && !error_to_output )
+    {
+        result = dmell_writer_open( &writers[1], redirect->error, redirect->error_append );
+    }
+
+    if( result == 0 )
+    {
+        dmell_io_t saved;
+        dmell_io_save( &saved );
+        if( writers[0].file != NULL )
+        {
+            dmell_io_set_output( dmell_io_file, &writers[0] );
+        }
+        if( writers[1].file != NULL )
+        {
+            dmell_io_set_error( dmell_io_file, &writers[1] );
+        }
+        if( error_to_output )
+        {
+            dmell_io_t current;
+            dmell_io_save( &current );
+            // Both streams already end up on the console
+            if( current.output.kind != dmell_io_console )
+            {
+                dmell_io_set_error( (dmell_io_kind_t)current.output.kind, current.output.object );
+            }
+        }
+        result = run_handler( argv[0], argc, argv );
+        dmell_io_restore( &saved );
+    }
+
+    for( int i = 0; i < 2; i++ )
+    {
+        int close_result = dmell_writer_close( &writers[i] );
+        if( close_result < 0 && result == 0 )
+        {
+            result = close_result;
+        }
+    }
+    return result;
+}
+
+/**
+ * @brief Runs a command by its name.
+ * 
+ * The arguments are passed to the command as they are - output
+ * redirections are recognized only when a command string is parsed.
+ * 
+ * @param cmd_name Name of the command to run
+ * @param argc Number of arguments
+ * @param argv Array of arguments
+ * @return int Exit code of the command
+ */
+int dmell_run_command(const char* cmd_name, int argc, char** argv)
+{
+    if( cmd_name == NULL )
+    {
+        DMOD_LOG_ERROR("Invalid command name passed to dmell_run_command: %p\n", cmd_name);
+        return -EINVAL;
+    }
+    return run_handler( cmd_name, argc, argv );
+}
+
 /**
  * @brief Runs a command from a command string.
  * 
+ * Unquoted words '>', '>>', '2>' and '2>>', followed by a file name or
+ * with the file name attached, redirect the output of the command to a
+ * file. '2>&1' sends the standard error to the standard output.
+ * 
  * @param cmd Command string to run
  * @param len Length of the command string
  * @return int Exit code of the command
@@ -433,20 +689,122 @@ int dmell_run_command_string(const char* cmd, size_t len)
     if( parsed_argv.argc == 0 )
     {
         DMOD_LOG_ERROR("No command found in command string\n");
-        free_argv( &parsed_argv );
+        dmell_free_argv( &parsed_argv );
         return -EINVAL;
     }
 
     const char* command_name = parsed_argv.argv[0];
-    result = dmell_run_command( command_name, parsed_argv.argc, parsed_argv.argv );
+    if( parsed_argv.redirect.output != NULL || parsed_argv.redirect.error != NULL )
+    {
+        result = run_redirected( parsed_argv.argc, parsed_argv.argv, &parsed_argv.redirect );
+    }
+    else
+    {
+        result = dmell_run_command( command_name, parsed_argv.argc, parsed_argv.argv );
+    }
 
-    free_argv( &parsed_argv );
+    dmell_free_argv( &parsed_argv );
     return result;
 }
 
+/**
+ * @brief Enumeration of output redirections.
+ */
+typedef enum
+{
+    redirect_none,          //!< Not a redirection
+    redirect_output,        //!< '>' - write the standard output to a file
+    redirect_append,        //!< '>>' - append the standard output to a file
+    redirect_error,         //!< '2>' - write the standard error to a file
+    redirect_error_append,  //!< '2>>' - append the standard error to a file
+} redirect_t;
+
+/**
+ * @brief Helper function to check if a word of a command string is an output redirection.
+ * 
+ * A quoted word starts with a quote, so it is never a redirection.
+ * 
+ * @param arg Word of the command string
+ * @param len Length of the word
+ * @param out_redirect Output parameter to hold the kind of the redirection
+ * @return size_t Length of the operator, 0 if the word is not a redirection
+ */
+static size_t get_redirection( const char* arg, size_t len, redirect_t* out_redirect )
+{
+    *out_redirect = redirect_none;
+    bool error = ( len >= 2 && arg[0] == '2' && arg[1] == '>' );
+    size_t pos = error ? 1 : 0;
+    if( pos >= len || arg[pos] != '>' )
+    {
+        return 0;
+    }
+    pos++;
+
+    bool append = ( pos < len && arg[pos] == '>' );
+    if( append )
+    {
+        pos++;
+    }
+
+    if( error )
+    {
+        *out_redirect = append ? redirect_error_append : redirect_error;
+    }
+    else
+    {
+        *out_redirect = append ? redirect_append : redirect_output;
+    }
+    return pos;
+}
+
+/**
+ * @brief Helper function to find the next word of a command string with its redirection.
+ * 
+ * The file name of a redirection is either attached to the operator or
+ * the next word.
+ * 
+ * @param ptr Position in the command string, moved after the word
+ * @param end_ptr Pointer to the end of the command string
+ * @param out_arg Output parameter to hold the argument, or the file name of a redirection
+ * @param out_len Output parameter to hold the length of the argument
+ * @param out_redirect Output parameter to hold the kind of the redirection
+ * @return int 1 if a word was found, 0 at the end of the string, -EINVAL if the file name is missing
+ */
+static int next_word( const char** ptr, const char* end_ptr, const char** out_arg, size_t* out_len, redirect_t* out_redirect )
+{
+    const char* arg = NULL;
+    const char* next = scan_arg( *ptr, end_ptr, &arg );
+    if( next == NULL )
+    {
+        return 0;
+    }
+
+    size_t op_len = get_redirection( arg, next - arg, out_redirect );
+    arg += op_len;
+    if( *out_redirect != redirect_none && arg == next )
+    {
+        next = scan_arg( next, end_ptr, &arg );
+        if( next == NULL )
+        {
+            DMOD_LOG_ERROR("Missing file name for the output redirection\n");
+            return -EINVAL;
+        }
+    }
+    *ptr = next;
+    *out_arg = arg;
+    *out_len = next - arg;
+    return 1;
+}
+
 /**
  * @brief Parses a command string into arguments.
  * 
+ * The argument pointers and the argument strings are stored in a single
+ * memory block, sized by a first scan over the command string. Output
+ * redirections are not arguments - their file names are stored in the
+ * same block and referenced by the redirect field. The result has to be
+ * released with dmell_free_argv.
+ * 
  * @param cmd Command string to parse
  * @param len Length of the command string
  * @param out_argv Output structure to hold parsed arguments
@@ -460,27 +818,84 @@ int dmell_parse_command( const char* cmd, size_t len, dmell_argv_t* out_argv )
         return -EINVAL;
     }
 
-    int result = 0;
+    memset( out_argv, 0, sizeof(*out_argv) );
+
+    // First pass - count the arguments and the bytes needed to store them
     const char* end_ptr = cmd + len;
+    const char* arg = NULL;
     const char* ptr = cmd;
-    while( ptr < end_ptr )
+    size_t arg_len = 0;
+    redirect_t redirect = redirect_none;
+    int argc = 0;
+    size_t strings_size = 0;
+    int result;
+    while( (result = next_word( &ptr, end_ptr, &arg, &arg_len, &redirect )) > 0 )
     {
-        ptr = dmell_skip_whitespaces( ptr, end_ptr );
-        if( ptr >= end_ptr )
-        {
-            break;
-        }
-        const char* arg = ptr;
-        const char* next_arg = get_next_arg(arg, end_ptr);
-        result = add_arg( out_argv, arg, next_arg, end_ptr );
-        if( result < 0 )
+        strings_size += ( is_quoted_arg( arg, arg_len ) ? arg_len - 2 : arg_len ) + 1;
+        argc += ( redirect == redirect_none ) ? 1 : 0;
+    }
+    if( result < 0 )
+    {
+        return result;
+    }
+
+    if( strings_size == 0 )
+    {
+        return 0;
+    }
+
+    // Second pass - fill a single block with the pointers followed by the strings
+    size_t pointers_size = sizeof(char*) * (argc + 1);
+    char** argv = Dmod_Malloc( pointers_size + strings_size );
+    if( argv == NULL )
+    {
+        DMOD_LOG_ERROR("Memory allocation failed in dmell_parse_command\n");
+        return -ENOMEM;
+    }
+
+    char* strings = (char*)argv + pointers_size;
+    int index = 0;
+    ptr = cmd;
+    while( next_word( &ptr, end_ptr, &arg, &arg_len, &redirect ) > 0 )
+    {
+        char* str = strings;
+        strings += copy_arg( strings, arg, arg_len );
+        switch( redirect )
         {
-            DMOD_LOG_ERROR("Failed to add argument in dmell_parse_command\n");
-            free_argv( out_argv );
-            return result;
+            case redirect_none:
+                argv[index++] = str;
+                break;
+            case redirect_output:
+            case redirect_append:
+                out_argv->redirect.output = str;
+                out_argv->redirect.output_append = ( redirect == redirect_append );
+                break;
+            default:
+                out_argv->redirect.error = str;
+                out_argv->redirect.error_append = ( redirect == redirect_error_append );
+                break;
         }
-        ptr = (next_arg != NULL) ? next_arg : end_ptr;
     }
+    argv[argc] = NULL;
 
+    out_argv->argv          = argv;
+    out_argv->argc          = argc;
+    out_argv->program_name  = argv[0];
     return 0;
-}
\ No newline at end of file
+}
+
+/**
+ * @brief Frees the arguments created by dmell_parse_command.
+ * 
+ * @param argv Pointer to the dmell_argv_t structure to free
+ */
+void dmell_free_argv( dmell_argv_t* argv )
+{
+    if( argv == NULL )
+    {
+        return;
+    }
+
+    Dmod_Free( argv->argv );
+    memset( argv, 0, sizeof(*argv) );
+}
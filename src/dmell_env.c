@@ -0,0 +1,85 @@
+#include <string.h>
+#include <stdbool.h>
+#include "dmell_env.h"
+#include "dmell_vars.h"
+#include "dmod.h"
+
+/**
+ * @brief Cached result of an environment lookup.
+ */
+typedef struct
+{
+    char        name[DMELL_ENV_CACHE_NAME_LEN];     /**< Name of the environment variable */
+    char        value[DMELL_ENV_CACHE_VALUE_LEN];   /**< Copy of the value of the variable */
+    bool        is_set;                             /**< False if the variable is not set */
+    uint32_t    hash;                               /**< Hash of the name */
+    uint32_t    generation;                         /**< Generation of the environment the entry was read from */
+} env_entry_t;
+
+/**
+ * @brief Environment cache (direct mapped by the hash of the name).
+ */
+static env_entry_t g_env_cache[DMELL_ENV_CACHE_SIZE];
+
+/**
+ * @brief Generation of the environment - entries of other generations are stale.
+ */
+static uint32_t g_env_generation = 1;
+
+/**
+ * @brief Gets the value of an environment variable by a name that does not have to be null terminated.
+ *
+ * @param name Name of the variable
+ * @param name_len Length of the name
+ * @param hash Hash of the name (see dmell_hash_name)
+ * @return const char* Value of the variable, or NULL if it is not set - valid until the next call
+ */
+const char* dmell_env_get( const char* name, size_t name_len, uint32_t hash )
+{
+    if( name == NULL || name_len >= DMELL_MAX_VAR_NAME_LEN )
+    {
+        return NULL;
+    }
+
+    env_entry_t* entry = &g_env_cache[hash & ( DMELL_ENV_CACHE_SIZE - 1 )];
+    bool cacheable = ( name_len < DMELL_ENV_CACHE_NAME_LEN );
+    if( cacheable && entry->generation == g_env_generation && entry->hash == hash &&
+        strncmp( entry->name, name, name_len ) == 0 && entry->name[name_len] == '\0' )
+    {
+        return entry->is_set ? entry->value : NULL;
+    }
+
+    // The environment needs a null terminated name
+    char var_name_cpy[ DMELL_MAX_VAR_NAME_LEN ];
+    memcpy( var_name_cpy, name, name_len );
+    var_name_cpy[ name_len ] = '\0';
+    const char* value = Dmod_GetEnv( var_name_cpy );
+    size_t value_len = ( value != NULL ) ? strlen( value ) : 0;
+    if( cacheable && value_len < DMELL_ENV_CACHE_VALUE_LEN )
+    {
+        memcpy( entry->name, var_name_cpy, name_len + 1 );
+        memcpy( entry->value, ( value != NULL ) ? value : "", value_len + 1 );
+        entry->is_set = ( value != NULL );
+        entry->hash = hash;
+        entry->generation = g_env_generation;
+        return entry->is_set ? entry->value : NULL;
+    }
+    return value;
+}
+
+/**
+ * @brief Reports a change of the environment.
+ *
+ * Has to be called after every change of the environment, otherwise the
+ * cache keeps serving the old values. The 'export' command, the modules
+ * run by the shell and the background jobs that were waited for call it.
+ */
+void dmell_env_changed( void )
+{
+    if( ++g_env_generation == 0 )
+    {
+        // Entries of the first generations could become valid again
+        memset( g_env_cache, 0, sizeof(g_env_cache) );
+        g_env_generation = 1;
+    }
+}
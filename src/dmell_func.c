@@ -0,0 +1,123 @@
+#include <errno.h>
+#include <string.h>
+#include <stddef.h>
+#include "dmell_func.h"
+#include "dmod.h"
+
+/**
+ * @brief Number of function calls that did not return yet.
+ */
+static int g_depth = 0;
+
+/**
+ * @brief Command handler of all shell functions.
+ *
+ * The body of the function runs in a frame that holds the arguments of the
+ * call as positional parameters ($0 is the name of the function). The frame
+ * lives on the stack, so it is gone as soon as the function returns.
+ *
+ * @param argc Number of arguments
+ * @param argv Array of arguments, argv[0] is the name of the function
+ * @return int Exit code of the function, or negative value on error
+ */
+static int run_function( int argc, char** argv )
+{
+    const dmell_cmd_t* command = dmell_find_command( argv[0] );
+    if( !dmell_func_is_function( command ) )
+    {
+        DMOD_LOG_ERROR("Function '%s' is not defined\n", argv[0]);
+        return -ENOENT;
+    }
+    if( g_depth >= DMELL_FUNC_MAX_DEPTH )
+    {
+        DMOD_LOG_ERROR("Too many nested function calls - at most %d are allowed\n", DMELL_FUNC_MAX_DEPTH);
+        return -ELOOP;
+    }
+
+    // The function can be redefined while it runs, so the body is retained
+    dmell_prog_t* body = dmell_prog_retain( ((const dmell_func_t*)command)->body );
+    dmell_script_ctx_t* caller = dmell_script_get_current();
+
+    dmell_var_t params[argc];
+    memset( params, 0, sizeof(params) );
+    for( int i = 0; i < argc; i++ )
+    {
+        params[i].value = argv[i];
+    }
+
+    dmell_script_ctx_t frame = {
+        .last_exit_code = 0,
+        .variables      = { .parent = &caller->variables, .params = params, .param_count = (size_t)argc },
+        .scratch        = { 0 }
+    };
+    dmell_script_take_scratch( caller, &frame.scratch );
+
+    g_depth++;
+    int result = dmell_prog_run( body, &frame );
+    g_depth--;
+
+    dmell_script_give_scratch( caller, &frame.scratch );
+    dmell_prog_release( body );
+    return result < 0 ? result : frame.last_exit_code;
+}
+
+/**
+ * @brief Checks if a command is a shell function.
+ *
+ * @param command Command to check
+ * @return true If the command was registered with dmell_func_define
+ * @return false Otherwise
+ */
+bool dmell_func_is_function( const dmell_cmd_t* command )
+{
+    return command != NULL && command->handler == run_function;
+}
+
+/**
+ * @brief Defines a shell function, or replaces the previous definition.
+ *
+ * The function is registered in the command table, so calling it costs the
+ * same lookup as calling a builtin.
+ *
+ * @param name Name of the function
+ * @param body Compiled body of the function (retained by the function)
+ * @return int 0 on success, negative value on error
+ */
+int dmell_func_define( const char* name, dmell_prog_t* body )
+{
+    if( name == NULL || *name == '\0' || body == NULL )
+    {
+        DMOD_LOG_ERROR("Invalid arguments to dmell_func_define: %p, %p\n", name, body);
+        return -EINVAL;
+    }
+
+    size_t name_len = strlen( name );
+    dmell_func_t* func = Dmod_Malloc( sizeof(dmell_func_t) + name_len + 1 );
+    if( func == NULL )
+    {
+        DMOD_LOG_ERROR("Memory allocation failed in dmell_func_define\n");
+        return -ENOMEM;
+    }
+    char* func_name = (char*)( func + 1 );
+    memcpy( func_name, name, name_len + 1 );
+    func->command.name = func_name;
+    func->command.handler = run_function;
+    func->body = dmell_prog_retain( body );
+
+    const dmell_cmd_t* previous = dmell_find_command( name );
+    int result = dmell_register_static_commands( &func->command, 1 );
+    if( result < 0 )
+    {
+        dmell_prog_release( func->body );
+        Dmod_Free( func );
+        return result;
+    }
+
+    if( dmell_func_is_function( previous ) )
+    {
+        dmell_func_t* old = (dmell_func_t*)previous;
+        dmell_prog_release( old->body );
+        Dmod_Free( old );
+    }
+    return 0;
+}
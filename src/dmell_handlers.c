@@ -6,8 +6,30 @@
 #include <dmosi.h>
 #include "dmell_handlers.h"
 #include "dmell.h"
+#include "dmell_resolve.h"
+#include "dmell_env.h"
+#include "dmell_pool.h"
+#include "dmell_io.h"
+#include "dmell_writer.h"
+#include "dmell_jobs.h"
+#include "dmell_buf.h"
 
 #define DMELL_FILE_IO_BUFFER_SIZE 512
+#define DMELL_PARALLEL_DEFAULT_JOBS 4
+#define DMELL_PARALLEL_SEPARATOR ":::"
+
+/**
+ * @brief Command run by the 'parallel' command.
+ */
+typedef struct
+{
+    int                 first;      /**< Index of the first argument of the command */
+    int                 argc;       /**< Number of arguments of the command */
+    dmosi_process_t     process;    /**< Process running the command, NULL if it is not running */
+    bool                finished;   /**< True when the exit code is known */
+    int                 exit_code;  /**< Exit code of the command */
+    dmell_buf_t         output;     /**< Captured output of a command run by the shell */
+} parallel_task_t;
 
 /**
  * @brief Handler for the 'echo' command.
@@ -20,13 +42,13 @@ int dmell_handler_echo( int argc, char** argv )
 {
     for( int i = 1; i < argc; i++ )
     {
-        Dmod_Printf("%s", argv[i]);
+        dmell_io_puts( argv[i] );
         if( i < argc - 1 )
         {
-            Dmod_Printf(" ");
+            dmell_io_write( " ", 1 );
         }
     }
-    Dmod_Printf("\n");
+    dmell_io_write( "\n", 1 );
     return 0;
 }
 
@@ -43,60 +65,73 @@ int dmell_handler_write( int argc, char** argv )
 {
     if( argc < 3 )
     {
-        DMOD_LOG_ERROR("Usage: write <file> <content...>\n");
+        dmell_eprintf("Usage: write <file> <content...>\n");
         return -EINVAL;
     }
 
     const char* file_path = argv[1];
     if( file_path == NULL || *file_path == '\0' )
     {
-        DMOD_LOG_ERROR("Invalid file path in write command\n");
+        dmell_eprintf("Invalid file path in write command\n");
         return -EINVAL;
     }
 
-    void* file = Dmod_FileOpen( file_path, "w" );
-    if( file == NULL )
+    dmell_writer_t writer = { 0 };
+    int result = dmell_writer_open( &writer, file_path, false );
+    if( result < 0 )
     {
-        DMOD_LOG_ERROR("Failed to open file '%s' for writing\n", file_path);
-        return -ENOENT;
+        return result;
     }
 
-    for( int i = 2; i < argc; i++ )
+    for( int i = 2; i < argc && result == 0; i++ )
     {
         const char* chunk = argv[i] ? argv[i] : "";
-        size_t chunk_len = strlen( chunk );
-
-        if( chunk_len > 0 )
+        result = dmell_writer_write( &writer, chunk, strlen( chunk ) );
+        if( result == 0 && i < argc - 1 )
         {
-            size_t bytes_written = Dmod_FileWrite( chunk, 1, chunk_len, file );
-            if( bytes_written != chunk_len )
-            {
-                Dmod_FileClose( file );
-                DMOD_LOG_ERROR("Failed to write content to '%s'\n", file_path);
-                return -EIO;
-            }
+            result = dmell_writer_write( &writer, " ", 1 );
         }
+    }
 
-        if( i < argc - 1 )
+    int close_result = dmell_writer_close( &writer );
+    if( result == 0 )
+    {
+        result = close_result;
+    }
+    if( result < 0 )
+    {
+        dmell_eprintf("Failed to write content to '%s'\n", file_path);
+    }
+    return result;
+}
+
+/**
+ * @brief Helper function to copy the standard input to the standard output.
+ *
+ * @return int Exit code
+ */
+static int copy_input( void )
+{
+    char buffer[DMELL_FILE_IO_BUFFER_SIZE];
+    int bytes_read = 0;
+    while( (bytes_read = dmell_io_read( buffer, sizeof(buffer) )) > 0 )
+    {
+        int result = dmell_io_write( buffer, (size_t)bytes_read );
+        if( result < 0 )
         {
-            size_t bytes_written = Dmod_FileWrite( " ", 1, 1, file );
-            if( bytes_written != 1 )
-            {
-                Dmod_FileClose( file );
-                DMOD_LOG_ERROR("Failed to write content to '%s'\n", file_path);
-                return -EIO;
-            }
+            return result;
         }
     }
-
-    Dmod_FileClose( file );
-    return 0;
+    return bytes_read;
 }
 
 /**
  * @brief Handler for the 'read' command.
  *
  * Usage: read <file>
+ *        <command> | read
+ *
+ * Without a file the piped input is printed.
  *
  * @param argc Number of arguments
  * @param argv Array of argument strings
@@ -104,32 +139,36 @@ int dmell_handler_write( int argc, char** argv )
  */
 int dmell_handler_read( int argc, char** argv )
 {
+    if( argc < 2 && !dmell_io_input_is_console() )
+    {
+        return copy_input();
+    }
+
     if( argc < 2 )
     {
-        DMOD_LOG_ERROR("Usage: read <file>\n");
+        dmell_eprintf("Usage: read <file>\n");
         return -EINVAL;
     }
 
     const char* file_path = argv[1];
     if( file_path == NULL || *file_path == '\0' )
     {
-        DMOD_LOG_ERROR("Invalid file path in read command\n");
+        dmell_eprintf("Invalid file path in read command\n");
         return -EINVAL;
     }
 
     void* file = Dmod_FileOpen( file_path, "r" );
     if( file == NULL )
     {
-        DMOD_LOG_ERROR("Failed to open file '%s' for reading\n", file_path);
+        dmell_eprintf("Failed to open file '%s' for reading\n", file_path);
         return -ENOENT;
     }
 
     char buffer[DMELL_FILE_IO_BUFFER_SIZE];
     size_t bytes_read = 0;
-    while( (bytes_read = Dmod_FileRead( buffer, 1, sizeof(buffer) - 1, file )) > 0 )
+    while( (bytes_read = Dmod_FileRead( buffer, 1, sizeof(buffer), file )) > 0 )
     {
-        buffer[bytes_read] = '\0';
-        Dmod_Printf("%s", buffer);
+        dmell_io_write( buffer, bytes_read );
     }
 
     Dmod_FileClose( file );
@@ -148,20 +187,26 @@ int dmell_handler_help( int argc, char** argv )
     (void)argc;
     (void)argv;
 
-    Dmod_Printf("Built-in commands:\n");
-    Dmod_Printf("  help                         Show this help message\n");
-    Dmod_Printf("  echo [args...]               Print arguments\n");
-    Dmod_Printf("  write <file> <content...>    Write content to a file\n");
-    Dmod_Printf("  read <file>                  Read and print file content\n");
-    Dmod_Printf("  set <name=value>             Set a shell variable\n");
-    Dmod_Printf("  export <name=value>          Export an environment variable\n");
-    Dmod_Printf("  unset <name>                 Remove a variable\n");
-    Dmod_Printf("  cd [path]                    Change current directory\n");
-    Dmod_Printf("  pwd                          Print current directory\n");
-    Dmod_Printf("  module ...                   Manage DMOD modules\n");
-    Dmod_Printf("  uptime                       Show system uptime\n");
-    Dmod_Printf("  setloglevel <level>          Set shell log level\n");
-    Dmod_Printf("  exit [code]                  Exit the shell\n");
+    dmell_printf("Built-in commands:\n");
+    dmell_printf("  help                         Show this help message\n");
+    dmell_printf("  echo [args...]               Print arguments\n");
+    dmell_printf("  write <file> <content...>    Write content to a file\n");
+    dmell_printf("  read [file]                  Print file content or piped input\n");
+    dmell_printf("  set <name=value>             Set a shell variable\n");
+    dmell_printf("  export <name=value>          Export an environment variable\n");
+    dmell_printf("  unset <name>                 Remove a variable\n");
+    dmell_printf("  cd [path]                    Change current directory\n");
+    dmell_printf("  pwd                          Print current directory\n");
+    dmell_printf("  module ...                   Manage DMOD modules\n");
+    dmell_printf("  uptime                       Show system uptime\n");
+    dmell_printf("  hash [-r]                    Show or clear cached command locations\n");
+    dmell_printf("  jobs                         List background jobs\n");
+    dmell_printf("  wait [pid | %%job ...]        Wait for background jobs\n");
+    dmell_printf("  kill <pid | %%job> [...]      Stop processes\n");
+    dmell_printf("  parallel [-j N] cmd ::: cmd  Run commands at the same time\n");
+    dmell_printf("  test <expr>, [ <expr> ]      Check files, strings and numbers\n");
+    dmell_printf("  setloglevel <level>          Set shell log level\n");
+    dmell_printf("  exit [code]                  Exit the shell\n");
     return 0;
 }
 
@@ -176,7 +221,7 @@ int dmell_handler_set( int argc, char** argv )
 {
     if( argc < 1 || argv == NULL )
     {
-        DMOD_LOG_ERROR("Invalid arguments to dmell_handler_set: %d, %p\n", argc, argv);
+        dmell_eprintf("Invalid arguments to dmell_handler_set: %d, %p\n", argc, argv);
         return -EINVAL;
     }
 
@@ -192,12 +237,12 @@ int dmell_handler_set( int argc, char** argv )
                 while(name != NULL)
                 {
                     const char* value = Dmod_GetEnv(name);
-                    Dmod_Printf("%s=%s\n", name, value ? value : "");
+                    dmell_printf("%s=%s\n", name, value ? value : "");
                     name = Dmod_GetNextEnvName(name);
                 }
                 return 0;
             }
-            DMOD_LOG_ERROR("Missing evaluation for '%s'\n", command);
+            dmell_eprintf("Missing evaluation for '%s'\n", command);
             return -EINVAL;
         }
         eval = argv[1];
@@ -213,7 +258,7 @@ int dmell_handler_set( int argc, char** argv )
     }
     if(*ptr != '=')
     {
-        DMOD_LOG_ERROR("Invalid variable assignment in dmell_handler_set: %s\n", eval);
+        dmell_eprintf("Invalid variable assignment in dmell_handler_set: %s\n", eval);
         return -EINVAL;
     }
 
@@ -221,7 +266,7 @@ int dmell_handler_set( int argc, char** argv )
     ptr++;
     if(name_len <= 0)
     {
-        DMOD_LOG_ERROR("Invalid variable name in dmell_handler_set: %s\n", eval);
+        dmell_eprintf("Invalid variable name in dmell_handler_set: %s\n", eval);
         return -EINVAL;
     }
     char var_name[name_len + 1];
@@ -231,15 +276,21 @@ int dmell_handler_set( int argc, char** argv )
     if(strcmp(command, "export") == 0)
     {
         int result = Dmod_SetEnv( var_name, var_value, 1 );
+        dmell_env_changed();
         if( result != 0 )
         {
-            DMOD_LOG_ERROR("Failed to set environment variable in dmell_handler_export: %s=%s\n", var_name, var_value);
+            dmell_eprintf("Failed to set environment variable in dmell_handler_export: %s=%s\n", var_name, var_value);
             return result;
         }
     }
     else 
     {
-        g_dmell_global_script_ctx.variables = dmell_set_variable( g_dmell_global_script_ctx.variables, var_name, var_value );
+        int result = dmell_set_variable( &dmell_script_get_current()->variables, var_name, var_value );
+        if( result < 0 )
+        {
+            dmell_eprintf("Failed to set variable in dmell_handler_set: %s=%s\n", var_name, var_value);
+            return result;
+        }
     }
     return 0;
 }
@@ -255,7 +306,7 @@ int dmell_handler_unset( int argc, char** argv )
 {
     if( argc < 2 )
     {
-        DMOD_LOG_ERROR("Missing variable name for 'unset' command\n");
+        dmell_eprintf("Missing variable name for 'unset' command\n");
         return -EINVAL;
     }
 
@@ -264,10 +315,10 @@ int dmell_handler_unset( int argc, char** argv )
         const char* var_name = argv[i];
         if( var_name == NULL || strlen(var_name) == 0 )
         {
-            DMOD_LOG_ERROR("Invalid variable name in unset: %s\n", var_name ? var_name : "(null)");
+            dmell_eprintf("Invalid variable name in unset: %s\n", var_name ? var_name : "(null)");
             continue;
         }
-        g_dmell_global_script_ctx.variables = dmell_remove_variable( g_dmell_global_script_ctx.variables, var_name );
+        dmell_remove_variable( &dmell_script_get_current()->variables, var_name );
     }
     return 0;
 }
@@ -289,7 +340,7 @@ int dmell_handler_cd( int argc, char** argv )
         path = Dmod_GetEnv("HOME");
         if( path == NULL )
         {
-            DMOD_LOG_ERROR("HOME environment variable not set\n");
+            dmell_eprintf("HOME environment variable not set\n");
             return -EINVAL;
         }
     }
@@ -300,17 +351,20 @@ int dmell_handler_cd( int argc, char** argv )
 
     if( path == NULL || strlen(path) == 0 )
     {
-        DMOD_LOG_ERROR("Invalid directory path\n");
+        dmell_eprintf("Invalid directory path\n");
         return -EINVAL;
     }
 
     int result = Dmod_ChDir(path);
     if( result != 0 )
     {
-        DMOD_LOG_ERROR("Failed to change directory to '%s': %d\n", path, result);
+        dmell_eprintf("Failed to change directory to '%s': %d\n", path, result);
         return result;
     }
 
+    // Relative command paths are resolved against the working directory
+    dmell_resolve_invalidate();
+
     return 0;
 }
 
@@ -327,11 +381,11 @@ int dmell_handler_pwd( int argc, char** argv )
     
     if( Dmod_GetCwd(cwd, sizeof(cwd)) == NULL )
     {
-        DMOD_LOG_ERROR("Failed to get current working directory\n");
+        dmell_eprintf("Failed to get current working directory\n");
         return -1;
     }
     
-    Dmod_Printf("%s\n", cwd);
+    dmell_printf("%s\n", cwd);
     return 0;
 }
 
@@ -362,7 +416,7 @@ int dmell_handler_exit( int argc, char** argv )
         
         if( *endptr != '\0' || code < INT_MIN || code > INT_MAX )
         {
-            DMOD_LOG_ERROR("Invalid exit code: %s\n", argv[1]);
+            dmell_eprintf("Invalid exit code: %s\n", argv[1]);
             exit_code = 2;
         }
         else
@@ -373,7 +427,7 @@ int dmell_handler_exit( int argc, char** argv )
     else
     {
         // Use last command's exit code if no argument provided
-        exit_code = g_dmell_global_script_ctx.last_exit_code;
+        exit_code = dmell_script_get_current()->last_exit_code;
     }
     
     // Signal exit by returning a special value (negative for error handling)
@@ -405,7 +459,7 @@ int dmell_handler_uptime( int argc, char** argv )
 
     if( days > 0 )
     {
-        Dmod_Printf("up %llu day%s, %02llu:%02llu:%02llu.%03llu\n",
+        dmell_printf("up %llu day%s, %02llu:%02llu:%02llu.%03llu\n",
             (unsigned long long)days,
             days == 1 ? "" : "s",
             (unsigned long long)hours,
@@ -415,7 +469,7 @@ int dmell_handler_uptime( int argc, char** argv )
     }
     else
     {
-        Dmod_Printf("up %02llu:%02llu:%02llu.%03llu\n",
+        dmell_printf("up %02llu:%02llu:%02llu.%03llu\n",
             (unsigned long long)hours,
             (unsigned long long)minutes,
             (unsigned long long)seconds,
@@ -436,7 +490,7 @@ int dmell_handler_setloglevel( int argc, char** argv )
 {
     if( argc < 2 )
     {
-        DMOD_LOG_ERROR("Usage: setloglevel <verbose|info|warning|error>\n");
+        dmell_eprintf("Usage: setloglevel <verbose|info|warning|error>\n");
         return -EINVAL;
     }
 
@@ -461,7 +515,7 @@ int dmell_handler_setloglevel( int argc, char** argv )
     }
     else
     {
-        DMOD_LOG_ERROR("Invalid log level: %s. Use verbose, info, warning, or error.\n", level);
+        dmell_eprintf("Invalid log level: %s. Use verbose, info, warning, or error.\n", level);
         return -EINVAL;
     }
 
@@ -470,45 +524,41 @@ int dmell_handler_setloglevel( int argc, char** argv )
 }
 
 /**
- * @brief Helper function to read the shebang line and extract the interpreter.
+ * @brief Handler for the 'hash' command.
+ * 
+ * Without arguments prints the cached resolutions of external commands,
+ * with '-r' clears the cache.
  * 
- * @param file_name Name of the script file
- * @param buffer Buffer to store the interpreter path
- * @param buffer_size Size of the buffer
- * @return bool True if shebang found and interpreter extracted, false otherwise
+ * @param argc Number of arguments
+ * @param argv Array of argument strings
+ * @return int Exit code
  */
-static bool get_shebang_interpreter(const char* file_name, char* buffer, size_t buffer_size)
+int dmell_handler_hash( int argc, char** argv )
 {
-    void* file = Dmod_FileOpen(file_name, "r");
-    if(file == NULL)
+    if( argc >= 2 )
     {
-        return false;
+        if( strcmp( argv[1], "-r" ) != 0 )
+        {
+            dmell_eprintf("Usage: hash [-r]\n");
+            return -EINVAL;
+        }
+        dmell_resolve_invalidate();
+        return 0;
     }
 
-    char mark[3] = {0};
-    size_t read_bytes = Dmod_FileRead(buffer, 1, 2, file);
-    if(read_bytes < 2 || mark[0] != '#' || mark[1] != '!')
+    static const char* const kind_names[dmell_resolve_max] = {
+        [dmell_resolve_not_found]   = "not found",
+        [dmell_resolve_script]      = "script",
+        [dmell_resolve_shebang]     = "shebang",
+        [dmell_resolve_file]        = "file",
+        [dmell_resolve_module]      = "module",
+    };
+    size_t iterator = 0;
+    for( const dmell_resolve_t* entry = dmell_resolve_next( &iterator ); entry != NULL; entry = dmell_resolve_next( &iterator ) )
     {
-        Dmod_FileClose(file);
-        return false;
+        dmell_printf("%-20s %-10s %s\n", entry->name, kind_names[entry->kind], entry->target != NULL ? entry->target : "");
     }
-
-    read_bytes = Dmod_FileRead(buffer, 1, buffer_size - 1, file);
-    Dmod_FileClose(file);
-    buffer[read_bytes] = '\0';
-    return true;
-}
-
-/**
- * @brief Helper function to check if a file is a dmell script based on its extension.
- * 
- * @param file_name Name of the file
- * @return bool True if it is a dmell script, false otherwise
- */
-static bool is_dmell_script(const char* file_name)
-{
-    size_t len = strlen(file_name);
-    return (len > 4 && strcmp(&file_name[len - 4], ".dme") == 0);
+    return 0;
 }
 
 /**
@@ -522,17 +572,18 @@ static bool is_dmell_script(const char* file_name)
  */
 static int run_shebang( char* interpreter, char* script_file, int argc, char** argv )
 {
-    int new_argc = argc + 2;
-    char** new_argv = Dmod_Malloc( sizeof(char*) * (new_argc + 2) );
+    // The interpreter and the script replace the command name
+    int new_argc = argc + 1;
+    char** new_argv = Dmod_Malloc( sizeof(char*) * (new_argc + 1) );
     if( new_argv == NULL )
     {
-        DMOD_LOG_ERROR("Memory allocation failed in run_shebang for new_argv\n");
+        dmell_eprintf("Memory allocation failed in run_shebang for new_argv\n");
         return -ENOMEM;
     }
 
     if(strcmp(interpreter, script_file) == 0)
     {
-        DMOD_LOG_ERROR("Circular dependency detected: Interpreter and script file cannot be the same: %s\n", interpreter);
+        dmell_eprintf("Circular dependency detected: Interpreter and script file cannot be the same: %s\n", interpreter);
         Dmod_Free( new_argv );
         return -EINVAL;
     }
@@ -543,6 +594,7 @@ static int run_shebang( char* interpreter, char* script_file, int argc, char** a
     {
         new_argv[i + 1] = argv[i];
     }
+    new_argv[new_argc] = NULL;
 
     int result = dmell_run_command( interpreter, new_argc, new_argv );
     Dmod_Free( new_argv );
@@ -564,7 +616,7 @@ static int spawn_and_wait( const char* file_name, int argc, char** argv )
 {
     if( !Dmod_IsFunctionConnected( (void*)Dmod_SpawnModule ) )
     {
-        DMOD_LOG_ERROR("Dmod_SpawnModule is not available and Dmod_RunModule failed with -ENOMEM\n");
+        dmell_eprintf("Dmod_SpawnModule is not available and Dmod_RunModule failed with -ENOMEM\n");
         return -ENOMEM;
     }
 
@@ -586,6 +638,25 @@ static int spawn_and_wait( const char* file_name, int argc, char** argv )
     return exit_status;
 }
 
+/**
+ * @brief Helper function to start a module as a background job.
+ *
+ * @param file_name Path or name of the module to spawn
+ * @param argc Number of arguments
+ * @param argv Array of argument strings
+ * @return int 0 on success, -ENOTSUP if modules cannot be spawned, other negative value on error
+ */
+static int start_job( const char* file_name, int argc, char** argv )
+{
+    const dmell_job_t* job = NULL;
+    int result = dmell_jobs_spawn( file_name, argc, argv, &job );
+    if( result == 0 )
+    {
+        dmell_printf("[%u] %d\n", (unsigned)job->id, job->pid);
+    }
+    return result;
+}
+
 /**
  * @brief Default handler for unknown commands.
  * 
@@ -597,7 +668,7 @@ int dmell_handler_default( int argc, char** argv )
 {
     if( argc < 1 )
     {
-        DMOD_LOG_ERROR("No command provided to default handler\n");
+        dmell_eprintf("No command provided to default handler\n");
         return -EINVAL;
     }
 
@@ -608,39 +679,150 @@ int dmell_handler_default( int argc, char** argv )
     }
     else
     {
-        // check if it is a file execution
+        // check if it is a file execution or a module
         char* file_name = argv[0];
-        int result;
-        if(Dmod_FileAvailable(file_name))
+        const dmell_resolve_t* resolution = dmell_resolve_command( file_name );
+        if( resolution == NULL )
         {
-            char interpreter[256] = {0};
-            if(get_shebang_interpreter(file_name, interpreter, sizeof(interpreter)))
-            {
-                return run_shebang(interpreter, file_name, argc, argv);
-            }
-            else if(is_dmell_script(file_name))
-            {
-                return dmell_run_script_file(file_name, argc, argv);
-            }
-            else
+            return -ENOMEM;
+        }
+
+        // The cache entry may be replaced while the command runs, so keep a copy of the target
+        dmell_resolve_kind_t kind = (dmell_resolve_kind_t)resolution->kind;
+        size_t target_len = ( resolution->target != NULL ) ? strlen( resolution->target ) : 0;
+        char target[target_len + 1];
+        memcpy( target, ( resolution->target != NULL ) ? resolution->target : "", target_len + 1 );
+
+        if( dmell_jobs_is_background() && ( kind == dmell_resolve_file || kind == dmell_resolve_module ) )
+        {
+            int result = start_job( target, argc, argv );
+            if( result != -ENOTSUP )
             {
-                result = Dmod_RunModule( file_name, argc, argv );
+                return result;
             }
+            dmell_eprintf("Background jobs are not available, running '%s' in the foreground\n", file_name);
         }
-        else 
+
+        int result;
+        switch( kind )
         {
-            result = Dmod_RunModule( file_name, argc, argv );
+            case dmell_resolve_shebang:
+                return run_shebang( target, file_name, argc, argv );
+            case dmell_resolve_script:
+                return dmell_run_script_file( file_name, argc, argv );
+            case dmell_resolve_file:
+                result = Dmod_RunModule( target, argc, argv );
+                break;
+            case dmell_resolve_module:
+                // A module kept in the pool is run by name, so the loaded instance is reused
+                result = Dmod_RunModule( dmell_pool_acquire( file_name, target ) ? file_name : target, argc, argv );
+                break;
+            default:
+                dmell_eprintf("Command not found: %s\n", file_name);
+                return -ENOENT;
         }
 
         if( result == -ENOMEM )
         {
-            result = spawn_and_wait( file_name, argc, argv );
+            result = spawn_and_wait( target, argc, argv );
         }
 
+        // The module ran in the environment of the shell and could change it
+        dmell_env_changed();
         return result;
     }
 }
 
+/**
+ * @brief Checks if the default handler runs a command inside the shell.
+ * 
+ * Variable assignments and dmell scripts run inside the shell, and so does
+ * the error message of a command that is not found. Modules and files with
+ * a shebang run as separate programs that write straight to the console,
+ * so their output cannot be captured.
+ * 
+ * @param cmd_name Name of the command
+ * @return true If the output of the command can be captured
+ * @return false Otherwise
+ */
+bool dmell_handler_default_captures( const char* cmd_name )
+{
+    if( strchr( cmd_name, '=' ) != NULL )
+    {
+        return true;
+    }
+    const dmell_resolve_t* resolution = dmell_resolve_command( cmd_name );
+    return resolution == NULL || resolution->kind == dmell_resolve_script || resolution->kind == dmell_resolve_not_found;
+}
+
+/**
+ * @brief Helper function to parse a size argument.
+ * 
+ * @param str String to parse
+ * @param out_value Output parameter to hold the value
+ * @return bool True if the string is a valid decimal number, false otherwise
+ */
+static bool parse_size( const char* str, size_t* out_value )
+{
+    size_t value = 0;
+    if( *str == '\0' )
+    {
+        return false;
+    }
+    while( *str >= '0' && *str <= '9' )
+    {
+        value = value * 10 + (size_t)(*str - '0');
+        str++;
+    }
+    *out_value = value;
+    return *str == '\0';
+}
+
+/**
+ * @brief Helper function to handle the 'module pool' subcommand.
+ * 
+ * @param argc Number of arguments after 'pool'
+ * @param argv Array of arguments after 'pool'
+ * @return int Exit code
+ */
+static int module_pool( int argc, char** argv )
+{
+    dmell_pool_stats_t stats;
+    dmell_pool_get_stats( &stats );
+    if( argc == 0 )
+    {
+        dmell_printf("Module pool: %zu/%zu modules, %zu/%zu bytes resident\n", stats.count, stats.max_count, stats.resident_bytes, stats.budget);
+        dmell_printf("  Hits:      %zu\n", stats.hits);
+        dmell_printf("  Misses:    %zu\n", stats.misses);
+        dmell_printf("  Evictions: %zu\n", stats.evictions);
+        for( const dmell_pool_entry_t* entry = dmell_pool_first(); entry != NULL; entry = entry->next )
+        {
+            dmell_printf("  %-20s %zu bytes\n", entry->name, entry->size);
+        }
+        return 0;
+    }
+
+    size_t value = 0;
+    if( strcmp( argv[0], "flush" ) == 0 )
+    {
+        dmell_pool_flush();
+        return 0;
+    }
+    else if( argc == 2 && strcmp( argv[0], "size" ) == 0 && parse_size( argv[1], &value ) )
+    {
+        dmell_pool_configure( value, stats.budget );
+        return 0;
+    }
+    else if( argc == 2 && strcmp( argv[0], "budget" ) == 0 && parse_size( argv[1], &value ) )
+    {
+        dmell_pool_configure( stats.max_count, value );
+        return 0;
+    }
+
+    dmell_printf("Usage: module pool [flush | size <count> | budget <bytes>]\n");
+    return -EINVAL;
+}
+
 /**
  * @brief Handler for the 'module' command.
  * 
@@ -652,14 +834,15 @@ int dmell_handler_module( int argc, char** argv )
 {
     if( argc < 2 )
     {
-        Dmod_Printf("Usage: module <subcommand> [args...]\n");
-        Dmod_Printf("Subcommands:\n");
-        Dmod_Printf("  load <name>      Load a module\n");
-        Dmod_Printf("  unload <name>    Unload a module\n");
-        Dmod_Printf("  enable <name>    Enable a module\n");
-        Dmod_Printf("  disable <name>   Disable a module\n");
-        Dmod_Printf("  info <name>      Show module information\n");
-        Dmod_Printf("  list             List all modules\n");
+        dmell_printf("Usage: module <subcommand> [args...]\n");
+        dmell_printf("Subcommands:\n");
+        dmell_printf("  load <name>      Load a module\n");
+        dmell_printf("  unload <name>    Unload a module\n");
+        dmell_printf("  enable <name>    Enable a module\n");
+        dmell_printf("  disable <name>   Disable a module\n");
+        dmell_printf("  info <name>      Show module information\n");
+        dmell_printf("  list             List all modules\n");
+        dmell_printf("  pool [...]       Show or configure the pool of resident command modules\n");
         return -EINVAL;
     }
 
@@ -669,75 +852,85 @@ int dmell_handler_module( int argc, char** argv )
     {
         if( argc < 3 )
         {
-            Dmod_Printf("Usage: module load <name>\n");
+            dmell_printf("Usage: module load <name>\n");
             return -EINVAL;
         }
         const char* module_name = argv[2];
         Dmod_Context_t* ctx = Dmod_LoadModuleByName( module_name );
+        dmell_resolve_invalidate();
         if( ctx == NULL )
         {
-            Dmod_Printf("Failed to load module: %s\n", module_name);
+            dmell_printf("Failed to load module: %s\n", module_name);
             return -1;
         }
-        Dmod_Printf("Module '%s' loaded successfully\n", module_name);
+        // The module belongs to the user now, so the pool must not unload it
+        dmell_pool_set_external( module_name, true );
+        dmell_printf("Module '%s' loaded successfully\n", module_name);
         return 0;
     }
     else if( strcmp( subcommand, "unload" ) == 0 )
     {
         if( argc < 3 )
         {
-            Dmod_Printf("Usage: module unload <name>\n");
+            dmell_printf("Usage: module unload <name>\n");
             return -EINVAL;
         }
         const char* module_name = argv[2];
+        dmell_pool_release( module_name );
+        dmell_pool_set_external( module_name, false );
         bool result = Dmod_UnloadModule( module_name, false );
+        dmell_resolve_invalidate();
         if( !result )
         {
-            Dmod_Printf("Failed to unload module: %s\n", module_name);
+            dmell_printf("Failed to unload module: %s\n", module_name);
             return -1;
         }
-        Dmod_Printf("Module '%s' unloaded successfully\n", module_name);
+        dmell_printf("Module '%s' unloaded successfully\n", module_name);
         return 0;
     }
     else if( strcmp( subcommand, "enable" ) == 0 )
     {
         if( argc < 3 )
         {
-            Dmod_Printf("Usage: module enable <name>\n");
+            dmell_printf("Usage: module enable <name>\n");
             return -EINVAL;
         }
         const char* module_name = argv[2];
         bool result = Dmod_EnableModule( module_name, false, NULL );
+        dmell_resolve_invalidate();
         if( !result )
         {
-            Dmod_Printf("Failed to enable module: %s\n", module_name);
+            dmell_printf("Failed to enable module: %s\n", module_name);
             return -1;
         }
-        Dmod_Printf("Module '%s' enabled successfully\n", module_name);
+        dmell_pool_set_external( module_name, true );
+        dmell_printf("Module '%s' enabled successfully\n", module_name);
         return 0;
     }
     else if( strcmp( subcommand, "disable" ) == 0 )
     {
         if( argc < 3 )
         {
-            Dmod_Printf("Usage: module disable <name>\n");
+            dmell_printf("Usage: module disable <name>\n");
             return -EINVAL;
         }
         const char* module_name = argv[2];
+        dmell_pool_set_external( module_name, true );
         bool result = Dmod_DisableModule( module_name, false );
+        dmell_resolve_invalidate();
         if( !result )
         {
-            Dmod_Printf("Failed to disable module: %s\n", module_name);
+            dmell_printf("Failed to disable module: %s\n", module_name);
             return -1;
         }
-        Dmod_Printf("Module '%s' disabled successfully\n", module_name);
+        dmell_printf("Module '%s' disabled successfully\n", module_name);
         return 0;
     }
     else if( strcmp( subcommand, "info" ) == 0 )
     {
         if( argc < 3 )
         {
-            Dmod_Printf("Usage: module info <name>\n");
+            dmell_printf("Usage: module info <name>\n");
             return -EINVAL;
         }
         const char* module_name = argv[2];
@@ -753,17 +946,17 @@ int dmell_handler_module( int argc, char** argv )
                 if( node.header.Name[0] != '\0' && strcmp( node.header.Name, module_name ) == 0 )
                 {
                     found = true;
-                    Dmod_Printf("Module Information:\n");
-                    Dmod_Printf("  Name:     %s\n", node.header.Name);
-                    Dmod_Printf("  Version:  %s\n", node.header.Version);
-                    Dmod_Printf("  Author:   %s\n", node.header.Author);
-                    Dmod_Printf("  Path:     %s\n", node.path);
+                    dmell_printf("Module Information:\n");
+                    dmell_printf("  Name:     %s\n", node.header.Name);
+                    dmell_printf("  Version:  %s\n", node.header.Version);
+                    dmell_printf("  Author:   %s\n", node.header.Author);
+                    dmell_printf("  Path:     %s\n", node.path);
                     
                     // Read module header to get more information
-                    Dmod_Printf("  Arch:     %s\n", node.header.Arch);
-                    Dmod_Printf("  CPU:      %s\n", node.header.CpuName);
-                    Dmod_Printf("  Priority: %u\n", node.header.Priority);
-                    Dmod_Printf("  Stack:    %llu bytes\n", (unsigned long long)node.header.RequiredStackSize);
+                    dmell_printf("  Arch:     %s\n", node.header.Arch);
+                    dmell_printf("  CPU:      %s\n", node.header.CpuName);
+                    dmell_printf("  Priority: %u\n", node.header.Priority);
+                    dmell_printf("  Stack:    %llu bytes\n", (unsigned long long)node.header.RequiredStackSize);
                     
                     // Read required modules
                     Dmod_RequiredModule_t requiredModules[DMOD_MAX_REQUIRED_MODULES] = {0};
@@ -777,10 +970,10 @@ int dmell_handler_module( int argc, char** argv )
                             {
                                 if( !has_required )
                                 {
-                                    Dmod_Printf("  Required modules:\n");
+                                    dmell_printf("  Required modules:\n");
                                     has_required = true;
                                 }
-                                Dmod_Printf("    - %s (v%s)%s\n", 
+                                dmell_printf("    - %s (v%s)%s\n", 
                                     requiredModules[i].Name,
                                     requiredModules[i].Version,
                                     requiredModules[i].SystemModule ? " [system]" : "");
@@ -788,7 +981,7 @@ int dmell_handler_module( int argc, char** argv )
                         }
                         if( !has_required )
                         {
-                            Dmod_Printf("  Required modules: none\n");
+                            dmell_printf("  Required modules: none\n");
                         }
                     }
                     break;
@@ -800,11 +993,15 @@ int dmell_handler_module( int argc, char** argv )
         
         if( !found )
         {
-            Dmod_Printf("Module not found: %s\n", module_name);
+            dmell_printf("Module not found: %s\n", module_name);
             return -1;
         }
         return 0;
     }
+    else if( strcmp( subcommand, "pool" ) == 0 )
+    {
+        return module_pool( argc - 2, &argv[2] );
+    }
     else if( strcmp( subcommand, "list" ) == 0 )
     {
         Dmod_ModuleNode_t node = {0};
@@ -812,16 +1009,16 @@ int dmell_handler_module( int argc, char** argv )
         
         if( Dmod_OpenModules( &node ) )
         {
-            Dmod_Printf("Available modules:\n");
-            Dmod_Printf("%-30s %-15s %-40s\n", "Name", "Version", "Path");
-            Dmod_Printf("---------------------------------------------------------------------------------------------\n");
+            dmell_printf("Available modules:\n");
+            dmell_printf("%-30s %-15s %-40s\n", "Name", "Version", "Path");
+            dmell_printf("---------------------------------------------------------------------------------------------\n");
             
             while( Dmod_ReadNextModule( &node ) )
             {
                 if( node.header.Name[0] != '\0' )
                 {
                     has_modules = true;
-                    Dmod_Printf("%-30s %-15s %-40s\n",
+                    dmell_printf("%-30s %-15s %-40s\n",
                         node.header.Name,
                         node.header.Version,
                         node.path);
@@ -833,18 +1030,664 @@ int dmell_handler_module( int argc, char** argv )
         
         if( !has_modules )
         {
-            Dmod_Printf("No modules available\n");
+            dmell_printf("No modules available\n");
         }
         return 0;
     }
     else
     {
-        Dmod_Printf("Unknown subcommand: %s\n", subcommand);
-        Dmod_Printf("Use 'module' without arguments to see available subcommands\n");
+        dmell_printf("Unknown subcommand: %s\n", subcommand);
+        dmell_printf("Use 'module' without arguments to see available subcommands\n");
+        return -EINVAL;
+    }
+}
+
+/**
+ * @brief Helper function to parse a job argument.
+ * 
+ * Accepts a process identifier or '%' followed by a job number.
+ * 
+ * @param arg Argument to parse
+ * @param out_pid Output parameter to hold the process identifier
+ * @return bool True if the argument is valid, false otherwise
+ */
+static bool parse_job( const char* arg, int* out_pid )
+{
+    size_t value = 0;
+    if( arg[0] != '%' )
+    {
+        if( !parse_size( arg, &value ) || value > INT_MAX )
+        {
+            return false;
+        }
+        *out_pid = (int)value;
+        return true;
+    }
+
+    if( !parse_size( &arg[1], &value ) )
+    {
+        return false;
+    }
+    size_t iterator = 0;
+    for( const dmell_job_t* job = dmell_jobs_next( &iterator ); job != NULL; job = dmell_jobs_next( &iterator ) )
+    {
+        if( job->id == value )
+        {
+            *out_pid = job->pid;
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * @brief Handler for the 'jobs' command.
+ * 
+ * Lists the background jobs. Jobs that finished are listed once and
+ * removed from the table.
+ * 
+ * @param argc Number of arguments
+ * @param argv Array of argument strings
+ * @return int Exit code
+ */
+int dmell_handler_jobs( int argc, char** argv )
+{
+    (void)argc;
+    (void)argv;
+
+    size_t iterator = 0;
+    for( const dmell_job_t* job = dmell_jobs_next( &iterator ); job != NULL; job = dmell_jobs_next( &iterator ) )
+    {
+        if( dmell_jobs_is_running( job ) )
+        {
+            dmell_printf("[%u] Running    %-6d %s\n", (unsigned)job->id, job->pid, job->command);
+        }
+        else
+        {
+            dmell_printf("[%u] Done       %-6d %s\n", (unsigned)job->id, job->pid, job->command);
+            dmell_jobs_wait( job->pid );
+        }
+    }
+    return 0;
+}
+
+/**
+ * @brief Handler for the 'wait' command.
+ * 
+ * Usage: wait [pid | %job ...]
+ * 
+ * Without arguments waits for all background jobs.
+ * 
+ * @param argc Number of arguments
+ * @param argv Array of argument strings
+ * @return int Exit status of the last job waited for
+ */
+int dmell_handler_wait( int argc, char** argv )
+{
+    int result = 0;
+    if( argc < 2 )
+    {
+        size_t iterator = 0;
+        for( const dmell_job_t* job = dmell_jobs_next( &iterator ); job != NULL; job = dmell_jobs_next( &iterator ) )
+        {
+            result = dmell_jobs_wait( job->pid );
+        }
+        return result;
+    }
+
+    for( int i = 1; i < argc; i++ )
+    {
+        int pid = 0;
+        if( !parse_job( argv[i], &pid ) )
+        {
+            dmell_eprintf("wait: invalid job: %s\n", argv[i]);
+            return -EINVAL;
+        }
+        result = dmell_jobs_wait( pid );
+        if( result == -ECHILD )
+        {
+            dmell_eprintf("wait: no such job: %s\n", argv[i]);
+        }
+    }
+    return result;
+}
+
+/**
+ * @brief Handler for the 'kill' command.
+ * 
+ * Usage: kill <pid | %job> [...]
+ * 
+ * @param argc Number of arguments
+ * @param argv Array of argument strings
+ * @return int Exit code
+ */
+int dmell_handler_kill( int argc, char** argv )
+{
+    if( argc < 2 )
+    {
+        dmell_eprintf("Usage: kill <pid | %%job> [...]\n");
         return -EINVAL;
     }
+
+    int result = 0;
+    for( int i = 1; i < argc; i++ )
+    {
+        int pid = 0;
+        if( !parse_job( argv[i], &pid ) )
+        {
+            dmell_eprintf("kill: invalid job: %s\n", argv[i]);
+            return -EINVAL;
+        }
+        if( dmell_jobs_kill( pid ) < 0 )
+        {
+            dmell_eprintf("kill: no such process: %s\n", argv[i]);
+            result = -ESRCH;
+        }
+    }
+    return result;
 }
 
+/**
+ * @brief Helper function to collect the exit code of a spawned 'parallel' command.
+ *
+ * @param task Task of the command
+ */
+static void parallel_reap( parallel_task_t* task )
+{
+    dmosi_process_wait( task->process, -1 );
+    task->exit_code = dmosi_process_get_exit_status( task->process );
+    dmosi_process_destroy( task->process );
+    task->process = NULL;
+    task->finished = true;
+
+    // The command could change the environment of the shell
+    dmell_env_changed();
+}
+
+/**
+ * @brief Helper function to free a slot in the pool of 'parallel' processes.
+ *
+ * A process that already finished is reaped first, otherwise waits for
+ * the oldest one.
+ *
+ * @param tasks Array of tasks
+ * @param count Number of started tasks
+ */
+static void parallel_reap_one( parallel_task_t* tasks, int count )
+{
+    parallel_task_t* oldest = NULL;
+    for( int i = 0; i < count; i++ )
+    {
+        if( tasks[i].process == NULL )
+        {
+            continue;
+        }
+        dmosi_process_state_t state = dmosi_process_get_state( tasks[i].process );
+        if( state == DMOSI_PROCESS_STATE_TERMINATED || state == DMOSI_PROCESS_STATE_ZOMBIE )
+        {
+            parallel_reap( &tasks[i] );
+            return;
+        }
+        oldest = ( oldest == NULL ) ? &tasks[i] : oldest;
+    }
+    if( oldest != NULL )
+    {
+        parallel_reap( oldest );
+    }
+}
+
+/**
+ * @brief Helper function to print the results of the finished 'parallel' commands in order.
+ *
+ * Stops at the first command that is still running, so the output of
+ * the commands is never mixed.
+ *
+ * @param tasks Array of tasks
+ * @param count Number of started tasks
+ * @param argv Arguments of the 'parallel' command
+ * @param next Index of the first task that was not printed yet
+ * @param failed Number of failed commands, updated
+ */
+static void parallel_emit( parallel_task_t* tasks, int count, char** argv, int* next, int* failed )
+{
+    while( *next < count && tasks[*next].finished )
+    {
+        parallel_task_t* task = &tasks[(*next)++];
+        if( task->output.length > 0 )
+        {
+            dmell_io_write( task->output.data, task->output.length );
+        }
+        dmell_buf_free( &task->output );
+        if( task->exit_code != 0 )
+        {
+            dmell_eprintf("parallel: '%s' failed with exit code %d\n", argv[task->first], task->exit_code);
+            (*failed)++;
+        }
+    }
+}
+
+/**
+ * @brief Helper function to start a command of 'parallel'.
+ *
+ * Modules are spawned as separate processes. Other commands, and modules
+ * when spawning is not available, run in the shell with the output and
+ * error messages captured, so they can be printed in order.
+ *
+ * @param task Task of the command
+ * @param argv Arguments of the command, null terminated
+ */
+static void parallel_start( parallel_task_t* task, char** argv )
+{
+    const dmell_resolve_t* resolution = dmell_resolve_command( argv[0] );
+    bool is_module = resolution != NULL &&
+                    ( resolution->kind == dmell_resolve_file || resolution->kind == dmell_resolve_module );
+    if( is_module && Dmod_IsFunctionConnected( (void*)Dmod_SpawnModule ) )
+    {
+        int pid = Dmod_SpawnModule( resolution->target, task->argc, argv );
+        task->process = ( pid >= 0 ) ? dmosi_process_find_by_id( (dmosi_process_id_t)pid ) : NULL;
+        if( task->process != NULL )
+        {
+            return;
+        }
+        dmell_eprintf("parallel: failed to spawn '%s', running it in the shell\n", argv[0]);
+    }
+
+    dmell_io_t saved;
+    dmell_io_save( &saved );
+    dmell_io_set_output( dmell_io_buffer, &task->output );
+    dmell_io_set_error( dmell_io_buffer, &task->output );
+    task->exit_code = dmell_run_command( argv[0], task->argc, argv );
+    dmell_io_restore( &saved );
+    task->finished = true;
+}
+
+/**
+ * @brief Handler for the 'parallel' command.
+ *
+ * Usage: parallel [-j N] [--] cmd1 [args...] ::: cmd2 [args...] ::: ...
+ *
+ * Runs at most N modules at the same time (4 by default).
+ *
+ * @param argc Number of arguments
+ * @param argv Array of argument strings
+ * @return int Number of commands that failed, or negative value on error
+ */
+int dmell_handler_parallel( int argc, char** argv )
+{
+    size_t max_jobs = DMELL_PARALLEL_DEFAULT_JOBS;
+    int i = 1;
+    if( i < argc && strcmp( argv[i], "-j" ) == 0 )
+    {
+        if( i + 1 >= argc || !parse_size( argv[i + 1], &max_jobs ) || max_jobs == 0 )
+        {
+            dmell_eprintf("parallel: invalid number of jobs\n");
+            return -EINVAL;
+        }
+        i += 2;
+    }
+    if( i < argc && strcmp( argv[i], "--" ) == 0 )
+    {
+        i++;
+    }
+    if( i >= argc )
+    {
+        dmell_eprintf("Usage: parallel [-j N] [--] cmd1 [args...] ::: cmd2 [args...] ...\n");
+        return -EINVAL;
+    }
+
+    parallel_task_t tasks[argc - i];
+    int count = 0;
+    while( i <= argc )
+    {
+        int first = i;
+        while( i < argc && strcmp( argv[i], DMELL_PARALLEL_SEPARATOR ) != 0 )
+        {
+            i++;
+        }
+        if( i > first )
+        {
+            tasks[count++] = (parallel_task_t){ .first = first, .argc = i - first };
+        }
+        i++;
+    }
+
+    int next = 0;
+    int failed = 0;
+    size_t running = 0;
+    for( int t = 0; t < count; t++ )
+    {
+        while( running >= max_jobs )
+        {
+            parallel_reap_one( tasks, t );
+            running--;
+        }
+
+        parallel_task_t* task = &tasks[t];
+        char* task_argv[task->argc + 1];
+        memcpy( task_argv, &argv[task->first], task->argc * sizeof(char*) );
+        task_argv[task->argc] = NULL;
+        parallel_start( task, task_argv );
+        running += ( task->process != NULL ) ? 1 : 0;
+        parallel_emit( tasks, t + 1, argv, &next, &failed );
+    }
+
+    for( int t = 0; t < count; t++ )
+    {
+        if( tasks[t].process != NULL )
+        {
+            parallel_reap( &tasks[t] );
+        }
+        parallel_emit( tasks, count, argv, &next, &failed );
+    }
+    return failed;
+}
+
+/**
+ * @brief State of the evaluation of a 'test' expression.
+ */
+typedef struct
+{
+    int     argc;       /**< Number of arguments of the expression */
+    char**  argv;       /**< Arguments of the expression */
+    int     pos;        /**< Index of the next argument */
+    bool    error;      /**< True if the expression is invalid */
+} test_state_t;
+
+static bool test_or( test_state_t* state );
+
+/**
+ * @brief Helper function to report an invalid 'test' expression.
+ *
+ * @param state State of the evaluation
+ * @param message Description of the error
+ * @param arg Argument that caused the error
+ * @return bool Always false
+ */
+static bool test_error( test_state_t* state, const char* message, const char* arg )
+{
+    if( !state->error )
+    {
+        dmell_eprintf("test: %s%s%s\n", message, arg != NULL ? ": " : "", arg != NULL ? arg : "");
+        state->error = true;
+    }
+    return false;
+}
+
+/**
+ * @brief Helper function to parse an integer operand of 'test'.
+ *
+ * @param state State of the evaluation
+ * @param str String to parse
+ * @param out_value Output parameter to hold the value
+ * @return bool True if the string is a valid integer, false otherwise
+ */
+static bool test_parse_integer( test_state_t* state, const char* str, long* out_value )
+{
+    char* end_ptr = NULL;
+    *out_value = strtol( str, &end_ptr, 10 );
+    if( end_ptr == str || *end_ptr != '\0' )
+    {
+        return test_error( state, "integer expression expected", str );
+    }
+    return true;
+}
+
+/**
+ * @brief Helper function to check if a path is a directory.
+ *
+ * @param path Path to check
+ * @return bool True if the directory can be opened, false otherwise
+ */
+static bool test_is_directory( const char* path )
+{
+    void* dir = Dmod_OpenDir( path );
+    if( dir != NULL )
+    {
+        Dmod_CloseDir( dir );
+    }
+    return dir != NULL;
+}
+
+/**
+ * @brief Helper function to check if a path is a regular file that is not empty.
+ *
+ * @param path Path to check
+ * @return bool True if the file has data, false otherwise
+ */
+static bool test_has_data( const char* path )
+{
+    if( test_is_directory( path ) )
+    {
+        return false;
+    }
+    void* file = Dmod_FileOpen( path, "r" );
+    if( file == NULL )
+    {
+        return false;
+    }
+    size_t size = Dmod_FileSize( file );
+    Dmod_FileClose( file );
+    return size > 0;
+}
+
+/**
+ * @brief Helper function to evaluate a unary primary of 'test' (-e, -f, -d, -s, -z, -n).
+ *
+ * @param op Operator
+ * @param arg Operand
+ * @param out_result Output parameter to hold the result
+ * @return bool True if the operator is a unary primary, false otherwise
+ */
+static bool test_unary( const char* op, const char* arg, bool* out_result )
+{
+    if( op[0] != '-' || op[1] == '\0' || op[2] != '\0' )
+    {
+        return false;
+    }
+
+    switch( op[1] )
+    {
+        case 'e': *out_result = Dmod_FileAvailable( arg ) || test_is_directory( arg ); return true;
+        case 'f': *out_result = Dmod_FileAvailable( arg ) && !test_is_directory( arg ); return true;
+        case 'd': *out_result = test_is_directory( arg ); return true;
+        case 's': *out_result = test_has_data( arg ); return true;
+        case 'z': *out_result = ( *arg == '\0' ); return true;
+        case 'n': *out_result = ( *arg != '\0' ); return true;
+        default: return false;
+    }
+}
+
+/**
+ * @brief Helper function to evaluate a binary primary of 'test' (=, !=, -eq, -ne, -lt, -le, -gt, -ge).
+ *
+ * @param state State of the evaluation
+ * @param lhs Left operand
+ * @param op Operator
+ * @param rhs Right operand
+ * @param out_result Output parameter to hold the result
+ * @return bool True if the operator is a binary primary, false otherwise
+ */
+static bool test_binary( test_state_t* state, const char* lhs, const char* op, const char* rhs, bool* out_result )
+{
+    static const char* const numeric_ops[] = { "-eq", "-ne", "-lt", "-le", "-gt", "-ge" };
+    if( strcmp( op, "=" ) == 0 || strcmp( op, "==" ) == 0 || strcmp( op, "!=" ) == 0 )
+    {
+        *out_result = ( strcmp( lhs, rhs ) == 0 ) == ( op[0] != '!' );
+        return true;
+    }
+
+    size_t index = 0;
+    while( index < sizeof(numeric_ops) / sizeof(numeric_ops[0]) && strcmp( op, numeric_ops[index] ) != 0 )
+    {
+        index++;
+    }
+    if( index >= sizeof(numeric_ops) / sizeof(numeric_ops[0]) )
+    {
+        return false;
+    }
+
+    long a = 0;
+    long b = 0;
+    if( !test_parse_integer( state, lhs, &a ) || !test_parse_integer( state, rhs, &b ) )
+    {
+        *out_result = false;
+        return true;
+    }
+    switch( index )
+    {
+        case 0:  *out_result = ( a == b ); break;
+        case 1:  *out_result = ( a != b ); break;
+        case 2:  *out_result = ( a < b );  break;
+        case 3:  *out_result = ( a <= b ); break;
+        case 4:  *out_result = ( a > b );  break;
+        default: *out_result = ( a >= b ); break;
+    }
+    return true;
+}
+
+/**
+ * @brief Helper function to evaluate a primary of 'test' - '!' primary, ( expression ), a unary or binary primary, or a string.
+ *
+ * @param state State of the evaluation
+ * @return bool Value of the primary
+ */
+static bool test_primary( test_state_t* state )
+{
+    if( state->pos >= state->argc )
+    {
+        return test_error( state, "argument expected", NULL );
+    }
+
+    char** args = &state->argv[state->pos];
+    int left = state->argc - state->pos;
+    bool result = false;
+    if( left >= 3 && test_binary( state, args[0], args[1], args[2], &result ) )
+    {
+        state->pos += 3;
+        return result;
+    }
+    if( strcmp( args[0], "!" ) == 0 && left >= 2 )
+    {
+        state->pos++;
+        return !test_primary( state );
+    }
+    if( strcmp( args[0], "(" ) == 0 && left >= 2 )
+    {
+        state->pos++;
+        result = test_or( state );
+        if( state->pos >= state->argc || strcmp( state->argv[state->pos], ")" ) != 0 )
+        {
+            return test_error( state, "missing ')'", NULL );
+        }
+        state->pos++;
+        return result;
+    }
+    if( left >= 2 && test_unary( args[0], args[1], &result ) )
+    {
+        state->pos += 2;
+        return result;
+    }
+
+    // A single string is true when it is not empty
+    state->pos++;
+    return args[0][0] != '\0';
+}
+
+/**
+ * @brief Helper function to evaluate primaries joined with '-a'.
+ *
+ * @param state State of the evaluation
+ * @return bool Value of the expression
+ */
+static bool test_and( test_state_t* state )
+{
+    bool result = test_primary( state );
+    while( !state->error && state->pos < state->argc && strcmp( state->argv[state->pos], "-a" ) == 0 )
+    {
+        state->pos++;
+        result = test_primary( state ) && result;
+    }
+    return result;
+}
+
+/**
+ * @brief Helper function to evaluate expressions joined with '-o'.
+ *
+ * @param state State of the evaluation
+ * @return bool Value of the expression
+ */
+static bool test_or( test_state_t* state )
+{
+    bool result = test_and( state );
+    while( !state->error && state->pos < state->argc && strcmp( state->argv[state->pos], "-o" ) == 0 )
+    {
+        state->pos++;
+        result = test_and( state ) || result;
+    }
+    return result;
+}
+
+/**
+ * @brief Handler for the 'test' and '[' commands.
+ *
+ * Usage: test EXPRESSION, or [ EXPRESSION ]
+ *
+ * Supports the primaries -e, -f, -d, -s, -z, -n, =, !=, -eq, -ne, -lt,
+ * -le, -gt and -ge, combined with '!', '-a', '-o' and parentheses. Files
+ * are checked through DMOD, so no module is started.
+ *
+ * @param argc Number of arguments
+ * @param argv Array of argument strings
+ * @return int 0 if the expression is true, 1 if it is false, 2 if it is invalid
+ */
+int dmell_handler_test( int argc, char** argv )
+{
+    if( argc > 0 && strcmp( argv[0], "[" ) == 0 )
+    {
+        if( strcmp( argv[argc - 1], "]" ) != 0 )
+        {
+            dmell_eprintf("[: missing ']'\n");
+            return 2;
+        }
+        argc--;
+    }
+
+    // Without an expression the result is false
+    test_state_t state = { .argc = argc, .argv = argv, .pos = 1, .error = false };
+    bool result = ( argc > 1 ) && test_or( &state );
+    if( !state.error && state.pos < state.argc )
+    {
+        test_error( &state, "unexpected argument", state.argv[state.pos] );
+    }
+    return state.error ? 2 : ( result ? 0 : 1 );
+}
+
+/**
+ * @brief Table of built-in commands.
+ */
+static const dmell_cmd_t g_builtin_commands[] = {
+    { "echo",           dmell_handler_echo },
+    { "write",          dmell_handler_write },
+    { "read",           dmell_handler_read },
+    { "help",           dmell_handler_help },
+    { "set",            dmell_handler_set },
+    { "unset",          dmell_handler_unset },
+    { "export",         dmell_handler_set },
+    { "cd",             dmell_handler_cd },
+    { "pwd",            dmell_handler_pwd },
+    { "exit",           dmell_handler_exit },
+    { "setloglevel",    dmell_handler_setloglevel },
+    { "module",         dmell_handler_module },
+    { "uptime",         dmell_handler_uptime },
+    { "hash",           dmell_handler_hash },
+    { "jobs",           dmell_handler_jobs },
+    { "wait",           dmell_handler_wait },
+    { "kill",           dmell_handler_kill },
+    { "parallel",       dmell_handler_parallel },
+    { "test",           dmell_handler_test },
+    { "[",              dmell_handler_test },
+};
+
 /**
  * @brief Registers built-in command handlers.
  * 
@@ -855,20 +1698,11 @@ int dmell_register_handlers( void )
     // Set default log level to warning
     Dmod_SetLogLevel( Dmod_LogLevel_Warn );
 
-    dmell_register_command_handler( "echo", dmell_handler_echo );
-    dmell_register_command_handler( "write", dmell_handler_write );
-    dmell_register_command_handler( "read", dmell_handler_read );
-    dmell_register_command_handler( "help", dmell_handler_help );
-    dmell_register_command_handler( "set", dmell_handler_set );
-    dmell_register_command_handler( "unset", dmell_handler_unset );
-    dmell_register_command_handler( "export", dmell_handler_set );
-    dmell_register_command_handler( "cd", dmell_handler_cd );
-    dmell_register_command_handler( "pwd", dmell_handler_pwd );
-    dmell_register_command_handler( "exit", dmell_handler_exit );
-    dmell_register_command_handler( "setloglevel", dmell_handler_setloglevel );
-    dmell_register_command_handler( "module", dmell_handler_module );
-    dmell_register_command_handler( "uptime", dmell_handler_uptime );
+    dmell_register_static_commands( g_builtin_commands, sizeof(g_builtin_commands) / sizeof(g_builtin_commands[0]) );
+    dmell_register_linked_commands();
 
     dmell_set_default_handler( dmell_handler_default );
+    dmell_set_capture_check( dmell_handler_default_captures );
+    dmell_set_substitution_handler( dmell_script_substitute );
     return 0;
 }
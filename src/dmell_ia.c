@@ -112,10 +112,6 @@ static void replace_line_display(const char* new_content, size_t old_position, b
     }
 }
 
-// External references to registered commands
-extern dmell_cmd_t* g_registered_commands;
-extern size_t g_registered_command_count;
-
 /**
  * @brief Find matching built-in command name.
  * 
@@ -138,9 +134,10 @@ static bool find_builtin_command_match(const char* partial_name, char* out_match
     }
 
     // Search through registered built-in commands
-    for( size_t i = 0; i < g_registered_command_count; i++ )
+    size_t iterator = 0;
+    for( const dmell_cmd_t* command = dmell_next_command( &iterator ); command != NULL; command = dmell_next_command( &iterator ) )
     {
-        const char* cmd_name = g_registered_commands[i].name;
+        const char* cmd_name = command->name;
         if( cmd_name != NULL && strncmp(cmd_name, partial_name, partial_len) == 0 )
         {
             size_t cmd_len = strlen(cmd_name);
@@ -0,0 +1,248 @@
+#include <errno.h>
+#include <string.h>
+#include "dmell_io.h"
+#include "dmell_pipe.h"
+#include "dmell_writer.h"
+#include "dmell_buf.h"
+
+/**
+ * @brief Size of the chunks in which data is printed to the console.
+ */
+#define DMELL_IO_CONSOLE_CHUNK  128
+
+/**
+ * @brief Streams of the command that is currently running.
+ */
+static dmell_io_t g_io = { 0 };
+
+/**
+ * @brief Saves the current streams, so they can be restored after a redirection.
+ *
+ * @param out_io Output parameter for the current streams
+ */
+void dmell_io_save( dmell_io_t* out_io )
+{
+    if( out_io != NULL )
+    {
+        *out_io = g_io;
+    }
+}
+
+/**
+ * @brief Restores streams saved with dmell_io_save.
+ *
+ * @param io Streams to restore
+ */
+void dmell_io_restore( const dmell_io_t* io )
+{
+    if( io != NULL )
+    {
+        g_io = *io;
+    }
+}
+
+/**
+ * @brief Sets the standard output of the following commands.
+ *
+ * @param kind Kind of the stream
+ * @param object Object behind the stream, NULL for the console
+ */
+void dmell_io_set_output( dmell_io_kind_t kind, void* object )
+{
+    g_io.output.kind = (uint32_t)kind;
+    g_io.output.object = object;
+}
+
+/**
+ * @brief Sets the standard input of the following commands.
+ *
+ * @param kind Kind of the stream
+ * @param object Object behind the stream, NULL for the console
+ */
+void dmell_io_set_input( dmell_io_kind_t kind, void* object )
+{
+    g_io.input.kind = (uint32_t)kind;
+    g_io.input.object = object;
+}
+
+/**
+ * @brief Sets the standard error of the following commands.
+ *
+ * @param kind Kind of the stream
+ * @param object Object behind the stream, NULL for the console
+ */
+void dmell_io_set_error( dmell_io_kind_t kind, void* object )
+{
+    g_io.error.kind = (uint32_t)kind;
+    g_io.error.object = object;
+}
+
+/**
+ * @brief Checks if the standard output is the console.
+ *
+ * @return true If the output goes to the console
+ * @return false Otherwise
+ */
+bool dmell_io_output_is_console( void )
+{
+    return g_io.output.kind == dmell_io_console;
+}
+
+/**
+ * @brief Checks if the standard input is the console.
+ *
+ * @return true If the input comes from the console
+ * @return false Otherwise
+ */
+bool dmell_io_input_is_console( void )
+{
+    return g_io.input.kind == dmell_io_console;
+}
+
+/**
+ * @brief Helper function to print data that is not null terminated to the console.
+ *
+ * @param data Data to print
+ * @param len Number of bytes to print
+ * @param error True to print to the DMOD error log
+ */
+static void write_console( const char* data, size_t len, bool error )
+{
+    char chunk[DMELL_IO_CONSOLE_CHUNK + 1];
+    while( len > 0 )
+    {
+        size_t count = len < DMELL_IO_CONSOLE_CHUNK ? len : DMELL_IO_CONSOLE_CHUNK;
+        memcpy( chunk, data, count );
+        chunk[count] = '\0';
+        if( error )
+        {
+            DMOD_LOG_ERROR( "%s", chunk );
+        }
+        else
+        {
+            Dmod_Printf( "%s", chunk );
+        }
+        data += count;
+        len -= count;
+    }
+}
+
+/**
+ * @brief Helper function to write data to a stream.
+ *
+ * @param stream Stream to write to
+ * @param data Data to write
+ * @param len Number of bytes to write
+ * @param error True if the stream is the standard error
+ * @return int 0 on success, negative value on error
+ */
+static int write_stream( const dmell_io_stream_t* stream, const char* data, size_t len, bool error )
+{
+    if( data == NULL && len > 0 )
+    {
+        DMOD_LOG_ERROR("Invalid data passed to dmell_io_write\n");
+        return -EINVAL;
+    }
+
+    switch( stream->kind )
+    {
+        case dmell_io_pipe:
+            return dmell_pipe_write( (dmell_pipe_t*)stream->object, data, len );
+        case dmell_io_file:
+            return dmell_writer_write( (dmell_writer_t*)stream->object, data, len );
+        case dmell_io_buffer:
+            return dmell_buf_append( (dmell_buf_t*)stream->object, data, len );
+        case dmell_io_console:
+        default:
+            write_console( data, len, error );
+            return 0;
+    }
+}
+
+/**
+ * @brief Writes data to the standard output.
+ *
+ * @param data Data to write
+ * @param len Number of bytes to write
+ * @return int 0 on success, negative value on error
+ */
+int dmell_io_write( const char* data, size_t len )
+{
+    return write_stream( &g_io.output, data, len, false );
+}
+
+/**
+ * @brief Writes data to the standard error.
+ *
+ * @param data Data to write
+ * @param len Number of bytes to write
+ * @return int 0 on success, negative value on error
+ */
+int dmell_io_write_error( const char* data, size_t len )
+{
+    return write_stream( &g_io.error, data, len, true );
+}
+
+/**
+ * @brief Writes a null terminated string to the standard output.
+ *
+ * @param str String to write
+ * @return int 0 on success, negative value on error
+ */
+int dmell_io_puts( const char* str )
+{
+    return dmell_io_write( str, str != NULL ? strlen( str ) : 0 );
+}
+
+/**
+ * @brief Reads data from the standard input.
+ *
+ * The console is read up to the end of the line.
+ *
+ * @param buffer Buffer for the data
+ * @param size Size of the buffer
+ * @return int Number of bytes read, 0 at the end of the input, negative value on error
+ */
+int dmell_io_read( char* buffer, size_t size )
+{
+    if( buffer == NULL || size == 0 )
+    {
+        DMOD_LOG_ERROR("Invalid arguments to dmell_io_read: %p, %zu\n", buffer, size);
+        return -EINVAL;
+    }
+
+    if( g_io.input.kind == dmell_io_pipe )
+    {
+        return (int)dmell_pipe_read( (dmell_pipe_t*)g_io.input.object, buffer, size );
+    }
+
+    size_t count = 0;
+    while( count < size )
+    {
+        int c = Dmod_Getc();
+        if( c < 0 )
+        {
+            break;
+        }
+        buffer[count++] = (char)c;
+        if( c == '\n' )
+        {
+            break;
+        }
+    }
+    return (int)count;
+}
+
+/**
+ * @brief Reads a single character from the standard input.
+ *
+ * @return int Character read, or negative value at the end of the input
+ */
+int dmell_io_getc( void )
+{
+    if( g_io.input.kind == dmell_io_pipe )
+    {
+        return dmell_pipe_getc( (dmell_pipe_t*)g_io.input.object );
+    }
+    return Dmod_Getc();
+}
@@ -0,0 +1,245 @@
+#include <errno.h>
+#include <string.h>
+#include <dmod.h>
+#include "dmell_jobs.h"
+#include "dmell_env.h"
+
+/**
+ * @brief Table of background jobs.
+ */
+static dmell_job_t g_jobs[DMELL_JOBS_MAX];
+
+/**
+ * @brief Number assigned to the next job.
+ */
+static uint32_t g_next_job_id = 1;
+
+/**
+ * @brief True while the command that is running was started with '&'.
+ */
+static bool g_background = false;
+
+/**
+ * @brief Checks if the command that is running should be started in the background.
+ *
+ * @return true If the command was followed by '&'
+ * @return false Otherwise
+ */
+bool dmell_jobs_is_background( void )
+{
+    return g_background;
+}
+
+/**
+ * @brief Sets if the following commands should be started in the background.
+ *
+ * @param background True for commands followed by '&'
+ * @return bool Previous value, so the caller can restore it
+ */
+bool dmell_jobs_set_background( bool background )
+{
+    bool previous = g_background;
+    g_background = background;
+    return previous;
+}
+
+/**
+ * @brief Helper function to find the table entry of a job.
+ *
+ * @param pid Process identifier of the job
+ * @return dmell_job_t* Entry of the job, or NULL if not found
+ */
+static dmell_job_t* find_job( int pid )
+{
+    for( size_t i = 0; i < DMELL_JOBS_MAX; i++ )
+    {
+        if( g_jobs[i].id != 0 && g_jobs[i].pid == pid )
+        {
+            return &g_jobs[i];
+        }
+    }
+    return NULL;
+}
+
+/**
+ * @brief Helper function to remove a job from the table.
+ *
+ * @param job Job to remove
+ */
+static void remove_job( dmell_job_t* job )
+{
+    Dmod_Free( job->command );
+    memset( job, 0, sizeof(*job) );
+
+    bool empty = true;
+    for( size_t i = 0; i < DMELL_JOBS_MAX && empty; i++ )
+    {
+        empty = ( g_jobs[i].id == 0 );
+    }
+    if( empty )
+    {
+        g_next_job_id = 1;
+    }
+}
+
+/**
+ * @brief Spawns a module as a background job.
+ *
+ * @param module Name or path of the module
+ * @param argc Number of arguments
+ * @param argv Array of argument strings
+ * @param out_job [optional] Output parameter to hold the new job
+ * @return int 0 on success, -ENOTSUP if modules cannot be spawned, other negative value on error
+ */
+int dmell_jobs_spawn( const char* module, int argc, char** argv, const dmell_job_t** out_job )
+{
+    if( module == NULL )
+    {
+        DMOD_LOG_ERROR("Invalid module passed to dmell_jobs_spawn\n");
+        return -EINVAL;
+    }
+
+    if( !Dmod_IsFunctionConnected( (void*)Dmod_SpawnModule ) )
+    {
+        return -ENOTSUP;
+    }
+
+    dmell_job_t* job = NULL;
+    for( size_t i = 0; i < DMELL_JOBS_MAX && job == NULL; i++ )
+    {
+        job = ( g_jobs[i].id == 0 ) ? &g_jobs[i] : NULL;
+    }
+    if( job == NULL )
+    {
+        DMOD_LOG_ERROR("Too many background jobs - at most %d can run at once\n", DMELL_JOBS_MAX);
+        return -EAGAIN;
+    }
+
+    char* command = Dmod_StrDup( module );
+    if( command == NULL )
+    {
+        DMOD_LOG_ERROR("Memory allocation failed in dmell_jobs_spawn\n");
+        return -ENOMEM;
+    }
+
+    int pid = Dmod_SpawnModule( module, argc, argv );
+    dmosi_process_t process = ( pid >= 0 ) ? dmosi_process_find_by_id( (dmosi_process_id_t)pid ) : NULL;
+    if( process == NULL )
+    {
+        DMOD_LOG_ERROR("Failed to spawn module '%s' in the background\n", module);
+        Dmod_Free( command );
+        return pid < 0 ? pid : -ESRCH;
+    }
+
+    job->id      = g_next_job_id++;
+    job->pid     = pid;
+    job->process = process;
+    job->command = command;
+    if( out_job != NULL )
+    {
+        *out_job = job;
+    }
+    return 0;
+}
+
+/**
+ * @brief Finds a background job by its process identifier.
+ *
+ * @param pid Process identifier
+ * @return const dmell_job_t* Job, or NULL if not found
+ */
+const dmell_job_t* dmell_jobs_find( int pid )
+{
+    return find_job( pid );
+}
+
+/**
+ * @brief Iterates over the background jobs.
+ *
+ * @param iterator Iterator, has to be 0 before the first call
+ * @return const dmell_job_t* Next job, or NULL after the last one
+ */
+const dmell_job_t* dmell_jobs_next( size_t* iterator )
+{
+    if( iterator == NULL )
+    {
+        return NULL;
+    }
+
+    while( *iterator < DMELL_JOBS_MAX )
+    {
+        const dmell_job_t* job = &g_jobs[(*iterator)++];
+        if( job->id != 0 )
+        {
+            return job;
+        }
+    }
+    return NULL;
+}
+
+/**
+ * @brief Checks if a background job is still running.
+ *
+ * @param job Job to check
+ * @return true If the process did not finish yet
+ * @return false Otherwise
+ */
+bool dmell_jobs_is_running( const dmell_job_t* job )
+{
+    if( job == NULL || job->process == NULL )
+    {
+        return false;
+    }
+
+    dmosi_process_state_t state = dmosi_process_get_state( job->process );
+    return state != DMOSI_PROCESS_STATE_TERMINATED && state != DMOSI_PROCESS_STATE_ZOMBIE;
+}
+
+/**
+ * @brief Waits for a background job to finish and removes it from the table.
+ *
+ * @param pid Process identifier of the job
+ * @return int Exit status of the job, or -ECHILD if there is no such job
+ */
+int dmell_jobs_wait( int pid )
+{
+    dmell_job_t* job = find_job( pid );
+    if( job == NULL )
+    {
+        return -ECHILD;
+    }
+
+    dmosi_process_wait( job->process, -1 );
+    int exit_status = dmosi_process_get_exit_status( job->process );
+    dmosi_process_destroy( job->process );
+    remove_job( job );
+
+    // The job could change the environment of the shell
+    dmell_env_changed();
+    return exit_status;
+}
+
+/**
+ * @brief Stops a process and removes it from the job table.
+ *
+ * Processes that were not started by the shell can be stopped as well.
+ *
+ * @param pid Process identifier
+ * @return int 0 on success, -ESRCH if there is no such process
+ */
+int dmell_jobs_kill( int pid )
+{
+    dmell_job_t* job = find_job( pid );
+    dmosi_process_t process = ( job != NULL ) ? job->process : dmosi_process_find_by_id( (dmosi_process_id_t)pid );
+    if( process == NULL )
+    {
+        return -ESRCH;
+    }
+
+    dmosi_process_destroy( process );
+    if( job != NULL )
+    {
+        remove_job( job );
+    }
+    return 0;
+}
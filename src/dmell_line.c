@@ -2,9 +2,11 @@
 #include <errno.h>
 #include <dmod.h>
 #include <string.h>
+#include <stdlib.h>
 #include "dmell_cmd.h"
 #include "dmell_line.h"
 #include "dmell_hlp.h"
+#include "dmell_jobs.h"
 
 /**
  * @brief Helper function to check if the current position is an 'OR' separator (||).
@@ -19,6 +21,32 @@ static bool is_or_separator( const char* str, const char* end_ptr )
     return ( str + 1 < end_ptr ) && ( str[0] == '|' ) && ( str[1] == '|' );
 }
 
+/**
+ * @brief Helper function to check if the current position is a pipe separator (|).
+ * 
+ * @param str Current position in the command string
+ * @param end_ptr Pointer to the end of the command string
+ * @return true If it is a pipe separator
+ * @return false Otherwise
+ */
+static bool is_pipe_separator( const char* str, const char* end_ptr )
+{
+    return str < end_ptr && str[0] == '|';
+}
+
+/**
+ * @brief Helper function to check if the current position is a background separator (&).
+ * 
+ * @param str Current position in the command string
+ * @param end_ptr Pointer to the end of the command string
+ * @return true If it is a background separator
+ * @return false Otherwise
+ */
+static bool is_background_separator( const char* str, const char* end_ptr )
+{
+    return str < end_ptr && str[0] == '&';
+}
+
 /**
  * @brief Helper function to check if the current position is an 'AND' separator (&&).
  * 
@@ -66,24 +94,34 @@ static dmell_line_sep_t get_command_separator( const char* str, const char* end_
     {
         return dmell_line_sep_seq;
     }
+    else if( is_pipe_separator( str, end_ptr ) )
+    {
+        return dmell_line_sep_pipe;
+    }
+    else if( is_background_separator( str, end_ptr ) )
+    {
+        return dmell_line_sep_background;
+    }
     return dmell_line_sep_none;
 }
 
 /**
- * @brief Helper function to skip a command separator in the command string.
+ * @brief Skips a command separator in the command string.
  * 
  * @param str Current position in the command string
  * @param end_ptr Pointer to the end of the command string
  * @param sep Type of command separator to skip
  * @return const char* Pointer to the position after the skipped separator
  */
-static const char* skip_separator( const char* str, const char* end_ptr, dmell_line_sep_t sep )
+const char* dmell_line_skip_separator( const char* str, const char* end_ptr, dmell_line_sep_t sep )
 {
     size_t sep_len[dmell_line_sep_max] = {
         [dmell_line_sep_none] = 0,
         [dmell_line_sep_and]  = 2,
         [dmell_line_sep_or]   = 2,
-        [dmell_line_sep_seq]  = 1
+        [dmell_line_sep_seq]  = 1,
+        [dmell_line_sep_pipe] = 1,
+        [dmell_line_sep_background] = 1
     };
 
     const char* ptr = str + sep_len[sep];
@@ -95,19 +133,76 @@ static const char* skip_separator( const char* str, const char* end_ptr, dmell_l
 }
 
 /**
- * @brief Helper function to find the next command separator in the command string.
+ * @brief Helper function to skip a "$(...)" or "$((...))" substitution.
+ * 
+ * Separators inside a substitution belong to its command or expression.
+ * 
+ * @param str Current position in the command string
+ * @param end_ptr Pointer to the end of the command string
+ * @return const char* Pointer to the closing parenthesis, or str if there is no complete substitution
+ */
+static const char* skip_substitution( const char* str, const char* end_ptr )
+{
+    if( end_ptr - str < 2 || str[0] != '$' || str[1] != '(' )
+    {
+        return str;
+    }
+
+    int depth = 0;
+    for( const char* ptr = str + 1; ptr < end_ptr; ptr++ )
+    {
+        depth += ( *ptr == '(' ) ? 1 : ( *ptr == ')' ) ? -1 : 0;
+        if( depth == 0 )
+        {
+            return ptr;
+        }
+    }
+    return str;
+}
+
+/**
+ * @brief Helper function to skip a quoted text.
+ * 
+ * Separators inside single quotes, double quotes and backticks are part
+ * of the text.
+ * 
+ * @param str Current position in the command string
+ * @param end_ptr Pointer to the end of the command string
+ * @return const char* Pointer to the closing quote, or str if there is no complete quoted text
+ */
+static const char* skip_quoted( const char* str, const char* end_ptr )
+{
+    if( str >= end_ptr || ( *str != '"' && *str != '\'' && *str != '`' ) )
+    {
+        return str;
+    }
+
+    const char* close = memchr( str + 1, *str, end_ptr - str - 1 );
+    return ( close != NULL ) ? close : str;
+}
+
+/**
+ * @brief Finds the next command separator in the command string.
+ * 
+ * Separators inside quotes and substitutions are not command separators,
+ * and neither is '&' that follows '>'.
  * 
  * @param str Current position in the command string
  * @param end_ptr Pointer to the end of the command string
  * @param out_sep Output parameter to hold the type of found separator
  * @return const char* Pointer to the position of the next command separator, or end_ptr if none found
  */
-static const char* find_next_command_separator(const char* str, const char* end_ptr, dmell_line_sep_t* out_sep)
+const char* dmell_line_find_separator(const char* str, const char* end_ptr, dmell_line_sep_t* out_sep)
 {
     const char* ptr = str;
     while( ptr < end_ptr )
     {
         dmell_line_sep_t sep = get_command_separator( ptr, end_ptr );
+        if( sep == dmell_line_sep_background && ptr > str && ptr[-1] == '>' )
+        {
+            // '&' after '>' is part of a redirection like "2>&1"
+            sep = dmell_line_sep_none;
+        }
         if( sep != dmell_line_sep_none )
         {            
             if( out_sep != NULL )
@@ -116,7 +211,12 @@ static const char* find_next_command_separator(const char* str, const char* end_
             }
             return ptr;
         }
-        ptr++;
+        const char* skipped = skip_substitution( ptr, end_ptr );
+        if( skipped == ptr )
+        {
+            skipped = skip_quoted( ptr, end_ptr );
+        }
+        ptr = skipped + 1;
     }
     if( out_sep != NULL )
     {
@@ -126,14 +226,14 @@ static const char* find_next_command_separator(const char* str, const char* end_
 }
 
 /**
- * @brief Helper function to combine exit codes based on the command separator.
+ * @brief Combines exit codes based on the command separator.
  * 
  * @param last_exit_code Exit code of the last executed command
  * @param current_exit_code Exit code of the current executed command
  * @param sep Type of command separator
  * @return int Combined exit code
  */
-static int join_results(int last_exit_code, int current_exit_code, dmell_line_sep_t sep)
+int dmell_line_join_results(int last_exit_code, int current_exit_code, dmell_line_sep_t sep)
 {
     switch( sep )
     {
@@ -142,6 +242,8 @@ static int join_results(int last_exit_code, int current_exit_code, dmell_line_se
         case dmell_line_sep_or:
             return (last_exit_code != 0) ? current_exit_code : last_exit_code;
         case dmell_line_sep_seq:
+        case dmell_line_sep_pipe:
+        case dmell_line_sep_background:
             return current_exit_code;
         case dmell_line_sep_none:
         default:
@@ -150,14 +252,14 @@ static int join_results(int last_exit_code, int current_exit_code, dmell_line_se
 }
 
 /**
- * @brief Helper function to determine if the next command should be executed based on the last exit code and separator.
+ * @brief Determines if the next command should be executed based on the last exit code and separator.
  * 
  * @param last_exit_code Exit code of the last executed command
  * @param sep Type of command separator
  * @return true If the next command should be executed
  * @return false Otherwise
  */
-static bool should_execute_command(int last_exit_code, dmell_line_sep_t sep)
+bool dmell_line_should_execute(int last_exit_code, dmell_line_sep_t sep)
 {
     switch( sep )
     {
@@ -166,6 +268,8 @@ static bool should_execute_command(int last_exit_code, dmell_line_sep_t sep)
         case dmell_line_sep_or:
             return (last_exit_code != 0);
         case dmell_line_sep_seq:
+        case dmell_line_sep_pipe:
+        case dmell_line_sep_background:
         case dmell_line_sep_none:
         default:
             return true;
@@ -173,64 +277,107 @@ static bool should_execute_command(int last_exit_code, dmell_line_sep_t sep)
 }
 
 /**
- * @brief Helper function to calculate the total length of a command line from arguments.
+ * @brief Determines if the next command should be executed, treating a pipeline as a single command.
  * 
- * @param argc Number of arguments
- * @param argv Array of argument strings
- * @return size_t Total length of the command line
+ * A command after a pipe runs only when the command before it ran, so a
+ * pipeline skipped by '&&' or '||' is skipped as a whole.
+ * 
+ * @param pipeline Pipeline state
+ * @param last_exit_code Exit code of the last executed command
+ * @param prev_sep Separator that precedes the next command
+ * @return true If the next command should be executed
+ * @return false Otherwise
  */
-static size_t calculate_line_length(int argc, char** argv)
+bool dmell_line_pipeline_should_execute(dmell_line_pipeline_t* pipeline, int last_exit_code, dmell_line_sep_t prev_sep)
 {
-    size_t total_length = 0;
-    for( int i = 0; i < argc; i++ )
-    {
-        total_length += strlen( argv[i] );
-        if( i < argc - 1 )
-        {
-            total_length += 1; // for space
-        }
-    }
-    return total_length;
+    bool execute = ( prev_sep == dmell_line_sep_pipe ) ? pipeline->ran
+                                                       : dmell_line_should_execute( last_exit_code, prev_sep );
+    pipeline->ran = execute;
+    return execute;
 }
 
 /**
- * @brief Helper function to convert arguments to a command line string.
+ * @brief Helper function to get the limit of the pipes of a pipeline.
  * 
- * @param argc Number of arguments
- * @param argv Array of argument strings
- * @param out_len Output parameter to hold the length of the command line string
- * @return char* Command line string, or NULL on failure
+ * @return size_t Limit set by the DMELL_PIPE_LIMIT environment variable, 0 for the default limit
+ */
+static size_t get_pipe_limit( void )
+{
+    const char* value = Dmod_GetEnv( "DMELL_PIPE_LIMIT" );
+    char* end_ptr = NULL;
+    unsigned long limit = ( value != NULL ) ? strtoul( value, &end_ptr, 10 ) : 0;
+    return ( end_ptr != NULL && end_ptr != value && *end_ptr == '\0' ) ? (size_t)limit : 0;
+}
+
+/**
+ * @brief Connects the streams of a command that is part of a pipeline.
+ * 
+ * A command followed by '&' is marked to run in the background.
+ * 
+ * @param pipeline Pipeline state
+ * @param prev_sep Separator that precedes the command
+ * @param next_sep Separator that follows the command
  */
-static char* to_line(int argc, char** argv, size_t* out_len)
+void dmell_line_pipeline_begin(dmell_line_pipeline_t* pipeline, dmell_line_sep_t prev_sep, dmell_line_sep_t next_sep)
 {
-    size_t line_length = calculate_line_length( argc, argv );
-    char* line = Dmod_Malloc( line_length + 1 );
-    if( line == NULL )
+    dmell_io_save( &pipeline->saved );
+    pipeline->background = dmell_jobs_set_background( next_sep == dmell_line_sep_background );
+    if( prev_sep == dmell_line_sep_pipe )
     {
-        DMOD_LOG_ERROR("Memory allocation failed in to_line\n");
-        return NULL;
+        dmell_io_set_input( dmell_io_pipe, &pipeline->pipes[pipeline->current ^ 1] );
     }
-
-    char* ptr = line;
-    for( int i = 0; i < argc; i++ )
+    if( next_sep == dmell_line_sep_pipe )
     {
-        size_t arg_len = strlen( argv[i] );
-        memcpy( ptr, argv[i], arg_len );
-        ptr += arg_len;
-        if( i < argc - 1 )
-        {
-            *ptr = ' ';
-            ptr++;
-        }
+        pipeline->pipes[pipeline->current].limit = get_pipe_limit();
+        dmell_io_set_output( dmell_io_pipe, &pipeline->pipes[pipeline->current] );
     }
-    *ptr = '\0';
+}
 
-    if( out_len != NULL )
+/**
+ * @brief Restores the streams after a command of a pipeline finished.
+ * 
+ * Input that the command did not read is dropped and its memory is
+ * released, and the output of the command becomes the input of the next
+ * one. A command whose output did not fit into the pipe fails with the
+ * error of the pipe. A command that failed to run (a negative exit code,
+ * for example a module whose output cannot be captured) stops the rest of
+ * the pipeline.
+ * 
+ * @param pipeline Pipeline state
+ * @param prev_sep Separator that precedes the command
+ * @param next_sep Separator that follows the command
+ * @param exit_code Exit code of the command
+ * @return int Exit code of the command, or the error of its output pipe
+ */
+int dmell_line_pipeline_end(dmell_line_pipeline_t* pipeline, dmell_line_sep_t prev_sep, dmell_line_sep_t next_sep, int exit_code)
+{
+    dmell_io_restore( &pipeline->saved );
+    dmell_jobs_set_background( pipeline->background );
+    if( prev_sep == dmell_line_sep_pipe )
     {
-        *out_len = line_length;
+        dmell_pipe_free( &pipeline->pipes[pipeline->current ^ 1] );
     }
+    if( next_sep == dmell_line_sep_pipe )
+    {
+        int error = pipeline->pipes[pipeline->current].error;
+        exit_code = ( exit_code >= 0 && error < 0 ) ? error : exit_code;
+        pipeline->current ^= 1;
+        pipeline->ran = ( exit_code >= 0 );
+    }
+    return exit_code;
+}
 
-    return line;
+/**
+ * @brief Frees the pipes of a pipeline.
+ * 
+ * @param pipeline Pipeline state
+ */
+void dmell_line_pipeline_free(dmell_line_pipeline_t* pipeline)
+{
+    dmell_pipe_free( &pipeline->pipes[0] );
+    dmell_pipe_free( &pipeline->pipes[1] );
+    pipeline->current = 0;
+    pipeline->ran = false;
 }
 
 /**
@@ -253,38 +400,59 @@ int dmell_run_line(const char* line, size_t len)
     int last_exit_code = 0;
     int result = 0;
     dmell_line_sep_t prev_sep = dmell_line_sep_none;
+    dmell_line_pipeline_t pipeline = { 0 };
     while( ptr < end_ptr && *ptr != '\0' )
     {
         // Find the next command separator
         dmell_line_sep_t sep = dmell_line_sep_none;
-        const char* sep_ptr = find_next_command_separator( ptr, end_ptr, &sep );
+        const char* sep_ptr = dmell_line_find_separator( ptr, end_ptr, &sep );
 
         // Check if we should execute the current command - lazy evaluation
         // Use the previous separator to decide if the current command should run
-        if( should_execute_command( last_exit_code, prev_sep ) )
+        if( dmell_line_pipeline_should_execute( &pipeline, last_exit_code, prev_sep ) )
         {
             // Determine the length of the current command
             size_t cmd_len = sep_ptr - ptr;
             if( cmd_len > 0 )
             {
-                // Execute the current command
+                // Execute the current command with its output sent to the next one when piped
+                dmell_line_pipeline_begin( &pipeline, prev_sep, sep );
                 int exit_code = dmell_run_command_string( ptr, cmd_len );
-                result = join_results( last_exit_code, exit_code, prev_sep );
+                exit_code = dmell_line_pipeline_end( &pipeline, prev_sep, sep, exit_code );
+                result = dmell_line_join_results( last_exit_code, exit_code, prev_sep );
                 last_exit_code = exit_code;
             }
         }
 
         // Move to the next command
-        ptr = skip_separator( sep_ptr, end_ptr, sep );
+        ptr = dmell_line_skip_separator( sep_ptr, end_ptr, sep );
         prev_sep = sep;
     }
 
+    dmell_line_pipeline_free( &pipeline );
     return result;
 }
 
+/**
+ * @brief Helper function to get the separator that an argument consists of.
+ * 
+ * @param arg Argument string
+ * @return dmell_line_sep_t Type of the separator, or dmell_line_sep_none if the argument is not a separator
+ */
+static dmell_line_sep_t get_argument_separator( const char* arg )
+{
+    const char* end_ptr = arg + strlen( arg );
+    dmell_line_sep_t sep = get_command_separator( arg, end_ptr );
+    return ( dmell_line_skip_separator( arg, end_ptr, sep ) == end_ptr ) ? sep : dmell_line_sep_none;
+}
+
 /**
  * @brief Executes a line of commands from argument array.
  * 
+ * The arguments are already tokenized, so they are passed to the commands
+ * as they are, without joining and parsing them again. Only arguments that
+ * are a whole separator ("&&", "||", ";", "|" or "&") split the commands.
+ * 
  * @param argc Number of arguments
  * @param argv Array of argument strings
  * @return int Exit code of the last executed command, or negative value on error
@@ -297,15 +465,41 @@ int dmell_run_args_line(int argc, char** argv)
         return -EINVAL;
     }
 
-    size_t line_length = 0;
-    char* line = to_line( argc, argv, &line_length );
-    if( line == NULL )
+    // The separators are replaced with NULL, so every command gets a terminated argument array
+    char* args[argc + 1];
+    memcpy( args, argv, sizeof(char*) * argc );
+    args[argc] = NULL;
+
+    int last_exit_code = 0;
+    int result = 0;
+    int start = 0;
+    dmell_line_sep_t prev_sep = dmell_line_sep_none;
+    dmell_line_pipeline_t pipeline = { 0 };
+    while( start <= argc )
     {
-        DMOD_LOG_ERROR("Failed to convert arguments to line in dmell_run_args_line\n");
-        return -ENOMEM;
+        // Find the next separator argument
+        dmell_line_sep_t sep = dmell_line_sep_none;
+        int end = start;
+        while( end < argc && ( sep = get_argument_separator( args[end] ) ) == dmell_line_sep_none )
+        {
+            end++;
+        }
+        args[end] = NULL;
+
+        // Use the previous separator to decide if the current command should run
+        if( dmell_line_pipeline_should_execute( &pipeline, last_exit_code, prev_sep ) && end > start )
+        {
+            dmell_line_pipeline_begin( &pipeline, prev_sep, sep );
+            int exit_code = dmell_run_command( args[start], end - start, &args[start] );
+            exit_code = dmell_line_pipeline_end( &pipeline, prev_sep, sep, exit_code );
+            result = dmell_line_join_results( last_exit_code, exit_code, prev_sep );
+            last_exit_code = exit_code;
+        }
+
+        start = end + 1;
+        prev_sep = sep;
     }
 
-    int result = dmell_run_line( line, line_length );
-    Dmod_Free( line );
+    dmell_line_pipeline_free( &pipeline );
     return result;
-}
\ No newline at end of file
+}
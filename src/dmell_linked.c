@@ -0,0 +1,69 @@
+#include "dmell_handlers.h"
+#include "dmell_env.h"
+
+#if DMELL_STATIC_COMMANDS
+
+/**
+ * @file dmell_linked.c
+ * @brief Registration of the command modules linked into the dmell image.
+ *
+ * The list of linked commands is generated by CMake (DMELL_LINKED_COMMANDS)
+ * as DMELL_LINKED_COMMAND(name) entries. The `main` of every linked command
+ * is compiled as `dmell_cmd_<name>_main`.
+ */
+
+#define DMELL_LINKED_COMMAND(name)    extern int dmell_cmd_##name##_main( int argc, char** argv );
+#include "dmell_linked_commands.h"
+#undef DMELL_LINKED_COMMAND
+
+/**
+ * @brief Runs a linked command and reports the change of the environment.
+ *
+ * A linked command runs in the shell and can call Dmod_SetEnv, so the
+ * environment cache is invalidated after it returns.
+ */
+#define DMELL_LINKED_COMMAND(name)                                  \
+    static int dmell_linked_##name( int argc, char** argv )         \
+    {                                                               \
+        int result = dmell_cmd_##name##_main( argc, argv );         \
+        dmell_env_changed();                                        \
+        return result;                                              \
+    }
+#include "dmell_linked_commands.h"
+#undef DMELL_LINKED_COMMAND
+
+/**
+ * @brief Table of the linked commands.
+ */
+static const dmell_cmd_t g_linked_commands[] = {
+#define DMELL_LINKED_COMMAND(name)    { #name, dmell_linked_##name },
+#include "dmell_linked_commands.h"
+#undef DMELL_LINKED_COMMAND
+};
+
+/**
+ * @brief Registers the command modules linked into the dmell image.
+ * 
+ * @return int 0 on success, negative value on error
+ */
+int dmell_register_linked_commands( void )
+{
+    return dmell_register_static_commands( g_linked_commands, sizeof(g_linked_commands) / sizeof(g_linked_commands[0]) );
+}
+
+#else
+
+/**
+ * @brief Registers the command modules linked into the dmell image.
+ * 
+ * No commands are linked when DMELL_STATIC_COMMANDS is disabled - all of
+ * them run as external modules.
+ * 
+ * @return int 0 on success
+ */
+int dmell_register_linked_commands( void )
+{
+    return 0;
+}
+
+#endif
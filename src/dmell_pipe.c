@@ -0,0 +1,171 @@
+#include <errno.h>
+#include <string.h>
+#include "dmell_pipe.h"
+#include "dmod.h"
+
+/**
+ * @brief Helper function to get the limit of the pipe.
+ *
+ * @param pipe Pipe to check
+ * @return size_t Maximum number of bytes the pipe can hold
+ */
+static size_t get_limit( const dmell_pipe_t* pipe )
+{
+    return pipe->limit > 0 ? pipe->limit : DMELL_PIPE_DEFAULT_LIMIT;
+}
+
+/**
+ * @brief Helper function to grow the ring storage.
+ *
+ * The waiting data is moved to the beginning of the new storage, so the
+ * ring starts again at index 0.
+ *
+ * @param pipe Pipe to grow
+ * @param needed Number of bytes that have to fit into the storage
+ * @return int 0 on success, negative value on error
+ */
+static int grow( dmell_pipe_t* pipe, size_t needed )
+{
+    size_t limit = get_limit( pipe );
+    size_t new_capacity = pipe->capacity > 0 ? pipe->capacity : DMELL_PIPE_MIN_CAPACITY;
+    while( new_capacity < needed )
+    {
+        new_capacity *= 2;
+    }
+    if( new_capacity > limit )
+    {
+        new_capacity = limit;
+    }
+
+    char* new_data = Dmod_Malloc( new_capacity );
+    if( new_data == NULL )
+    {
+        DMOD_LOG_ERROR("Memory allocation failed in dmell_pipe_write for %zu bytes\n", new_capacity);
+        return -ENOMEM;
+    }
+
+    size_t copied = dmell_pipe_read( pipe, new_data, pipe->length );
+    Dmod_Free( pipe->data );
+    pipe->data = new_data;
+    pipe->capacity = new_capacity;
+    pipe->head = 0;
+    pipe->length = copied;
+    return 0;
+}
+
+/**
+ * @brief Writes data to the pipe.
+ *
+ * The first error is also kept in the pipe, so the writer can be failed
+ * when it finishes even if it ignored the result of a write.
+ *
+ * @param pipe Pipe to write to
+ * @param data Data to write
+ * @param len Number of bytes to write
+ * @return int 0 on success, -ENOSPC when the data does not fit below the limit, other negative value on error
+ */
+int dmell_pipe_write( dmell_pipe_t* pipe, const char* data, size_t len )
+{
+    if( pipe == NULL || ( data == NULL && len > 0 ) )
+    {
+        DMOD_LOG_ERROR("Invalid arguments to dmell_pipe_write: %p, %p\n", pipe, data);
+        return -EINVAL;
+    }
+
+    if( len == 0 )
+    {
+        return 0;
+    }
+
+    size_t needed = pipe->length + len;
+    if( needed > get_limit( pipe ) )
+    {
+        if( pipe->error == 0 )
+        {
+            DMOD_LOG_ERROR("Pipe is full - %zu bytes do not fit into the limit of %zu bytes\n", needed, get_limit( pipe ));
+            pipe->error = -ENOSPC;
+        }
+        return -ENOSPC;
+    }
+
+    if( needed > pipe->capacity )
+    {
+        int result = grow( pipe, needed );
+        if( result < 0 )
+        {
+            pipe->error = ( pipe->error == 0 ) ? result : pipe->error;
+            return result;
+        }
+    }
+
+    size_t tail = ( pipe->head + pipe->length ) % pipe->capacity;
+    size_t first = pipe->capacity - tail;
+    if( first > len )
+    {
+        first = len;
+    }
+    memcpy( &pipe->data[tail], data, first );
+    memcpy( pipe->data, &data[first], len - first );
+    pipe->length += len;
+    return 0;
+}
+
+/**
+ * @brief Reads data from the pipe.
+ *
+ * @param pipe Pipe to read from
+ * @param buffer Buffer for the data
+ * @param size Size of the buffer
+ * @return size_t Number of bytes read, 0 when the pipe is empty
+ */
+size_t dmell_pipe_read( dmell_pipe_t* pipe, char* buffer, size_t size )
+{
+    if( pipe == NULL || buffer == NULL || pipe->length == 0 )
+    {
+        return 0;
+    }
+
+    size_t count = size < pipe->length ? size : pipe->length;
+    size_t first = pipe->capacity - pipe->head;
+    if( first > count )
+    {
+        first = count;
+    }
+    memcpy( buffer, &pipe->data[pipe->head], first );
+    memcpy( &buffer[first], pipe->data, count - first );
+    pipe->head = ( pipe->head + count ) % pipe->capacity;
+    pipe->length -= count;
+    return count;
+}
+
+/**
+ * @brief Reads a single character from the pipe.
+ *
+ * @param pipe Pipe to read from
+ * @return int Character read, or -1 when the pipe is empty
+ */
+int dmell_pipe_getc( dmell_pipe_t* pipe )
+{
+    char c = 0;
+    return dmell_pipe_read( pipe, &c, 1 ) == 1 ? (unsigned char)c : -1;
+}
+
+/**
+ * @brief Frees the memory of the pipe.
+ *
+ * @param pipe Pipe to free
+ */
+void dmell_pipe_free( dmell_pipe_t* pipe )
+{
+    if( pipe == NULL )
+    {
+        return;
+    }
+
+    Dmod_Free( pipe->data );
+    pipe->data = NULL;
+    pipe->capacity = 0;
+    pipe->head = 0;
+    pipe->length = 0;
+    pipe->error = 0;
+}
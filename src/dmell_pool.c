@@ -0,0 +1,372 @@
+#include <string.h>
+#include "dmell_pool.h"
+#include "dmell_hlp.h"
+#include "dmod.h"
+
+/**
+ * @brief Most recently used module.
+ */
+static dmell_pool_entry_t* g_pool_head = NULL;
+/**
+ * @brief Least recently used module.
+ */
+static dmell_pool_entry_t* g_pool_tail = NULL;
+/**
+ * @brief Modules loaded outside of the pool (only the name and the hash are used).
+ */
+static dmell_pool_entry_t* g_pool_external = NULL;
+/**
+ * @brief Statistics and configuration of the pool.
+ */
+static dmell_pool_stats_t g_pool_stats = {
+    .max_count  = DMELL_POOL_DEFAULT_SIZE,
+    .budget     = DMELL_POOL_DEFAULT_BUDGET
+};
+
+/**
+ * @brief Helper function to get the size of a module file.
+ * 
+ * @param path Path of the module file
+ * @return size_t Size of the file, or 0 if it cannot be read
+ */
+static size_t get_module_size( const char* path )
+{
+    void* file = Dmod_FileOpen( path, "rb" );
+    if( file == NULL )
+    {
+        return 0;
+    }
+    size_t size = Dmod_FileSize( file );
+    Dmod_FileClose( file );
+    return size;
+}
+
+/**
+ * @brief Helper function to find a module in the pool.
+ * 
+ * @param name Name of the module
+ * @param hash Hash of the name
+ * @return dmell_pool_entry_t* Entry of the module, or NULL if it is not resident
+ */
+static dmell_pool_entry_t* find_entry( const char* name, uint32_t hash )
+{
+    for( dmell_pool_entry_t* entry = g_pool_head; entry != NULL; entry = entry->next )
+    {
+        if( entry->hash == hash && strcmp( entry->name, name ) == 0 )
+        {
+            return entry;
+        }
+    }
+    return NULL;
+}
+
+/**
+ * @brief Helper function to find a module that was loaded outside of the pool.
+ * 
+ * @param name Name of the module
+ * @param hash Hash of the name
+ * @param out_link Output parameter to hold the link that points to the entry (can be NULL)
+ * @return dmell_pool_entry_t* Entry of the module, or NULL if it is not external
+ */
+static dmell_pool_entry_t* find_external( const char* name, uint32_t hash, dmell_pool_entry_t*** out_link )
+{
+    for( dmell_pool_entry_t** link = &g_pool_external; *link != NULL; link = &(*link)->next )
+    {
+        if( (*link)->hash == hash && strcmp( (*link)->name, name ) == 0 )
+        {
+            if( out_link != NULL )
+            {
+                *out_link = link;
+            }
+            return *link;
+        }
+    }
+    return NULL;
+}
+
+/**
+ * @brief Helper function to remove an entry from the usage list.
+ * 
+ * @param entry Entry to unlink
+ */
+static void unlink_entry( dmell_pool_entry_t* entry )
+{
+    if( entry->prev != NULL )
+    {
+        entry->prev->next = entry->next;
+    }
+    else
+    {
+        g_pool_head = entry->next;
+    }
+    if( entry->next != NULL )
+    {
+        entry->next->prev = entry->prev;
+    }
+    else
+    {
+        g_pool_tail = entry->prev;
+    }
+    entry->prev = NULL;
+    entry->next = NULL;
+}
+
+/**
+ * @brief Helper function to put an entry at the front of the usage list.
+ * 
+ * @param entry Entry to link
+ */
+static void link_front( dmell_pool_entry_t* entry )
+{
+    entry->prev = NULL;
+    entry->next = g_pool_head;
+    if( g_pool_head != NULL )
+    {
+        g_pool_head->prev = entry;
+    }
+    else
+    {
+        g_pool_tail = entry;
+    }
+    g_pool_head = entry;
+}
+
+/**
+ * @brief Helper function to release a module and free its entry.
+ * 
+ * @param entry Entry to release
+ */
+static void release_entry( dmell_pool_entry_t* entry )
+{
+    unlink_entry( entry );
+    Dmod_DisableModule( entry->name, false );
+    Dmod_UnloadModule( entry->name, false );
+    g_pool_stats.count--;
+    g_pool_stats.resident_bytes -= entry->size;
+    Dmod_Free( entry );
+}
+
+/**
+ * @brief Helper function to release the least recently used modules until a new module fits.
+ * 
+ * @param size Size of the new module
+ */
+static void make_room( size_t size )
+{
+    while( g_pool_tail != NULL && 
+         ( g_pool_stats.count + 1 > g_pool_stats.max_count || g_pool_stats.resident_bytes + size > g_pool_stats.budget ) )
+    {
+        release_entry( g_pool_tail );
+        g_pool_stats.evictions++;
+    }
+}
+
+/**
+ * @brief Makes sure that the module of a command is resident before it runs.
+ * 
+ * If the module is already in the pool it becomes the most recently used
+ * one. Otherwise it is loaded and enabled and kept in the pool, as long as
+ * it fits in the pool at all. Modules loaded outside of the pool are not
+ * taken over.
+ * 
+ * @param name Name of the module
+ * @param path Path of the module file (used to measure the module)
+ * @return true If the module is resident
+ * @return false If the module is not kept in the pool
+ */
+bool dmell_pool_acquire( const char* name, const char* path )
+{
+    if( name == NULL || g_pool_stats.max_count == 0 )
+    {
+        return false;
+    }
+
+    uint32_t hash = dmell_hash_name( name, strlen( name ) );
+    dmell_pool_entry_t* entry = find_entry( name, hash );
+    if( entry != NULL )
+    {
+        unlink_entry( entry );
+        link_front( entry );
+        g_pool_stats.hits++;
+        return true;
+    }
+    if( find_external( name, hash, NULL ) != NULL )
+    {
+        return false;
+    }
+
+    g_pool_stats.misses++;
+    size_t size = ( path != NULL ) ? get_module_size( path ) : 0;
+    if( size > g_pool_stats.budget )
+    {
+        return false;
+    }
+
+    size_t name_size = strlen( name ) + 1;
+    entry = Dmod_Malloc( sizeof(dmell_pool_entry_t) + name_size );
+    if( entry == NULL )
+    {
+        DMOD_LOG_ERROR("Memory allocation failed for the pool entry of %s\n", name);
+        return false;
+    }
+
+    make_room( size );
+    if( Dmod_LoadModuleByName( name ) == NULL )
+    {
+        DMOD_LOG_ERROR("Failed to load module %s into the pool\n", name);
+        Dmod_Free( entry );
+        return false;
+    }
+    if( !Dmod_EnableModule( name, false, NULL ) )
+    {
+        DMOD_LOG_ERROR("Failed to enable module %s in the pool\n", name);
+        Dmod_UnloadModule( name, false );
+        Dmod_Free( entry );
+        return false;
+    }
+
+    entry->name = (char*)( entry + 1 );
+    memcpy( entry->name, name, name_size );
+    entry->hash = hash;
+    entry->size = size;
+    link_front( entry );
+    g_pool_stats.count++;
+    g_pool_stats.resident_bytes += size;
+    return true;
+}
+
+/**
+ * @brief Releases a module from the pool, if it is resident.
+ * 
+ * @param name Name of the module
+ */
+void dmell_pool_release( const char* name )
+{
+    if( name == NULL )
+    {
+        return;
+    }
+
+    dmell_pool_entry_t* entry = find_entry( name, dmell_hash_name( name, strlen( name ) ) );
+    if( entry != NULL )
+    {
+        release_entry( entry );
+    }
+}
+
+/**
+ * @brief Marks a module as loaded outside of the pool.
+ * 
+ * An external module is never loaded, unloaded or evicted by the pool. If
+ * the pool holds the module already, it is handed over without unloading
+ * it, so a module loaded with 'module load' stays loaded.
+ * 
+ * @param name Name of the module
+ * @param external True if the module was loaded outside of the pool, false if it was unloaded
+ */
+void dmell_pool_set_external( const char* name, bool external )
+{
+    if( name == NULL )
+    {
+        return;
+    }
+
+    size_t name_size = strlen( name ) + 1;
+    uint32_t hash = dmell_hash_name( name, name_size - 1 );
+    dmell_pool_entry_t** link = NULL;
+    dmell_pool_entry_t* entry = find_external( name, hash, &link );
+    if( !external )
+    {
+        if( entry != NULL )
+        {
+            *link = entry->next;
+            Dmod_Free( entry );
+        }
+        return;
+    }
+    if( entry != NULL )
+    {
+        return;
+    }
+
+    entry = find_entry( name, hash );
+    if( entry != NULL )
+    {
+        // The module stays loaded, only the pool forgets it
+        unlink_entry( entry );
+        g_pool_stats.count--;
+        g_pool_stats.resident_bytes -= entry->size;
+    }
+    else
+    {
+        entry = Dmod_Malloc( sizeof(dmell_pool_entry_t) + name_size );
+        if( entry == NULL )
+        {
+            DMOD_LOG_ERROR("Memory allocation failed for the external module %s\n", name);
+            return;
+        }
+        entry->name = (char*)( entry + 1 );
+        memcpy( entry->name, name, name_size );
+        entry->hash = hash;
+        entry->size = 0;
+        entry->prev = NULL;
+    }
+    entry->next = g_pool_external;
+    g_pool_external = entry;
+}
+
+/**
+ * @brief Releases all modules from the pool.
+ */
+void dmell_pool_flush( void )
+{
+    while( g_pool_head != NULL )
+    {
+        release_entry( g_pool_head );
+    }
+}
+
+/**
+ * @brief Configures the limits of the pool.
+ * 
+ * Modules that do not fit in the new limits are released. A size of 0
+ * disables the pool.
+ * 
+ * @param max_count Maximum number of resident modules
+ * @param budget Memory budget in bytes
+ */
+void dmell_pool_configure( size_t max_count, size_t budget )
+{
+    g_pool_stats.max_count = max_count;
+    g_pool_stats.budget = budget;
+    while( g_pool_tail != NULL && ( g_pool_stats.count > max_count || g_pool_stats.resident_bytes > budget ) )
+    {
+        release_entry( g_pool_tail );
+        g_pool_stats.evictions++;
+    }
+}
+
+/**
+ * @brief Reads the statistics of the pool.
+ * 
+ * @param out_stats Output parameter to hold the statistics
+ */
+void dmell_pool_get_stats( dmell_pool_stats_t* out_stats )
+{
+    if( out_stats != NULL )
+    {
+        *out_stats = g_pool_stats;
+    }
+}
+
+/**
+ * @brief Gets the most recently used module of the pool.
+ * 
+ * The next entries are reached through the next field, in the order of use.
+ * 
+ * @return const dmell_pool_entry_t* Most recently used module, or NULL if the pool is empty
+ */
+const dmell_pool_entry_t* dmell_pool_first( void )
+{
+    return g_pool_head;
+}
@@ -0,0 +1,1639 @@
+#include <errno.h>
+#include <string.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <ctype.h>
+#include <stdlib.h>
+#include "dmell_prog.h"
+#include "dmell_cmd.h"
+#include "dmell_vars.h"
+#include "dmell_hlp.h"
+#include "dmell_func.h"
+#include "dmell_arith.h"
+#include "dmod.h"
+
+/**
+ * @brief Marker that terminates each pre-tokenized argument list.
+ */
+#define DMELL_PROG_ARGS_END     UINT32_MAX
+
+/**
+ * @brief Keyword that starts the definition of a function.
+ */
+#define DMELL_PROG_FUNCTION_KEYWORD "function"
+
+/**
+ * @brief Initial capacity of the program arrays.
+ */
+#define DMELL_PROG_INITIAL_CAPACITY 16
+
+/**
+ * @brief State of the segment that is currently being compiled.
+ */
+typedef struct
+{
+    dmell_line_sep_t sep;           /**< Separator that precedes the segment */
+    uint32_t         first_part;    /**< Index of the first part of the segment */
+    bool             has_vars;      /**< True if the segment references variables */
+    bool             line_has_cmds; /**< True if any command was emitted for the current line */
+} segment_state_t;
+
+/**
+ * @brief Keywords of the blocks.
+ */
+typedef enum
+{
+    keyword_none,
+    keyword_if,
+    keyword_then,
+    keyword_elif,
+    keyword_else,
+    keyword_fi,
+    keyword_while,
+    keyword_for,
+    keyword_do,
+    keyword_done,
+    keyword_break,
+    keyword_continue,
+    keyword_return,
+
+    keyword_max
+} keyword_t;
+
+/**
+ * @brief Names of the keywords.
+ */
+static const char* const g_keywords[keyword_max] = {
+    [keyword_none]      = "",
+    [keyword_if]        = "if",
+    [keyword_then]      = "then",
+    [keyword_elif]      = "elif",
+    [keyword_else]      = "else",
+    [keyword_fi]        = "fi",
+    [keyword_while]     = "while",
+    [keyword_for]       = "for",
+    [keyword_do]        = "do",
+    [keyword_done]      = "done",
+    [keyword_break]     = "break",
+    [keyword_continue]  = "continue",
+    [keyword_return]    = "return",
+};
+
+/**
+ * @brief Kinds of blocks.
+ */
+typedef enum
+{
+    block_kind_if,
+    block_kind_while,
+    block_kind_for,
+} block_kind_t;
+
+/**
+ * @brief Parts of a block.
+ */
+typedef enum
+{
+    block_stage_cond,   //!< Condition of 'if', 'elif' or 'while', or the words of 'for'
+    block_stage_body,   //!< Commands after 'then' or 'do'
+    block_stage_else,   //!< Commands after 'else'
+} block_stage_t;
+
+/**
+ * @brief Helper function to make sure that an array can hold the given number of items.
+ *
+ * @param array Pointer to the array
+ * @param capacity Pointer to the capacity of the array (in items)
+ * @param needed Number of items that have to fit
+ * @param item_size Size of a single item
+ * @return int 0 on success, negative value on error
+ */
+static int reserve_items( void** array, uint32_t* capacity, uint32_t needed, size_t item_size )
+{
+    if( needed <= *capacity )
+    {
+        return 0;
+    }
+
+    uint32_t new_capacity = ( *capacity > 0 ) ? *capacity : DMELL_PROG_INITIAL_CAPACITY;
+    while( new_capacity < needed )
+    {
+        new_capacity *= 2;
+    }
+
+    void* new_array = Dmod_Realloc( *array, new_capacity * item_size );
+    if( new_array == NULL )
+    {
+        DMOD_LOG_ERROR("Memory allocation failed while compiling script\n");
+        return -ENOMEM;
+    }
+
+    *array = new_array;
+    *capacity = new_capacity;
+    return 0;
+}
+
+/**
+ * @brief Helper function to add a string to the program pool.
+ *
+ * @param prog Program to update
+ * @param str String to add
+ * @param len Length of the string
+ * @param out_offset Output parameter to hold the offset of the string in the pool
+ * @return int 0 on success, negative value on error
+ */
+static int add_to_pool( dmell_prog_t* prog, const char* str, size_t len, uint32_t* out_offset )
+{
+    int result = reserve_items( (void**)&prog->pool, &prog->pool_capacity, prog->pool_size + len + 1, sizeof(char) );
+    if( result < 0 )
+    {
+        return result;
+    }
+
+    memcpy( &prog->pool[prog->pool_size], str, len );
+    prog->pool[prog->pool_size + len] = '\0';
+    *out_offset = prog->pool_size;
+    prog->pool_size += len + 1;
+    return 0;
+}
+
+/**
+ * @brief Helper function to add an instruction to the program.
+ *
+ * @param prog Program to update
+ * @param instr Instruction to add
+ * @return int 0 on success, negative value on error
+ */
+static int add_instr( dmell_prog_t* prog, const dmell_prog_instr_t* instr )
+{
+    int result = reserve_items( (void**)&prog->instrs, &prog->instr_capacity, prog->instr_count + 1, sizeof(dmell_prog_instr_t) );
+    if( result < 0 )
+    {
+        return result;
+    }
+
+    prog->instrs[prog->instr_count++] = *instr;
+    return 0;
+}
+
+/**
+ * @brief Helper function to add an entry to the pre-tokenized arguments.
+ *
+ * @param prog Program to update
+ * @param offset Pool offset of the argument, or DMELL_PROG_ARGS_END
+ * @return int 0 on success, negative value on error
+ */
+static int add_arg_entry( dmell_prog_t* prog, uint32_t offset )
+{
+    int result = reserve_items( (void**)&prog->args, &prog->arg_capacity, prog->arg_count + 1, sizeof(uint32_t) );
+    if( result < 0 )
+    {
+        return result;
+    }
+
+    prog->args[prog->arg_count++] = offset;
+    return 0;
+}
+
+/**
+ * @brief Helper function to find or create the slot of a variable.
+ *
+ * @param prog Program to update
+ * @param name Name of the variable
+ * @param name_len Length of the name
+ * @param out_index Output parameter to hold the index of the slot
+ * @return int 0 on success, negative value on error
+ */
+static int get_slot( dmell_prog_t* prog, const char* name, size_t name_len, uint32_t* out_index )
+{
+    for( uint32_t i = 0; i < prog->slot_count; i++ )
+    {
+        const dmell_prog_slot_t* slot = &prog->slots[i];
+        if( slot->length == name_len && memcmp( &prog->pool[slot->name], name, name_len ) == 0 )
+        {
+            *out_index = i;
+            return 0;
+        }
+    }
+
+    int result = reserve_items( (void**)&prog->slots, &prog->slot_capacity, prog->slot_count + 1, sizeof(dmell_prog_slot_t) );
+    if( result < 0 )
+    {
+        return result;
+    }
+
+    dmell_prog_slot_t* slot = &prog->slots[prog->slot_count];
+    result = add_to_pool( prog, name, name_len, &slot->name );
+    if( result < 0 )
+    {
+        return result;
+    }
+    slot->length = (uint32_t)name_len;
+    slot->hash = dmell_hash_name( name, name_len );
+    *out_index = prog->slot_count++;
+    return 0;
+}
+
+/**
+ * @brief Helper function to add a part to the segment that is being compiled.
+ *
+ * @param prog Program to update
+ * @param seg State of the current segment
+ * @param kind Kind of the part
+ * @param value Pool offset or slot index
+ * @param length Length of the text
+ * @return int 0 on success, negative value on error
+ */
+static int add_part( dmell_prog_t* prog, segment_state_t* seg, dmell_prog_part_kind_t kind, uint32_t value, uint32_t length )
+{
+    int result = reserve_items( (void**)&prog->parts, &prog->part_capacity, prog->part_count + 1, sizeof(dmell_prog_part_t) );
+    if( result < 0 )
+    {
+        return result;
+    }
+
+    dmell_prog_part_t* part = &prog->parts[prog->part_count++];
+    part->kind   = kind;
+    part->value  = value;
+    part->length = length;
+    if( kind != dmell_prog_part_text )
+    {
+        seg->has_vars = true;
+    }
+    return 0;
+}
+
+/**
+ * @brief Helper function to tokenize a segment without variables at compile time.
+ *
+ * A segment with output redirections is not tokenized, because the
+ * redirections are not arguments, and neither is a segment with more
+ * arguments than an instruction can count. Such a segment is kept as text
+ * and parsed when it runs.
+ *
+ * @param prog Program to update
+ * @param seg State of the segment
+ * @param out_argc Output parameter to hold the number of arguments
+ * @param out_first Output parameter to hold the index of the first argument
+ * @param out_keep_text Output parameter set to true if the segment has to be kept as text
+ * @return int 0 on success, negative value on error
+ */
+static int tokenize_segment( dmell_prog_t* prog, const segment_state_t* seg, uint16_t* out_argc, uint32_t* out_first, bool* out_keep_text )
+{
+    size_t len = 0;
+    for( uint32_t i = seg->first_part; i < prog->part_count; i++ )
+    {
+        len += prog->parts[i].length;
+    }
+
+    *out_argc = 0;
+    *out_keep_text = false;
+    if( len == 0 )
+    {
+        return 0;
+    }
+
+    char* text = Dmod_Malloc( len );
+    if( text == NULL )
+    {
+        DMOD_LOG_ERROR("Memory allocation failed while tokenizing script segment\n");
+        return -ENOMEM;
+    }
+
+    char* ptr = text;
+    for( uint32_t i = seg->first_part; i < prog->part_count; i++ )
+    {
+        memcpy( ptr, &prog->pool[prog->parts[i].value], prog->parts[i].length );
+        ptr += prog->parts[i].length;
+    }
+
+    const char* end_ptr = text + len;
+    if( dmell_skip_whitespaces( text, end_ptr ) >= end_ptr )
+    {
+        Dmod_Free( text );
+        return 0;
+    }
+
+    dmell_argv_t parsed_argv = {0};
+    int result = dmell_parse_command( text, len, &parsed_argv );
+    Dmod_Free( text );
+    if( result < 0 )
+    {
+        return result;
+    }
+    if( parsed_argv.redirect.output != NULL || parsed_argv.redirect.error != NULL || parsed_argv.argc > UINT16_MAX )
+    {
+        *out_keep_text = true;
+        dmell_free_argv( &parsed_argv );
+        return 0;
+    }
+
+    *out_first = prog->arg_count;
+    for( int i = 0; i < parsed_argv.argc && result == 0; i++ )
+    {
+        uint32_t offset = 0;
+        result = add_to_pool( prog, parsed_argv.argv[i], strlen( parsed_argv.argv[i] ), &offset );
+        if( result == 0 )
+        {
+            result = add_arg_entry( prog, offset );
+        }
+    }
+    if( result == 0 )
+    {
+        result = add_arg_entry( prog, DMELL_PROG_ARGS_END );
+    }
+    if( result == 0 )
+    {
+        *out_argc = (uint16_t)parsed_argv.argc;
+    }
+
+    dmell_free_argv( &parsed_argv );
+    return result;
+}
+
+/**
+ * @brief Helper function to emit the instruction of the segment that is being compiled.
+ *
+ * A command segment without arguments is not emitted.
+ *
+ * @param prog Program to update
+ * @param seg State of the segment
+ * @param op Operation of the instruction
+ * @return int 0 on success, negative value on error
+ */
+static int emit_segment( dmell_prog_t* prog, segment_state_t* seg, dmell_prog_op_t op )
+{
+    int result = 0;
+    dmell_prog_instr_t instr = {
+        .op     = (uint8_t)op,
+        .sep    = (uint8_t)seg->sep,
+        .argc   = 0,
+        .line   = prog->line_count,
+        .first  = seg->first_part,
+        .count  = prog->part_count - seg->first_part
+    };
+
+    bool keep_text = false;
+    if( !seg->has_vars )
+    {
+        result = tokenize_segment( prog, seg, &instr.argc, &instr.first, &keep_text );
+    }
+    if( !seg->has_vars && !keep_text )
+    {
+        // The text parts are not needed anymore
+        prog->part_count = seg->first_part;
+        instr.count = 0;
+        if( result == 0 && ( instr.argc > 0 || op != dmell_prog_op_cmd ) )
+        {
+            result = add_instr( prog, &instr );
+            seg->line_has_cmds |= ( op == dmell_prog_op_cmd );
+        }
+    }
+    else if( result == 0 )
+    {
+        result = add_instr( prog, &instr );
+        seg->line_has_cmds |= ( op == dmell_prog_op_cmd );
+    }
+    return result;
+}
+
+/**
+ * @brief Helper function to find the keyword at the start of a segment.
+ *
+ * A keyword has to be a separate word in the literal text of the segment.
+ * The keyword is removed from the segment.
+ *
+ * @param prog Program to update
+ * @param seg State of the segment
+ * @return keyword_t Keyword found, or keyword_none
+ */
+static keyword_t take_keyword( dmell_prog_t* prog, const segment_state_t* seg )
+{
+    if( seg->first_part >= prog->part_count || prog->parts[seg->first_part].kind != dmell_prog_part_text )
+    {
+        return keyword_none;
+    }
+
+    dmell_prog_part_t* part = &prog->parts[seg->first_part];
+    const char* text = &prog->pool[part->value];
+    const char* end_ptr = text + part->length;
+    const char* word = dmell_skip_whitespaces( text, end_ptr );
+    for( int keyword = keyword_none + 1; keyword < keyword_max; keyword++ )
+    {
+        size_t len = strlen( g_keywords[keyword] );
+        const char* word_end = word + len;
+        if( word_end > end_ptr || memcmp( word, g_keywords[keyword], len ) != 0 )
+        {
+            continue;
+        }
+        bool separated = ( word_end < end_ptr ) ? ( dmell_skip_whitespaces( word_end, end_ptr ) > word_end )
+                                                 : ( seg->first_part + 1 == prog->part_count );
+        if( separated )
+        {
+            part->value  += (uint32_t)( word_end - text );
+            part->length -= (uint32_t)( word_end - text );
+            return (keyword_t)keyword;
+        }
+    }
+    return keyword_none;
+}
+
+/**
+ * @brief Helper function to check if the rest of a segment is empty.
+ *
+ * @param prog Program that is compiled
+ * @param seg State of the segment
+ * @return true If the segment has only whitespaces
+ * @return false Otherwise
+ */
+static bool is_segment_empty( const dmell_prog_t* prog, const segment_state_t* seg )
+{
+    for( uint32_t i = seg->first_part; i < prog->part_count; i++ )
+    {
+        const dmell_prog_part_t* part = &prog->parts[i];
+        const char* text = &prog->pool[part->value];
+        if( part->kind != dmell_prog_part_text || dmell_skip_whitespaces( text, text + part->length ) < text + part->length )
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * @brief Helper function to add a jump instruction.
+ *
+ * @param prog Program to update
+ * @param op Operation of the jump
+ * @param sep Separator that precedes the jump
+ * @param target Index of the target instruction, or the next jump of a chain
+ * @param out_pc [optional] Output parameter to hold the index of the jump
+ * @return int 0 on success, negative value on error
+ */
+static int add_jump( dmell_prog_t* prog, dmell_prog_op_t op, dmell_line_sep_t sep, uint32_t target, uint32_t* out_pc )
+{
+    dmell_prog_instr_t instr = {
+        .op     = (uint8_t)op,
+        .sep    = (uint8_t)sep,
+        .argc   = 0,
+        .line   = prog->line_count,
+        .first  = target,
+        .count  = 0
+    };
+    if( out_pc != NULL )
+    {
+        *out_pc = prog->instr_count;
+    }
+    return add_instr( prog, &instr );
+}
+
+/**
+ * @brief Helper function to set the target of a chain of jumps.
+ *
+ * Jumps that wait for their target are linked through their 'first' field.
+ *
+ * @param prog Program to update
+ * @param chain Index of the last jump of the chain, or DMELL_PROG_NO_TARGET
+ * @param target Index of the target instruction
+ */
+static void patch_jumps( dmell_prog_t* prog, uint32_t chain, uint32_t target )
+{
+    while( chain != DMELL_PROG_NO_TARGET )
+    {
+        uint32_t next = prog->instrs[chain].first;
+        prog->instrs[chain].first = target;
+        chain = next;
+    }
+}
+
+/**
+ * @brief Helper function to open a block.
+ *
+ * @param prog Program to update
+ * @param kind Keyword that opens the block
+ * @param start Instruction that 'continue' jumps to
+ * @return int 0 on success, negative value on error
+ */
+static int push_block( dmell_prog_t* prog, block_kind_t kind, uint32_t start )
+{
+    int result = reserve_items( (void**)&prog->blocks, &prog->block_capacity, prog->block_count + 1, sizeof(dmell_prog_block_t) );
+    if( result < 0 )
+    {
+        return result;
+    }
+
+    dmell_prog_block_t* block = &prog->blocks[prog->block_count++];
+    block->kind  = (uint8_t)kind;
+    block->stage = (uint8_t)block_stage_cond;
+    block->start = start;
+    block->test  = DMELL_PROG_NO_TARGET;
+    block->exits = DMELL_PROG_NO_TARGET;
+    return 0;
+}
+
+/**
+ * @brief Helper function to find the innermost loop.
+ *
+ * @param prog Program that is compiled
+ * @return dmell_prog_block_t* Innermost 'while' or 'for' block, or NULL if there is none
+ */
+static dmell_prog_block_t* find_loop( dmell_prog_t* prog )
+{
+    for( uint32_t i = prog->block_count; i > 0; i-- )
+    {
+        if( prog->blocks[i - 1].kind != block_kind_if )
+        {
+            return &prog->blocks[i - 1];
+        }
+    }
+    return NULL;
+}
+
+/**
+ * @brief Helper function to compile the header of a 'for' loop.
+ *
+ * Usage: for NAME in WORDS...
+ *
+ * @param prog Program to update
+ * @param seg State of the segment without the keyword
+ * @return int 0 on success, negative value on error
+ */
+static int compile_for( dmell_prog_t* prog, segment_state_t* seg )
+{
+    char name[DMELL_MAX_VAR_NAME_LEN];
+    size_t name_len = 0;
+    bool valid = seg->first_part < prog->part_count && prog->parts[seg->first_part].kind == dmell_prog_part_text;
+    if( valid )
+    {
+        dmell_prog_part_t* part = &prog->parts[seg->first_part];
+        const char* text = &prog->pool[part->value];
+        const char* end_ptr = text + part->length;
+        const char* ptr = dmell_skip_whitespaces( text, end_ptr );
+        while( ptr + name_len < end_ptr && name_len < sizeof(name) - 1 &&
+               ( isalnum( (unsigned char)ptr[name_len] ) || ptr[name_len] == '_' ) )
+        {
+            name[name_len] = ptr[name_len];
+            name_len++;
+        }
+        const char* in = dmell_skip_whitespaces( ptr + name_len, end_ptr );
+        const char* words = in + 2;
+        valid = name_len > 0 && in > ptr + name_len && words <= end_ptr && memcmp( in, "in", 2 ) == 0 &&
+                ( words == end_ptr || dmell_skip_whitespaces( words, end_ptr ) > words );
+        if( valid )
+        {
+            part->value  += (uint32_t)( words - text );
+            part->length -= (uint32_t)( words - text );
+        }
+    }
+    if( !valid )
+    {
+        DMOD_LOG_ERROR("Invalid 'for' loop in line %u, expected: for NAME in WORDS...\n", (unsigned)prog->line_count);
+        return -EINVAL;
+    }
+
+    uint32_t slot = 0;
+    int result = get_slot( prog, name, name_len, &slot );
+    if( result == 0 )
+    {
+        seg->sep = dmell_line_sep_none;
+        result = emit_segment( prog, seg, dmell_prog_op_for_init );
+    }
+
+    uint32_t next_pc = prog->instr_count;
+    if( result == 0 )
+    {
+        dmell_prog_instr_t instr = {
+            .op     = dmell_prog_op_for_next,
+            .sep    = dmell_line_sep_none,
+            .argc   = (uint16_t)prog->loop_count++,
+            .line   = prog->line_count,
+            .first  = slot,
+            .count  = DMELL_PROG_NO_TARGET
+        };
+        result = add_instr( prog, &instr );
+    }
+    if( result == 0 )
+    {
+        result = push_block( prog, block_kind_for, next_pc );
+    }
+    if( result == 0 )
+    {
+        prog->blocks[prog->block_count - 1].test = next_pc;
+    }
+    return result;
+}
+
+/**
+ * @brief Helper function to compile a keyword of a block.
+ *
+ * The commands that follow 'if', 'elif', 'while', 'then', 'else' and 'do'
+ * in the same segment are compiled as a command. 'return' is allowed only
+ * in the body of a function.
+ *
+ * @param prog Program to update
+ * @param seg State of the segment without the keyword
+ * @param keyword Keyword to compile
+ * @return int 0 on success, negative value on error
+ */
+static int compile_keyword( dmell_prog_t* prog, segment_state_t* seg, keyword_t keyword )
+{
+    bool is_jump = ( keyword == keyword_break || keyword == keyword_continue || keyword == keyword_return );
+    bool valid_sep = is_jump ? ( seg->sep != dmell_line_sep_pipe )
+                             : ( seg->sep != dmell_line_sep_pipe && seg->sep != dmell_line_sep_and && seg->sep != dmell_line_sep_or );
+    dmell_prog_block_t* block = ( prog->block_count > 0 ) ? &prog->blocks[prog->block_count - 1] : NULL;
+    block_kind_t kind = ( block != NULL ) ? (block_kind_t)block->kind : block_kind_if;
+    block_stage_t stage = ( block != NULL ) ? (block_stage_t)block->stage : block_stage_cond;
+    uint32_t here = prog->instr_count;
+    int result = 0;
+
+    switch( keyword )
+    {
+        case keyword_if:
+            result = valid_sep ? push_block( prog, block_kind_if, DMELL_PROG_NO_TARGET ) : -EINVAL;
+            break;
+        case keyword_while:
+            result = valid_sep ? push_block( prog, block_kind_while, here ) : -EINVAL;
+            break;
+        case keyword_for:
+            if( valid_sep )
+            {
+                return compile_for( prog, seg );
+            }
+            break;
+        case keyword_then:
+            valid_sep = valid_sep && block != NULL && kind == block_kind_if && stage == block_stage_cond;
+            result = valid_sep ? add_jump( prog, dmell_prog_op_jump_false, seg->sep, DMELL_PROG_NO_TARGET, &block->test ) : -EINVAL;
+            if( result == 0 )
+            {
+                block->stage = (uint8_t)block_stage_body;
+            }
+            break;
+        case keyword_elif:
+        case keyword_else:
+            valid_sep = valid_sep && block != NULL && kind == block_kind_if && stage == block_stage_body;
+            result = valid_sep ? add_jump( prog, dmell_prog_op_jump, dmell_line_sep_none, block->exits, &block->exits ) : -EINVAL;
+            if( result == 0 )
+            {
+                patch_jumps( prog, block->test, prog->instr_count );
+                block->test = DMELL_PROG_NO_TARGET;
+                block->stage = (uint8_t)( keyword == keyword_elif ? block_stage_cond : block_stage_else );
+            }
+            break;
+        case keyword_fi:
+            valid_sep = valid_sep && block != NULL && kind == block_kind_if && stage != block_stage_cond;
+            if( valid_sep )
+            {
+                patch_jumps( prog, block->test, here );
+                patch_jumps( prog, block->exits, here );
+                prog->block_count--;
+            }
+            break;
+        case keyword_do:
+            valid_sep = valid_sep && block != NULL && kind != block_kind_if && stage == block_stage_cond;
+            if( valid_sep && kind == block_kind_while )
+            {
+                result = add_jump( prog, dmell_prog_op_jump_false, seg->sep, DMELL_PROG_NO_TARGET, &block->test );
+            }
+            if( valid_sep && result == 0 )
+            {
+                block->stage = (uint8_t)block_stage_body;
+            }
+            break;
+        case keyword_done:
+            valid_sep = valid_sep && block != NULL && kind != block_kind_if && stage == block_stage_body;
+            result = valid_sep ? add_jump( prog, dmell_prog_op_jump, dmell_line_sep_none, block->start, NULL ) : -EINVAL;
+            if( result == 0 )
+            {
+                if( kind == block_kind_for )
+                {
+                    prog->instrs[block->test].count = prog->instr_count;
+                }
+                else
+                {
+                    patch_jumps( prog, block->test, prog->instr_count );
+                }
+                patch_jumps( prog, block->exits, prog->instr_count );
+                prog->block_count--;
+            }
+            break;
+        case keyword_break:
+        case keyword_continue:
+            block = find_loop( prog );
+            valid_sep = valid_sep && block != NULL;
+            if( valid_sep && keyword == keyword_break )
+            {
+                result = add_jump( prog, dmell_prog_op_jump, seg->sep, block->exits, &block->exits );
+            }
+            else if( valid_sep )
+            {
+                result = add_jump( prog, dmell_prog_op_jump, seg->sep, block->start, NULL );
+            }
+            break;
+        case keyword_return:
+            if( valid_sep && prog->is_function )
+            {
+                // The exit code is the rest of the segment
+                return emit_segment( prog, seg, dmell_prog_op_return );
+            }
+            valid_sep = false;
+            break;
+        default:
+            break;
+    }
+
+    if( !valid_sep )
+    {
+        DMOD_LOG_ERROR("Syntax error in line %u: unexpected '%s'\n", (unsigned)prog->line_count, g_keywords[keyword]);
+        return -EINVAL;
+    }
+    if( result < 0 )
+    {
+        return result;
+    }
+
+    if( keyword == keyword_fi || keyword == keyword_done || is_jump )
+    {
+        if( !is_segment_empty( prog, seg ) )
+        {
+            DMOD_LOG_ERROR("Syntax error in line %u: unexpected text after '%s'\n", (unsigned)prog->line_count, g_keywords[keyword]);
+            return -EINVAL;
+        }
+        prog->part_count = seg->first_part;
+        return 0;
+    }
+
+    // The commands after the keyword start a new chain, which can start with a keyword as well
+    seg->sep = dmell_line_sep_none;
+    keyword_t next = take_keyword( prog, seg );
+    return ( next != keyword_none ) ? compile_keyword( prog, seg, next )
+                                    : emit_segment( prog, seg, dmell_prog_op_cmd );
+}
+
+/**
+ * @brief Helper function to close the segment that is being compiled and emit its instructions.
+ *
+ * @param prog Program to update
+ * @param seg State of the segment
+ * @return int 0 on success, negative value on error
+ */
+static int close_segment( dmell_prog_t* prog, segment_state_t* seg )
+{
+    keyword_t keyword = take_keyword( prog, seg );
+    int result = ( keyword != keyword_none ) ? compile_keyword( prog, seg, keyword )
+                                             : emit_segment( prog, seg, dmell_prog_op_cmd );
+
+    seg->first_part = prog->part_count;
+    seg->has_vars   = false;
+    return result;
+}
+
+/**
+ * @brief Helper function to add literal text to the current segment.
+ *
+ * @param prog Program to update
+ * @param seg State of the current segment
+ * @param str Start of the text
+ * @param end_ptr End of the text
+ * @return int 0 on success, negative value on error
+ */
+static int add_text( dmell_prog_t* prog, segment_state_t* seg, const char* str, const char* end_ptr )
+{
+    if( end_ptr <= str )
+    {
+        return 0;
+    }
+
+    uint32_t offset = 0;
+    int result = add_to_pool( prog, str, end_ptr - str, &offset );
+    if( result == 0 )
+    {
+        result = add_part( prog, seg, dmell_prog_part_text, offset, (uint32_t)(end_ptr - str) );
+    }
+    return result;
+}
+
+/**
+ * @brief Helper function to add the text of a command to the current segment.
+ *
+ * The text is split into literal text, variable references, command
+ * substitutions and arithmetic expansions.
+ *
+ * @param prog Program to update
+ * @param seg State of the current segment
+ * @param str Start of the command
+ * @param end_ptr End of the command
+ * @return int 0 on success, negative value on error
+ */
+static int add_command( dmell_prog_t* prog, segment_state_t* seg, const char* str, const char* end_ptr )
+{
+    int result = 0;
+    const char* ptr = str;
+    while( ptr < end_ptr && result == 0 )
+    {
+        bool is_cmd = false;
+        const char* name = NULL;
+        size_t name_len = 0;
+        const char* ref_end = end_ptr;
+        const char* var_start = dmell_find_next_reference( ptr, end_ptr, &is_cmd, &name, &name_len, &ref_end );
+        result = add_text( prog, seg, ptr, var_start );
+        if( result == 0 && var_start < end_ptr )
+        {
+            const char* expr = NULL;
+            size_t expr_len = 0;
+            if( is_cmd && dmell_arith_is_expansion( name, name_len, &expr, &expr_len ) )
+            {
+                uint32_t offset = 0;
+                result = add_to_pool( prog, expr, expr_len, &offset );
+                if( result == 0 )
+                {
+                    result = add_part( prog, seg, dmell_prog_part_arith, offset, (uint32_t)expr_len );
+                }
+            }
+            else if( is_cmd )
+            {
+                uint32_t offset = 0;
+                result = add_to_pool( prog, name, name_len, &offset );
+                if( result == 0 )
+                {
+                    result = add_part( prog, seg, dmell_prog_part_cmd, offset, (uint32_t)name_len );
+                }
+            }
+            else if( name != NULL && name_len > 0 && name_len < DMELL_MAX_VAR_NAME_LEN )
+            {
+                uint32_t slot = 0;
+                result = get_slot( prog, name, name_len, &slot );
+                if( result == 0 )
+                {
+                    result = add_part( prog, seg, dmell_prog_part_var, slot, 0 );
+                }
+            }
+            ptr = ref_end;
+        }
+        else
+        {
+            ptr = end_ptr;
+        }
+    }
+    return result;
+}
+
+/**
+ * @brief Creates an empty program that lines can be compiled into.
+ *
+ * @return dmell_prog_t* New program, or NULL on failure
+ */
+dmell_prog_t* dmell_prog_create( void )
+{
+    dmell_prog_t* prog = Dmod_Malloc( sizeof(dmell_prog_t) );
+    if( prog == NULL )
+    {
+        DMOD_LOG_ERROR("Memory allocation failed in dmell_prog_create\n");
+        return NULL;
+    }
+    memset( prog, 0, sizeof(dmell_prog_t) );
+    prog->refs = 1;
+    return prog;
+}
+
+/**
+ * @brief Helper function to skip whitespaces at the end of a text.
+ *
+ * @param str Start of the text
+ * @param end_ptr End of the text
+ * @return const char* New end of the text
+ */
+static const char* trim_end( const char* str, const char* end_ptr )
+{
+    while( end_ptr > str && ( end_ptr[-1] == ' ' || end_ptr[-1] == '\t' || end_ptr[-1] == '\n' || end_ptr[-1] == '\r' ) )
+    {
+        end_ptr--;
+    }
+    return end_ptr;
+}
+
+/**
+ * @brief Helper function to start the definition of a function.
+ *
+ * Usage: function NAME {
+ *
+ * @param prog Program to update
+ * @param line Line of the definition without the keyword
+ * @param end_ptr End of the line
+ * @return int 0 on success, negative value on error
+ */
+static int begin_function( dmell_prog_t* prog, const char* line, const char* end_ptr )
+{
+    const char* name = dmell_skip_whitespaces( line, end_ptr );
+    const char* name_end = name;
+    while( name_end < end_ptr && ( isalnum( (unsigned char)*name_end ) || *name_end == '_' || *name_end == '-' ) )
+    {
+        name_end++;
+    }
+    const char* ptr = name_end;
+    if( end_ptr - ptr >= 2 && ptr[0] == '(' && ptr[1] == ')' )
+    {
+        ptr += 2;
+    }
+    ptr = dmell_skip_whitespaces( ptr, end_ptr );
+    if( name_end == name || ptr + 1 != end_ptr || *ptr != '{' )
+    {
+        DMOD_LOG_ERROR("Invalid function definition in line %u, expected: function NAME {\n", (unsigned)prog->line_count);
+        return -EINVAL;
+    }
+
+    int result = reserve_items( (void**)&prog->funcs, &prog->func_capacity, prog->func_count + 1, sizeof(dmell_prog_t*) );
+    if( result == 0 )
+    {
+        result = add_to_pool( prog, name, name_end - name, &prog->body_name );
+    }
+    if( result < 0 )
+    {
+        return result;
+    }
+
+    prog->body = dmell_prog_create();
+    if( prog->body == NULL )
+    {
+        return -ENOMEM;
+    }
+    prog->body->is_function = true;
+    prog->body->line_count = prog->line_count;
+    return 0;
+}
+
+/**
+ * @brief Helper function to finish the definition of a function.
+ *
+ * @param prog Program to update
+ * @return int 0 on success, negative value on error
+ */
+static int end_function( dmell_prog_t* prog )
+{
+    dmell_prog_t* body = prog->body;
+    int result = dmell_prog_finish( body );
+    if( result < 0 )
+    {
+        return result;
+    }
+
+    prog->body = NULL;
+    prog->funcs[prog->func_count] = body;
+    dmell_prog_instr_t instr = {
+        .op     = dmell_prog_op_define,
+        .sep    = dmell_line_sep_none,
+        .argc   = 0,
+        .line   = prog->line_count,
+        .first  = prog->func_count++,
+        .count  = prog->body_name
+    };
+    return add_instr( prog, &instr );
+}
+
+/**
+ * @brief Helper function to compile a line of the function that is being defined.
+ *
+ * @param prog Program to update
+ * @param line Script line without leading whitespaces and the comment
+ * @param end_ptr End of the line
+ * @return int 0 on success, negative value on error
+ */
+static int add_body_line( dmell_prog_t* prog, const char* line, const char* end_ptr )
+{
+    if( prog->body->body == NULL && trim_end( line, end_ptr ) == line + 1 && *line == '}' )
+    {
+        return end_function( prog );
+    }
+
+    // Keep the line numbers of the body the same as in the script
+    prog->body->line_count = prog->line_count - 1;
+    return dmell_prog_add_line( prog->body, line, end_ptr - line );
+}
+
+/**
+ * @brief Compiles a single script line and appends it to the program.
+ *
+ * The line is processed in the same way as dmell_run_script_line processes
+ * it - comments are stripped, whitespaces at the start of the line and after
+ * each variable reference are skipped and the result is split on command
+ * separators. Segments that start with a keyword ('if', 'then', 'done', ...)
+ * are compiled into jumps, so a block can span many lines. The lines between
+ * 'function NAME {' and '}' are compiled into the body of the function.
+ *
+ * @param prog Program to update
+ * @param line Script line
+ * @param len Length of the script line
+ * @return int 0 on success, negative value on error
+ */
+int dmell_prog_add_line( dmell_prog_t* prog, const char* line, size_t len )
+{
+    if( prog == NULL || ( line == NULL && len > 0 ) )
+    {
+        DMOD_LOG_ERROR("Invalid arguments to dmell_prog_add_line: %p, %p, %zu\n", prog, line, len);
+        return -EINVAL;
+    }
+
+    prog->line_count++;
+
+    const char* end_ptr = line + len;
+    line = dmell_skip_whitespaces( line, end_ptr );
+    end_ptr = dmell_find_comment_start( line, end_ptr );
+
+    if( prog->body != NULL )
+    {
+        return add_body_line( prog, line, end_ptr );
+    }
+    const char* keyword_end = line + sizeof(DMELL_PROG_FUNCTION_KEYWORD) - 1;
+    if( keyword_end <= end_ptr && memcmp( line, DMELL_PROG_FUNCTION_KEYWORD, keyword_end - line ) == 0 &&
+        dmell_skip_whitespaces( keyword_end, end_ptr ) > keyword_end )
+    {
+        return begin_function( prog, keyword_end, trim_end( keyword_end, end_ptr ) );
+    }
+
+    segment_state_t seg = {
+        .sep            = dmell_line_sep_none,
+        .first_part     = prog->part_count,
+        .has_vars       = false,
+        .line_has_cmds  = false
+    };
+
+    // Separators are found in the whole line, so quotes can span variable references
+    int result = 0;
+    const char* ptr = line;
+    while( ptr < end_ptr && result == 0 )
+    {
+        dmell_line_sep_t sep = dmell_line_sep_none;
+        const char* sep_ptr = dmell_line_find_separator( ptr, end_ptr, &sep );
+        result = add_command( prog, &seg, ptr, sep_ptr );
+        if( result == 0 && sep != dmell_line_sep_none )
+        {
+            uint32_t instr_count = prog->instr_count;
+            result = close_segment( prog, &seg );
+            // An empty segment after '&' (like the end of the line) keeps the '&' for the previous command
+            if( prog->instr_count != instr_count || seg.sep != dmell_line_sep_background )
+            {
+                seg.sep = sep;
+            }
+        }
+        ptr = dmell_line_skip_separator( sep_ptr, end_ptr, sep );
+    }
+
+    // A separator that ends the line (like '&') is kept in the status instruction
+    dmell_line_sep_t trailing_sep = dmell_line_sep_none;
+    if( result == 0 )
+    {
+        uint32_t instr_count = prog->instr_count;
+        result = close_segment( prog, &seg );
+        if( prog->instr_count == instr_count )
+        {
+            trailing_sep = seg.sep;
+        }
+    }
+
+    // The exit code of a condition is checked by the instruction that ends it
+    bool in_condition = prog->block_count > 0 && prog->blocks[prog->block_count - 1].stage == block_stage_cond;
+    if( result == 0 && seg.line_has_cmds && !in_condition )
+    {
+        dmell_prog_instr_t instr = {
+            .op     = dmell_prog_op_status,
+            .sep    = (uint8_t)trailing_sep,
+            .argc   = 0,
+            .line   = prog->line_count,
+            .first  = 0,
+            .count  = 0
+        };
+        result = add_instr( prog, &instr );
+    }
+
+    return result;
+}
+
+/**
+ * @brief Finishes the compilation of the program.
+ *
+ * Checks that all blocks are closed and builds the table of argument
+ * pointers used to run pre-tokenized segments. No lines can be added to the
+ * program after it is finished.
+ *
+ * @param prog Program to finish
+ * @return int 0 on success, negative value on error
+ */
+int dmell_prog_finish( dmell_prog_t* prog )
+{
+    if( prog == NULL )
+    {
+        DMOD_LOG_ERROR("Invalid program passed to dmell_prog_finish\n");
+        return -EINVAL;
+    }
+
+    if( prog->body != NULL )
+    {
+        DMOD_LOG_ERROR("Syntax error: missing '}' at the end of the function '%s'\n", &prog->pool[prog->body_name]);
+        return -EINVAL;
+    }
+    if( prog->block_count > 0 )
+    {
+        const dmell_prog_block_t* block = &prog->blocks[prog->block_count - 1];
+        DMOD_LOG_ERROR("Syntax error: missing '%s' at the end of the script\n", block->kind == block_kind_if ? "fi" : "done");
+        return -EINVAL;
+    }
+    Dmod_Free( prog->blocks );
+    prog->blocks = NULL;
+    prog->block_capacity = 0;
+
+    Dmod_Free( prog->argv_table );
+    prog->argv_table = NULL;
+    if( prog->arg_count == 0 )
+    {
+        return 0;
+    }
+
+    prog->argv_table = Dmod_Malloc( sizeof(char*) * prog->arg_count );
+    if( prog->argv_table == NULL )
+    {
+        DMOD_LOG_ERROR("Memory allocation failed in dmell_prog_finish\n");
+        return -ENOMEM;
+    }
+
+    for( uint32_t i = 0; i < prog->arg_count; i++ )
+    {
+        prog->argv_table[i] = ( prog->args[i] == DMELL_PROG_ARGS_END ) ? NULL : &prog->pool[prog->args[i]];
+    }
+    return 0;
+}
+
+/**
+ * @brief Compiles a script text into a program.
+ *
+ * @param text Script text
+ * @param len Length of the script text
+ * @return dmell_prog_t* Compiled program, or NULL on failure
+ */
+dmell_prog_t* dmell_prog_compile( const char* text, size_t len )
+{
+    if( text == NULL && len > 0 )
+    {
+        DMOD_LOG_ERROR("Invalid arguments to dmell_prog_compile: %p, %zu\n", text, len);
+        return NULL;
+    }
+
+    dmell_prog_t* prog = dmell_prog_create();
+    if( prog == NULL )
+    {
+        return NULL;
+    }
+
+    const char* end_ptr = text + len;
+    const char* ptr = text;
+    int result = 0;
+    while( ptr < end_ptr && result == 0 )
+    {
+        const char* line_end = memchr( ptr, '\n', end_ptr - ptr );
+        line_end = ( line_end != NULL ) ? line_end + 1 : end_ptr;
+        result = dmell_prog_add_line( prog, ptr, line_end - ptr );
+        ptr = line_end;
+    }
+
+    if( result == 0 )
+    {
+        result = dmell_prog_finish( prog );
+    }
+
+    if( result < 0 )
+    {
+        dmell_prog_release( prog );
+        return NULL;
+    }
+    return prog;
+}
+
+/**
+ * @brief Takes a reference to the program.
+ *
+ * @param prog Program to retain
+ * @return dmell_prog_t* The same program
+ */
+dmell_prog_t* dmell_prog_retain( dmell_prog_t* prog )
+{
+    if( prog != NULL )
+    {
+        prog->refs++;
+    }
+    return prog;
+}
+
+/**
+ * @brief Drops a reference to the program and frees it when it is not used anymore.
+ *
+ * @param prog Program to release
+ */
+void dmell_prog_release( dmell_prog_t* prog )
+{
+    if( prog == NULL || --prog->refs > 0 )
+    {
+        return;
+    }
+
+    Dmod_Free( prog->instrs );
+    Dmod_Free( prog->parts );
+    Dmod_Free( prog->slots );
+    Dmod_Free( prog->args );
+    Dmod_Free( prog->argv_table );
+    Dmod_Free( prog->pool );
+    Dmod_Free( prog->blocks );
+    for( uint32_t i = 0; i < prog->func_count; i++ )
+    {
+        dmell_prog_release( prog->funcs[i] );
+    }
+    Dmod_Free( prog->funcs );
+    dmell_prog_release( prog->body );
+    Dmod_Free( prog );
+}
+
+/**
+ * @brief State of a 'for' loop while the program runs.
+ */
+typedef struct
+{
+    dmell_argv_t    parsed;     /**< Words of the loop after expansion */
+    char**          words;      /**< Words of the loop */
+    int             count;      /**< Number of words */
+    int             index;      /**< Index of the next word */
+} loop_state_t;
+
+/**
+ * @brief State of a running program.
+ */
+typedef struct
+{
+    dmell_line_pipeline_t   pipeline;       /**< Pipeline of the current line */
+    int                     last_exit_code; /**< Exit code of the last command */
+    int                     line_result;    /**< Exit code of the current line */
+    bool                    line_pending;   /**< True if a command of the current line ran since the exit code was published */
+    loop_state_t*           loops;          /**< States of the 'for' loops */
+} run_state_t;
+
+/**
+ * @brief Helper function to expand a segment that references variables.
+ *
+ * @param prog Program that is running
+ * @param instr Instruction of the segment
+ * @param ctx Script execution context
+ * @param out Buffer to append the expanded text to
+ * @return int 0 on success, negative value on error
+ */
+static int expand_segment( dmell_prog_t* prog, const dmell_prog_instr_t* instr, dmell_script_ctx_t* ctx, dmell_buf_t* out )
+{
+    const dmell_prog_part_t* parts = &prog->parts[instr->first];
+    int result = 0;
+    for( uint32_t i = 0; i < instr->count && result == 0; i++ )
+    {
+        if( parts[i].kind == dmell_prog_part_var )
+        {
+            const dmell_prog_slot_t* slot = &prog->slots[parts[i].value];
+            const char* name = &prog->pool[slot->name];
+            char special[DMELL_VARS_SPECIAL_SIZE];
+            const char* value = dmell_get_variable_value_n( &ctx->variables, name, slot->length, slot->hash, special );
+            if( value != NULL )
+            {
+                result = dmell_buf_append( out, value, strlen( value ) );
+            }
+        }
+        else if( parts[i].kind == dmell_prog_part_cmd )
+        {
+            int length = dmell_substitute_command( &ctx->variables, &prog->pool[parts[i].value], parts[i].length, out );
+            result = length < 0 ? length : 0;
+        }
+        else if( parts[i].kind == dmell_prog_part_arith )
+        {
+            char value[DMELL_ARITH_RESULT_SIZE];
+            int length = dmell_arith_expand( &ctx->variables, &prog->pool[parts[i].value], parts[i].length, value, sizeof(value) );
+            result = length < 0 ? length : dmell_buf_append( out, value, (size_t)length );
+        }
+        else
+        {
+            result = dmell_buf_append( out, &prog->pool[parts[i].value], parts[i].length );
+        }
+    }
+    if( result < 0 )
+    {
+        DMOD_LOG_ERROR("Failed to expand script line %u\n", (unsigned)instr->line);
+    }
+    return result;
+}
+
+/**
+ * @brief Helper function to expand and run a segment that references variables.
+ *
+ * @param prog Program that is running
+ * @param instr Instruction of the segment
+ * @param ctx Script execution context
+ * @return int Exit code of the command
+ */
+static int run_expanded_segment( dmell_prog_t* prog, const dmell_prog_instr_t* instr, dmell_script_ctx_t* ctx )
+{
+    dmell_buf_t cmd;
+    dmell_script_take_scratch( ctx, &cmd );
+    int result = expand_segment( prog, instr, ctx, &cmd );
+    if( result < 0 )
+    {
+        dmell_script_give_scratch( ctx, &cmd );
+        return result;
+    }
+
+    int exit_code = 0;
+    if( dmell_skip_whitespaces( cmd.data, cmd.data + cmd.length ) < cmd.data + cmd.length )
+    {
+        exit_code = dmell_run_command_string( cmd.data, cmd.length );
+    }
+    dmell_script_give_scratch( ctx, &cmd );
+    return exit_code;
+}
+
+/**
+ * @brief Helper function to get the separator that follows a command segment.
+ *
+ * @param prog Program that is running
+ * @param pc Index of the instruction of the segment
+ * @return dmell_line_sep_t Separator that precedes the next segment of the same line, or the one that ends the line
+ */
+static dmell_line_sep_t get_next_separator( const dmell_prog_t* prog, uint32_t pc )
+{
+    if( pc + 1 < prog->instr_count )
+    {
+        return (dmell_line_sep_t)prog->instrs[pc + 1].sep;
+    }
+    return dmell_line_sep_none;
+}
+
+/**
+ * @brief Helper function to run a command segment.
+ *
+ * @param prog Program that is running
+ * @param pc Index of the instruction of the segment
+ * @param ctx Script execution context
+ * @param state State of the program
+ */
+static void run_cmd( dmell_prog_t* prog, uint32_t pc, dmell_script_ctx_t* ctx, run_state_t* state )
+{
+    const dmell_prog_instr_t* instr = &prog->instrs[pc];
+    dmell_line_sep_t sep = (dmell_line_sep_t)instr->sep;
+    if( !dmell_line_pipeline_should_execute( &state->pipeline, state->last_exit_code, sep ) )
+    {
+        return;
+    }
+
+    dmell_line_sep_t next_sep = get_next_separator( prog, pc );
+    int exit_code = 0;
+    dmell_line_pipeline_begin( &state->pipeline, sep, next_sep );
+    if( instr->argc > 0 )
+    {
+        char** argv = &prog->argv_table[instr->first];
+        exit_code = dmell_run_command( argv[0], instr->argc, argv );
+    }
+    else
+    {
+        exit_code = run_expanded_segment( prog, instr, ctx );
+    }
+    exit_code = dmell_line_pipeline_end( &state->pipeline, sep, next_sep, exit_code );
+    state->line_result = dmell_line_join_results( state->last_exit_code, exit_code, sep );
+    state->last_exit_code = exit_code;
+    state->line_pending = true;
+}
+
+/**
+ * @brief Helper function to publish the exit code of the commands that ran since the last check.
+ *
+ * @param ctx Script execution context
+ * @param state State of the program
+ * @param line Line number used in the error message
+ * @return int 0 on success, or the negative exit code that stops the program
+ */
+static int publish_line( dmell_script_ctx_t* ctx, run_state_t* state, uint32_t line )
+{
+    if( !state->line_pending )
+    {
+        return 0;
+    }
+
+    int line_result = state->line_result;
+    dmell_script_set_exit_code( ctx, line_result );
+    state->last_exit_code = 0;
+    state->line_result = 0;
+    state->line_pending = false;
+    if( line_result < 0 )
+    {
+        DMOD_LOG_ERROR("Error executing line %u of the script\n", (unsigned)line);
+        return line_result;
+    }
+    return 0;
+}
+
+/**
+ * @brief Helper function to check the condition of a block.
+ *
+ * A failed command, also one that could not run, makes the condition false.
+ *
+ * @param ctx Script execution context
+ * @param state State of the program
+ * @return true If the condition is true
+ * @return false Otherwise
+ */
+static bool check_condition( dmell_script_ctx_t* ctx, run_state_t* state )
+{
+    int exit_code = state->line_pending ? state->line_result : ctx->last_exit_code;
+    dmell_script_set_exit_code( ctx, exit_code );
+    state->last_exit_code = 0;
+    state->line_result = 0;
+    state->line_pending = false;
+    return exit_code == 0;
+}
+
+/**
+ * @brief Helper function to start a 'for' loop.
+ *
+ * @param prog Program that is running
+ * @param instr Instruction with the words of the loop
+ * @param ctx Script execution context
+ * @param loop State of the loop
+ * @return int 0 on success, negative value on error
+ */
+static int start_loop( dmell_prog_t* prog, const dmell_prog_instr_t* instr, dmell_script_ctx_t* ctx, loop_state_t* loop )
+{
+    dmell_free_argv( &loop->parsed );
+    memset( loop, 0, sizeof(*loop) );
+    if( instr->argc > 0 )
+    {
+        loop->words = &prog->argv_table[instr->first];
+        loop->count = instr->argc;
+        return 0;
+    }
+    if( instr->count == 0 )
+    {
+        return 0;
+    }
+
+    dmell_buf_t words;
+    dmell_script_take_scratch( ctx, &words );
+    int result = expand_segment( prog, instr, ctx, &words );
+    if( result == 0 && dmell_skip_whitespaces( words.data, words.data + words.length ) < words.data + words.length )
+    {
+        result = dmell_parse_command( words.data, words.length, &loop->parsed );
+        loop->words = loop->parsed.argv;
+        loop->count = ( result == 0 ) ? loop->parsed.argc : 0;
+    }
+    dmell_script_give_scratch( ctx, &words );
+    return result;
+}
+
+/**
+ * @brief Helper function to leave a function.
+ *
+ * The exit code of the function is the argument of 'return', or the exit
+ * code of the last command when there is no argument.
+ *
+ * @param prog Program that is running
+ * @param instr Instruction of the 'return' segment
+ * @param ctx Script execution context
+ * @param state State of the program
+ * @return int 0 on success, negative value on error
+ */
+static int run_return( dmell_prog_t* prog, const dmell_prog_instr_t* instr, dmell_script_ctx_t* ctx, run_state_t* state )
+{
+    int exit_code = state->line_pending ? state->line_result : ctx->last_exit_code;
+    const char* value = NULL;
+    dmell_buf_t text;
+    dmell_script_take_scratch( ctx, &text );
+    int result = 0;
+    if( instr->argc > 0 )
+    {
+        value = prog->argv_table[instr->first];
+    }
+    else if( instr->count > 0 )
+    {
+        result = expand_segment( prog, instr, ctx, &text );
+        result = ( result == 0 ) ? dmell_buf_append( &text, "", 1 ) : result;
+        value = ( result == 0 ) ? dmell_skip_whitespaces( text.data, text.data + text.length - 1 ) : NULL;
+    }
+
+    if( value != NULL && *value != '\0' )
+    {
+        char* end_ptr = NULL;
+        long code = strtol( value, &end_ptr, 10 );
+        end_ptr = (char*)dmell_skip_whitespaces( end_ptr, end_ptr + strlen( end_ptr ) );
+        if( *end_ptr != '\0' )
+        {
+            DMOD_LOG_ERROR("Invalid exit code '%s' in line %u of the script\n", value, (unsigned)instr->line);
+            result = -EINVAL;
+        }
+        exit_code = (int)code;
+    }
+    dmell_script_give_scratch( ctx, &text );
+
+    dmell_script_set_exit_code( ctx, result < 0 ? result : exit_code );
+    state->last_exit_code = 0;
+    state->line_result = 0;
+    state->line_pending = false;
+    return result;
+}
+
+/**
+ * @brief Runs a compiled program in the given script context.
+ *
+ * @param prog Program to run
+ * @param ctx Script execution context
+ * @return int 0 on success, or the negative exit code of the line that stopped the program
+ */
+int dmell_prog_run( dmell_prog_t* prog, dmell_script_ctx_t* ctx )
+{
+    if( prog == NULL || ctx == NULL )
+    {
+        DMOD_LOG_ERROR("Invalid arguments to dmell_prog_run: %p, %p\n", prog, ctx);
+        return -EINVAL;
+    }
+
+    run_state_t state = { 0 };
+    if( prog->loop_count > 0 )
+    {
+        state.loops = Dmod_Malloc( sizeof(loop_state_t) * prog->loop_count );
+        if( state.loops == NULL )
+        {
+            DMOD_LOG_ERROR("Memory allocation failed in dmell_prog_run\n");
+            return -ENOMEM;
+        }
+        memset( state.loops, 0, sizeof(loop_state_t) * prog->loop_count );
+    }
+
+    dmell_prog_retain( prog );
+    dmell_script_ctx_t* previous_ctx = dmell_script_set_current( ctx );
+
+    int result = 0;
+    uint32_t pc = 0;
+    while( pc < prog->instr_count && result == 0 )
+    {
+        const dmell_prog_instr_t* instr = &prog->instrs[pc];
+        uint32_t next_pc = pc + 1;
+        switch( instr->op )
+        {
+            case dmell_prog_op_cmd:
+                run_cmd( prog, pc, ctx, &state );
+                break;
+            case dmell_prog_op_status:
+                result = publish_line( ctx, &state, instr->line );
+                break;
+            case dmell_prog_op_jump:
+                // 'break' and 'continue' can follow '&&' or '||'
+                if( dmell_line_should_execute( state.last_exit_code, (dmell_line_sep_t)instr->sep ) )
+                {
+                    result = publish_line( ctx, &state, instr->line );
+                    next_pc = instr->first;
+                }
+                break;
+            case dmell_prog_op_jump_false:
+                if( !check_condition( ctx, &state ) )
+                {
+                    next_pc = instr->first;
+                }
+                break;
+            case dmell_prog_op_for_init:
+                result = start_loop( prog, instr, ctx, &state.loops[prog->instrs[pc + 1].argc] );
+                break;
+            case dmell_prog_op_for_next:
+            {
+                loop_state_t* loop = &state.loops[instr->argc];
+                if( loop->index < loop->count )
+                {
+                    const char* name = &prog->pool[prog->slots[instr->first].name];
+                    result = dmell_set_variable( &ctx->variables, name, loop->words[loop->index++] );
+                }
+                else
+                {
+                    next_pc = instr->count;
+                }
+                break;
+            }
+            case dmell_prog_op_define:
+                result = dmell_func_define( &prog->pool[instr->count], prog->funcs[instr->first] );
+                break;
+            case dmell_prog_op_return:
+                if( dmell_line_should_execute( state.last_exit_code, (dmell_line_sep_t)instr->sep ) )
+                {
+                    result = run_return( prog, instr, ctx, &state );
+                    next_pc = prog->instr_count;
+                }
+                break;
+            default:
+                break;
+        }
+        pc = next_pc;
+    }
+
+    for( uint32_t i = 0; i < prog->loop_count; i++ )
+    {
+        dmell_free_argv( &state.loops[i].parsed );
+    }
+    Dmod_Free( state.loops );
+    dmell_line_pipeline_free( &state.pipeline );
+    dmell_script_set_current( previous_ctx );
+    dmell_prog_release( prog );
+    return result;
+}
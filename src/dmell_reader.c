@@ -0,0 +1,229 @@
+#include <errno.h>
+#include <string.h>
+#include "dmell_reader.h"
+#include "dmod.h"
+
+/**
+ * @brief Helper function to load a small file with a single read.
+ *
+ * Larger files, and files whose size is not known, are read in chunks.
+ *
+ * @param reader Reader that was just opened
+ * @return int 0 on success, negative value on error
+ */
+static int read_whole_file( dmell_reader_t* reader )
+{
+    size_t size = Dmod_FileSize( reader->file );
+    if( size == 0 || size > DMELL_READER_WHOLE_FILE_MAX )
+    {
+        return 0;
+    }
+
+    int result = dmell_buf_reserve( &reader->buffer, size );
+    if( result < 0 )
+    {
+        Dmod_FileClose( reader->file );
+        reader->file = NULL;
+        return result;
+    }
+    size_t count = Dmod_FileRead( reader->buffer.data, 1, size, reader->file );
+    reader->buffer.length = count;
+    reader->buffer.data[count] = '\0';
+
+    // A short read falls back to reading chunks
+    reader->eof = ( count == size );
+    return 0;
+}
+
+/**
+ * @brief Opens a script file for reading.
+ *
+ * @param reader Reader to open
+ * @param path Path of the file
+ * @return int 0 on success, negative value on error
+ */
+int dmell_reader_open( dmell_reader_t* reader, const char* path )
+{
+    if( reader == NULL || path == NULL )
+    {
+        DMOD_LOG_ERROR("Invalid arguments to dmell_reader_open: %p, %p\n", reader, path);
+        return -EINVAL;
+    }
+
+    memset( reader, 0, sizeof(*reader) );
+    reader->file = Dmod_FileOpen( path, "r" );
+    if( reader->file == NULL )
+    {
+        DMOD_LOG_ERROR("Failed to open script file: %s\n", path);
+        return -ENOENT;
+    }
+    reader->next_line = 1;
+    return read_whole_file( reader );
+}
+
+/**
+ * @brief Helper function to read the next chunk of the file.
+ *
+ * The consumed lines are dropped from the buffer first, so the buffer only
+ * grows when a single line is longer than what is left in it.
+ *
+ * @param reader Reader to use
+ * @param out Offset of the end of the current line, moved with the data
+ * @param scan Offset of the first byte that was not scanned yet, moved with the data
+ * @return int 0 on success, negative value on error
+ */
+static int read_chunk( dmell_reader_t* reader, size_t* out, size_t* scan )
+{
+    dmell_buf_t* buf = &reader->buffer;
+    if( buf->data != NULL )
+    {
+        // Close the gap left by the removed line continuations
+        size_t unscanned = buf->length - *scan;
+        memmove( &buf->data[*out], &buf->data[*scan], unscanned );
+        buf->length = *out + unscanned;
+        *scan = *out;
+    }
+
+    if( reader->start > 0 )
+    {
+        memmove( buf->data, &buf->data[reader->start], buf->length - reader->start );
+        buf->length -= reader->start;
+        *out -= reader->start;
+        *scan -= reader->start;
+        reader->start = 0;
+    }
+
+    int result = dmell_buf_reserve( buf, DMELL_READER_CHUNK_SIZE );
+    if( result < 0 )
+    {
+        return result;
+    }
+    size_t count = Dmod_FileRead( &buf->data[buf->length], 1, DMELL_READER_CHUNK_SIZE, reader->file );
+    buf->length += count;
+    buf->data[buf->length] = '\0';
+    reader->eof = ( count == 0 );
+    return 0;
+}
+
+/**
+ * @brief Helper function to check if a backslash is escaped by the backslashes before it.
+ *
+ * @param data Data of the line
+ * @param start Offset of the start of the line
+ * @param pos Offset of the backslash
+ * @return true If an odd number of backslashes is before it
+ * @return false Otherwise
+ */
+static bool is_escaped( const char* data, size_t start, size_t pos )
+{
+    size_t count = 0;
+    while( pos > start && data[pos - 1] == '\\' )
+    {
+        count++;
+        pos--;
+    }
+    return ( count % 2 ) != 0;
+}
+
+/**
+ * @brief Reads the next line of the script.
+ *
+ * A backslash at the end of a line joins it with the next one. The line
+ * is returned without the line break and stays valid until the next call.
+ *
+ * @param reader Reader to use
+ * @param out_line Output parameter to hold the null terminated line
+ * @param out_len Output parameter to hold the length of the line
+ * @return int 1 if a line was read, 0 at the end of the file, negative value on error
+ */
+int dmell_reader_next_line( dmell_reader_t* reader, const char** out_line, size_t* out_len )
+{
+    if( reader == NULL || reader->file == NULL || out_line == NULL || out_len == NULL )
+    {
+        DMOD_LOG_ERROR("Invalid arguments to dmell_reader_next_line: %p\n", reader);
+        return -EINVAL;
+    }
+
+    dmell_buf_t* buf = &reader->buffer;
+    size_t out = reader->start;
+    size_t scan = reader->start;
+    uint32_t joined = 0;
+    bool found = false;
+    while( !found )
+    {
+        while( scan < buf->length )
+        {
+            char c = buf->data[scan];
+            if( c == '\n' )
+            {
+                found = true;
+                break;
+            }
+            if( c == '\\' && !is_escaped( buf->data, reader->start, out ) )
+            {
+                size_t next = scan + 1;
+                next += ( next < buf->length && buf->data[next] == '\r' ) ? 1 : 0;
+                if( next >= buf->length && !reader->eof )
+                {
+                    // The line break can be in the next chunk
+                    break;
+                }
+                if( next < buf->length && buf->data[next] == '\n' )
+                {
+                    scan = next + 1;
+                    joined++;
+                    continue;
+                }
+            }
+            buf->data[out++] = buf->data[scan++];
+        }
+
+        if( found || reader->eof )
+        {
+            break;
+        }
+        int result = read_chunk( reader, &out, &scan );
+        if( result < 0 )
+        {
+            return result;
+        }
+    }
+
+    if( !found && out == reader->start && joined == 0 )
+    {
+        return 0;
+    }
+
+    size_t line_start = reader->start;
+    if( out > line_start && buf->data[out - 1] == '\r' )
+    {
+        out--;
+    }
+    buf->data[out] = '\0';
+    reader->start = found ? scan + 1 : buf->length;
+    reader->line = reader->next_line;
+    reader->next_line += joined + 1;
+    *out_line = &buf->data[line_start];
+    *out_len = out - line_start;
+    return 1;
+}
+
+/**
+ * @brief Closes the file and frees the buffer of the reader.
+ *
+ * @param reader Reader to close
+ */
+void dmell_reader_close( dmell_reader_t* reader )
+{
+    if( reader == NULL )
+    {
+        return;
+    }
+
+    if( reader->file != NULL )
+    {
+        Dmod_FileClose( reader->file );
+    }
+    dmell_buf_free( &reader->buffer );
+    memset( reader, 0, sizeof(*reader) );
+}
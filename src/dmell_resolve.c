@@ -0,0 +1,219 @@
+#include <errno.h>
+#include <string.h>
+#include <stdbool.h>
+#include "dmell_resolve.h"
+#include "dmell_hlp.h"
+#include "dmod.h"
+
+/**
+ * @brief Maximum length of a resolved path.
+ */
+#define DMELL_RESOLVE_MAX_PATH  256
+
+/**
+ * @brief Resolution cache (direct mapped by the hash of the command name).
+ */
+static dmell_resolve_t g_resolve_cache[DMELL_RESOLVE_CACHE_SIZE];
+
+/**
+ * @brief Helper function to read the shebang line and extract the interpreter.
+ * 
+ * @param file_name Name of the script file
+ * @param buffer Buffer to store the interpreter path
+ * @param buffer_size Size of the buffer
+ * @return bool True if shebang found and interpreter extracted, false otherwise
+ */
+static bool get_shebang_interpreter(const char* file_name, char* buffer, size_t buffer_size)
+{
+    void* file = Dmod_FileOpen(file_name, "r");
+    if(file == NULL)
+    {
+        return false;
+    }
+
+    char mark[3] = {0};
+    size_t read_bytes = Dmod_FileRead(mark, 1, 2, file);
+    if(read_bytes < 2 || mark[0] != '#' || mark[1] != '!')
+    {
+        Dmod_FileClose(file);
+        return false;
+    }
+
+    read_bytes = Dmod_FileRead(buffer, 1, buffer_size - 1, file);
+    Dmod_FileClose(file);
+    buffer[read_bytes] = '\0';
+
+    // The interpreter is the first word of the shebang line
+    const char* start = dmell_skip_whitespaces(buffer, buffer + read_bytes);
+    size_t len = 0;
+    while(start[len] != '\0' && start[len] != ' ' && start[len] != '\t' && start[len] != '\r' && start[len] != '\n')
+    {
+        len++;
+    }
+    memmove(buffer, start, len);
+    buffer[len] = '\0';
+    return len > 0;
+}
+
+/**
+ * @brief Helper function to check if a file is a dmell script based on its extension.
+ * 
+ * @param file_name Name of the file
+ * @return bool True if it is a dmell script, false otherwise
+ */
+static bool is_dmell_script(const char* file_name)
+{
+    size_t len = strlen(file_name);
+    return (len > 4 && strcmp(&file_name[len - 4], ".dme") == 0);
+}
+
+/**
+ * @brief Helper function to free a cache entry.
+ * 
+ * @param entry Entry to free
+ */
+static void free_entry( dmell_resolve_t* entry )
+{
+    // The target is stored in the same allocation as the name
+    Dmod_Free( entry->name );
+    entry->name = NULL;
+    entry->target = NULL;
+    entry->kind = dmell_resolve_not_found;
+}
+
+/**
+ * @brief Helper function to store a resolution in a cache entry.
+ * 
+ * @param entry Entry to fill
+ * @param name Command name
+ * @param hash Hash of the command name
+ * @param kind Kind of the resolution
+ * @param target [optional] Target of the resolution
+ * @return int 0 on success, negative value on error
+ */
+static int set_entry( dmell_resolve_t* entry, const char* name, uint32_t hash, dmell_resolve_kind_t kind, const char* target )
+{
+    size_t name_size = strlen( name ) + 1;
+    size_t target_size = ( target != NULL ) ? strlen( target ) + 1 : 0;
+    char* data = Dmod_Malloc( name_size + target_size );
+    if( data == NULL )
+    {
+        DMOD_LOG_ERROR("Memory allocation failed while caching the resolution of %s\n", name);
+        return -ENOMEM;
+    }
+
+    free_entry( entry );
+    memcpy( data, name, name_size );
+    if( target != NULL )
+    {
+        memcpy( &data[name_size], target, target_size );
+    }
+    entry->name = data;
+    entry->target = ( target != NULL ) ? &data[name_size] : NULL;
+    entry->hash = hash;
+    entry->kind = kind;
+    return 0;
+}
+
+/**
+ * @brief Helper function to resolve a command name without the cache.
+ * 
+ * @param name Command name
+ * @param path Buffer for the resolved path or interpreter
+ * @param path_size Size of the buffer
+ * @return dmell_resolve_kind_t Kind of the resolution
+ */
+static dmell_resolve_kind_t resolve( const char* name, char* path, size_t path_size )
+{
+    if( Dmod_FileAvailable( name ) )
+    {
+        // A .dme script runs in the shell even if it has a shebang
+        if( !is_dmell_script( name ) && get_shebang_interpreter( name, path, path_size ) )
+        {
+            return dmell_resolve_shebang;
+        }
+        strncpy( path, name, path_size - 1 );
+        path[path_size - 1] = '\0';
+        return is_dmell_script( name ) ? dmell_resolve_script : dmell_resolve_file;
+    }
+    if( Dmod_FindModuleFile( name, NULL, path, path_size ) )
+    {
+        return dmell_resolve_module;
+    }
+    return dmell_resolve_not_found;
+}
+
+/**
+ * @brief Resolves an external command name.
+ * 
+ * The result is taken from the cache when possible, otherwise the command
+ * is resolved and the result is cached. Commands that were not found are
+ * resolved again on every call.
+ * 
+ * @param name Command name
+ * @return const dmell_resolve_t* Resolution of the command (valid until the next call), or NULL on error
+ */
+const dmell_resolve_t* dmell_resolve_command( const char* name )
+{
+    if( name == NULL )
+    {
+        DMOD_LOG_ERROR("Invalid command name passed to dmell_resolve_command\n");
+        return NULL;
+    }
+
+    uint32_t hash = dmell_hash_name( name, strlen( name ) );
+    dmell_resolve_t* entry = &g_resolve_cache[hash & ( DMELL_RESOLVE_CACHE_SIZE - 1 )];
+    // A command that was not found is checked again, because its file may have been added since
+    if( entry->name != NULL && entry->hash == hash && strcmp( entry->name, name ) == 0 &&
+        entry->kind != dmell_resolve_not_found )
+    {
+        return entry;
+    }
+
+    char path[DMELL_RESOLVE_MAX_PATH] = {0};
+    dmell_resolve_kind_t kind = resolve( name, path, sizeof(path) );
+    bool has_target = ( kind != dmell_resolve_not_found );
+    if( set_entry( entry, name, hash, kind, has_target ? path : NULL ) < 0 )
+    {
+        return NULL;
+    }
+    return entry;
+}
+
+/**
+ * @brief Removes all cached resolutions.
+ * 
+ * Has to be called when the result of a resolution may change, e.g. when
+ * the working directory changes or modules are loaded or unloaded.
+ */
+void dmell_resolve_invalidate( void )
+{
+    for( size_t i = 0; i < DMELL_RESOLVE_CACHE_SIZE; i++ )
+    {
+        free_entry( &g_resolve_cache[i] );
+    }
+}
+
+/**
+ * @brief Iterates over the cached resolutions.
+ * 
+ * @param iterator Iteration state, has to be set to 0 before the first call
+ * @return const dmell_resolve_t* Next cached resolution, or NULL if there are no more entries
+ */
+const dmell_resolve_t* dmell_resolve_next( size_t* iterator )
+{
+    if( iterator == NULL )
+    {
+        return NULL;
+    }
+
+    while( *iterator < DMELL_RESOLVE_CACHE_SIZE )
+    {
+        const dmell_resolve_t* entry = &g_resolve_cache[(*iterator)++];
+        if( entry->name != NULL )
+        {
+            return entry;
+        }
+    }
+    return NULL;
+}
@@ -1,38 +1,163 @@
 #include <errno.h>
 #include <string.h>
 #include "dmell_script.h"
+#include "dmell_prog.h"
+#include "dmell_reader.h"
+#include "dmell_cache.h"
 #include "dmod.h"
 #include "dmell_hlp.h"
+#include "dmell_io.h"
 
 dmell_script_ctx_t g_dmell_global_script_ctx = {
     .last_exit_code = 0,
-    .variables      = NULL
+    .variables      = { 0 },
+    .scratch        = { 0 }
 };
 
 /**
- * @brief Helper function to find the start of a comment in the script line.
+ * @brief Context of the program that is running, NULL for the global one.
+ */
+static dmell_script_ctx_t* g_current_ctx = NULL;
+
+/**
+ * @brief Sets the context of the program that is running.
+ * 
+ * Builtins that change variables, functions and nested scripts use the
+ * variables of this context.
+ * 
+ * @param ctx Script execution context, NULL for the global one
+ * @return dmell_script_ctx_t* Previous context, so the caller can restore it
+ */
+dmell_script_ctx_t* dmell_script_set_current( dmell_script_ctx_t* ctx )
+{
+    dmell_script_ctx_t* previous = g_current_ctx;
+    g_current_ctx = ctx;
+    return previous;
+}
+
+/**
+ * @brief Gets the context of the program that is running.
+ * 
+ * @return dmell_script_ctx_t* Running context, or the global one when no program runs
+ */
+dmell_script_ctx_t* dmell_script_get_current( void )
+{
+    return ( g_current_ctx != NULL ) ? g_current_ctx : &g_dmell_global_script_ctx;
+}
+
+/**
+ * @brief Stores the exit code of the last executed line in the script context and in $?.
+ * 
+ * The exit code is kept as a number, so tracking it allocates no memory.
+ * 
+ * @param ctx Script execution context
+ * @param exit_code Exit code to store
+ */
+void dmell_script_set_exit_code( dmell_script_ctx_t* ctx, int exit_code )
+{
+    dmell_set_status( &ctx->variables, exit_code );
+    ctx->last_exit_code = exit_code;
+}
+
+/**
+ * @brief Takes the scratch buffer of the script context for expanding a line.
+ * 
+ * The buffer is moved out of the context, so a command that runs another line
+ * in the same context while the buffer is in use gets its own buffer instead
+ * of overwriting the caller's one.
+ * 
+ * @param ctx Script execution context
+ * @param out_buf Receives the (cleared) scratch buffer
+ */
+void dmell_script_take_scratch( dmell_script_ctx_t* ctx, dmell_buf_t* out_buf )
+{
+    *out_buf = ctx->scratch;
+    ctx->scratch.data = NULL;
+    ctx->scratch.length = 0;
+    ctx->scratch.capacity = 0;
+    dmell_buf_clear( out_buf );
+}
+
+/**
+ * @brief Gives the scratch buffer back to the script context.
  * 
- * @param str Current position in the script line
- * @param end_ptr Pointer to the end of the script line
- * @return const char* Pointer to the position of the comment start, or end_ptr if none found
+ * If a nested line already returned its buffer, the larger one is kept.
+ * 
+ * @param ctx Script execution context
+ * @param buf Buffer taken with dmell_script_take_scratch
  */
-static const char* find_comment_start( const char* str, const char* end_ptr )
+void dmell_script_give_scratch( dmell_script_ctx_t* ctx, dmell_buf_t* buf )
 {
-    const char* ptr = str;
-    while( ptr < end_ptr )
+    if( buf->capacity > ctx->scratch.capacity )
     {
-        if( *ptr == '#' )
-        {
-            return ptr;
-        }
-        ptr++;
+        dmell_buf_t tmp = ctx->scratch;
+        ctx->scratch = *buf;
+        *buf = tmp;
+    }
+    dmell_buf_free( buf );
+}
+
+/**
+ * @brief Runs the command of a command substitution and captures its output.
+ * 
+ * The command is expanded with the given variables, so substitutions can be
+ * nested, and its standard output is appended to the buffer instead of
+ * being printed. Used as the substitution handler of the variable module.
+ * 
+ * @param vars Variable store used to expand the command
+ * @param cmd Command line (does not have to be null terminated)
+ * @param len Length of the command line
+ * @param out Buffer to append the output to
+ * @return int 0 on success, negative value on error
+ */
+int dmell_script_substitute( const dmell_vars_t* vars, const char* cmd, size_t len, dmell_buf_t* out )
+{
+    dmell_buf_t line = { 0 };
+    int result = dmell_expand_variables_to_buf( vars, cmd, len, &line );
+    if( result > 0 && dmell_skip_whitespaces( line.data, line.data + line.length ) < line.data + line.length )
+    {
+        dmell_io_t saved;
+        dmell_io_save( &saved );
+        dmell_io_set_output( dmell_io_buffer, out );
+        dmell_run_line( line.data, line.length );
+        dmell_io_restore( &saved );
+    }
+    dmell_buf_free( &line );
+    return result < 0 ? result : 0;
+}
+
+/**
+ * @brief Helper function to compile a line into a program and run it.
+ * 
+ * The separators of the line are found before any variable is expanded,
+ * so the line runs exactly like the same line of a script file.
+ * 
+ * @param ctx Script execution context
+ * @param line Command line string
+ * @param len Length of the command line string
+ * @return int Exit code of the last executed command, or negative value on error
+ */
+static int run_compiled_line( dmell_script_ctx_t* ctx, const char* line, size_t len )
+{
+    dmell_prog_t* prog = dmell_prog_compile( line, len );
+    if( prog == NULL )
+    {
+        dmell_script_set_exit_code( ctx, -EINVAL );
+        return -EINVAL;
     }
-    return end_ptr;
+
+    int result = dmell_prog_run( prog, ctx );
+    dmell_prog_release( prog );
+    return result < 0 ? result : ctx->last_exit_code;
 }
 
 /**
  * @brief Executes a line of commands in the context of a script, with variable expansion.
  * 
+ * The line is compiled like a line of a script file, so separators (';',
+ * '&&', '||', '|', '&') that come from the value of a variable are plain
+ * text and never split the line.
+ * 
  * @param ctx Script execution context
  * @param line Command line string
  * @param len Length of the command line string
@@ -56,47 +181,69 @@ int dmell_run_script_line( dmell_script_ctx_t* ctx, const char* line, size_t len
         // Line is empty or whitespace only
         return 0;
     }
-    const char* comment_start = find_comment_start( line, end_ptr );
+    const char* comment_start = dmell_find_comment_start( line, end_ptr );
     size_t effective_len = comment_start - line;
     if( effective_len == 0 )
     {
         // Line is empty or a comment
         return 0;
     }
-    int required_size = dmell_expand_variables( ctx->variables, line, effective_len, NULL, 0 );
-    if( required_size < 0 )
+    return run_compiled_line( ctx, line, effective_len );
+}
+
+/**
+ * @brief Helper function to compile the lines of a script file.
+ *
+ * @param reader Opened reader of the script file
+ * @param file_path Path to the script file
+ * @param out_prog Output parameter to hold the finished program
+ * @return int 0 on success, negative value on error
+ */
+static int compile_script_file( dmell_reader_t* reader, const char* file_path, dmell_prog_t** out_prog )
+{
+    dmell_prog_t* prog = dmell_prog_create();
+    if( prog == NULL )
     {
-        DMOD_LOG_ERROR("Failed to calculate required size for variable expansion in dmell_run_script_line\n");
-        return required_size;
+        DMOD_LOG_ERROR("Memory allocation failed in dmell_run_script_file\n");
+        return -ENOMEM;
     }
 
-    char* expanded_line = Dmod_Malloc( required_size + 1 );
-    if( expanded_line == NULL )
+    int result = 0;
+    const char* line = NULL;
+    size_t len = 0;
+    while( result == 0 && ( result = dmell_reader_next_line( reader, &line, &len ) ) > 0 )
     {
-        DMOD_LOG_ERROR("Memory allocation failed in dmell_run_script_line for expanded line\n");
-        return -ENOMEM; 
+        // Lines joined with '\' keep the numbers of the file lines in error messages
+        prog->line_count = reader->line - 1;
+        result = dmell_prog_add_line( prog, line, len );
     }
 
-    if(dmell_expand_variables( ctx->variables, line, effective_len, expanded_line, required_size + 1 ) < 0 )
+    if( result == 0 )
     {
-        DMOD_LOG_ERROR("Failed to expand variables in dmell_run_script_line\n");
-        Dmod_Free( expanded_line );
-        return -EINVAL;
+        result = dmell_prog_finish( prog );
     }
-    int exit_code = dmell_run_line( expanded_line, effective_len );
-    Dmod_Free( expanded_line );
-    
-    char code_str[12];
-    Dmod_SnPrintf( code_str, sizeof(code_str), "%d", exit_code );
-    ctx->variables      = dmell_set_variable( ctx->variables, "?", code_str );
-    ctx->last_exit_code = exit_code;
-
-    return exit_code;
+    if( result < 0 )
+    {
+        DMOD_LOG_ERROR("Failed to compile script file %s\n", file_path);
+        dmell_prog_release( prog );
+        return result;
+    }
+    *out_prog = prog;
+    return 0;
 }
 
 /**
  * @brief Executes a script file with given arguments.
  * 
+ * The whole file is compiled into a program first and then the program is
+ * executed, so each line is parsed only once. The program of a script that
+ * is loaded whole is kept in a cache file, and later runs of the same
+ * content load it instead of compiling the text again.
+ * 
+ * The script runs in a new scope: the arguments are its positional
+ * parameters, and the variables it sets are released when it ends. The
+ * variables of the caller stay visible to it.
+ * 
  * @param file_path Path to the script file
  * @param argc Number of arguments
  * @param argv Array of argument strings
@@ -110,36 +257,66 @@ int dmell_run_script_file(const char* file_path, int argc, char** argv)
         return -EINVAL;
     }
 
-    void* file = Dmod_FileOpen( file_path, "r" );
-    if( file == NULL )
+    dmell_reader_t reader;
+    int result = dmell_reader_open( &reader, file_path );
+    if( result < 0 )
     {
-        DMOD_LOG_ERROR("Failed to open script file: %s\n", file_path);
-        return -ENOENT;
+        return result;
     }
 
-    size_t line_len = 0;
-    char* line = Dmod_Malloc( DMELL_MAX_SCRIPT_LINE_LENGTH );
-    if (line == NULL )
+    // Only a file that is already in memory can be hashed without reading it twice
+    char* cache_path = reader.eof ? dmell_cache_get_path( file_path ) : NULL;
+    uint32_t source_size = (uint32_t)reader.buffer.length;
+    uint32_t source_hash = ( cache_path != NULL ) ? dmell_hash_name( reader.buffer.data, reader.buffer.length ) : 0;
+    dmell_prog_t* prog = dmell_cache_load( cache_path, source_size, source_hash );
+    if( prog == NULL )
     {
-        DMOD_LOG_ERROR("Memory allocation failed in dmell_run_script_file for line buffer\n");
-        Dmod_FileClose( file );
-        return -ENOMEM;
+        result = compile_script_file( &reader, file_path, &prog );
+        if( result == 0 && cache_path != NULL )
+        {
+            // The script still runs when the cache cannot be written
+            dmell_cache_store( cache_path, prog, source_size, source_hash );
+        }
+    }
+    dmell_reader_close( &reader );
+    Dmod_Free( cache_path );
+    if( result < 0 )
+    {
+        return result;
     }
-    
-    int line_number = 0;
-    while( Dmod_FileReadLine( line, DMELL_MAX_SCRIPT_LINE_LENGTH, file ) != NULL )
+
+    // The script runs in its own scope, with the arguments as positional parameters
+    dmell_script_ctx_t* caller = dmell_script_get_current();
+    dmell_script_ctx_t scope = {
+        .last_exit_code = 0,
+        .variables      = { .parent = &caller->variables, .is_scope = true },
+        .scratch        = { 0 }
+    };
+
+    // The parameters live in the arena of the scope, so their number is not limited by the stack
+    if( argc > 0 )
     {
-        line_number++;
-        line_len = strlen( line );
-        int exit_code = dmell_run_script_line( &g_dmell_global_script_ctx, line, line_len );
-        if( exit_code < 0 )
+        scope.variables.params = dmell_vars_alloc( &scope.variables, sizeof(dmell_var_t) * (size_t)argc );
+        if( scope.variables.params == NULL )
         {
-            DMOD_LOG_ERROR("Error executing line %d in script file %s\n", line_number, file_path);
-            Dmod_Free( line );
-            Dmod_FileClose( file );
-            return exit_code;
+            DMOD_LOG_ERROR("Memory allocation failed for the parameters of %s\n", file_path);
+            dmell_free_variables( &scope.variables );
+            dmell_prog_release( prog );
+            return -ENOMEM;
         }
+        memset( scope.variables.params, 0, sizeof(dmell_var_t) * (size_t)argc );
+        for( int i = 0; i < argc; i++ )
+        {
+            scope.variables.params[i].value = argv[i];
+        }
+        scope.variables.param_count = (size_t)argc;
     }
+    dmell_script_take_scratch( caller, &scope.scratch );
 
-    return 0;
-}
\ No newline at end of file
+    result = dmell_prog_run( prog, &scope );
+
+    dmell_script_give_scratch( caller, &scope.scratch );
+    dmell_free_variables( &scope.variables );
+    dmell_prog_release( prog );
+    return result;
+}
@@ -2,7 +2,10 @@
 #include <errno.h>
 #include <stdbool.h>
 #include "dmell_vars.h"
+#include "dmell_buf.h"
 #include "dmell_hlp.h"
+#include "dmell_arith.h"
+#include "dmell_env.h"
 #include "dmod.h"
 
 /**
@@ -20,6 +23,18 @@ static bool is_var_name_char( char c )
              ( c == '_' ) );
 }
 
+/**
+ * @brief Helper function to check if a character is the name of a special parameter ($? or $#).
+ * 
+ * @param c Character to check
+ * @return true If the character names a special parameter
+ * @return false Otherwise
+ */
+static bool is_special_char( char c )
+{
+    return ( c == '?' || c == '#' );
+}
+
 /**
  * @brief Helper function to check if the string at the current position represents a variable.
  * 
@@ -42,7 +57,7 @@ static bool is_var( const char* str, const char* end_ptr )
     }
 
     char c = *str;
-    return ( c == '{' || is_var_name_char( c ) );
+    return ( c == '{' || is_var_name_char( c ) || is_special_char( c ) );
 }
 
 /**
@@ -79,6 +94,10 @@ static const char* get_var_end( const char* str, const char* end_ptr )
         }
         return ptr;
     }
+    else if( is_special_char( *ptr ) )
+    {
+        return ptr + 1;
+    }
     else
     {
         while( ptr < end_ptr && is_var_name_char( *ptr ) )
@@ -150,256 +169,1140 @@ static const char* find_next_var( const char* str, const char* end_ptr )
 }
 
 /**
- * @brief Adds a new variable to the list.
+ * @brief Helper function to get the bounds of a command substitution.
+ * 
+ * Handles "$(command)", with nested parentheses, and "`command`".
+ * 
+ * @param str Current position in the string
+ * @param end_ptr Pointer to the end of the string
+ * @param out_cmd Output parameter to hold the start of the command
+ * @param out_cmd_len Output parameter to hold the length of the command
+ * @return const char* Pointer to the position after the substitution, or NULL if there is no complete substitution
+ */
+static const char* get_substitution_end( const char* str, const char* end_ptr, const char** out_cmd, size_t* out_cmd_len )
+{
+    const char* ptr = NULL;
+    if( str + 1 < end_ptr && str[0] == '$' && str[1] == '(' )
+    {
+        int depth = 1;
+        for( ptr = str + 2; ptr < end_ptr; ptr++ )
+        {
+            if( *ptr == '(' )
+            {
+                depth++;
+            }
+            else if( *ptr == ')' && --depth == 0 )
+            {
+                break;
+            }
+        }
+        *out_cmd = str + 2;
+    }
+    else if( str < end_ptr && str[0] == '`' )
+    {
+        ptr = memchr( str + 1, '`', end_ptr - str - 1 );
+        *out_cmd = str + 1;
+    }
+
+    if( ptr == NULL || ptr >= end_ptr )
+    {
+        return NULL;
+    }
+    *out_cmd_len = ptr - *out_cmd;
+    return ptr + 1;
+}
+
+/**
+ * @brief Finds the next variable reference or command substitution in the string.
+ * 
+ * @param str Current position in the string
+ * @param end_ptr Pointer to the end of the string
+ * @param out_is_cmd Output parameter set to true for a command substitution
+ * @param out_name Output parameter to hold the start of the variable name, or of the command
+ * @param out_name_len Output parameter to hold the length of the variable name, or of the command
+ * @param out_ref_end Output parameter to hold the position after the reference
+ * @return const char* Pointer to the start of the next reference, or end_ptr if none found
+ */
+const char* dmell_find_next_reference( const char* str, const char* end_ptr, bool* out_is_cmd, const char** out_name, size_t* out_name_len, const char** out_ref_end )
+{
+    for( const char* ptr = str; ptr < end_ptr; ptr++ )
+    {
+        const char* ref_end = get_substitution_end( ptr, end_ptr, out_name, out_name_len );
+        if( ref_end != NULL )
+        {
+            *out_is_cmd = true;
+            *out_ref_end = ref_end;
+            return ptr;
+        }
+        if( is_var( ptr, end_ptr ) )
+        {
+            *out_is_cmd = false;
+            return dmell_find_next_variable( ptr, end_ptr, out_name, out_name_len, out_ref_end );
+        }
+    }
+    return end_ptr;
+}
+
+/**
+ * @brief Finds the next variable reference in the string.
  * 
- * @param head Pointer to the head of the variable list
+ * @param str Current position in the string
+ * @param end_ptr Pointer to the end of the string
+ * @param out_name [optional] Output parameter to hold the start of the variable name
+ * @param out_name_len [optional] Output parameter to hold the length of the variable name
+ * @param out_ref_end [optional] Output parameter to hold the position after the reference
+ * @return const char* Pointer to the '$' of the next reference, or end_ptr if none found
+ */
+const char* dmell_find_next_variable( const char* str, const char* end_ptr, const char** out_name, size_t* out_name_len, const char** out_ref_end )
+{
+    const char* var_start = find_next_var( str, end_ptr );
+    if( var_start >= end_ptr )
+    {
+        return end_ptr;
+    }
+
+    size_t name_len = 0;
+    const char* name = get_var_name( var_start, end_ptr, &name_len );
+    if( out_name != NULL )
+    {
+        *out_name = name;
+    }
+    if( out_name_len != NULL )
+    {
+        *out_name_len = ( name != NULL ) ? name_len : 0;
+    }
+    if( out_ref_end != NULL )
+    {
+        *out_ref_end = get_var_end( var_start, end_ptr );
+    }
+    return var_start;
+}
+
+/**
+ * @brief Minimum number of slots in the hash table of a variable store.
+ */
+#define DMELL_VARS_MIN_CAPACITY     16
+
+/**
+ * @brief Marker of a slot whose variable was removed.
+ */
+static dmell_var_t g_removed_slot;
+
+/**
+ * @brief Helper function to find the slot of a variable in the hash table.
+ * 
+ * @param vars Variable store
+ * @param name Name of the variable (does not have to be null terminated)
+ * @param name_len Length of the name
+ * @param hash Hash of the name
+ * @param out_free [optional] Output parameter to hold the first slot that can be used to insert the variable
+ * @return dmell_var_t** Slot of the variable, or NULL if not found
+ */
+static dmell_var_t** find_slot( const dmell_vars_t* vars, const char* name, size_t name_len, uint32_t hash, dmell_var_t*** out_free )
+{
+    if( out_free != NULL )
+    {
+        *out_free = NULL;
+    }
+    if( vars->capacity == 0 )
+    {
+        return NULL;
+    }
+
+    size_t mask = vars->capacity - 1;
+    for( size_t i = hash & mask; ; i = ( i + 1 ) & mask )
+    {
+        dmell_var_t** slot = &vars->slots[i];
+        if( *slot == NULL )
+        {
+            if( out_free != NULL && *out_free == NULL )
+            {
+                *out_free = slot;
+            }
+            return NULL;
+        }
+        if( *slot == &g_removed_slot )
+        {
+            if( out_free != NULL && *out_free == NULL )
+            {
+                *out_free = slot;
+            }
+        }
+        else if( (*slot)->hash == hash && strncmp( (*slot)->name, name, name_len ) == 0 && (*slot)->name[name_len] == '\0' )
+        {
+            return slot;
+        }
+    }
+}
+
+/**
+ * @brief Helper function to rebuild the hash table with the given capacity.
+ * 
+ * Removed slots are dropped, so rebuilding also cleans up after many removals.
+ * 
+ * @param vars Variable store
+ * @param capacity New number of slots (power of 2)
+ * @return int 0 on success, negative value on error
+ */
+static int rehash( dmell_vars_t* vars, size_t capacity )
+{
+    dmell_var_t** slots = Dmod_Malloc( capacity * sizeof(dmell_var_t*) );
+    if( slots == NULL )
+    {
+        DMOD_LOG_ERROR("Memory allocation failed for %zu variable slots\n", capacity);
+        return -ENOMEM;
+    }
+    memset( slots, 0, capacity * sizeof(dmell_var_t*) );
+
+    size_t mask = capacity - 1;
+    for( dmell_var_t* var = vars->head; var != NULL; var = var->next )
+    {
+        size_t i = var->hash & mask;
+        while( slots[i] != NULL )
+        {
+            i = ( i + 1 ) & mask;
+        }
+        slots[i] = var;
+    }
+
+    Dmod_Free( vars->slots );
+    vars->slots = slots;
+    vars->capacity = capacity;
+    vars->used = vars->count;
+    return 0;
+}
+
+/**
+ * @brief Helper function to make sure that one more variable fits in the hash table.
+ * 
+ * The table is kept at most 3/4 full, counting removed slots.
+ * 
+ * @param vars Variable store
+ * @return int 0 on success, negative value on error
+ */
+static int reserve_slot( dmell_vars_t* vars )
+{
+    if( ( vars->used + 1 ) * 4 <= vars->capacity * 3 )
+    {
+        return 0;
+    }
+
+    size_t capacity = vars->capacity > 0 ? vars->capacity : DMELL_VARS_MIN_CAPACITY;
+    while( ( vars->count + 1 ) * 2 > capacity )
+    {
+        capacity *= 2;
+    }
+    return rehash( vars, capacity );
+}
+
+/**
+ * @brief Smallest block of an arena, including its header.
+ */
+#define ARENA_MIN_BLOCK         32
+/**
+ * @brief Number of size classes of an arena (blocks of ARENA_MIN_BLOCK << class bytes).
+ */
+#define ARENA_CLASS_COUNT       16
+
+/**
+ * @brief Chunk of the arena of a scope.
+ */
+typedef struct dmell_vars_chunk_s
+{
+    struct dmell_vars_chunk_s*  next;   /**< Previously filled chunk */
+    size_t                      used;   /**< Number of used bytes */
+    size_t                      size;   /**< Number of bytes after the header */
+} dmell_vars_chunk_t;
+
+/**
+ * @brief Header of a block of an arena.
+ * 
+ * A free block holds the next free block of its size class after the header.
+ */
+typedef union
+{
+    size_t      size_class;     /**< Size class of the block */
+    void*       align;          /**< Aligns the data of the block to a pointer */
+} arena_block_t;
+
+/**
+ * @brief Arena of a scope.
+ */
+struct dmell_vars_arena_s
+{
+    dmell_vars_chunk_t* chunks;                         /**< Chunks of the arena */
+    arena_block_t*      free_blocks[ARENA_CLASS_COUNT]; /**< Free blocks of every size class */
+};
+
+/**
+ * @brief Helper function to take memory for a new block from the chunks of an arena.
+ * 
+ * @param arena Arena of the scope
+ * @param size Size of the block
+ * @return void* Memory of the block, or NULL on error
+ */
+static void* arena_take( dmell_vars_arena_t* arena, size_t size )
+{
+    dmell_vars_chunk_t* chunk = arena->chunks;
+    if( chunk == NULL || chunk->size - chunk->used < size )
+    {
+        size_t chunk_size = ( size > DMELL_VARS_ARENA_CHUNK_SIZE ) ? size : DMELL_VARS_ARENA_CHUNK_SIZE;
+        chunk = Dmod_Malloc( sizeof(dmell_vars_chunk_t) + chunk_size );
+        if( chunk == NULL )
+        {
+            return NULL;
+        }
+        chunk->next = arena->chunks;
+        chunk->used = 0;
+        chunk->size = chunk_size;
+        arena->chunks = chunk;
+    }
+    void* ptr = (char*)( chunk + 1 ) + chunk->used;
+    chunk->used += size;
+    return ptr;
+}
+
+/**
+ * @brief Helper function to allocate memory for the variables of a store.
+ * 
+ * The variables of a scope are allocated from its arena, which is released
+ * as a whole when the scope ends. Blocks are rounded up to a power of 2,
+ * and a freed block is reused by the next allocation of the same size
+ * class. Other stores use the heap.
+ * 
+ * @param vars Store that owns the memory
+ * @param size Number of bytes
+ * @return void* Allocated memory, or NULL on error
+ */
+static void* alloc_storage( dmell_vars_t* vars, size_t size )
+{
+    if( !vars->is_scope )
+    {
+        return Dmod_Malloc( size );
+    }
+
+    size_t size_class = 0;
+    while( ( (size_t)ARENA_MIN_BLOCK << size_class ) - sizeof(arena_block_t) < size )
+    {
+        if( ++size_class == ARENA_CLASS_COUNT )
+        {
+            return NULL;
+        }
+    }
+
+    if( vars->arena == NULL )
+    {
+        vars->arena = Dmod_Malloc( sizeof(dmell_vars_arena_t) );
+        if( vars->arena == NULL )
+        {
+            return NULL;
+        }
+        memset( vars->arena, 0, sizeof(dmell_vars_arena_t) );
+    }
+
+    arena_block_t* block = vars->arena->free_blocks[size_class];
+    if( block != NULL )
+    {
+        vars->arena->free_blocks[size_class] = *(arena_block_t**)( block + 1 );
+    }
+    else
+    {
+        block = arena_take( vars->arena, (size_t)ARENA_MIN_BLOCK << size_class );
+        if( block == NULL )
+        {
+            return NULL;
+        }
+    }
+    block->size_class = size_class;
+    return block + 1;
+}
+
+/**
+ * @brief Helper function to free memory from alloc_storage.
+ * 
+ * A block of an arena is put on the free list of its size class, the
+ * chunks are kept until the scope ends.
+ * 
+ * @param vars Store that owns the memory
+ * @param ptr Memory to free
+ */
+static void free_storage( dmell_vars_t* vars, void* ptr )
+{
+    if( !vars->is_scope )
+    {
+        Dmod_Free( ptr );
+        return;
+    }
+
+    arena_block_t* block = (arena_block_t*)ptr - 1;
+    size_t size_class = block->size_class;
+    *(arena_block_t**)ptr = vars->arena->free_blocks[size_class];
+    vars->arena->free_blocks[size_class] = block;
+}
+
+/**
+ * @brief Allocates memory that is released together with the variables of a scope.
+ * 
+ * The memory is taken from the arena of the scope and stays valid until
+ * dmell_free_variables is called for the scope.
+ * 
+ * @param vars Variable store that is a scope
+ * @param size Number of bytes
+ * @return void* Allocated memory, or NULL on error
+ */
+void* dmell_vars_alloc( dmell_vars_t* vars, size_t size )
+{
+    if( vars == NULL || !vars->is_scope )
+    {
+        DMOD_LOG_ERROR("Invalid store passed to dmell_vars_alloc: %p\n", vars);
+        return NULL;
+    }
+    return alloc_storage( vars, size );
+}
+
+/**
+ * @brief Helper function to check if the value of a variable is stored in the allocation of the variable.
+ * 
+ * @param var Variable to check
+ * @return true If the value is stored inline
+ * @return false If the value is in a separate block
+ */
+static bool is_value_inline( const dmell_var_t* var )
+{
+    return var->value == var->name + strlen( var->name ) + 1;
+}
+
+/**
+ * @brief Helper function to create a variable with its name and value in a single allocation.
+ * 
+ * @param vars Store of the variable
+ * @param name Name of the variable
+ * @param name_len Length of the name
+ * @param value Value of the variable
+ * @param hash Hash of the name
+ * @return dmell_var_t* New variable, or NULL on error
+ */
+static dmell_var_t* create_variable( dmell_vars_t* vars, const char* name, size_t name_len, const char* value, uint32_t hash )
+{
+    size_t value_size = strlen( value ) + 1;
+    size_t capacity = ( value_size > DMELL_VAR_INLINE_VALUE_SIZE ) ? value_size : DMELL_VAR_INLINE_VALUE_SIZE;
+    if( capacity > UINT32_MAX )
+    {
+        return NULL;
+    }
+    dmell_var_t* var = alloc_storage( vars, sizeof(dmell_var_t) + name_len + 1 + capacity );
+    if( var == NULL )
+    {
+        return NULL;
+    }
+
+    var->name = (char*)( var + 1 );
+    memcpy( var->name, name, name_len );
+    var->name[name_len] = '\0';
+    var->value = var->name + name_len + 1;
+    memcpy( var->value, value, value_size );
+    var->hash = hash;
+    var->capacity = (uint32_t)capacity;
+    return var;
+}
+
+/**
+ * @brief Helper function to change the value of a variable.
+ * 
+ * The value is copied into the current storage when it fits, so setting
+ * short values again and again does not allocate memory.
+ * 
+ * @param vars Store of the variable
+ * @param var Variable to change
+ * @param value New value
+ * @return int 0 on success, negative value on error
+ */
+static int assign_value( dmell_vars_t* vars, dmell_var_t* var, const char* value )
+{
+    size_t value_size = strlen( value ) + 1;
+    if( value_size > var->capacity )
+    {
+        // Grow by half, so a value that is appended to repeatedly is not moved every time
+        size_t capacity = value_size + value_size / 2;
+        char* storage = ( capacity <= UINT32_MAX ) ? alloc_storage( vars, capacity ) : NULL;
+        if( storage == NULL )
+        {
+            return -ENOMEM;
+        }
+        // The new value can be a part of the old one, so it is copied first
+        memcpy( storage, value, value_size );
+        if( !is_value_inline( var ) )
+        {
+            free_storage( vars, var->value );
+        }
+        var->value = storage;
+        var->capacity = (uint32_t)capacity;
+        return 0;
+    }
+    memmove( var->value, value, value_size );
+    return 0;
+}
+
+/**
+ * @brief Helper function to free a single variable.
+ * 
+ * @param vars Store of the variable
+ * @param var Variable to free
+ */
+static void free_variable( dmell_vars_t* vars, dmell_var_t* var )
+{
+    if( !is_value_inline( var ) )
+    {
+        free_storage( vars, var->value );
+    }
+    free_storage( vars, var );
+}
+
+/**
+ * @brief Helper function to get the store that holds the variables of a frame.
+ * 
+ * @param vars Variable store or frame
+ * @return dmell_vars_t* Nearest scope, or the store without a parent
+ */
+static dmell_vars_t* get_scope( dmell_vars_t* vars )
+{
+    while( vars->parent != NULL && !vars->is_scope )
+    {
+        vars = vars->parent;
+    }
+    return vars;
+}
+
+/**
+ * @brief Helper function to find a positional parameter of a frame.
+ * 
+ * @param vars Frame
+ * @param name Name of the variable
+ * @param name_len Length of the name
+ * @param out_param Output parameter to hold the parameter, NULL if the frame does not have it
+ * @return true If the name is a positional parameter
+ * @return false Otherwise
+ */
+static bool find_param( const dmell_vars_t* vars, const char* name, size_t name_len, dmell_var_t** out_param )
+{
+    size_t index = 0;
+    for( size_t i = 0; i < name_len; i++ )
+    {
+        if( name[i] < '0' || name[i] > '9' )
+        {
+            return false;
+        }
+        index = ( index < vars->param_count ) ? index * 10 + (size_t)( name[i] - '0' ) : index;
+    }
+    *out_param = ( name_len > 0 && index < vars->param_count ) ? &vars->params[index] : NULL;
+    return name_len > 0;
+}
+
+/**
+ * @brief Adds a new variable to the store.
+ * 
+ * Variables added through a function frame are stored in the nearest scope.
+ * 
+ * @param vars Variable store
  * @param name Name of the variable to add
  * @param value Value of the variable to add
- * @return dmell_var_t* Pointer to the head of the updated variable list
+ * @return int 0 on success, -EEXIST if the variable already exists, other negative value on error
  */
-dmell_var_t* dmell_add_variable( dmell_var_t* head, const char* name, const char* value)
+int dmell_add_variable( dmell_vars_t* vars, const char* name, const char* value)
 {
-    if(name == NULL || value == NULL)
+    if(vars == NULL || name == NULL || value == NULL)
     {
-        DMOD_LOG_ERROR("Invalid arguments to dmell_add_variable: %p, %p\n", name, value);
-        return head;
+        DMOD_LOG_ERROR("Invalid arguments to dmell_add_variable: %p, %p, %p\n", vars, name, value);
+        return -EINVAL;
     }
 
-    dmell_var_t* new_var = (dmell_var_t*)Dmod_Malloc(sizeof(dmell_var_t));
-    if(new_var == NULL)
+    vars = get_scope(vars);
+    size_t name_len = strlen(name);
+    uint32_t hash = dmell_hash_name(name, name_len);
+    if(find_slot(vars, name, name_len, hash, NULL) != NULL)
     {
-        DMOD_LOG_ERROR("Memory allocation failed in dmell_add_variable for %s=%s\n", name, value);
-        return head;
+        DMOD_LOG_ERROR("Variable %s already exists\n", name);
+        return -EEXIST;
     }
 
-    new_var->name = Dmod_StrDup(name);
-    new_var->value = Dmod_StrDup(value);
-    if(new_var->name == NULL || new_var->value == NULL)
+    int result = reserve_slot(vars);
+    if(result < 0)
     {
-        DMOD_LOG_ERROR("Memory allocation failed in Dmod_StrDup in dmell_add_variable for %s=%s\n", name, value);
-        Dmod_Free(new_var->name);
-        Dmod_Free(new_var->value);
-        Dmod_Free(new_var);
-        return head;    
+        return result;
     }
 
+    dmell_var_t* new_var = create_variable(vars, name, name_len, value, hash);
+    if(new_var == NULL)
+    {
+        DMOD_LOG_ERROR("Memory allocation failed in dmell_add_variable for %s=%s\n", name, value);
+        return -ENOMEM;
+    }
     new_var->next = NULL;
+    new_var->prev = vars->tail;
 
-    // If the list is empty, the new variable becomes the head
-    if(head == NULL)
+    // Add the new variable at the end of the insertion order
+    if(vars->tail != NULL)
     {
-        return new_var;
+        vars->tail->next = new_var;
     }
-
-    // Find the last element in the list
-    dmell_var_t* current = head;
-    while(current->next != NULL)
+    else
     {
-        current = current->next;
+        vars->head = new_var;
     }
+    vars->tail = new_var;
 
-    // Add the new variable at the end
-    current->next = new_var;
-    return head;
+    dmell_var_t** free_slot = NULL;
+    find_slot(vars, name, name_len, hash, &free_slot);
+    if(*free_slot == NULL)
+    {
+        vars->used++;
+    }
+    *free_slot = new_var;
+    vars->count++;
+    return 0;
 }
 
 /**
- * @brief Finds a variable by its name.
+ * @brief Finds a variable by a name that does not have to be null terminated.
+ * 
+ * A frame is searched before the stores of its callers.
  * 
- * @param head Pointer to the head of the variable list
+ * @param vars Variable store
  * @param name Name of the variable to find
+ * @param name_len Length of the name
+ * @param hash Hash of the name (see dmell_hash_name)
  * @return dmell_var_t* Pointer to the found variable, or NULL if not found
  */
-dmell_var_t* dmell_find_variable( dmell_var_t* head, const char* name )
+dmell_var_t* dmell_find_variable_n( const dmell_vars_t* vars, const char* name, size_t name_len, uint32_t hash )
 {
-    dmell_var_t* current = head;
-    while(current != NULL)
+    if(vars == NULL || name == NULL)
     {
-        if(strcmp(current->name, name) == 0)
+        return NULL;
+    }
+    for( ; vars != NULL; vars = vars->parent )
+    {
+        dmell_var_t* param = NULL;
+        if( vars->params != NULL && find_param( vars, name, name_len, &param ) )
+        {
+            return param;
+        }
+        dmell_var_t** slot = find_slot(vars, name, name_len, hash, NULL);
+        if( slot != NULL )
         {
-            return current;
+            return *slot;
         }
-        current = current->next;
     }
     return NULL;
 }
 
 /**
- * @brief Removes a variable from the list by its name.
+ * @brief Finds a variable by its name.
  * 
- * @param head Pointer to the head of the variable list
+ * @param vars Variable store
+ * @param name Name of the variable to find
+ * @return dmell_var_t* Pointer to the found variable, or NULL if not found
+ */
+dmell_var_t* dmell_find_variable( const dmell_vars_t* vars, const char* name )
+{
+    if(name == NULL)
+    {
+        return NULL;
+    }
+    size_t name_len = strlen(name);
+    return dmell_find_variable_n(vars, name, name_len, dmell_hash_name(name, name_len));
+}
+
+/**
+ * @brief Removes a variable from the store by its name.
+ * 
+ * @param vars Variable store
  * @param name Name of the variable to remove
- * @return dmell_var_t* Pointer to the head of the updated variable list
+ * @return int 0 on success, -ENOENT if the variable does not exist
  */
-dmell_var_t* dmell_remove_variable( dmell_var_t* head, const char* name )
+int dmell_remove_variable( dmell_vars_t* vars, const char* name )
 {
-    dmell_var_t* current = head;
-    dmell_var_t* previous = NULL;
+    if(vars == NULL || name == NULL)
+    {
+        DMOD_LOG_ERROR("Invalid arguments to dmell_remove_variable: %p, %p\n", vars, name);
+        return -EINVAL;
+    }
 
-    while(current != NULL)
+    vars = get_scope(vars);
+    size_t name_len = strlen(name);
+    dmell_var_t** slot = find_slot(vars, name, name_len, dmell_hash_name(name, name_len), NULL);
+    if(slot == NULL)
     {
-        if(strcmp(current->name, name) == 0)
-        {
-            if(previous == NULL)
-            {
-                head = current->next;
-            }
-            else
-            {
-                previous->next = current->next;
-            }
-            Dmod_Free(current->name);
-            Dmod_Free(current->value);
-            Dmod_Free(current);
-            return head;
-        }
-        previous = current;
-        current = current->next;
+        return -ENOENT;
+    }
+
+    dmell_var_t* var = *slot;
+    *slot = &g_removed_slot;
+    if(var->prev != NULL)
+    {
+        var->prev->next = var->next;
+    }
+    else
+    {
+        vars->head = var->next;
+    }
+    if(var->next != NULL)
+    {
+        var->next->prev = var->prev;
+    }
+    else
+    {
+        vars->tail = var->prev;
     }
-    return head;
+    vars->count--;
+    free_variable(vars, var);
+    return 0;
 }
 
 /**
- * @brief Adds variables for each argument in the format ARG0, ARG1, ..., ARGN-1.
+ * @brief Sets variables for each argument in the format 0, 1, ..., N-1.
  * 
- * @param head Pointer to the head of the variable list
+ * The number of arguments becomes the value of $# (without $0).
+ * 
+ * @param vars Variable store
  * @param argc Number of arguments
  * @param argv Array of argument strings
- * @return dmell_var_t* Pointer to the head of the updated variable list
+ * @return int 0 on success, negative value on error
  */
-dmell_var_t* dmell_add_argv_variables( dmell_var_t* head, int argc, char** argv )
+int dmell_add_argv_variables( dmell_vars_t* vars, int argc, char** argv )
 {
+    if(vars == NULL || argc < 0 || (argv == NULL && argc > 0))
+    {
+        DMOD_LOG_ERROR("Invalid arguments to dmell_add_argv_variables: %p, %d, %p\n", vars, argc, argv);
+        return -EINVAL;
+    }
+    get_scope(vars)->param_count = (size_t)argc;
     for(int i = 0; i < argc; i++)
     {
         char var_name[32];
         Dmod_SnPrintf(var_name, sizeof(var_name), "%d", i);
-        head = dmell_add_variable( head, var_name, argv[i] );
+        int result = dmell_set_variable( vars, var_name, argv[i] );
+        if(result < 0)
+        {
+            return result;
+        }
     }
-    return head;
+    return 0;
 }
 
 /**
- * @brief Frees the entire variable list.
+ * @brief Frees all variables of the store.
  * 
- * @param head Pointer to the head of the variable list
+ * The variables of a scope are released together with its arena. The
+ * store is left empty and can be used again.
+ * 
+ * @param vars Variable store
  */
-void dmell_free_variables( dmell_var_t* head )
+void dmell_free_variables( dmell_vars_t* vars )
 {
-    dmell_var_t* current = head;
+    if(vars == NULL)
+    {
+        return;
+    }
+    dmell_var_t* current = vars->is_scope ? NULL : vars->head;
     while(current != NULL)
     {
         dmell_var_t* next = current->next;
-        Dmod_Free(current->name);
-        Dmod_Free(current->value);
-        Dmod_Free(current);
+        free_variable(vars, current);
         current = next;
     }
+    // The variables of a scope are released with its arena
+    if(vars->arena != NULL)
+    {
+        while(vars->arena->chunks != NULL)
+        {
+            dmell_vars_chunk_t* next = vars->arena->chunks->next;
+            Dmod_Free(vars->arena->chunks);
+            vars->arena->chunks = next;
+        }
+        Dmod_Free(vars->arena);
+    }
+    Dmod_Free(vars->slots);
+    memset(vars, 0, sizeof(*vars));
 }
 
 /**
  * @brief Sets the value of a variable. If the variable does not exist, it is added.
  * 
- * @param head Pointer to the head of the variable list
+ * Variables set through a function frame are stored in the nearest scope.
+ * 
+ * @param vars Variable store
  * @param name Name of the variable to set
  * @param value Value to set for the variable
- * @return dmell_var_t* Pointer to the head of the updated variable list
+ * @return int 0 on success, negative value on error
  */
-dmell_var_t* dmell_set_variable( dmell_var_t* head, const char* name, const char* value )
+int dmell_set_variable( dmell_vars_t* vars, const char* name, const char* value )
 {
-    if(name == NULL || value == NULL)
+    if(vars == NULL || name == NULL || value == NULL)
     {
-        DMOD_LOG_ERROR("Invalid arguments to dmell_set_variable: %p, %p\n", name, value);
-        return head;
+        DMOD_LOG_ERROR("Invalid arguments to dmell_set_variable: %p, %p, %p\n", vars, name, value);
+        return -EINVAL;
     }
     
-    dmell_var_t* var = dmell_find_variable( head, name );
-    if( var != NULL )
+    // Variables of the callers are not changed - the value is set in the nearest scope
+    vars = get_scope( vars );
+    size_t name_len = strlen( name );
+    dmell_var_t** slot = find_slot( vars, name, name_len, dmell_hash_name( name, name_len ), NULL );
+    if( slot != NULL )
     {
-        Dmod_Free( var->value );
-        var->value = Dmod_StrDup( value );
-        if( var->value == NULL )
+        int result = assign_value( vars, *slot, value );
+        if( result < 0 )
         {
-            DMOD_LOG_ERROR("Memory allocation failed in Dmod_StrDup in dmell_set_variable for %s=%s\n", name, value);
+            DMOD_LOG_ERROR("Memory allocation failed in dmell_set_variable for %s=%s\n", name, value);
         }
-        return head;
+        return result;
     }
     else
     {
-        return dmell_add_variable( head, name, value );
+        return dmell_add_variable( vars, name, value );
     }
 }
 
 /**
  * @brief Gets the value of a variable by its name.
  * 
- * @param head Pointer to the head of the variable list
+ * The value of a special parameter is formatted into a static buffer that
+ * is valid until the next call.
+ * 
+ * @param vars Variable store
  * @param name Name of the variable to get
  * @return const char* Value of the variable, or NULL if not found
  */
-const char* dmell_get_variable_value( dmell_var_t* head, const char* name )
+const char* dmell_get_variable_value( const dmell_vars_t* vars, const char* name )
+{
+    static char special[DMELL_VARS_SPECIAL_SIZE];
+    if( name == NULL )
+    {
+        return NULL;
+    }
+    size_t name_len = strlen( name );
+    return dmell_get_variable_value_n( vars, name, name_len, dmell_hash_name( name, name_len ), special );
+}
+
+/**
+ * @brief Helper function to get the value of a special parameter.
+ * 
+ * @param vars Variable store
+ * @param name Name of the parameter
+ * @param name_len Length of the name
+ * @param special Buffer of DMELL_VARS_SPECIAL_SIZE characters for the formatted value
+ * @return const char* Value of the parameter, or NULL if the name is not a special parameter
+ */
+static const char* get_special_value( const dmell_vars_t* vars, const char* name, size_t name_len, char* special )
+{
+    if( name_len != 1 || !is_special_char( name[0] ) )
+    {
+        return NULL;
+    }
+
+    int value = 0;
+    if( name[0] == '?' )
+    {
+        // The exit code is kept by the scope of the script
+        while( vars->parent != NULL && !vars->is_scope )
+        {
+            vars = vars->parent;
+        }
+        value = vars->status;
+    }
+    else
+    {
+        // The parameters of the script and of a function do not count $0
+        value = ( vars->param_count > 0 ) ? (int)vars->param_count - 1 : 0;
+    }
+    Dmod_SnPrintf( special, DMELL_VARS_SPECIAL_SIZE, "%d", value );
+    return special;
+}
+
+/**
+ * @brief Gets the value of a variable by a name that does not have to be null terminated.
+ * 
+ * Special parameters are formatted only when they are read, variables that
+ * are not in the store are read from the environment (see dmell_env_get).
+ * 
+ * @param vars Variable store
+ * @param name Name of the variable
+ * @param name_len Length of the name
+ * @param hash Hash of the name (see dmell_hash_name)
+ * @param special Buffer of DMELL_VARS_SPECIAL_SIZE characters for the value of a special parameter
+ * @return const char* Value of the variable, or NULL if not found
+ */
+const char* dmell_get_variable_value_n( const dmell_vars_t* vars, const char* name, size_t name_len, uint32_t hash, char* special )
 {
-    dmell_var_t* var = dmell_find_variable( head, name );
+    if( name == NULL || special == NULL || name_len >= DMELL_MAX_VAR_NAME_LEN )
+    {
+        return NULL;
+    }
+
+    const char* value = ( vars != NULL ) ? get_special_value( vars, name, name_len, special ) : NULL;
+    if( value != NULL )
+    {
+        return value;
+    }
+    dmell_var_t* var = dmell_find_variable_n( vars, name, name_len, hash );
     if( var != NULL )
     {
         return var->value;
     }
-    return Dmod_GetEnv( name );
+    return dmell_env_get( name, name_len, hash );
 }
 
 /**
- * @brief Expands variables in a string and writes the result to the destination buffer.
+ * @brief Sets the exit code of the last command - the value of $?.
  * 
- * @note If dst is NULL, the function only calculates the required buffer size.
+ * The exit code is stored as a number in the nearest scope, so no
+ * memory is allocated for it.
  * 
- * @param head Pointer to the head of the variable list
- * @param str Input string with variables to expand
- * @param str_len Length of the input string
- * @param dst [optional] Destination buffer to write the expanded string
- * @param dst_size [optional] Size of the destination buffer
+ * @param vars Variable store or frame
+ * @param status Exit code of the last command
+ */
+void dmell_set_status( dmell_vars_t* vars, int status )
+{
+    if( vars != NULL )
+    {
+        get_scope( vars )->status = status;
+    }
+}
+
+/**
+ * @brief Output of the variable expansion - either a growable buffer or a fixed destination.
+ */
+typedef struct 
+{
+    dmell_buf_t*    buf;        /**< Growable buffer, or NULL when writing to dst */
+    char*           dst;        /**< Fixed destination buffer (optional) */
+    char*           end_dst;    /**< End of the fixed destination buffer */
+    size_t          length;     /**< Number of characters produced so far */
+    int             error;      /**< First error that occurred, or 0 */
+} expand_output_t;
+
+/**
+ * @brief Helper function to append characters to the expansion output.
  * 
- * @return number of characters written to dst (excluding null terminator) or -errno on error
+ * @param out Expansion output
+ * @param str Characters to append
+ * @param len Number of characters to append
  */
-int dmell_expand_variables( dmell_var_t* head, const char* str, size_t str_len, char* dst, size_t dst_size )
+static void output_append( expand_output_t* out, const char* str, size_t len )
 {
-    if(str == NULL)
+    if( out->buf != NULL )
     {
-        DMOD_LOG_ERROR("Invalid argument to dmell_expand_variables: %p\n", str);
+        if( out->error == 0 )
+        {
+            out->error = dmell_buf_append( out->buf, str, len );
+        }
+    }
+    else if( out->dst != NULL && out->end_dst != NULL )
+    {
+        char* dst_ptr = out->dst + out->length;
+        for( size_t i = 0; i < len && dst_ptr < out->end_dst; i++ )
+        {
+            *dst_ptr++ = str[i];
+        }
+    }
+    out->length += len;
+}
+
+/**
+ * @brief Handler of command substitutions.
+ */
+static dmell_subst_handler_t g_substitution_handler = NULL;
+
+/**
+ * @brief Sets the handler that runs the commands of command substitutions.
+ * 
+ * @param handler Handler to use, NULL to disable command substitution
+ */
+void dmell_set_substitution_handler( dmell_subst_handler_t handler )
+{
+    g_substitution_handler = handler;
+}
+
+/**
+ * @brief Runs a command and appends its output to a buffer.
+ * 
+ * Trailing newlines of the output are removed and the remaining line breaks
+ * are replaced with spaces.
+ * 
+ * @param vars Variable store used to expand the command
+ * @param cmd Command to run (does not have to be null terminated)
+ * @param len Length of the command
+ * @param buf Buffer to append the output to
+ * @return int Number of characters appended to the buffer, or -errno on error
+ */
+int dmell_substitute_command( const dmell_vars_t* vars, const char* cmd, size_t len, dmell_buf_t* buf )
+{
+    if( cmd == NULL || buf == NULL )
+    {
+        DMOD_LOG_ERROR("Invalid arguments to dmell_substitute_command: %p, %p\n", cmd, buf);
         return -EINVAL;
     }
+    if( g_substitution_handler == NULL )
+    {
+        DMOD_LOG_ERROR("Command substitution is not available\n");
+        return -ENOTSUP;
+    }
 
-    size_t required_size = 0;
+    size_t start = buf->length;
+    int result = g_substitution_handler( vars, cmd, len, buf );
+    if( result < 0 )
+    {
+        return result;
+    }
+    while( buf->length > start && ( buf->data[buf->length - 1] == '\n' || buf->data[buf->length - 1] == '\r' ) )
+    {
+        buf->data[--buf->length] = '\0';
+    }
+    // Line breaks inside the output would split the line into separate commands
+    for( size_t i = start; i < buf->length; i++ )
+    {
+        if( buf->data[i] == '\n' || buf->data[i] == '\r' )
+        {
+            buf->data[i] = ' ';
+        }
+    }
+    return (int)( buf->length - start );
+}
 
-    char* dst_ptr = dst;
-    char* end_dst = dst != NULL ? dst + dst_size : NULL;
+/**
+ * @brief Helper function that expands variables in a single pass over the string.
+ * 
+ * Each reference is resolved exactly once and its value is written directly
+ * to the output. Arithmetic expansions are evaluated in place. Command
+ * substitutions are run only when the output is a growable buffer,
+ * otherwise they are copied unchanged.
+ * 
+ * @param vars Variable store
+ * @param str Input string with variables to expand
+ * @param str_len Length of the input string
+ * @param out Expansion output
+ */
+static void expand( const dmell_vars_t* vars, const char* str, size_t str_len, expand_output_t* out )
+{
     const char* end_ptr = str + str_len;
     const char* ptr = str;
-    while( ptr < end_ptr )
+    while( ptr < end_ptr && out->error == 0 )
     {
-        ptr = dmell_skip_whitespaces( ptr, end_ptr );
-        const char* var_start = find_next_var( ptr, end_ptr );
-        required_size += dmell_add_to_string( dst_ptr, end_dst, ptr, var_start );
-        dst_ptr = dst != NULL ? dst + required_size : NULL;
-        if(var_start < end_ptr)
+        bool is_cmd = false;
+        const char* name = NULL;
+        size_t name_len = 0;
+        const char* ref_end = end_ptr;
+        const char* var_start = dmell_find_next_reference( ptr, end_ptr, &is_cmd, &name, &name_len, &ref_end );
+        output_append( out, ptr, var_start - ptr );
+        const char* expr = NULL;
+        size_t expr_len = 0;
+        if( var_start < end_ptr && is_cmd && dmell_arith_is_expansion( name, name_len, &expr, &expr_len ) )
+        {
+            char value[DMELL_ARITH_RESULT_SIZE];
+            int result = dmell_arith_expand( vars, expr, expr_len, value, sizeof(value) );
+            if( result >= 0 )
+            {
+                output_append( out, value, (size_t)result );
+            }
+            out->error = result < 0 ? result : out->error;
+            ptr = ref_end;
+        }
+        else if( var_start < end_ptr && is_cmd )
         {
-            size_t name_len = 0;
-            const char* var_name = get_var_name(var_start, end_ptr, &name_len);
-            if(var_name != NULL && name_len > 0 && name_len < DMELL_MAX_VAR_NAME_LEN)
+            if( out->buf != NULL )
+            {
+                int result = dmell_substitute_command( vars, name, name_len, out->buf );
+                out->error = result < 0 ? result : 0;
+                out->length += result > 0 ? (size_t)result : 0;
+            }
+            else
             {
-                char var_name_cpy[ DMELL_MAX_VAR_NAME_LEN ];
-                strncpy( var_name_cpy, var_name, name_len );
-                var_name_cpy[ name_len ] = '\0';
-                const char* var_value = dmell_get_variable_value(head, var_name_cpy);
-                const char* var_value_end = var_value != NULL ? var_value + strlen(var_value) : NULL;
-                required_size += dmell_add_to_string(dst_ptr, end_dst, var_value, var_value_end);
-                dst_ptr = dst != NULL ? dst + required_size : NULL;
+                output_append( out, var_start, ref_end - var_start );
             }
-            ptr = get_var_end( var_start, end_ptr );
+            ptr = ref_end;
+        }
+        else if( var_start < end_ptr )
+        {
+            if( name != NULL && name_len > 0 && name_len < DMELL_MAX_VAR_NAME_LEN )
+            {
+                char special[DMELL_VARS_SPECIAL_SIZE];
+                const char* var_value = dmell_get_variable_value_n( vars, name, name_len, dmell_hash_name( name, name_len ), special );
+                if( var_value != NULL )
+                {
+                    output_append( out, var_value, strlen( var_value ) );
+                }
+            }
+            ptr = ref_end;
         }
         else 
         {
             ptr = end_ptr;
         }
     }
+}
 
-    return (int)required_size;
-}
\ No newline at end of file
+/**
+ * @brief Expands variables in a string and writes the result to the destination buffer.
+ * 
+ * @note If dst is NULL, the function only calculates the required buffer size.
+ * 
+ * @param vars Variable store
+ * @param str Input string with variables to expand
+ * @param str_len Length of the input string
+ * @param dst [optional] Destination buffer to write the expanded string
+ * @param dst_size [optional] Size of the destination buffer
+ * 
+ * @return number of characters written to dst (excluding null terminator) or -errno on error
+ */
+int dmell_expand_variables( const dmell_vars_t* vars, const char* str, size_t str_len, char* dst, size_t dst_size )
+{
+    if(str == NULL)
+    {
+        DMOD_LOG_ERROR("Invalid argument to dmell_expand_variables: %p\n", str);
+        return -EINVAL;
+    }
+
+    expand_output_t out = {
+        .buf        = NULL,
+        .dst        = dst,
+        .end_dst    = dst != NULL ? dst + dst_size : NULL,
+        .length     = 0,
+        .error      = 0
+    };
+    expand( vars, str, str_len, &out );
+    return out.error < 0 ? out.error : (int)out.length;
+}
+
+/**
+ * @brief Expands variables in a string and appends the result to a growable buffer.
+ * 
+ * The string is scanned once and every variable is looked up once. Command
+ * substitutions - "$(command)" and "`command`" - are replaced with the output
+ * of the command, and arithmetic expansions - "$((expression))" - with the
+ * value of the expression. The buffer is not cleared, so a caller can reuse it to
+ * avoid allocations.
+ * 
+ * @param vars Variable store
+ * @param str Input string with variables to expand
+ * @param str_len Length of the input string
+ * @param buf Buffer to append the expanded string to
+ * 
+ * @return number of characters appended to the buffer or -errno on error
+ */
+int dmell_expand_variables_to_buf( const dmell_vars_t* vars, const char* str, size_t str_len, dmell_buf_t* buf )
+{
+    if( str == NULL || buf == NULL )
+    {
+        DMOD_LOG_ERROR("Invalid arguments to dmell_expand_variables_to_buf: %p, %p\n", str, buf);
+        return -EINVAL;
+    }
+
+    expand_output_t out = {
+        .buf        = buf,
+        .dst        = NULL,
+        .end_dst    = NULL,
+        .length     = 0,
+        .error      = 0
+    };
+    expand( vars, str, str_len, &out );
+    return out.error < 0 ? out.error : (int)out.length;
+}
@@ -0,0 +1,170 @@
+#include <errno.h>
+#include <string.h>
+#include "dmell_writer.h"
+#include "dmod.h"
+
+/**
+ * @brief Connects a writer to a file that is already open.
+ *
+ * The writer takes over the file and closes it in dmell_writer_close. A
+ * caller that opens the file itself can choose its mode and handle a file
+ * that cannot be created without an error message.
+ *
+ * @param writer Writer to set up
+ * @param file File opened for writing
+ * @return int 0 on success, negative value on error
+ */
+int dmell_writer_attach( dmell_writer_t* writer, void* file )
+{
+    if( writer == NULL || file == NULL )
+    {
+        DMOD_LOG_ERROR("Invalid arguments to dmell_writer_attach: %p, %p\n", writer, file);
+        return -EINVAL;
+    }
+
+    writer->length = 0;
+    writer->error = 0;
+    writer->buffer = Dmod_Malloc( DMELL_WRITER_BUFFER_SIZE );
+    if( writer->buffer == NULL )
+    {
+        DMOD_LOG_ERROR("Memory allocation failed in dmell_writer_attach\n");
+        writer->file = NULL;
+        return -ENOMEM;
+    }
+    writer->file = file;
+    return 0;
+}
+
+/**
+ * @brief Opens a file for writing.
+ *
+ * @param writer Writer to open
+ * @param path Path of the file
+ * @param append True to append to the file, false to truncate it
+ * @return int 0 on success, negative value on error
+ */
+int dmell_writer_open( dmell_writer_t* writer, const char* path, bool append )
+{
+    if( writer == NULL || path == NULL || *path == '\0' )
+    {
+        DMOD_LOG_ERROR("Invalid arguments to dmell_writer_open: %p, %p\n", writer, path);
+        return -EINVAL;
+    }
+
+    void* file = Dmod_FileOpen( path, append ? "a" : "w" );
+    if( file == NULL )
+    {
+        DMOD_LOG_ERROR("Failed to open file '%s' for writing\n", path);
+        return -ENOENT;
+    }
+
+    int result = dmell_writer_attach( writer, file );
+    if( result < 0 )
+    {
+        Dmod_FileClose( file );
+    }
+    return result;
+}
+
+/**
+ * @brief Helper function to write data straight to the file.
+ *
+ * @param writer Writer to use
+ * @param data Data to write
+ * @param len Number of bytes to write
+ * @return int 0 on success, negative value on error
+ */
+static int write_file( dmell_writer_t* writer, const char* data, size_t len )
+{
+    if( len > 0 && Dmod_FileWrite( data, 1, len, writer->file ) != len )
+    {
+        DMOD_LOG_ERROR("Failed to write %zu bytes to a file\n", len);
+        writer->error = -EIO;
+    }
+    return writer->error;
+}
+
+/**
+ * @brief Writes data to the file through the buffer.
+ *
+ * Data larger than the buffer is written directly after the buffered
+ * content.
+ *
+ * @param writer Writer to use
+ * @param data Data to write
+ * @param len Number of bytes to write
+ * @return int 0 on success, negative value on error
+ */
+int dmell_writer_write( dmell_writer_t* writer, const char* data, size_t len )
+{
+    if( writer == NULL || writer->file == NULL || ( data == NULL && len > 0 ) )
+    {
+        DMOD_LOG_ERROR("Invalid arguments to dmell_writer_write: %p, %p\n", writer, data);
+        return -EINVAL;
+    }
+
+    if( writer->error < 0 || len == 0 )
+    {
+        return writer->error;
+    }
+
+    if( writer->length + len > DMELL_WRITER_BUFFER_SIZE )
+    {
+        int result = dmell_writer_flush( writer );
+        if( result < 0 )
+        {
+            return result;
+        }
+    }
+
+    if( len >= DMELL_WRITER_BUFFER_SIZE )
+    {
+        return write_file( writer, data, len );
+    }
+
+    memcpy( &writer->buffer[writer->length], data, len );
+    writer->length += len;
+    return 0;
+}
+
+/**
+ * @brief Writes the buffered data to the file.
+ *
+ * @param writer Writer to flush
+ * @return int 0 on success, negative value on error
+ */
+int dmell_writer_flush( dmell_writer_t* writer )
+{
+    if( writer == NULL || writer->file == NULL )
+    {
+        DMOD_LOG_ERROR("Invalid writer passed to dmell_writer_flush: %p\n", writer);
+        return -EINVAL;
+    }
+
+    int result = write_file( writer, writer->buffer, writer->length );
+    writer->length = 0;
+    return result;
+}
+
+/**
+ * @brief Flushes the buffered data and closes the file.
+ *
+ * @param writer Writer to close
+ * @return int 0 on success, or the first error that occurred while writing
+ */
+int dmell_writer_close( dmell_writer_t* writer )
+{
+    if( writer == NULL || writer->file == NULL )
+    {
+        return 0;
+    }
+
+    int result = dmell_writer_flush( writer );
+    Dmod_FileClose( writer->file );
+    Dmod_Free( writer->buffer );
+    writer->file = NULL;
+    writer->buffer = NULL;
+    writer->length = 0;
+    writer->error = 0;
+    return result;
+}
@@ -0,0 +1,137 @@
+/**
+ * @file tests_dmell_arith.cpp
+ * @brief Unit tests for the dmell arithmetic evaluator
+ */
+
+#include <gtest/gtest.h>
+#include <errno.h>
+#include <string.h>
+
+extern "C" {
+#include "dmell_arith.h"
+#include "dmell_vars.h"
+#include "dmod_sal.h"
+}
+
+// ===============================================================
+//                  Arithmetic Evaluation Tests
+// ===============================================================
+
+class DmellArithTest : public ::testing::Test
+{
+protected:
+    void SetUp() override
+    {
+        variables = {};
+    }
+
+    void TearDown() override
+    {
+        dmell_free_variables(&variables);
+    }
+
+    long eval(const char* expr, int expected_result = 0)
+    {
+        long value = -12345;
+        EXPECT_EQ(dmell_arith_eval(&variables, expr, strlen(expr), &value), expected_result) << expr;
+        return value;
+    }
+
+    dmell_vars_t variables;
+};
+
+/**
+ * @brief Test the precedence and associativity of the operators
+ */
+TEST_F(DmellArithTest, Precedence)
+{
+    EXPECT_EQ(eval("1 + 2 * 3"), 7);
+    EXPECT_EQ(eval("(1 + 2) * 3"), 9);
+    EXPECT_EQ(eval("10 - 4 - 3"), 3);
+    EXPECT_EQ(eval("100 / 10 / 5"), 2);
+    EXPECT_EQ(eval("-7 % 3"), -1);
+    EXPECT_EQ(eval("1 + 2 < 4 == 1"), 1);
+    EXPECT_EQ(eval("1 << 4 | 3 & 2 ^ 1"), 19);
+    EXPECT_EQ(eval("!0 + ~0 + -(-2)"), 2);
+    EXPECT_EQ(eval("0x1F + 1"), 32);
+}
+
+/**
+ * @brief Test the comparison and logical operators
+ */
+TEST_F(DmellArithTest, Comparisons)
+{
+    EXPECT_EQ(eval("3 >= 3 && 2 <= 1"), 0);
+    EXPECT_EQ(eval("3 > 4 || 2 != 1"), 1);
+    EXPECT_EQ(eval("0 && 1 / 0"), 0);
+    EXPECT_EQ(eval("1 || 1 % 0"), 1);
+}
+
+/**
+ * @brief Test that variables are read from the store
+ */
+TEST_F(DmellArithTest, Variables)
+{
+    ASSERT_EQ(dmell_set_variable(&variables, "COUNT", "41"), 0);
+    ASSERT_EQ(dmell_set_variable(&variables, "NEG", " -3 "), 0);
+    ASSERT_EQ(dmell_set_variable(&variables, "1", "5"), 0);
+    ASSERT_EQ(dmell_set_variable(&variables, "EMPTY", ""), 0);
+
+    EXPECT_EQ(eval("COUNT + 1"), 42);
+    EXPECT_EQ(eval("$COUNT * ${NEG}"), -123);
+    EXPECT_EQ(eval("$1 + UNDEFINED_VARIABLE + EMPTY"), 5);
+}
+
+/**
+ * @brief Test that invalid expressions are reported
+ */
+TEST_F(DmellArithTest, InvalidExpressions)
+{
+    ASSERT_EQ(dmell_set_variable(&variables, "WORD", "abc"), 0);
+
+    eval("1 / 0", -EDOM);
+    eval("5 % (2 - 2)", -EDOM);
+    eval("1 +", -EINVAL);
+    eval("(1 + 2", -EINVAL);
+    eval("1 2", -EINVAL);
+    eval("12abc", -EINVAL);
+    eval("WORD + 1", -EINVAL);
+    eval("", -EINVAL);
+    EXPECT_EQ(dmell_arith_eval(&variables, nullptr, 0, nullptr), -EINVAL);
+}
+
+/**
+ * @brief Test that deeply nested expressions are rejected instead of overflowing the stack
+ */
+TEST_F(DmellArithTest, NestingLimit)
+{
+    std::string expr = std::string(DMELL_ARITH_MAX_DEPTH + 1, '(') + "1" + std::string(DMELL_ARITH_MAX_DEPTH + 1, ')');
+
+    eval(expr.c_str(), -EINVAL);
+}
+
+/**
+ * @brief Test recognizing "$((expression))" in the text of a substitution
+ */
+TEST_F(DmellArithTest, IsExpansion)
+{
+    const char* expr = nullptr;
+    size_t len = 0;
+
+    EXPECT_TRUE(dmell_arith_is_expansion("(1 + (2))", 9, &expr, &len));
+    EXPECT_EQ(std::string(expr, len), "1 + (2)");
+    EXPECT_FALSE(dmell_arith_is_expansion("(a) (b)", 7, nullptr, nullptr));
+    EXPECT_FALSE(dmell_arith_is_expansion("echo (x)", 8, nullptr, nullptr));
+}
+
+/**
+ * @brief Test formatting the value of an expression
+ */
+TEST_F(DmellArithTest, Expand)
+{
+    char value[DMELL_ARITH_RESULT_SIZE];
+
+    EXPECT_EQ(dmell_arith_expand(&variables, "-6 * 7", 6, value, sizeof(value)), 3);
+    EXPECT_STREQ(value, "-42");
+    EXPECT_EQ(dmell_arith_expand(&variables, "1000", 4, value, 3), -ENOSPC);
+}
@@ -0,0 +1,207 @@
+/**
+ * @file tests_dmell_cache.cpp
+ * @brief Unit tests for the cache of compiled script programs
+ */
+
+#include <gtest/gtest.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+extern "C" {
+#include "dmell_cache.h"
+#include "dmell_cmd.h"
+#include "dmell_script.h"
+#include "dmod_sal.h"
+}
+
+// Arguments of every call of the recording handler
+static std::vector<std::vector<std::string>> g_cache_calls;
+
+// Handler that records its arguments
+static int cache_record_handler(int argc, char** argv)
+{
+    std::vector<std::string> args;
+    for (int i = 0; i < argc; i++)
+    {
+        args.push_back(argv[i]);
+    }
+    g_cache_calls.push_back(args);
+    return 0;
+}
+
+// ===============================================================
+//                  Compiled Script Cache Tests
+// ===============================================================
+
+class DmellCacheTest : public ::testing::Test
+{
+protected:
+    void SetUp() override
+    {
+        g_cache_calls.clear();
+        ctx = {};
+        path = testing::TempDir() + "dmell_cache_test.dmec";
+        dmell_register_command_handler("cache_rec", cache_record_handler);
+    }
+
+    void TearDown() override
+    {
+        dmell_free_variables(&ctx.variables);
+        dmell_buf_free(&ctx.scratch);
+        remove(path.c_str());
+    }
+
+    // Runs the program and returns the recorded calls
+    std::vector<std::vector<std::string>> run(dmell_prog_t* prog)
+    {
+        g_cache_calls.clear();
+        EXPECT_EQ(dmell_prog_run(prog, &ctx), 0);
+        dmell_free_variables(&ctx.variables);
+        return g_cache_calls;
+    }
+
+    dmell_script_ctx_t ctx;
+    std::string path;
+};
+
+/**
+ * @brief Test that a loaded program runs like the compiled one
+ */
+TEST_F(DmellCacheTest, StoreAndLoad)
+{
+    const char* text = "function cache_func {\n"
+                       "  cache_rec $0,$1\n"
+                       "}\n"
+                       "for V in a 'b c'; do cache_rec $V; done\n"
+                       "cache_func x && cache_rec literal\n";
+    dmell_prog_t* prog = dmell_prog_compile(text, strlen(text));
+    ASSERT_NE(prog, nullptr);
+    ASSERT_EQ(dmell_cache_store(path.c_str(), prog, 10, 20), 0);
+
+    dmell_prog_t* loaded = dmell_cache_load(path.c_str(), 10, 20);
+    ASSERT_NE(loaded, nullptr);
+    EXPECT_EQ(loaded->instr_count, prog->instr_count);
+    EXPECT_EQ(loaded->func_count, 1u);
+    EXPECT_TRUE(loaded->funcs[0]->is_function);
+
+    std::vector<std::vector<std::string>> expected = run(prog);
+    EXPECT_EQ(expected.size(), 4u);
+    EXPECT_EQ(run(loaded), expected);
+
+    dmell_prog_release(loaded);
+    dmell_prog_release(prog);
+}
+
+/**
+ * @brief Test that a cache of another version of the script is not loaded
+ */
+TEST_F(DmellCacheTest, StaleCacheIsIgnored)
+{
+    const char* text = "cache_rec a\n";
+    dmell_prog_t* prog = dmell_prog_compile(text, strlen(text));
+    ASSERT_NE(prog, nullptr);
+    ASSERT_EQ(dmell_cache_store(path.c_str(), prog, 10, 20), 0);
+    dmell_prog_release(prog);
+
+    EXPECT_EQ(dmell_cache_load(path.c_str(), 11, 20), nullptr);
+    EXPECT_EQ(dmell_cache_load(path.c_str(), 10, 21), nullptr);
+    EXPECT_EQ(dmell_cache_load((path + ".missing").c_str(), 10, 20), nullptr);
+    EXPECT_EQ(dmell_cache_load(nullptr, 10, 20), nullptr);
+}
+
+/**
+ * @brief Test that a cache file that cannot be created is skipped
+ */
+TEST_F(DmellCacheTest, UnwritableCacheIsSkipped)
+{
+    const char* text = "cache_rec a\n";
+    dmell_prog_t* prog = dmell_prog_compile(text, strlen(text));
+    ASSERT_NE(prog, nullptr);
+
+    std::string missing = testing::TempDir() + "dmell_missing_dir/run.dmec";
+    EXPECT_EQ(dmell_cache_store(missing.c_str(), prog, 10, 20), -ENOENT);
+    EXPECT_EQ(dmell_cache_load(missing.c_str(), 10, 20), nullptr);
+    dmell_prog_release(prog);
+}
+
+/**
+ * @brief Test that truncated and corrupted cache files are rejected
+ */
+TEST_F(DmellCacheTest, CorruptedCacheIsRejected)
+{
+    const char* text = "cache_rec $A b\n";
+    dmell_prog_t* prog = dmell_prog_compile(text, strlen(text));
+    ASSERT_NE(prog, nullptr);
+    ASSERT_EQ(dmell_cache_store(path.c_str(), prog, 10, 20), 0);
+    dmell_prog_release(prog);
+
+    FILE* file = fopen(path.c_str(), "rb");
+    ASSERT_NE(file, nullptr);
+    std::string data;
+    char chunk[256];
+    size_t count;
+    while ((count = fread(chunk, 1, sizeof(chunk), file)) > 0)
+    {
+        data.append(chunk, count);
+    }
+    fclose(file);
+
+    // Every truncation and every single corrupted byte must either be rejected or load safely
+    for (size_t i = 0; i < data.size(); i++)
+    {
+        for (int variant = 0; variant < 2; variant++)
+        {
+            std::string broken = (variant == 0) ? data.substr(0, i) : data;
+            if (variant == 1)
+            {
+                broken[i] = (char)(broken[i] ^ 0xA5);
+            }
+            file = fopen(path.c_str(), "wb");
+            ASSERT_NE(file, nullptr);
+            fwrite(broken.data(), 1, broken.size(), file);
+            fclose(file);
+
+            dmell_prog_t* loaded = dmell_cache_load(path.c_str(), 10, 20);
+            if (variant == 0)
+            {
+                EXPECT_EQ(loaded, nullptr) << "truncated at " << i;
+            }
+            dmell_prog_release(loaded);
+        }
+    }
+}
+
+/**
+ * @brief Test the path of the cache file of a script
+ */
+TEST_F(DmellCacheTest, CachePath)
+{
+    unsetenv("DMELL_CACHE");
+    unsetenv("DMELL_CACHE_DIR");
+
+    char* cache_path = dmell_cache_get_path("/scripts/run.dme");
+    ASSERT_NE(cache_path, nullptr);
+    EXPECT_STREQ(cache_path, "/scripts/run.dmec");
+    Dmod_Free(cache_path);
+
+    cache_path = dmell_cache_get_path("/scripts/run");
+    ASSERT_NE(cache_path, nullptr);
+    EXPECT_STREQ(cache_path, "/scripts/run.dmec");
+    Dmod_Free(cache_path);
+
+    setenv("DMELL_CACHE_DIR", "/cache", 1);
+    cache_path = dmell_cache_get_path("/scripts/run.dme");
+    ASSERT_NE(cache_path, nullptr);
+    EXPECT_EQ(strncmp(cache_path, "/cache/run.dme.", 15), 0);
+    EXPECT_STREQ(cache_path + strlen(cache_path) - 5, ".dmec");
+    Dmod_Free(cache_path);
+    unsetenv("DMELL_CACHE_DIR");
+
+    setenv("DMELL_CACHE", "0", 1);
+    EXPECT_EQ(dmell_cache_get_path("/scripts/run.dme"), nullptr);
+    unsetenv("DMELL_CACHE");
+}
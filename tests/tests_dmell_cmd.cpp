@@ -5,9 +5,12 @@
 
 #include <gtest/gtest.h>
 #include <string.h>
+#include <stdio.h>
+#include <string>
 
 extern "C" {
 #include "dmell_cmd.h"
+#include "dmell_io.h"
 #include "dmod_sal.h"
 }
 
@@ -280,6 +283,84 @@ TEST_F(DmellCmdTest, RegisterMultipleCommands)
     EXPECT_STREQ(cmd2->name, "test_cmd2");
 }
 
+/**
+ * @brief Test that registering an existing name replaces the command
+ */
+TEST_F(DmellCmdTest, RegisterReplacesExistingCommand)
+{
+    ASSERT_EQ(dmell_register_command_handler("replace_cmd", test_handler), 0);
+    ASSERT_EQ(dmell_register_command_handler("replace_cmd", test_handler2), 0);
+
+    const dmell_cmd_t* found = dmell_find_command("replace_cmd");
+    ASSERT_NE(found, nullptr);
+    EXPECT_EQ(found->handler, test_handler2);
+
+    EXPECT_EQ(dmell_unregister_command(found), 0);
+    EXPECT_EQ(dmell_find_command("replace_cmd"), nullptr);
+}
+
+/**
+ * @brief Test that static commands are referenced without copying
+ */
+TEST_F(DmellCmdTest, RegisterStaticCommands)
+{
+    static const dmell_cmd_t commands[] = {
+        { "static_cmd1", test_handler },
+        { "static_cmd2", test_handler2 },
+    };
+
+    ASSERT_EQ(dmell_register_static_commands(commands, 2), 0);
+
+    EXPECT_EQ(dmell_find_command("static_cmd1"), &commands[0]);
+    EXPECT_EQ(dmell_find_command("static_cmd2"), &commands[1]);
+    EXPECT_LT(dmell_register_static_commands(nullptr, 1), 0);
+}
+
+/**
+ * @brief Test registering, iterating and unregistering many commands
+ */
+TEST_F(DmellCmdTest, RegisterManyCommands)
+{
+    char name[32];
+    for (int i = 0; i < 300; i++)
+    {
+        snprintf(name, sizeof(name), "many_cmd_%d", i);
+        ASSERT_EQ(dmell_register_command_handler(name, test_handler), 0);
+    }
+    for (int i = 0; i < 300; i += 3)
+    {
+        snprintf(name, sizeof(name), "many_cmd_%d", i);
+        ASSERT_EQ(dmell_unregister_command(dmell_find_command(name)), 0);
+    }
+
+    size_t iterator = 0;
+    int listed = 0;
+    for (const dmell_cmd_t* cmd = dmell_next_command(&iterator); cmd != nullptr; cmd = dmell_next_command(&iterator))
+    {
+        if (strncmp(cmd->name, "many_cmd_", 9) == 0)
+        {
+            listed++;
+        }
+    }
+    EXPECT_EQ(listed, 200);
+
+    for (int i = 0; i < 300; i++)
+    {
+        snprintf(name, sizeof(name), "many_cmd_%d", i);
+        const dmell_cmd_t* cmd = dmell_find_command(name);
+        if (i % 3 == 0)
+        {
+            EXPECT_EQ(cmd, nullptr) << name;
+        }
+        else
+        {
+            ASSERT_NE(cmd, nullptr) << name;
+            EXPECT_STREQ(cmd->name, name);
+            EXPECT_EQ(dmell_unregister_command(cmd), 0);
+        }
+    }
+}
+
 // ===============================================================
 //                  Command Parsing Tests
 // ===============================================================
@@ -294,18 +375,7 @@ protected:
 
     void TearDown() override
     {
-        // Free parsed argv
-        for (int i = 0; i < parsed_argv.argc; i++)
-        {
-            if (parsed_argv.argv != nullptr && parsed_argv.argv[i] != nullptr)
-            {
-                Dmod_Free(parsed_argv.argv[i]);
-            }
-        }
-        if (parsed_argv.argv != nullptr)
-        {
-            Dmod_Free(parsed_argv.argv);
-        }
+        dmell_free_argv(&parsed_argv);
     }
 
     dmell_argv_t parsed_argv;
@@ -460,6 +530,49 @@ TEST_F(DmellCmdParseTest, ProgramNameSet)
     EXPECT_STREQ(parsed_argv.program_name, "myprogram");
 }
 
+/**
+ * @brief Test that the parsed argument list is null terminated
+ */
+TEST_F(DmellCmdParseTest, ArgvNullTerminated)
+{
+    const char* cmd = "cmd a 'b c' d";
+    
+    int result = dmell_parse_command(cmd, strlen(cmd), &parsed_argv);
+    
+    EXPECT_EQ(result, 0);
+    ASSERT_EQ(parsed_argv.argc, 4);
+    EXPECT_STREQ(parsed_argv.argv[2], "b c");
+    EXPECT_EQ(parsed_argv.argv[4], nullptr);
+}
+
+/**
+ * @brief Test parsing a lone quote character
+ */
+TEST_F(DmellCmdParseTest, ParseLoneQuote)
+{
+    const char* cmd = "echo \"";
+    
+    int result = dmell_parse_command(cmd, strlen(cmd), &parsed_argv);
+    
+    EXPECT_EQ(result, 0);
+    ASSERT_EQ(parsed_argv.argc, 2);
+    EXPECT_STREQ(parsed_argv.argv[1], "\"");
+}
+
+/**
+ * @brief Test parsing a whitespace only command
+ */
+TEST_F(DmellCmdParseTest, ParseWhitespaceOnly)
+{
+    const char* cmd = "   \t ";
+    
+    int result = dmell_parse_command(cmd, strlen(cmd), &parsed_argv);
+    
+    EXPECT_EQ(result, 0);
+    EXPECT_EQ(parsed_argv.argc, 0);
+    EXPECT_EQ(parsed_argv.argv, nullptr);
+}
+
 // ===============================================================
 //                  Command String Execution Tests
 // ===============================================================
@@ -526,3 +639,192 @@ TEST_F(DmellCmdRunStringTest, RunEmptyCommandString)
     
     EXPECT_LT(result, 0);
 }
+
+// ===============================================================
+//                  Output Redirection Tests
+// ===============================================================
+
+// Handler that prints its arguments to the output and an error message
+static int redirect_handler(int argc, char** argv)
+{
+    g_last_argc = argc;
+    for (int i = 1; i < argc; i++)
+    {
+        dmell_printf("%s\n", argv[i]);
+    }
+    dmell_eprintf("error %d\n", argc);
+    return g_return_value;
+}
+
+class DmellCmdRedirectTest : public ::testing::Test
+{
+protected:
+    void SetUp() override
+    {
+        reset_globals();
+        dmell_register_command_handler("redir_cmd", redirect_handler);
+        out_path = testing::TempDir() + "dmell_redirect_out.txt";
+        err_path = testing::TempDir() + "dmell_redirect_err.txt";
+        remove(out_path.c_str());
+        remove(err_path.c_str());
+    }
+
+    void TearDown() override
+    {
+        remove(out_path.c_str());
+        remove(err_path.c_str());
+    }
+
+    int run(const std::string& line)
+    {
+        return dmell_run_command_string(line.c_str(), line.size());
+    }
+
+    static std::string read_file(const std::string& path)
+    {
+        std::string content;
+        FILE* file = fopen(path.c_str(), "r");
+        if (file != nullptr)
+        {
+            char buffer[64];
+            size_t len = 0;
+            while ((len = fread(buffer, 1, sizeof(buffer), file)) > 0)
+            {
+                content.append(buffer, len);
+            }
+            fclose(file);
+        }
+        return content;
+    }
+
+    std::string out_path;
+    std::string err_path;
+};
+
+/**
+ * @brief Test redirecting the output to a file
+ */
+TEST_F(DmellCmdRedirectTest, RedirectOutput)
+{
+    EXPECT_EQ(run("redir_cmd a b > " + out_path), 0);
+
+    EXPECT_EQ(g_last_argc, 3);
+    EXPECT_EQ(read_file(out_path), "a\nb\n");
+    EXPECT_TRUE(dmell_io_output_is_console());
+}
+
+/**
+ * @brief Test appending the output to a file with the file name attached to the operator
+ */
+TEST_F(DmellCmdRedirectTest, AppendOutput)
+{
+    run("redir_cmd one >" + out_path);
+    run("redir_cmd two >>" + out_path);
+
+    EXPECT_EQ(read_file(out_path), "one\ntwo\n");
+}
+
+/**
+ * @brief Test redirecting the output and the errors to different files
+ */
+TEST_F(DmellCmdRedirectTest, RedirectErrors)
+{
+    g_return_value = 4;
+
+    EXPECT_EQ(run("redir_cmd x 2> " + err_path + " > " + out_path), 4);
+
+    EXPECT_EQ(g_last_argc, 2);
+    EXPECT_EQ(read_file(out_path), "x\n");
+    EXPECT_EQ(read_file(err_path), "error 2\n");
+}
+
+/**
+ * @brief Test that '2>&1' sends the standard error to the file of the standard output
+ */
+TEST_F(DmellCmdRedirectTest, RedirectErrorsToOutput)
+{
+    EXPECT_EQ(run("redir_cmd x > " + out_path + " 2>&1"), 0);
+
+    EXPECT_EQ(g_last_argc, 2);
+    EXPECT_EQ(read_file(out_path), "x\nerror 2\n");
+}
+
+/**
+ * @brief Test that a redirection without a file name is rejected
+ */
+TEST_F(DmellCmdRedirectTest, MissingFileName)
+{
+    EXPECT_EQ(run("redir_cmd a >"), -EINVAL);
+    EXPECT_EQ(g_last_argc, 0);
+}
+
+/**
+ * @brief Test that an output larger than the writer buffer is written completely
+ */
+TEST_F(DmellCmdRedirectTest, RedirectLargeOutput)
+{
+    std::string word(300, 'w');
+    std::string line = "redir_cmd";
+    std::string expected;
+    for (int i = 0; i < 10; i++)
+    {
+        line += " " + word;
+        expected += word + "\n";
+    }
+
+    EXPECT_EQ(run(line + " > " + out_path), 0);
+    EXPECT_EQ(read_file(out_path), expected);
+}
+
+/**
+ * @brief Test that quoted operators and argument arrays are never redirections
+ */
+TEST_F(DmellCmdRedirectTest, QuotedOperatorsAreArguments)
+{
+    EXPECT_EQ(run("redir_cmd \">\" " + out_path + " '>>" + out_path + "'"), 0);
+    EXPECT_EQ(g_last_argc, 4);
+    EXPECT_EQ(fopen(out_path.c_str(), "r"), nullptr);
+
+    char* argv[] = { (char*)"redir_cmd", (char*)">", (char*)out_path.c_str(), nullptr };
+    EXPECT_EQ(dmell_run_command("redir_cmd", 3, argv), 0);
+    EXPECT_EQ(g_last_argc, 3);
+    EXPECT_EQ(fopen(out_path.c_str(), "r"), nullptr);
+}
+
+/**
+ * @brief Test that the parser separates the redirections from the arguments
+ */
+TEST_F(DmellCmdRedirectTest, ParseRedirections)
+{
+    const char* cmd = "cmd a 2>>err.txt \">\" > \"out file.txt\"";
+    dmell_argv_t parsed = {};
+    ASSERT_EQ(dmell_parse_command(cmd, strlen(cmd), &parsed), 0);
+
+    ASSERT_EQ(parsed.argc, 3);
+    EXPECT_STREQ(parsed.argv[2], ">");
+    EXPECT_EQ(parsed.argv[3], nullptr);
+    EXPECT_STREQ(parsed.redirect.output, "out file.txt");
+    EXPECT_FALSE(parsed.redirect.output_append);
+    EXPECT_STREQ(parsed.redirect.error, "err.txt");
+    EXPECT_TRUE(parsed.redirect.error_append);
+    dmell_free_argv(&parsed);
+}
+
+/**
+ * @brief Test that a command whose output cannot be captured does not touch the file
+ */
+TEST_F(DmellCmdRedirectTest, UncapturedCommandIsRejected)
+{
+    FILE* file = fopen(out_path.c_str(), "w");
+    ASSERT_NE(file, nullptr);
+    fputs("keep", file);
+    fclose(file);
+
+    dmell_set_capture_check([](const char*) { return false; });
+    EXPECT_EQ(run("redir_external > " + out_path), -ENOTSUP);
+    EXPECT_TRUE(dmell_is_output_captured("redir_cmd"));
+    EXPECT_FALSE(dmell_is_output_captured("redir_external"));
+    dmell_set_capture_check(nullptr);
+
+    EXPECT_EQ(read_file(out_path), "keep");
+}
@@ -0,0 +1,107 @@
+/**
+ * @file tests_dmell_env.cpp
+ * @brief Unit tests for the dmell environment lookup cache
+ */
+
+#include <gtest/gtest.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+
+extern "C" {
+#include "dmell_env.h"
+#include "dmell_hlp.h"
+#include "dmod_sal.h"
+}
+
+// ===============================================================
+//                  Environment Cache Tests
+// ===============================================================
+
+class DmellEnvTest : public ::testing::Test
+{
+protected:
+    void SetUp() override
+    {
+        dmell_env_changed();
+    }
+
+    void TearDown() override
+    {
+        unsetenv("DMELL_ENV_TEST");
+        dmell_env_changed();
+    }
+
+    static const char* get(const std::string& name)
+    {
+        return dmell_env_get(name.data(), name.size(), dmell_hash_name(name.data(), name.size()));
+    }
+};
+
+/**
+ * @brief Test that values are served from the cache until the environment changes
+ */
+TEST_F(DmellEnvTest, CachesUntilChanged)
+{
+    setenv("DMELL_ENV_TEST", "first", 1);
+    EXPECT_STREQ(get("DMELL_ENV_TEST"), "first");
+
+    // A change that is not reported is not seen
+    setenv("DMELL_ENV_TEST", "second", 1);
+    EXPECT_STREQ(get("DMELL_ENV_TEST"), "first");
+
+    dmell_env_changed();
+    EXPECT_STREQ(get("DMELL_ENV_TEST"), "second");
+}
+
+/**
+ * @brief Test that names that are not set are cached too
+ */
+TEST_F(DmellEnvTest, CachesMissingNames)
+{
+    EXPECT_EQ(get("DMELL_ENV_TEST"), nullptr);
+    setenv("DMELL_ENV_TEST", "value", 1);
+    EXPECT_EQ(get("DMELL_ENV_TEST"), nullptr);
+
+    dmell_env_changed();
+    EXPECT_STREQ(get("DMELL_ENV_TEST"), "value");
+}
+
+/**
+ * @brief Test names that are not null terminated and names too long to be cached
+ */
+TEST_F(DmellEnvTest, NameBounds)
+{
+    setenv("DMELL_ENV_TEST", "value", 1);
+    const char* text = "DMELL_ENV_TEST_SUFFIX";
+    EXPECT_STREQ(dmell_env_get(text, 14, dmell_hash_name(text, 14)), "value");
+
+    std::string long_name(DMELL_ENV_CACHE_NAME_LEN + 8, 'L');
+    setenv(long_name.c_str(), "long", 1);
+    EXPECT_STREQ(get(long_name), "long");
+    setenv(long_name.c_str(), "longer", 1);
+    EXPECT_STREQ(get(long_name), "longer");
+    unsetenv(long_name.c_str());
+
+    EXPECT_EQ(dmell_env_get(nullptr, 0, 0), nullptr);
+}
+
+/**
+ * @brief Test that cached values are copies and that long values are not cached
+ */
+TEST_F(DmellEnvTest, ValuesAreCopied)
+{
+    char value[] = "first";
+    setenv("DMELL_ENV_TEST", value, 1);
+    const char* cached = get("DMELL_ENV_TEST");
+    ASSERT_NE(cached, nullptr);
+    EXPECT_NE(cached, getenv("DMELL_ENV_TEST"));
+    EXPECT_STREQ(cached, "first");
+
+    std::string long_value(DMELL_ENV_CACHE_VALUE_LEN + 8, 'V');
+    setenv("DMELL_ENV_TEST", long_value.c_str(), 1);
+    dmell_env_changed();
+    EXPECT_STREQ(get("DMELL_ENV_TEST"), long_value.c_str());
+    setenv("DMELL_ENV_TEST", "short", 1);
+    EXPECT_STREQ(get("DMELL_ENV_TEST"), "short");
+}
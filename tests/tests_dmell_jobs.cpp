@@ -0,0 +1,56 @@
+/**
+ * @file tests_dmell_jobs.cpp
+ * @brief Unit tests for the dmell background job table
+ */
+
+#include <gtest/gtest.h>
+#include <errno.h>
+
+extern "C" {
+#include "dmell_jobs.h"
+#include "dmod_sal.h"
+}
+
+// ===============================================================
+//                  Job Table Tests
+// ===============================================================
+
+/**
+ * @brief Test switching the background mode
+ */
+TEST(DmellJobsTest, SetBackground)
+{
+    EXPECT_FALSE(dmell_jobs_set_background(true));
+    EXPECT_TRUE(dmell_jobs_is_background());
+    EXPECT_TRUE(dmell_jobs_set_background(false));
+    EXPECT_FALSE(dmell_jobs_is_background());
+}
+
+/**
+ * @brief Test the empty job table
+ */
+TEST(DmellJobsTest, EmptyTable)
+{
+    size_t iterator = 0;
+
+    EXPECT_EQ(dmell_jobs_next(&iterator), nullptr);
+    EXPECT_EQ(dmell_jobs_next(nullptr), nullptr);
+    EXPECT_EQ(dmell_jobs_find(1), nullptr);
+    EXPECT_FALSE(dmell_jobs_is_running(nullptr));
+}
+
+/**
+ * @brief Test waiting for a job that does not exist
+ */
+TEST(DmellJobsTest, WaitUnknownJob)
+{
+    EXPECT_EQ(dmell_jobs_wait(4242), -ECHILD);
+}
+
+/**
+ * @brief Test spawning with invalid arguments
+ */
+TEST(DmellJobsTest, SpawnInvalidArguments)
+{
+    EXPECT_EQ(dmell_jobs_spawn(nullptr, 0, nullptr, nullptr), -EINVAL);
+}
@@ -4,11 +4,16 @@
  */
 
 #include <gtest/gtest.h>
+#include <errno.h>
+#include <stdlib.h>
 #include <string.h>
+#include <string>
+#include <vector>
 
 extern "C" {
 #include "dmell_line.h"
 #include "dmell_cmd.h"
+#include "dmell_jobs.h"
 #include "dmod_sal.h"
 }
 
@@ -54,6 +59,92 @@ static int line_failure_handler(int argc, char** argv)
     return 1;
 }
 
+// Arguments seen by the recording handler, joined with '|'
+static std::vector<std::string> g_args_seen;
+
+// Handler that records its arguments and checks that they are terminated
+static int args_record_handler(int argc, char** argv)
+{
+    std::string joined;
+    for (int i = 0; i < argc; i++)
+    {
+        joined += std::string(argv[i]) + "|";
+    }
+    g_args_seen.push_back(argv[argc] == nullptr ? joined : "unterminated");
+    return 0;
+}
+
+// Background mode seen by the recording handler
+static std::string g_background_calls;
+
+// Handler that records if it was started in the background
+static int line_background_handler(int argc, char** argv)
+{
+    (void)argc;
+    (void)argv;
+    g_background_calls += dmell_jobs_is_background() ? "B" : "F";
+    return 0;
+}
+
+// Input read by the consuming handler
+static std::string g_consumed;
+
+// Handler that writes its arguments to the standard output
+static int line_produce_handler(int argc, char** argv)
+{
+    for (int i = 1; i < argc; i++)
+    {
+        dmell_io_puts(argv[i]);
+    }
+    g_call_count++;
+    return 0;
+}
+
+// Handler that writes 100 lines of 100 characters, more than the default pipe limit
+static int line_big_handler(int argc, char** argv)
+{
+    (void)argc;
+    (void)argv;
+    std::string text(99, 'x');
+    for (int i = 0; i < 100; i++)
+    {
+        dmell_printf("%s\n", text.c_str());
+    }
+    g_call_count++;
+    return 0;
+}
+
+// Handler that copies its input to the output with a prefix
+static int line_relay_handler(int argc, char** argv)
+{
+    (void)argc;
+    (void)argv;
+    dmell_io_puts(">");
+    int c = 0;
+    while ((c = dmell_io_getc()) >= 0)
+    {
+        char ch = (char)c;
+        dmell_io_write(&ch, 1);
+    }
+    g_call_count++;
+    return 0;
+}
+
+// Handler that records its input
+static int line_consume_handler(int argc, char** argv)
+{
+    (void)argc;
+    (void)argv;
+    char buffer[8];
+    int len = 0;
+    while ((len = dmell_io_read(buffer, sizeof(buffer))) > 0)
+    {
+        g_consumed.append(buffer, len);
+    }
+    g_call_count++;
+    return 3;
+}
+
 // ===============================================================
 //                  Line Execution Tests
 // ===============================================================
@@ -68,6 +159,13 @@ protected:
         dmell_register_command_handler("line_cmd", counting_handler);
         dmell_register_command_handler("line_success", line_success_handler);
         dmell_register_command_handler("line_fail", line_failure_handler);
+        dmell_register_command_handler("line_produce", line_produce_handler);
+        dmell_register_command_handler("line_relay", line_relay_handler);
+        dmell_register_command_handler("line_consume", line_consume_handler);
+        dmell_register_command_handler("line_bg", line_background_handler);
+        dmell_register_command_handler("line_big", line_big_handler);
+        g_consumed.clear();
+        g_background_calls.clear();
     }
 
     void TearDown() override
@@ -243,6 +341,154 @@ TEST_F(DmellLineTest, ComplexCombinedSeparators)
     EXPECT_EQ(g_call_count, 3);
 }
 
+/**
+ * @brief Test that a pipe passes the output of a command to the next one
+ */
+TEST_F(DmellLineTest, PipePassesOutput)
+{
+    const char* line = "line_produce hello world | line_consume";
+    int result = dmell_run_line(line, strlen(line));
+
+    EXPECT_EQ(result, 3);
+    EXPECT_EQ(g_call_count, 2);
+    EXPECT_EQ(g_consumed, "helloworld");
+    EXPECT_TRUE(dmell_io_output_is_console());
+    EXPECT_TRUE(dmell_io_input_is_console());
+}
+
+/**
+ * @brief Test that a quoted '|' is not a pipe
+ */
+TEST_F(DmellLineTest, QuotedPipeIsText)
+{
+    const char* line = "line_produce \"a | b\" 'c|d' | line_consume";
+    int result = dmell_run_line(line, strlen(line));
+
+    EXPECT_EQ(result, 3);
+    EXPECT_EQ(g_call_count, 2);
+    EXPECT_EQ(g_consumed, "a | bc|d");
+}
+
+/**
+ * @brief Test that a quoted '&' and the '&' of "2>&1" do not start a background command
+ */
+TEST_F(DmellLineTest, QuotedBackgroundIsText)
+{
+    const char* line = "line_produce \"Tom & Jerry\" 2>&1 | line_consume";
+    int result = dmell_run_line(line, strlen(line));
+
+    EXPECT_EQ(result, 3);
+    EXPECT_EQ(g_call_count, 2);
+    EXPECT_EQ(g_consumed, "Tom & Jerry");
+
+    dmell_line_sep_t sep = dmell_line_sep_none;
+    const char* text = "a 2>&1 & b";
+    const char* ptr = dmell_line_find_separator(text, text + strlen(text), &sep);
+    EXPECT_EQ(sep, dmell_line_sep_background);
+    EXPECT_EQ(ptr, text + 7);
+}
+
+/**
+ * @brief Test a pipeline of more than two commands
+ */
+TEST_F(DmellLineTest, PipeChain)
+{
+    const char* line = "line_produce abc | line_relay | line_relay | line_consume";
+    dmell_run_line(line, strlen(line));
+
+    EXPECT_EQ(g_call_count, 4);
+    EXPECT_EQ(g_consumed, ">>abc");
+}
+
+/**
+ * @brief Test that a pipeline skipped by '&&' is skipped as a whole
+ */
+TEST_F(DmellLineTest, PipelineSkippedAsWhole)
+{
+    const char* line = "line_fail && line_produce a | line_consume; line_produce b | line_consume";
+    dmell_run_line(line, strlen(line));
+
+    EXPECT_EQ(g_call_count, 3);
+    EXPECT_EQ(g_consumed, "b");
+}
+
+/**
+ * @brief Test that an output larger than the pipe limit fails the pipeline
+ */
+TEST_F(DmellLineTest, PipeOverflowFailsPipeline)
+{
+    const char* line = "line_big | line_consume";
+    int result = dmell_run_line(line, strlen(line));
+
+    EXPECT_EQ(result, -ENOSPC);
+    EXPECT_EQ(g_call_count, 1);
+    EXPECT_EQ(g_consumed, "");
+
+    // A larger limit can be set at run time
+    setenv("DMELL_PIPE_LIMIT", "16384", 1);
+    result = dmell_run_line(line, strlen(line));
+    unsetenv("DMELL_PIPE_LIMIT");
+
+    EXPECT_EQ(result, 3);
+    EXPECT_EQ(g_call_count, 3);
+    EXPECT_EQ(g_consumed.size(), 10000u);
+}
+
+/**
+ * @brief Test that a pipeline stops at a command whose output cannot be captured
+ */
+TEST_F(DmellLineTest, UncapturedStageIsRejected)
+{
+    dmell_set_default_handler(line_success_handler);
+    dmell_set_capture_check([](const char*) { return false; });
+
+    const char* line = "line_produce a | line_external | line_consume; line_external";
+    int result = dmell_run_line(line, strlen(line));
+
+    dmell_set_capture_check(nullptr);
+    dmell_set_default_handler(nullptr);
+
+    EXPECT_EQ(result, 0);
+    EXPECT_EQ(g_call_count, 2);
+    EXPECT_EQ(g_consumed, "");
+    EXPECT_TRUE(dmell_io_output_is_console());
+    EXPECT_TRUE(dmell_io_input_is_console());
+}
+
+/**
+ * @brief Test that only the command followed by '&' is marked to run in the background
+ */
+TEST_F(DmellLineTest, BackgroundSeparator)
+{
+    const char* line = "line_bg & line_bg && line_bg &";
+    int result = dmell_run_line(line, strlen(line));
+
+    EXPECT_EQ(result, 0);
+    EXPECT_EQ(g_background_calls, "BFB");
+    EXPECT_FALSE(dmell_jobs_is_background());
+}
+
+/**
+ * @brief Test finding the pipe separator next to the 'OR' separator
+ */
+TEST_F(DmellLineTest, FindPipeSeparator)
+{
+    const char* line = "a || b | c";
+    dmell_line_sep_t sep = dmell_line_sep_none;
+
+    const char* ptr = dmell_line_find_separator(line, line + strlen(line), &sep);
+    EXPECT_EQ(sep, dmell_line_sep_or);
+    ptr = dmell_line_skip_separator(ptr, line + strlen(line), sep);
+    ptr = dmell_line_find_separator(ptr, line + strlen(line), &sep);
+    EXPECT_EQ(sep, dmell_line_sep_pipe);
+    EXPECT_EQ(ptr, line + 7);
+
+    const char* quoted = "a \"b | c\" 'd;e' `f&g` | h";
+    ptr = dmell_line_find_separator(quoted, quoted + strlen(quoted), &sep);
+    EXPECT_EQ(sep, dmell_line_sep_pipe);
+    EXPECT_EQ(ptr, quoted + 22);
+}
+
 // ===============================================================
 //                  Args Line Tests
 // ===============================================================
@@ -321,7 +567,41 @@ TEST_F(DmellArgsLineTest, RunArgsLineWithSeparators)
     
     int result = dmell_run_args_line(4, argv);
     
-    // This should treat the whole thing as one command line string
-    // and parse separators correctly
+    // Only whole separator arguments split the commands, so "arg1;" is an argument
     EXPECT_GE(g_call_count, 1);
 }
+
+/**
+ * @brief Test that separator arguments split the commands and follow their logic
+ */
+TEST_F(DmellArgsLineTest, RunArgsLineSeparatorArguments)
+{
+    g_return_values[0] = 1;
+    g_return_values[1] = 0;
+    g_return_values[2] = 0;
+    char* argv[] = { (char*)"args_cmd", (char*)"&&", (char*)"args_cmd", (char*)"||",
+                     (char*)"args_cmd", (char*)";", (char*)"args_cmd", (char*)";" };
+
+    int result = dmell_run_args_line(8, argv);
+
+    // The command after '&&' is skipped, the one after '||' runs
+    EXPECT_EQ(result, 0);
+    EXPECT_EQ(g_call_count, 3);
+}
+
+/**
+ * @brief Test that arguments are passed to the command without parsing them again
+ */
+TEST_F(DmellArgsLineTest, RunArgsLineKeepsArguments)
+{
+    dmell_register_command_handler("args_rec", args_record_handler);
+    g_args_seen.clear();
+    char* argv[] = { (char*)"args_rec", (char*)"a b", (char*)"'q'", (char*)"", (char*)"|", (char*)"args_rec", (char*)"x" };
+
+    int result = dmell_run_args_line(7, argv);
+
+    EXPECT_EQ(result, 0);
+    ASSERT_EQ(g_args_seen.size(), 2u);
+    EXPECT_EQ(g_args_seen[0], "args_rec|a b|'q'||");
+    EXPECT_EQ(g_args_seen[1], "args_rec|x|");
+}
@@ -0,0 +1,170 @@
+/**
+ * @file tests_dmell_pipe.cpp
+ * @brief Unit tests for dmell pipes and command streams
+ */
+
+#include <gtest/gtest.h>
+#include <string.h>
+#include <string>
+
+extern "C" {
+#include "dmell_pipe.h"
+#include "dmell_io.h"
+#include "dmod_sal.h"
+}
+
+// ===============================================================
+//                  Pipe Tests
+// ===============================================================
+
+class DmellPipeTest : public ::testing::Test
+{
+protected:
+    void SetUp() override
+    {
+        pipe = {};
+    }
+
+    void TearDown() override
+    {
+        dmell_pipe_free(&pipe);
+    }
+
+    std::string read_all()
+    {
+        std::string result;
+        char buffer[16];
+        size_t len = 0;
+        while ((len = dmell_pipe_read(&pipe, buffer, sizeof(buffer))) > 0)
+        {
+            result.append(buffer, len);
+        }
+        return result;
+    }
+
+    dmell_pipe_t pipe;
+};
+
+/**
+ * @brief Test writing and reading data
+ */
+TEST_F(DmellPipeTest, WriteAndRead)
+{
+    EXPECT_EQ(dmell_pipe_write(&pipe, "hello", 5), 0);
+    EXPECT_EQ(dmell_pipe_write(&pipe, " world", 6), 0);
+
+    EXPECT_EQ(pipe.length, 11u);
+    EXPECT_EQ(read_all(), "hello world");
+    EXPECT_EQ(pipe.length, 0u);
+    EXPECT_EQ(dmell_pipe_getc(&pipe), -1);
+}
+
+/**
+ * @brief Test that the data wraps around the end of the storage
+ */
+TEST_F(DmellPipeTest, WrapsAround)
+{
+    char chunk[100];
+    memset(chunk, 'a', sizeof(chunk));
+    ASSERT_EQ(dmell_pipe_write(&pipe, chunk, sizeof(chunk)), 0);
+    for (int round = 1; round < 20; round++)
+    {
+        memset(chunk, 'a' + round, sizeof(chunk));
+        ASSERT_EQ(dmell_pipe_write(&pipe, chunk, sizeof(chunk)), 0);
+        char out[100];
+        ASSERT_EQ(dmell_pipe_read(&pipe, out, sizeof(out)), sizeof(out));
+        EXPECT_EQ(std::string(out, sizeof(out)), std::string(sizeof(out), 'a' + round - 1));
+    }
+
+    EXPECT_EQ(pipe.capacity, (size_t)DMELL_PIPE_MIN_CAPACITY);
+    EXPECT_EQ(read_all(), std::string(100, 'a' + 19));
+}
+
+/**
+ * @brief Test that growing the storage keeps the order of wrapped data
+ */
+TEST_F(DmellPipeTest, GrowKeepsOrder)
+{
+    std::string text(DMELL_PIPE_MIN_CAPACITY - 10, 'x');
+    ASSERT_EQ(dmell_pipe_write(&pipe, text.c_str(), text.size()), 0);
+    char out[200];
+    ASSERT_EQ(dmell_pipe_read(&pipe, out, sizeof(out)), sizeof(out));
+    ASSERT_EQ(dmell_pipe_write(&pipe, "0123456789abcdef", 16), 0);
+    ASSERT_EQ(dmell_pipe_write(&pipe, std::string(300, 'y').c_str(), 300), 0);
+
+    std::string result = read_all();
+    EXPECT_EQ(result.size(), text.size() - sizeof(out) + 316);
+    EXPECT_EQ(result.substr(text.size() - sizeof(out), 16), "0123456789abcdef");
+    EXPECT_EQ(result.back(), 'y');
+}
+
+/**
+ * @brief Test that the pipe rejects data above its limit
+ */
+TEST_F(DmellPipeTest, RejectsDataAboveLimit)
+{
+    pipe.limit = 8;
+
+    EXPECT_EQ(dmell_pipe_write(&pipe, "12345", 5), 0);
+    EXPECT_EQ(dmell_pipe_write(&pipe, "6789", 4), -ENOSPC);
+    EXPECT_EQ(dmell_pipe_write(&pipe, "678", 3), 0);
+    EXPECT_EQ(read_all(), "12345678");
+
+    // The first error is kept until the pipe is freed
+    EXPECT_EQ(pipe.error, -ENOSPC);
+    dmell_pipe_free(&pipe);
+    EXPECT_EQ(pipe.error, 0);
+}
+
+/**
+ * @brief Test writing with invalid arguments
+ */
+TEST_F(DmellPipeTest, WriteInvalidArguments)
+{
+    EXPECT_EQ(dmell_pipe_write(nullptr, "a", 1), -EINVAL);
+    EXPECT_EQ(dmell_pipe_write(&pipe, nullptr, 1), -EINVAL);
+    EXPECT_EQ(dmell_pipe_write(&pipe, nullptr, 0), 0);
+}
+
+// ===============================================================
+//                  Stream Tests
+// ===============================================================
+
+/**
+ * @brief Test that the output and input streams can be sent through a pipe
+ */
+TEST_F(DmellPipeTest, StreamsUsePipe)
+{
+    dmell_io_t saved;
+    dmell_io_save(&saved);
+    dmell_io_set_output(dmell_io_pipe, &pipe);
+    dmell_io_set_input(dmell_io_pipe, &pipe);
+
+    EXPECT_FALSE(dmell_io_output_is_console());
+    dmell_io_puts("abc");
+    dmell_printf("%d-%s", 42, "x");
+    EXPECT_EQ(dmell_io_getc(), 'a');
+    char buffer[16] = {};
+    EXPECT_EQ(dmell_io_read(buffer, sizeof(buffer)), 6);
+    EXPECT_STREQ(buffer, "bc42-x");
+
+    dmell_io_restore(&saved);
+    EXPECT_TRUE(dmell_io_output_is_console());
+    EXPECT_TRUE(dmell_io_input_is_console());
+}
+
+/**
+ * @brief Test formatting output longer than the stack buffer
+ */
+TEST_F(DmellPipeTest, PrintfLongOutput)
+{
+    std::string text(DMELL_IO_FORMAT_SIZE * 3, 'z');
+    dmell_io_t saved;
+    dmell_io_save(&saved);
+    dmell_io_set_output(dmell_io_pipe, &pipe);
+
+    dmell_printf("[%s]", text.c_str());
+
+    dmell_io_restore(&saved);
+    EXPECT_EQ(read_all(), "[" + text + "]");
+}
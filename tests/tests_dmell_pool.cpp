@@ -0,0 +1,139 @@
+/**
+ * @file tests_dmell_pool.cpp
+ * @brief Unit tests for the dmell module pool
+ */
+
+#include <gtest/gtest.h>
+
+extern "C" {
+#include "dmell_pool.h"
+#include "dmod_sal.h"
+}
+
+// ===============================================================
+//                  Module Pool Tests
+// ===============================================================
+
+class DmellPoolTest : public ::testing::Test
+{
+protected:
+    void SetUp() override
+    {
+        dmell_pool_flush();
+        dmell_pool_configure(DMELL_POOL_DEFAULT_SIZE, DMELL_POOL_DEFAULT_BUDGET);
+        dmell_pool_get_stats(&initial);
+    }
+
+    void TearDown() override
+    {
+        dmell_pool_flush();
+        dmell_pool_configure(DMELL_POOL_DEFAULT_SIZE, DMELL_POOL_DEFAULT_BUDGET);
+    }
+
+    dmell_pool_stats_t initial;
+};
+
+/**
+ * @brief Test the default configuration of the pool
+ */
+TEST_F(DmellPoolTest, DefaultConfiguration)
+{
+    EXPECT_EQ(initial.count, 0u);
+    EXPECT_EQ(initial.resident_bytes, 0u);
+    EXPECT_EQ(initial.max_count, (size_t)DMELL_POOL_DEFAULT_SIZE);
+    EXPECT_EQ(initial.budget, (size_t)DMELL_POOL_DEFAULT_BUDGET);
+    EXPECT_EQ(dmell_pool_first(), nullptr);
+    EXPECT_EQ(initial.max_count, 0u);
+    EXPECT_LE(initial.budget, 16u * 1024u);
+}
+
+/**
+ * @brief Test that a disabled pool does not load modules
+ */
+TEST_F(DmellPoolTest, DisabledPool)
+{
+    dmell_pool_configure(0, DMELL_POOL_DEFAULT_BUDGET);
+
+    EXPECT_FALSE(dmell_pool_acquire("pool_test_module", nullptr));
+
+    dmell_pool_stats_t stats;
+    dmell_pool_get_stats(&stats);
+    EXPECT_EQ(stats.misses, initial.misses);
+    EXPECT_EQ(stats.count, 0u);
+}
+
+/**
+ * @brief Test that a module that cannot be loaded is not kept
+ */
+TEST_F(DmellPoolTest, MissingModuleNotResident)
+{
+    dmell_pool_configure(4, DMELL_POOL_DEFAULT_BUDGET);
+    EXPECT_FALSE(dmell_pool_acquire("pool_missing_module", nullptr));
+
+    dmell_pool_stats_t stats;
+    dmell_pool_get_stats(&stats);
+    EXPECT_EQ(stats.misses, initial.misses + 1);
+    EXPECT_EQ(stats.hits, initial.hits);
+    EXPECT_EQ(stats.count, 0u);
+    EXPECT_EQ(dmell_pool_first(), nullptr);
+}
+
+/**
+ * @brief Test acquiring with invalid arguments
+ */
+TEST_F(DmellPoolTest, AcquireNullName)
+{
+    EXPECT_FALSE(dmell_pool_acquire(nullptr, nullptr));
+}
+
+/**
+ * @brief Test that the least recently used module loaded by the pool is evicted
+ */
+TEST_F(DmellPoolTest, EvictsLeastRecentlyUsed)
+{
+    dmell_pool_configure(2, DMELL_POOL_DEFAULT_BUDGET);
+
+    EXPECT_TRUE(dmell_pool_acquire("mod_a", nullptr));
+    EXPECT_TRUE(dmell_pool_acquire("mod_b", nullptr));
+    EXPECT_TRUE(dmell_pool_acquire("mod_a", nullptr));
+    EXPECT_TRUE(dmell_pool_acquire("mod_c", nullptr));
+
+    const dmell_pool_entry_t* entry = dmell_pool_first();
+    ASSERT_NE(entry, nullptr);
+    EXPECT_STREQ(entry->name, "mod_c");
+    ASSERT_NE(entry->next, nullptr);
+    EXPECT_STREQ(entry->next->name, "mod_a");
+    EXPECT_EQ(entry->next->next, nullptr);
+
+    dmell_pool_stats_t stats;
+    dmell_pool_get_stats(&stats);
+    EXPECT_EQ(stats.evictions, initial.evictions + 1);
+    EXPECT_EQ(stats.hits, initial.hits + 1);
+}
+
+/**
+ * @brief Test that modules loaded outside of the pool are not taken over
+ */
+TEST_F(DmellPoolTest, ExternalModulesAreNotOwned)
+{
+    dmell_pool_configure(2, DMELL_POOL_DEFAULT_BUDGET);
+
+    // A module loaded by the user is not pooled
+    dmell_pool_set_external("mod_user", true);
+    EXPECT_FALSE(dmell_pool_acquire("mod_user", nullptr));
+
+    // A pooled module loaded again by the user leaves the pool without being evicted
+    EXPECT_TRUE(dmell_pool_acquire("mod_pooled", nullptr));
+    dmell_pool_set_external("mod_pooled", true);
+    EXPECT_EQ(dmell_pool_first(), nullptr);
+
+    dmell_pool_stats_t stats;
+    dmell_pool_get_stats(&stats);
+    EXPECT_EQ(stats.count, 0u);
+    EXPECT_EQ(stats.evictions, initial.evictions);
+
+    // Once unloaded, the pool can load the module again
+    dmell_pool_set_external("mod_user", false);
+    dmell_pool_set_external("mod_pooled", false);
+    EXPECT_TRUE(dmell_pool_acquire("mod_user", nullptr));
+}
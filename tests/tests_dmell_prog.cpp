@@ -0,0 +1,598 @@
+/**
+ * @file tests_dmell_prog.cpp
+ * @brief Unit tests for dmell compiled script programs
+ */
+
+#include <gtest/gtest.h>
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+extern "C" {
+#include "dmell_prog.h"
+#include "dmell_cmd.h"
+#include "dmell_script.h"
+#include "dmell_handlers.h"
+#include "dmell_io.h"
+#include "dmell_jobs.h"
+#include "dmod_sal.h"
+}
+
+// Arguments of every call of the recording handler
+static std::vector<std::vector<std::string>> g_calls;
+static int g_prog_return_value = 0;
+
+// Handler that records its arguments
+static int prog_record_handler(int argc, char** argv)
+{
+    std::vector<std::string> args;
+    for (int i = 0; i < argc; i++)
+    {
+        args.push_back(argv[i]);
+    }
+    g_calls.push_back(args);
+    return g_prog_return_value;
+}
+
+// Handler that prints its arguments
+static int prog_print_handler(int argc, char** argv)
+{
+    for (int i = 1; i < argc; i++)
+    {
+        dmell_printf("%s\n", argv[i]);
+    }
+    return 0;
+}
+
+// Handler that records if it was started with '&'
+static int prog_bg_handler(int argc, char** argv)
+{
+    (void)argc;
+    (void)argv;
+    g_calls.push_back({ dmell_jobs_is_background() ? "B" : "F" });
+    return 0;
+}
+
+// Failure handler
+static int prog_fail_handler(int argc, char** argv)
+{
+    (void)argc;
+    (void)argv;
+    g_calls.push_back({ "prog_fail" });
+    return 1;
+}
+
+// ===============================================================
+//                  Program Compilation Tests
+// ===============================================================
+
+class DmellProgTest : public ::testing::Test
+{
+protected:
+    void SetUp() override
+    {
+        g_calls.clear();
+        g_prog_return_value = 0;
+        ctx = {};
+        // Use unique command names to avoid conflicts with other tests
+        dmell_register_command_handler("prog_rec", prog_record_handler);
+        dmell_register_command_handler("prog_fail", prog_fail_handler);
+        dmell_register_command_handler("prog_print", prog_print_handler);
+        dmell_register_command_handler("prog_bg", prog_bg_handler);
+        dmell_register_command_handler("set", dmell_handler_set);
+        dmell_register_command_handler("test", dmell_handler_test);
+        dmell_register_command_handler("[", dmell_handler_test);
+        dmell_set_substitution_handler(dmell_script_substitute);
+    }
+
+    void TearDown() override
+    {
+        dmell_set_substitution_handler(nullptr);
+        dmell_free_variables(&ctx.variables);
+        dmell_buf_free(&ctx.scratch);
+    }
+
+    int run(const char* text)
+    {
+        dmell_prog_t* prog = dmell_prog_compile(text, strlen(text));
+        EXPECT_NE(prog, nullptr);
+        if (prog == nullptr)
+        {
+            return -1;
+        }
+        int result = dmell_prog_run(prog, &ctx);
+        dmell_prog_release(prog);
+        return result;
+    }
+
+    dmell_script_ctx_t ctx;
+};
+
+/**
+ * @brief Test compiling a script without variables
+ */
+TEST_F(DmellProgTest, CompileTokenizesLiteralSegments)
+{
+    const char* text = "prog_rec a b\nprog_rec 'c d'\n";
+    dmell_prog_t* prog = dmell_prog_compile(text, strlen(text));
+
+    ASSERT_NE(prog, nullptr);
+    EXPECT_EQ(prog->line_count, 2u);
+    EXPECT_EQ(prog->part_count, 0u);
+    ASSERT_EQ(prog->instr_count, 4u);
+    EXPECT_EQ(prog->instrs[0].op, dmell_prog_op_cmd);
+    EXPECT_EQ(prog->instrs[0].argc, 3);
+    EXPECT_EQ(prog->instrs[1].op, dmell_prog_op_status);
+    EXPECT_EQ(prog->instrs[2].argc, 2);
+
+    dmell_prog_release(prog);
+}
+
+/**
+ * @brief Test that a segment with more arguments than an instruction can count is kept as text
+ */
+TEST_F(DmellProgTest, CompileKeepsHugeSegmentsAsText)
+{
+    std::string text = "prog_rec";
+    for (int i = 0; i < 65536; i++)
+    {
+        text += " a";
+    }
+    text += "\n";
+    dmell_prog_t* prog = dmell_prog_compile(text.c_str(), text.size());
+
+    ASSERT_NE(prog, nullptr);
+    ASSERT_GE(prog->instr_count, 1u);
+    EXPECT_EQ(prog->instrs[0].argc, 0);
+    EXPECT_GT(prog->instrs[0].count, 0u);
+
+    EXPECT_EQ(dmell_prog_run(prog, &ctx), 0);
+    ASSERT_EQ(g_calls.size(), 1u);
+    EXPECT_EQ(g_calls[0].size(), 65537u);
+    dmell_prog_release(prog);
+}
+
+/**
+ * @brief Test that comments and empty lines produce no instructions
+ */
+TEST_F(DmellProgTest, CompileSkipsCommentsAndEmptyLines)
+{
+    const char* text = "#!/bin/dmell\n\n   \n# comment\nprog_rec x # trailing\n";
+    dmell_prog_t* prog = dmell_prog_compile(text, strlen(text));
+
+    ASSERT_NE(prog, nullptr);
+    EXPECT_EQ(prog->instr_count, 2u);
+    EXPECT_EQ(prog->instrs[0].argc, 2);
+
+    dmell_prog_release(prog);
+}
+
+/**
+ * @brief Test that variable references become shared slots
+ */
+TEST_F(DmellProgTest, CompileVariableSlots)
+{
+    const char* text = "prog_rec $A ${B}\nprog_rec $A\n";
+    dmell_prog_t* prog = dmell_prog_compile(text, strlen(text));
+
+    ASSERT_NE(prog, nullptr);
+    EXPECT_EQ(prog->slot_count, 2u);
+    EXPECT_EQ(prog->instrs[0].argc, 0);
+    EXPECT_GT(prog->instrs[0].count, 0u);
+
+    dmell_prog_release(prog);
+}
+
+/**
+ * @brief Test compiling null text
+ */
+TEST_F(DmellProgTest, CompileNullText)
+{
+    EXPECT_EQ(dmell_prog_compile(nullptr, 10), nullptr);
+}
+
+// ===============================================================
+//                  Program Execution Tests
+// ===============================================================
+
+/**
+ * @brief Test running pre-tokenized commands
+ */
+TEST_F(DmellProgTest, RunLiteralCommands)
+{
+    int result = run("prog_rec a \"b c\"\nprog_rec d\n");
+
+    EXPECT_EQ(result, 0);
+    ASSERT_EQ(g_calls.size(), 2u);
+    ASSERT_EQ(g_calls[0].size(), 3u);
+    EXPECT_EQ(g_calls[0][2], "b c");
+    EXPECT_EQ(g_calls[1][1], "d");
+}
+
+/**
+ * @brief Test running commands with variables
+ */
+TEST_F(DmellProgTest, RunExpandsVariables)
+{
+    dmell_set_variable(&ctx.variables, "NAME", "World");
+
+    int result = run("prog_rec Hello $NAME!\n");
+
+    EXPECT_EQ(result, 0);
+    ASSERT_EQ(g_calls.size(), 1u);
+    ASSERT_EQ(g_calls[0].size(), 3u);
+    EXPECT_EQ(g_calls[0][2], "World!");
+}
+
+/**
+ * @brief Test that variables are read when the line runs, not when it is compiled
+ */
+TEST_F(DmellProgTest, RunUsesCurrentVariableValues)
+{
+    dmell_prog_t* prog = dmell_prog_compile("prog_rec $V", 11);
+    ASSERT_NE(prog, nullptr);
+
+    dmell_set_variable(&ctx.variables, "V", "one");
+    dmell_prog_run(prog, &ctx);
+    dmell_set_variable(&ctx.variables, "V", "two");
+    dmell_prog_run(prog, &ctx);
+    dmell_prog_release(prog);
+
+    ASSERT_EQ(g_calls.size(), 2u);
+    EXPECT_EQ(g_calls[0][1], "one");
+    EXPECT_EQ(g_calls[1][1], "two");
+}
+
+/**
+ * @brief Test separators inside a compiled line
+ */
+TEST_F(DmellProgTest, RunSeparators)
+{
+    int result = run("prog_fail && prog_rec no; prog_rec yes || prog_rec no\n");
+
+    EXPECT_EQ(result, 0);
+    ASSERT_EQ(g_calls.size(), 2u);
+    EXPECT_EQ(g_calls[0][0], "prog_fail");
+    EXPECT_EQ(g_calls[1][1], "yes");
+}
+
+/**
+ * @brief Test that separators inside quotes do not split a compiled line
+ */
+TEST_F(DmellProgTest, QuotedSeparatorsAreText)
+{
+    dmell_set_variable(&ctx.variables, "V", "v");
+    int result = run("prog_rec \"x | y\" 'a;b' && prog_rec \"w || $V\"\n");
+
+    EXPECT_EQ(result, 0);
+    ASSERT_EQ(g_calls.size(), 2u);
+    EXPECT_EQ(g_calls[0], (std::vector<std::string>{ "prog_rec", "x | y", "a;b" }));
+    EXPECT_EQ(g_calls[1], (std::vector<std::string>{ "prog_rec", "w || v" }));
+}
+
+/**
+ * @brief Test that a quoted '&' and the '&' of "2>&1" do not run a command in the background
+ */
+TEST_F(DmellProgTest, QuotedBackgroundIsText)
+{
+    int result = run("prog_rec \"Tom & Jerry\"\nprog_bg 2>&1\n");
+
+    EXPECT_EQ(result, 0);
+    ASSERT_EQ(g_calls.size(), 2u);
+    EXPECT_EQ(g_calls[0], (std::vector<std::string>{ "prog_rec", "Tom & Jerry" }));
+    EXPECT_EQ(g_calls[1][0], "F");
+}
+
+/**
+ * @brief Test that separators in variable values do not split a line, in a script and on the command line
+ */
+TEST_F(DmellProgTest, SeparatorsInValuesAreText)
+{
+    const char* line = "prog_rec $SEP && prog_rec end";
+    dmell_set_variable(&ctx.variables, "SEP", "a;prog_fail");
+
+    EXPECT_EQ(run(line), 0);
+    std::vector<std::vector<std::string>> compiled = g_calls;
+    ASSERT_EQ(compiled.size(), 2u);
+    EXPECT_EQ(compiled[0][1], "a;prog_fail");
+
+    g_calls.clear();
+    EXPECT_EQ(dmell_run_script_line(&ctx, line, strlen(line)), 0);
+    EXPECT_EQ(g_calls, compiled);
+
+    dmell_set_variable(&ctx.variables, "SEP", "a|prog_fail&&prog_fail");
+    g_calls.clear();
+    EXPECT_EQ(dmell_run_script_line(&ctx, line, strlen(line)), 0);
+    ASSERT_EQ(g_calls.size(), 2u);
+    EXPECT_EQ(g_calls[0][1], "a|prog_fail&&prog_fail");
+}
+
+/**
+ * @brief Test that quoted operators are arguments and unquoted ones redirect the output
+ */
+TEST_F(DmellProgTest, RunRedirections)
+{
+    std::string path = testing::TempDir() + "dmell_prog_redirect.txt";
+    remove(path.c_str());
+
+    EXPECT_EQ(run(("prog_rec \">\" '>>x' && prog_print out > " + path + "\n").c_str()), 0);
+    ASSERT_EQ(g_calls.size(), 1u);
+    EXPECT_EQ(g_calls[0], (std::vector<std::string>{ "prog_rec", ">", ">>x" }));
+
+    FILE* file = fopen(path.c_str(), "r");
+    ASSERT_NE(file, nullptr);
+    char buffer[16] = {};
+    EXPECT_EQ(fread(buffer, 1, sizeof(buffer) - 1, file), 4u);
+    fclose(file);
+    EXPECT_STREQ(buffer, "out\n");
+    remove(path.c_str());
+}
+
+/**
+ * @brief Test that a pipeline inside a compiled line is skipped as a whole
+ */
+TEST_F(DmellProgTest, RunPipelines)
+{
+    int result = run("prog_fail && prog_rec a | prog_rec b\nprog_rec c | prog_fail\n");
+
+    EXPECT_EQ(result, 0);
+    ASSERT_EQ(g_calls.size(), 3u);
+    EXPECT_EQ(g_calls[1][1], "c");
+    EXPECT_EQ(ctx.last_exit_code, 1);
+}
+
+/**
+ * @brief Test that '&' at the end of a compiled line marks the last command
+ */
+TEST_F(DmellProgTest, RunBackgroundSeparator)
+{
+    int result = run("prog_bg & prog_bg &\nprog_bg\n");
+
+    EXPECT_EQ(result, 0);
+    ASSERT_EQ(g_calls.size(), 3u);
+    EXPECT_EQ(g_calls[0][0], "B");
+    EXPECT_EQ(g_calls[1][0], "B");
+    EXPECT_EQ(g_calls[2][0], "F");
+    EXPECT_FALSE(dmell_jobs_is_background());
+}
+
+/**
+ * @brief Test that command substitutions capture the output of the command
+ */
+TEST_F(DmellProgTest, RunCommandSubstitution)
+{
+    dmell_set_variable(&ctx.variables, "W", "two");
+
+    int result = run("prog_rec $(prog_print one; prog_print $W),`prog_print (x)`\n");
+
+    EXPECT_EQ(result, 0);
+    ASSERT_EQ(g_calls.size(), 1u);
+    ASSERT_EQ(g_calls[0].size(), 3u);
+    EXPECT_EQ(g_calls[0][1], "one");
+    EXPECT_EQ(g_calls[0][2], "two,(x)");
+    EXPECT_TRUE(dmell_io_output_is_console());
+}
+
+/**
+ * @brief Test that a block has to be closed and its keywords have to be in order
+ */
+TEST_F(DmellProgTest, CompileRejectsInvalidBlocks)
+{
+    const char* texts[] = {
+        "if prog_rec a; then\nprog_rec b\n",
+        "while prog_rec a\nprog_rec b\ndone\n",
+        "prog_rec a\nfi\n",
+        "break\n",
+        "for x; do prog_rec $x; done\n",
+        "if prog_rec a; then prog_rec b; fi prog_rec c\n",
+        "function prog_open {\nprog_rec a\n",
+        "function prog_bad\nprog_rec a\n}\n",
+        "return 1\n",
+    };
+    for (const char* text : texts)
+    {
+        EXPECT_EQ(dmell_prog_compile(text, strlen(text)), nullptr) << text;
+    }
+}
+
+/**
+ * @brief Test the branches of an 'if' block
+ */
+TEST_F(DmellProgTest, RunIfElifElse)
+{
+    int result = run("if prog_fail; then\n"
+                     "  prog_rec a\n"
+                     "elif prog_rec b; then prog_rec c\n"
+                     "else\n"
+                     "  prog_rec d\n"
+                     "fi\n"
+                     "if prog_fail; then prog_rec e; else prog_rec f; fi\n");
+
+    EXPECT_EQ(result, 0);
+    ASSERT_EQ(g_calls.size(), 5u);
+    EXPECT_EQ(g_calls[1][1], "b");
+    EXPECT_EQ(g_calls[2][1], "c");
+    EXPECT_EQ(g_calls[4][1], "f");
+}
+
+/**
+ * @brief Test that the whitespace after a variable is kept
+ */
+TEST_F(DmellProgTest, RunKeepsWhitespaceAfterVariables)
+{
+    dmell_set_variable(&ctx.variables, "X", "ab");
+    int result = run("prog_rec $X cd ${X} $X\n");
+
+    EXPECT_EQ(result, 0);
+    ASSERT_EQ(g_calls.size(), 1u);
+    EXPECT_EQ(g_calls[0], (std::vector<std::string>{ "prog_rec", "ab", "cd", "ab", "ab" }));
+}
+
+/**
+ * @brief Test a 'while' loop with a condition on a variable
+ */
+TEST_F(DmellProgTest, RunWhileLoopWithTest)
+{
+    int result = run("set i=0\n"
+                     "while [ $i -lt 3 ]; do\n"
+                     "  prog_rec $i next\n"
+                     "  set i=$((i + 1))\n"
+                     "done\n");
+
+    EXPECT_EQ(result, 0);
+    ASSERT_EQ(g_calls.size(), 3u);
+    EXPECT_EQ(g_calls[0], (std::vector<std::string>{ "prog_rec", "0", "next" }));
+    EXPECT_EQ(g_calls[2], (std::vector<std::string>{ "prog_rec", "2", "next" }));
+    EXPECT_STREQ(dmell_get_variable_value(&ctx.variables, "i"), "3");
+}
+
+/**
+ * @brief Test 'test' and '[' with variable operands on script lines
+ */
+TEST_F(DmellProgTest, TestWithVariableOperands)
+{
+    dmell_set_variable(&ctx.variables, "I", "2");
+    dmell_set_variable(&ctx.variables, "NAME", "uart0");
+    dmell_set_variable(&ctx.variables, "EMPTY", "");
+
+    auto line = [this](const char* text) { return dmell_run_script_line(&ctx, text, strlen(text)); };
+    EXPECT_EQ(line("[ $I -lt 3 ]"), 0);
+    EXPECT_EQ(line("[ $I -ge 3 ]"), 1);
+    EXPECT_EQ(line("test $I -eq 2 -a $NAME = uart0"), 0);
+    EXPECT_EQ(line("test $NAME != uart0"), 1);
+    EXPECT_EQ(line("[ -z \"$EMPTY\" ]"), 0);
+    EXPECT_EQ(line("[ -n \"$NAME\" ] && prog_rec $NAME ok"), 0);
+    ASSERT_EQ(g_calls.size(), 1u);
+    EXPECT_EQ(g_calls[0], (std::vector<std::string>{ "prog_rec", "uart0", "ok" }));
+}
+
+/**
+ * @brief Test that the words of a 'for' loop are expanded when the loop starts
+ */
+TEST_F(DmellProgTest, RunForLoop)
+{
+    dmell_set_variable(&ctx.variables, "W", "b c");
+
+    int result = run("for v in a $W\n"
+                     "do\n"
+                     "  prog_rec $v\n"
+                     "  continue\n"
+                     "  prog_rec never\n"
+                     "done\n");
+
+    EXPECT_EQ(result, 0);
+    ASSERT_EQ(g_calls.size(), 3u);
+    EXPECT_EQ(g_calls[0][1], "a");
+    EXPECT_EQ(g_calls[1][1], "b");
+    EXPECT_EQ(g_calls[2][1], "c");
+}
+
+/**
+ * @brief Test that 'break' leaves only the innermost loop
+ */
+TEST_F(DmellProgTest, RunNestedLoopsWithBreak)
+{
+    int result = run("for a in 1 2; do\n"
+                     "  for b in x y; do prog_rec $a$b; prog_fail || break; done\n"
+                     "done\n"
+                     "while prog_rec w; do break; done\n");
+
+    EXPECT_EQ(result, 0);
+    ASSERT_EQ(g_calls.size(), 5u);
+    EXPECT_EQ(g_calls[0][1], "1x");
+    EXPECT_EQ(g_calls[2][1], "2x");
+    EXPECT_EQ(g_calls[4][1], "w");
+}
+
+/**
+ * @brief Test that a function gets its arguments as positional parameters
+ */
+TEST_F(DmellProgTest, RunFunctionWithParameters)
+{
+    dmell_set_variable(&ctx.variables, "V", "script");
+    dmell_set_variable(&ctx.variables, "1", "outer");
+
+    int result = run("function prog_func {\n"
+                     "  prog_rec $0,$1,$2,$V\n"
+                     "  for R in $1; do prog_rec $R; done\n"
+                     "}\n"
+                     "prog_func a b\n"
+                     "prog_rec $1,$R\n");
+
+    EXPECT_EQ(result, 0);
+    ASSERT_EQ(g_calls.size(), 3u);
+    EXPECT_EQ(g_calls[0][1], "prog_func,a,b,script");
+    EXPECT_EQ(g_calls[1][1], "a");
+    EXPECT_EQ(g_calls[2][1], "outer,a");
+}
+
+/**
+ * @brief Test that a positional parameter followed by an argument stays a separate word
+ */
+TEST_F(DmellProgTest, RunFunctionParameterWithArgument)
+{
+    int result = run("function prog_flash {\n"
+                     "  prog_rec $1 fw.bin || return 1\n"
+                     "  prog_rec \"$0: flashed $1\"\n"
+                     "}\n"
+                     "prog_flash uart0 && prog_flash uart1\n");
+
+    EXPECT_EQ(result, 0);
+    ASSERT_EQ(g_calls.size(), 4u);
+    EXPECT_EQ(g_calls[0], (std::vector<std::string>{ "prog_rec", "uart0", "fw.bin" }));
+    EXPECT_EQ(g_calls[1], (std::vector<std::string>{ "prog_rec", "prog_flash: flashed uart0" }));
+    EXPECT_EQ(g_calls[2], (std::vector<std::string>{ "prog_rec", "uart1", "fw.bin" }));
+}
+
+/**
+ * @brief Test that 'return' leaves a recursive function with its exit code
+ */
+TEST_F(DmellProgTest, RunFunctionReturn)
+{
+    int result = run("function prog_count() {\n"
+                     "  prog_rec $1\n"
+                     "  for n in $2; do prog_count $n; return 3; done\n"
+                     "  prog_fail\n"
+                     "}\n"
+                     "prog_count a b\n");
+
+    EXPECT_EQ(result, 0);
+    EXPECT_EQ(ctx.last_exit_code, 3);
+    ASSERT_EQ(g_calls.size(), 3u);
+    EXPECT_EQ(g_calls[0][1], "a");
+    EXPECT_EQ(g_calls[1][1], "b");
+    EXPECT_EQ(g_calls[2][0], "prog_fail");
+}
+
+/**
+ * @brief Test that the exit code of every line is published
+ */
+TEST_F(DmellProgTest, RunPublishesExitCode)
+{
+    run("prog_fail\n");
+
+    EXPECT_EQ(ctx.last_exit_code, 1);
+    EXPECT_STREQ(dmell_get_variable_value(&ctx.variables, "?"), "1");
+}
+
+/**
+ * @brief Test that a negative exit code stops the program
+ */
+TEST_F(DmellProgTest, RunStopsOnNegativeExitCode)
+{
+    g_prog_return_value = -5;
+
+    int result = run("prog_rec a\nprog_rec b\n");
+
+    EXPECT_EQ(result, -5);
+    EXPECT_EQ(g_calls.size(), 1u);
+}
+
+/**
+ * @brief Test running with invalid arguments
+ */
+TEST_F(DmellProgTest, RunInvalidArguments)
+{
+    EXPECT_LT(dmell_prog_run(nullptr, &ctx), 0);
+}
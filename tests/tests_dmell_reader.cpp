@@ -0,0 +1,170 @@
+/**
+ * @file tests_dmell_reader.cpp
+ * @brief Unit tests for the dmell script file reader
+ */
+
+#include <gtest/gtest.h>
+#include <errno.h>
+#include <stdio.h>
+#include <string>
+#include <vector>
+
+extern "C" {
+#include "dmell_reader.h"
+#include "dmod_sal.h"
+}
+
+// ===============================================================
+//                  Script Reader Tests
+// ===============================================================
+
+class DmellReaderTest : public ::testing::Test
+{
+protected:
+    void SetUp() override
+    {
+        path = testing::TempDir() + "dmell_reader_test.dme";
+    }
+
+    void TearDown() override
+    {
+        remove(path.c_str());
+    }
+
+    // Writes the file and reads all of its lines with their line numbers
+    std::vector<std::string> read_lines(const std::string& content, std::vector<uint32_t>* numbers = nullptr)
+    {
+        FILE* file = fopen(path.c_str(), "wb");
+        EXPECT_NE(file, nullptr);
+        if (file == nullptr)
+        {
+            return {};
+        }
+        fwrite(content.data(), 1, content.size(), file);
+        fclose(file);
+
+        std::vector<std::string> lines;
+        dmell_reader_t reader;
+        EXPECT_EQ(dmell_reader_open(&reader, path.c_str()), 0);
+        const char* line = nullptr;
+        size_t len = 0;
+        while (dmell_reader_next_line(&reader, &line, &len) > 0)
+        {
+            EXPECT_EQ(line[len], '\0');
+            lines.push_back(std::string(line, len));
+            if (numbers != nullptr)
+            {
+                numbers->push_back(reader.line);
+            }
+        }
+        dmell_reader_close(&reader);
+        return lines;
+    }
+
+    // Comment line that makes the file too large to be loaded whole, so it is read in chunks
+    static std::string chunked_prefix()
+    {
+        static_assert(DMELL_READER_WHOLE_FILE_MAX % DMELL_READER_CHUNK_SIZE == 0, "the prefix has to fill whole chunks");
+        return "#" + std::string(DMELL_READER_WHOLE_FILE_MAX - 2, 'p') + "\n";
+    }
+
+    std::string path;
+};
+
+/**
+ * @brief Test splitting a file into lines
+ */
+TEST_F(DmellReaderTest, SplitsLines)
+{
+    std::vector<std::string> lines = read_lines("echo a\r\n\necho b");
+
+    ASSERT_EQ(lines.size(), 3u);
+    EXPECT_EQ(lines[0], "echo a");
+    EXPECT_EQ(lines[1], "");
+    EXPECT_EQ(lines[2], "echo b");
+}
+
+/**
+ * @brief Test that lines longer than a chunk are read whole
+ */
+TEST_F(DmellReaderTest, LinesLongerThanChunk)
+{
+    std::string first(DMELL_READER_CHUNK_SIZE * 3 + 7, 'a');
+    std::string second(DMELL_READER_CHUNK_SIZE - 2, 'b');
+
+    std::vector<std::string> lines = read_lines(chunked_prefix() + first + "\n" + second + "\n");
+
+    ASSERT_EQ(lines.size(), 3u);
+    EXPECT_EQ(lines[1], first);
+    EXPECT_EQ(lines[2], second);
+}
+
+/**
+ * @brief Test joining lines that end with a backslash
+ */
+TEST_F(DmellReaderTest, LineContinuation)
+{
+    std::vector<uint32_t> numbers;
+    std::vector<std::string> lines = read_lines("echo a \\\n  b \\\r\n c\n"
+                                                "echo d\\\\\n"
+                                                "echo e\\", &numbers);
+
+    ASSERT_EQ(lines.size(), 3u);
+    EXPECT_EQ(lines[0], "echo a   b  c");
+    EXPECT_EQ(lines[1], "echo d\\\\");
+    EXPECT_EQ(lines[2], "echo e\\");
+    EXPECT_EQ(numbers, (std::vector<uint32_t>{ 1, 4, 5 }));
+}
+
+/**
+ * @brief Test a continuation that crosses the end of a chunk
+ */
+TEST_F(DmellReaderTest, ContinuationAcrossChunks)
+{
+    std::string head(DMELL_READER_CHUNK_SIZE - 1, 'x');
+
+    std::vector<std::string> lines = read_lines(chunked_prefix() + head + "\\\nyz\nlast\n");
+
+    ASSERT_EQ(lines.size(), 3u);
+    EXPECT_EQ(lines[1], head + "yz");
+    EXPECT_EQ(lines[2], "last");
+}
+
+/**
+ * @brief Test that a small file is loaded with one read and its lines are slices of one buffer
+ */
+TEST_F(DmellReaderTest, WholeFileLoadedAtOpen)
+{
+    FILE* file = fopen(path.c_str(), "wb");
+    ASSERT_NE(file, nullptr);
+    fputs("echo a\necho bc\n", file);
+    fclose(file);
+
+    dmell_reader_t reader;
+    ASSERT_EQ(dmell_reader_open(&reader, path.c_str()), 0);
+    EXPECT_TRUE(reader.eof);
+    const char* first = nullptr;
+    const char* second = nullptr;
+    size_t len = 0;
+    EXPECT_EQ(dmell_reader_next_line(&reader, &first, &len), 1);
+    EXPECT_EQ(dmell_reader_next_line(&reader, &second, &len), 1);
+    EXPECT_EQ(second, first + 7);
+    EXPECT_STREQ(second, "echo bc");
+    EXPECT_EQ(dmell_reader_next_line(&reader, &second, &len), 0);
+    dmell_reader_close(&reader);
+}
+
+/**
+ * @brief Test invalid arguments and missing files
+ */
+TEST_F(DmellReaderTest, InvalidArguments)
+{
+    dmell_reader_t reader = {};
+    const char* line = nullptr;
+    size_t len = 0;
+
+    EXPECT_EQ(dmell_reader_open(&reader, "/nonexistent/dmell_reader.dme"), -ENOENT);
+    EXPECT_EQ(dmell_reader_next_line(&reader, &line, &len), -EINVAL);
+    EXPECT_EQ(dmell_reader_open(nullptr, path.c_str()), -EINVAL);
+    dmell_reader_close(&reader);
+}
@@ -0,0 +1,130 @@
+/**
+ * @file tests_dmell_resolve.cpp
+ * @brief Unit tests for the dmell command resolution cache
+ */
+
+#include <gtest/gtest.h>
+#include <stdio.h>
+#include <string.h>
+
+extern "C" {
+#include "dmell_resolve.h"
+#include "dmod_sal.h"
+}
+
+static const char* g_script_name = "resolve_test_script.dme";
+
+// ===============================================================
+//                  Resolution Cache Tests
+// ===============================================================
+
+class DmellResolveTest : public ::testing::Test
+{
+protected:
+    void SetUp() override
+    {
+        dmell_resolve_invalidate();
+        FILE* file = fopen(g_script_name, "w");
+        ASSERT_NE(file, nullptr);
+        fputs("echo test\n", file);
+        fclose(file);
+    }
+
+    void TearDown() override
+    {
+        remove(g_script_name);
+        dmell_resolve_invalidate();
+    }
+};
+
+/**
+ * @brief Test resolving a dmell script
+ */
+TEST_F(DmellResolveTest, ResolveScript)
+{
+    const dmell_resolve_t* entry = dmell_resolve_command(g_script_name);
+
+    ASSERT_NE(entry, nullptr);
+    EXPECT_EQ(entry->kind, (uint32_t)dmell_resolve_script);
+    EXPECT_STREQ(entry->name, g_script_name);
+    EXPECT_STREQ(entry->target, g_script_name);
+}
+
+/**
+ * @brief Test that the resolution is cached until the cache is invalidated
+ */
+TEST_F(DmellResolveTest, CachedUntilInvalidated)
+{
+    ASSERT_NE(dmell_resolve_command(g_script_name), nullptr);
+    remove(g_script_name);
+
+    const dmell_resolve_t* entry = dmell_resolve_command(g_script_name);
+    ASSERT_NE(entry, nullptr);
+    EXPECT_EQ(entry->kind, (uint32_t)dmell_resolve_script);
+
+    dmell_resolve_invalidate();
+    entry = dmell_resolve_command(g_script_name);
+    ASSERT_NE(entry, nullptr);
+    EXPECT_NE(entry->kind, (uint32_t)dmell_resolve_script);
+}
+
+/**
+ * @brief Test listing the cached resolutions
+ */
+TEST_F(DmellResolveTest, IterateEntries)
+{
+    size_t iterator = 0;
+    EXPECT_EQ(dmell_resolve_next(&iterator), nullptr);
+
+    dmell_resolve_command(g_script_name);
+    iterator = 0;
+    const dmell_resolve_t* entry = dmell_resolve_next(&iterator);
+    ASSERT_NE(entry, nullptr);
+    EXPECT_STREQ(entry->name, g_script_name);
+    EXPECT_EQ(dmell_resolve_next(&iterator), nullptr);
+}
+
+/**
+ * @brief Test resolving a null name
+ */
+TEST_F(DmellResolveTest, ResolveNullName)
+{
+    EXPECT_EQ(dmell_resolve_command(nullptr), nullptr);
+}
+
+/**
+ * @brief Test that a command that was not found is found once its file exists
+ */
+TEST_F(DmellResolveTest, NotFoundIsCheckedAgain)
+{
+    remove(g_script_name);
+    const dmell_resolve_t* entry = dmell_resolve_command(g_script_name);
+    ASSERT_NE(entry, nullptr);
+    EXPECT_EQ(entry->kind, (uint32_t)dmell_resolve_not_found);
+
+    FILE* file = fopen(g_script_name, "w");
+    ASSERT_NE(file, nullptr);
+    fclose(file);
+
+    entry = dmell_resolve_command(g_script_name);
+    ASSERT_NE(entry, nullptr);
+    EXPECT_EQ(entry->kind, (uint32_t)dmell_resolve_script);
+}
+
+/**
+ * @brief Test resolving a file with a shebang line
+ */
+TEST_F(DmellResolveTest, ResolveShebang)
+{
+    const char* name = "resolve_test_shebang.sh";
+    FILE* file = fopen(name, "w");
+    ASSERT_NE(file, nullptr);
+    fputs("#! /bin/dmell -x\necho test\n", file);
+    fclose(file);
+
+    const dmell_resolve_t* entry = dmell_resolve_command(name);
+    ASSERT_NE(entry, nullptr);
+    EXPECT_EQ(entry->kind, (uint32_t)dmell_resolve_shebang);
+    EXPECT_STREQ(entry->target, "/bin/dmell");
+    remove(name);
+}
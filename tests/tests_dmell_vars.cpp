@@ -5,9 +5,17 @@
 
 #include <gtest/gtest.h>
 #include <string.h>
+#include <string>
+#include <errno.h>
+#include <stdio.h>
+#include <chrono>
+#include <iostream>
+#include <vector>
+#include <ctype.h>
 
 extern "C" {
 #include "dmell_vars.h"
+#include "dmell_hlp.h"
 #include "dmod_sal.h"
 }
 
@@ -20,19 +28,15 @@ class DmellVarsTest : public ::testing::Test
 protected:
     void SetUp() override
     {
-        variables = nullptr;
+        variables = {};
     }
 
     void TearDown() override
     {
-        if (variables != nullptr)
-        {
-            dmell_free_variables(variables);
-            variables = nullptr;
-        }
+        dmell_free_variables(&variables);
     }
 
-    dmell_var_t* variables;
+    dmell_vars_t variables;
 };
 
 /**
@@ -40,12 +44,12 @@ protected:
  */
 TEST_F(DmellVarsTest, AddSingleVariable)
 {
-    variables = dmell_add_variable(nullptr, "TEST_VAR", "test_value");
+    ASSERT_EQ(dmell_add_variable(&variables, "TEST_VAR", "test_value"), 0);
     
-    ASSERT_NE(variables, nullptr);
-    EXPECT_STREQ(variables->name, "TEST_VAR");
-    EXPECT_STREQ(variables->value, "test_value");
-    EXPECT_EQ(variables->next, nullptr);
+    ASSERT_NE(variables.head, nullptr);
+    EXPECT_STREQ(variables.head->name, "TEST_VAR");
+    EXPECT_STREQ(variables.head->value, "test_value");
+    EXPECT_EQ(variables.head->next, nullptr);
 }
 
 /**
@@ -53,26 +57,26 @@ TEST_F(DmellVarsTest, AddSingleVariable)
  */
 TEST_F(DmellVarsTest, AddMultipleVariables)
 {
-    variables = dmell_add_variable(nullptr, "VAR1", "value1");
-    variables = dmell_add_variable(variables, "VAR2", "value2");
-    variables = dmell_add_variable(variables, "VAR3", "value3");
+    ASSERT_EQ(dmell_add_variable(&variables, "VAR1", "value1"), 0);
+    ASSERT_EQ(dmell_add_variable(&variables, "VAR2", "value2"), 0);
+    ASSERT_EQ(dmell_add_variable(&variables, "VAR3", "value3"), 0);
     
-    ASSERT_NE(variables, nullptr);
+    ASSERT_NE(variables.head, nullptr);
     
     // First variable
-    EXPECT_STREQ(variables->name, "VAR1");
-    EXPECT_STREQ(variables->value, "value1");
+    EXPECT_STREQ(variables.head->name, "VAR1");
+    EXPECT_STREQ(variables.head->value, "value1");
     
     // Second variable
-    ASSERT_NE(variables->next, nullptr);
-    EXPECT_STREQ(variables->next->name, "VAR2");
-    EXPECT_STREQ(variables->next->value, "value2");
+    ASSERT_NE(variables.head->next, nullptr);
+    EXPECT_STREQ(variables.head->next->name, "VAR2");
+    EXPECT_STREQ(variables.head->next->value, "value2");
     
     // Third variable
-    ASSERT_NE(variables->next->next, nullptr);
-    EXPECT_STREQ(variables->next->next->name, "VAR3");
-    EXPECT_STREQ(variables->next->next->value, "value3");
-    EXPECT_EQ(variables->next->next->next, nullptr);
+    ASSERT_NE(variables.head->next->next, nullptr);
+    EXPECT_STREQ(variables.head->next->next->name, "VAR3");
+    EXPECT_STREQ(variables.head->next->next->value, "value3");
+    EXPECT_EQ(variables.head->next->next->next, nullptr);
 }
 
 /**
@@ -80,8 +84,8 @@ TEST_F(DmellVarsTest, AddMultipleVariables)
  */
 TEST_F(DmellVarsTest, AddVariableNullName)
 {
-    variables = dmell_add_variable(nullptr, nullptr, "value");
-    EXPECT_EQ(variables, nullptr);
+    EXPECT_LT(dmell_add_variable(&variables, nullptr, "value"), 0);
+    EXPECT_EQ(variables.head, nullptr);
 }
 
 /**
@@ -89,8 +93,8 @@ TEST_F(DmellVarsTest, AddVariableNullName)
  */
 TEST_F(DmellVarsTest, AddVariableNullValue)
 {
-    variables = dmell_add_variable(nullptr, "name", nullptr);
-    EXPECT_EQ(variables, nullptr);
+    EXPECT_LT(dmell_add_variable(&variables, "name", nullptr), 0);
+    EXPECT_EQ(variables.head, nullptr);
 }
 
 /**
@@ -98,11 +102,11 @@ TEST_F(DmellVarsTest, AddVariableNullValue)
  */
 TEST_F(DmellVarsTest, FindExistingVariable)
 {
-    variables = dmell_add_variable(nullptr, "VAR1", "value1");
-    variables = dmell_add_variable(variables, "VAR2", "value2");
-    variables = dmell_add_variable(variables, "VAR3", "value3");
+    ASSERT_EQ(dmell_add_variable(&variables, "VAR1", "value1"), 0);
+    ASSERT_EQ(dmell_add_variable(&variables, "VAR2", "value2"), 0);
+    ASSERT_EQ(dmell_add_variable(&variables, "VAR3", "value3"), 0);
     
-    dmell_var_t* found = dmell_find_variable(variables, "VAR2");
+    dmell_var_t* found = dmell_find_variable(&variables, "VAR2");
     
     ASSERT_NE(found, nullptr);
     EXPECT_STREQ(found->name, "VAR2");
@@ -114,10 +118,10 @@ TEST_F(DmellVarsTest, FindExistingVariable)
  */
 TEST_F(DmellVarsTest, FindFirstVariable)
 {
-    variables = dmell_add_variable(nullptr, "FIRST", "first_value");
-    variables = dmell_add_variable(variables, "SECOND", "second_value");
+    ASSERT_EQ(dmell_add_variable(&variables, "FIRST", "first_value"), 0);
+    ASSERT_EQ(dmell_add_variable(&variables, "SECOND", "second_value"), 0);
     
-    dmell_var_t* found = dmell_find_variable(variables, "FIRST");
+    dmell_var_t* found = dmell_find_variable(&variables, "FIRST");
     
     ASSERT_NE(found, nullptr);
     EXPECT_STREQ(found->name, "FIRST");
@@ -128,10 +132,10 @@ TEST_F(DmellVarsTest, FindFirstVariable)
  */
 TEST_F(DmellVarsTest, FindLastVariable)
 {
-    variables = dmell_add_variable(nullptr, "FIRST", "first_value");
-    variables = dmell_add_variable(variables, "LAST", "last_value");
+    ASSERT_EQ(dmell_add_variable(&variables, "FIRST", "first_value"), 0);
+    ASSERT_EQ(dmell_add_variable(&variables, "LAST", "last_value"), 0);
     
-    dmell_var_t* found = dmell_find_variable(variables, "LAST");
+    dmell_var_t* found = dmell_find_variable(&variables, "LAST");
     
     ASSERT_NE(found, nullptr);
     EXPECT_STREQ(found->name, "LAST");
@@ -142,9 +146,9 @@ TEST_F(DmellVarsTest, FindLastVariable)
  */
 TEST_F(DmellVarsTest, FindNonExistingVariable)
 {
-    variables = dmell_add_variable(nullptr, "VAR1", "value1");
+    ASSERT_EQ(dmell_add_variable(&variables, "VAR1", "value1"), 0);
     
-    dmell_var_t* found = dmell_find_variable(variables, "NONEXISTENT");
+    dmell_var_t* found = dmell_find_variable(&variables, "NONEXISTENT");
     
     EXPECT_EQ(found, nullptr);
 }
@@ -154,17 +158,17 @@ TEST_F(DmellVarsTest, FindNonExistingVariable)
  */
 TEST_F(DmellVarsTest, RemoveMiddleVariable)
 {
-    variables = dmell_add_variable(nullptr, "VAR1", "value1");
-    variables = dmell_add_variable(variables, "VAR2", "value2");
-    variables = dmell_add_variable(variables, "VAR3", "value3");
+    ASSERT_EQ(dmell_add_variable(&variables, "VAR1", "value1"), 0);
+    ASSERT_EQ(dmell_add_variable(&variables, "VAR2", "value2"), 0);
+    ASSERT_EQ(dmell_add_variable(&variables, "VAR3", "value3"), 0);
     
-    variables = dmell_remove_variable(variables, "VAR2");
+    EXPECT_EQ(dmell_remove_variable(&variables, "VAR2"), 0);
     
-    ASSERT_NE(variables, nullptr);
-    EXPECT_STREQ(variables->name, "VAR1");
-    ASSERT_NE(variables->next, nullptr);
-    EXPECT_STREQ(variables->next->name, "VAR3");
-    EXPECT_EQ(variables->next->next, nullptr);
+    ASSERT_NE(variables.head, nullptr);
+    EXPECT_STREQ(variables.head->name, "VAR1");
+    ASSERT_NE(variables.head->next, nullptr);
+    EXPECT_STREQ(variables.head->next->name, "VAR3");
+    EXPECT_EQ(variables.head->next->next, nullptr);
 }
 
 /**
@@ -172,14 +176,14 @@ TEST_F(DmellVarsTest, RemoveMiddleVariable)
  */
 TEST_F(DmellVarsTest, RemoveFirstVariable)
 {
-    variables = dmell_add_variable(nullptr, "VAR1", "value1");
-    variables = dmell_add_variable(variables, "VAR2", "value2");
+    ASSERT_EQ(dmell_add_variable(&variables, "VAR1", "value1"), 0);
+    ASSERT_EQ(dmell_add_variable(&variables, "VAR2", "value2"), 0);
     
-    variables = dmell_remove_variable(variables, "VAR1");
+    EXPECT_EQ(dmell_remove_variable(&variables, "VAR1"), 0);
     
-    ASSERT_NE(variables, nullptr);
-    EXPECT_STREQ(variables->name, "VAR2");
-    EXPECT_EQ(variables->next, nullptr);
+    ASSERT_NE(variables.head, nullptr);
+    EXPECT_STREQ(variables.head->name, "VAR2");
+    EXPECT_EQ(variables.head->next, nullptr);
 }
 
 /**
@@ -187,14 +191,14 @@ TEST_F(DmellVarsTest, RemoveFirstVariable)
  */
 TEST_F(DmellVarsTest, RemoveLastVariable)
 {
-    variables = dmell_add_variable(nullptr, "VAR1", "value1");
-    variables = dmell_add_variable(variables, "VAR2", "value2");
+    ASSERT_EQ(dmell_add_variable(&variables, "VAR1", "value1"), 0);
+    ASSERT_EQ(dmell_add_variable(&variables, "VAR2", "value2"), 0);
     
-    variables = dmell_remove_variable(variables, "VAR2");
+    EXPECT_EQ(dmell_remove_variable(&variables, "VAR2"), 0);
     
-    ASSERT_NE(variables, nullptr);
-    EXPECT_STREQ(variables->name, "VAR1");
-    EXPECT_EQ(variables->next, nullptr);
+    ASSERT_NE(variables.head, nullptr);
+    EXPECT_STREQ(variables.head->name, "VAR1");
+    EXPECT_EQ(variables.head->next, nullptr);
 }
 
 /**
@@ -202,11 +206,11 @@ TEST_F(DmellVarsTest, RemoveLastVariable)
  */
 TEST_F(DmellVarsTest, RemoveOnlyVariable)
 {
-    variables = dmell_add_variable(nullptr, "ONLY", "only_value");
+    ASSERT_EQ(dmell_add_variable(&variables, "ONLY", "only_value"), 0);
     
-    variables = dmell_remove_variable(variables, "ONLY");
+    EXPECT_EQ(dmell_remove_variable(&variables, "ONLY"), 0);
     
-    EXPECT_EQ(variables, nullptr);
+    EXPECT_EQ(variables.head, nullptr);
 }
 
 /**
@@ -214,12 +218,12 @@ TEST_F(DmellVarsTest, RemoveOnlyVariable)
  */
 TEST_F(DmellVarsTest, RemoveNonExistingVariable)
 {
-    variables = dmell_add_variable(nullptr, "VAR1", "value1");
+    ASSERT_EQ(dmell_add_variable(&variables, "VAR1", "value1"), 0);
     
-    variables = dmell_remove_variable(variables, "NONEXISTENT");
+    EXPECT_EQ(dmell_remove_variable(&variables, "NONEXISTENT"), -ENOENT);
     
-    ASSERT_NE(variables, nullptr);
-    EXPECT_STREQ(variables->name, "VAR1");
+    ASSERT_NE(variables.head, nullptr);
+    EXPECT_STREQ(variables.head->name, "VAR1");
 }
 
 /**
@@ -227,13 +231,13 @@ TEST_F(DmellVarsTest, RemoveNonExistingVariable)
  */
 TEST_F(DmellVarsTest, SetExistingVariable)
 {
-    variables = dmell_add_variable(nullptr, "VAR", "old_value");
+    ASSERT_EQ(dmell_add_variable(&variables, "VAR", "old_value"), 0);
     
-    variables = dmell_set_variable(variables, "VAR", "new_value");
+    EXPECT_EQ(dmell_set_variable(&variables, "VAR", "new_value"), 0);
     
-    ASSERT_NE(variables, nullptr);
-    EXPECT_STREQ(variables->value, "new_value");
-    EXPECT_EQ(variables->next, nullptr);
+    ASSERT_NE(variables.head, nullptr);
+    EXPECT_STREQ(variables.head->value, "new_value");
+    EXPECT_EQ(variables.head->next, nullptr);
 }
 
 /**
@@ -241,24 +245,128 @@ TEST_F(DmellVarsTest, SetExistingVariable)
  */
 TEST_F(DmellVarsTest, SetNewVariable)
 {
-    variables = dmell_add_variable(nullptr, "EXISTING", "existing_value");
+    ASSERT_EQ(dmell_add_variable(&variables, "EXISTING", "existing_value"), 0);
     
-    variables = dmell_set_variable(variables, "NEW", "new_value");
+    EXPECT_EQ(dmell_set_variable(&variables, "NEW", "new_value"), 0);
     
-    ASSERT_NE(variables, nullptr);
-    dmell_var_t* found = dmell_find_variable(variables, "NEW");
+    ASSERT_NE(variables.head, nullptr);
+    dmell_var_t* found = dmell_find_variable(&variables, "NEW");
     ASSERT_NE(found, nullptr);
     EXPECT_STREQ(found->value, "new_value");
 }
 
+/**
+ * @brief Test that new values are copied into the storage of the variable when they fit
+ */
+TEST_F(DmellVarsTest, SetVariableReusesStorage)
+{
+    ASSERT_EQ(dmell_add_variable(&variables, "I", "0"), 0);
+    dmell_var_t* var = dmell_find_variable(&variables, "I");
+    ASSERT_NE(var, nullptr);
+    char* inline_value = var->value;
+    EXPECT_EQ(inline_value, var->name + 2);
+
+    for (int i = 0; i < 100; i++)
+    {
+        ASSERT_EQ(dmell_set_variable(&variables, "I", std::to_string(i).c_str()), 0);
+        EXPECT_EQ(var->value, inline_value);
+    }
+    EXPECT_STREQ(var->value, "99");
+
+    // A long value moves to a separate block that shorter values reuse
+    std::string long_value(100, 'x');
+    ASSERT_EQ(dmell_set_variable(&variables, "I", long_value.c_str()), 0);
+    char* long_storage = var->value;
+    EXPECT_NE(long_storage, inline_value);
+    EXPECT_STREQ(var->value, long_value.c_str());
+    ASSERT_EQ(dmell_set_variable(&variables, "I", var->value + 90), 0);
+    EXPECT_EQ(var->value, long_storage);
+    EXPECT_STREQ(var->value, "xxxxxxxxxx");
+}
+
+/**
+ * @brief Test that a scope keeps its variables and parameters to itself
+ */
+TEST_F(DmellVarsTest, ScopeKeepsVariablesLocal)
+{
+    ASSERT_EQ(dmell_set_variable(&variables, "X", "outer"), 0);
+    ASSERT_EQ(dmell_set_variable(&variables, "1", "outer_arg"), 0);
+
+    dmell_var_t params[2] = {};
+    params[0].value = (char*)"child.dme";
+    params[1].value = (char*)"inner_arg";
+    dmell_vars_t scope = {};
+    scope.parent = &variables;
+    scope.params = params;
+    scope.param_count = 2;
+    scope.is_scope = true;
+
+    // A function frame in the scope writes to the scope
+    dmell_var_t func_params[1] = {};
+    func_params[0].value = (char*)"func";
+    dmell_vars_t frame = {};
+    frame.parent = &scope;
+    frame.params = func_params;
+    frame.param_count = 1;
+
+    ASSERT_EQ(dmell_set_variable(&frame, "X", "inner"), 0);
+    for (int i = 0; i < 50; i++)
+    {
+        std::string name = "V" + std::to_string(i);
+        ASSERT_EQ(dmell_set_variable(&scope, name.c_str(), std::string(i, 'v').c_str()), 0);
+    }
+    EXPECT_STREQ(dmell_get_variable_value(&frame, "X"), "inner");
+    EXPECT_STREQ(dmell_get_variable_value(&scope, "1"), "inner_arg");
+    EXPECT_STREQ(dmell_get_variable_value(&scope, "V49"), std::string(49, 'v').c_str());
+    EXPECT_EQ(dmell_find_variable(&variables, "V0"), nullptr);
+    EXPECT_STREQ(dmell_get_variable_value(&variables, "X"), "outer");
+
+    dmell_free_variables(&scope);
+    EXPECT_STREQ(dmell_get_variable_value(&variables, "X"), "outer");
+    EXPECT_STREQ(dmell_get_variable_value(&variables, "1"), "outer_arg");
+}
+
+/**
+ * @brief Test that a scope reuses the memory of removed variables and replaced values
+ */
+TEST_F(DmellVarsTest, ScopeReusesFreedMemory)
+{
+    dmell_vars_t scope = {};
+    scope.parent = &variables;
+    scope.is_scope = true;
+
+    ASSERT_EQ(dmell_set_variable(&scope, "A", "first"), 0);
+    dmell_var_t* first = dmell_find_variable(&scope, "A");
+    ASSERT_EQ(dmell_remove_variable(&scope, "A"), 0);
+    ASSERT_EQ(dmell_set_variable(&scope, "B", "second"), 0);
+    EXPECT_EQ(dmell_find_variable(&scope, "B"), first);
+
+    // A value that grows and shrinks again in a loop stays correct
+    for (int i = 0; i < 200; i++)
+    {
+        std::string value(i * 7, 'x');
+        ASSERT_EQ(dmell_set_variable(&scope, "GROW", value.c_str()), 0);
+        ASSERT_EQ(dmell_set_variable(&scope, "T", std::to_string(i).c_str()), 0);
+        ASSERT_EQ(dmell_remove_variable(&scope, "T"), 0);
+        EXPECT_STREQ(dmell_get_variable_value(&scope, "GROW"), value.c_str());
+    }
+
+    void* params = dmell_vars_alloc(&scope, 100 * sizeof(dmell_var_t));
+    EXPECT_NE(params, nullptr);
+    EXPECT_EQ(dmell_vars_alloc(&variables, 16), nullptr);
+
+    dmell_free_variables(&scope);
+    EXPECT_EQ(scope.arena, nullptr);
+}
+
 /**
  * @brief Test getting variable value
  */
 TEST_F(DmellVarsTest, GetVariableValue)
 {
-    variables = dmell_add_variable(nullptr, "MYVAR", "myvalue");
+    ASSERT_EQ(dmell_add_variable(&variables, "MYVAR", "myvalue"), 0);
     
-    const char* value = dmell_get_variable_value(variables, "MYVAR");
+    const char* value = dmell_get_variable_value(&variables, "MYVAR");
     
     ASSERT_NE(value, nullptr);
     EXPECT_STREQ(value, "myvalue");
@@ -269,9 +377,9 @@ TEST_F(DmellVarsTest, GetVariableValue)
  */
 TEST_F(DmellVarsTest, GetNonExistingVariableValue)
 {
-    variables = dmell_add_variable(nullptr, "VAR", "value");
+    ASSERT_EQ(dmell_add_variable(&variables, "VAR", "value"), 0);
     
-    const char* value = dmell_get_variable_value(variables, "NONEXISTENT");
+    const char* value = dmell_get_variable_value(&variables, "NONEXISTENT");
     
     // Should fall back to Dmod_GetEnv which may return nullptr
     // The actual behavior depends on whether the env variable exists
@@ -285,13 +393,13 @@ TEST_F(DmellVarsTest, AddArgvVariables)
     char* argv[] = { (char*)"arg0", (char*)"arg1", (char*)"arg2" };
     int argc = 3;
     
-    variables = dmell_add_argv_variables(nullptr, argc, argv);
+    ASSERT_EQ(dmell_add_argv_variables(&variables, argc, argv), 0);
     
-    ASSERT_NE(variables, nullptr);
+    ASSERT_NE(variables.head, nullptr);
     
-    const char* val0 = dmell_get_variable_value(variables, "0");
-    const char* val1 = dmell_get_variable_value(variables, "1");
-    const char* val2 = dmell_get_variable_value(variables, "2");
+    const char* val0 = dmell_get_variable_value(&variables, "0");
+    const char* val1 = dmell_get_variable_value(&variables, "1");
+    const char* val2 = dmell_get_variable_value(&variables, "2");
     
     ASSERT_NE(val0, nullptr);
     ASSERT_NE(val1, nullptr);
@@ -302,6 +410,118 @@ TEST_F(DmellVarsTest, AddArgvVariables)
     EXPECT_STREQ(val2, "arg2");
 }
 
+/**
+ * @brief Test adding a variable that already exists
+ */
+TEST_F(DmellVarsTest, AddDuplicateVariable)
+{
+    ASSERT_EQ(dmell_add_variable(&variables, "VAR", "value1"), 0);
+
+    EXPECT_EQ(dmell_add_variable(&variables, "VAR", "value2"), -EEXIST);
+    EXPECT_STREQ(dmell_get_variable_value(&variables, "VAR"), "value1");
+    EXPECT_EQ(variables.count, 1u);
+}
+
+/**
+ * @brief Test that the store grows and keeps the insertion order after removals
+ */
+TEST_F(DmellVarsTest, ManyVariablesWithRemovals)
+{
+    char name[32];
+    for (int i = 0; i < 200; i++)
+    {
+        snprintf(name, sizeof(name), "VAR_%d", i);
+        ASSERT_EQ(dmell_set_variable(&variables, name, name), 0);
+    }
+    for (int i = 0; i < 200; i += 2)
+    {
+        snprintf(name, sizeof(name), "VAR_%d", i);
+        ASSERT_EQ(dmell_remove_variable(&variables, name), 0);
+    }
+
+    EXPECT_EQ(variables.count, 100u);
+    int expected = 1;
+    for (dmell_var_t* var = variables.head; var != nullptr; var = var->next)
+    {
+        snprintf(name, sizeof(name), "VAR_%d", expected);
+        EXPECT_STREQ(var->name, name);
+        EXPECT_EQ(dmell_find_variable(&variables, name), var);
+        expected += 2;
+    }
+    EXPECT_EQ(expected, 201);
+    EXPECT_EQ(dmell_find_variable(&variables, "VAR_0"), nullptr);
+    EXPECT_STREQ(variables.tail->name, "VAR_199");
+}
+
+/**
+ * @brief Test finding a variable by a name that is not null terminated
+ */
+TEST_F(DmellVarsTest, FindVariableByLength)
+{
+    ASSERT_EQ(dmell_add_variable(&variables, "VAR", "value"), 0);
+
+    const char* text = "VARIABLE";
+    EXPECT_NE(dmell_find_variable_n(&variables, text, 3, dmell_hash_name(text, 3)), nullptr);
+    EXPECT_EQ(dmell_find_variable_n(&variables, text, 4, dmell_hash_name(text, 4)), nullptr);
+}
+
+/**
+ * @brief Benchmark of the lookups compared to a walk over the variable list
+ */
+TEST_F(DmellVarsTest, BenchmarkLookupAgainstList)
+{
+    const int var_count = 500;
+    const int rounds = 20;
+    char name[32];
+    for (int i = 0; i < var_count; i++)
+    {
+        snprintf(name, sizeof(name), "PROVISION_VAR_%d", i);
+        ASSERT_EQ(dmell_add_variable(&variables, name, "value"), 0);
+    }
+
+    // Reference: linear walk over the insertion ordered list, like the old store
+    auto list_find = [this](const char* var_name) -> dmell_var_t* {
+        for (dmell_var_t* var = variables.head; var != nullptr; var = var->next)
+        {
+            if (strcmp(var->name, var_name) == 0)
+            {
+                return var;
+            }
+        }
+        return nullptr;
+    };
+
+    size_t list_found = 0;
+    auto list_start = std::chrono::steady_clock::now();
+    for (int r = 0; r < rounds; r++)
+    {
+        for (int i = 0; i < var_count; i++)
+        {
+            snprintf(name, sizeof(name), "PROVISION_VAR_%d", i);
+            list_found += list_find(name) != nullptr;
+        }
+    }
+    auto list_time = std::chrono::steady_clock::now() - list_start;
+
+    size_t hash_found = 0;
+    auto hash_start = std::chrono::steady_clock::now();
+    for (int r = 0; r < rounds; r++)
+    {
+        for (int i = 0; i < var_count; i++)
+        {
+            snprintf(name, sizeof(name), "PROVISION_VAR_%d", i);
+            hash_found += dmell_find_variable(&variables, name) != nullptr;
+        }
+    }
+    auto hash_time = std::chrono::steady_clock::now() - hash_start;
+
+    EXPECT_EQ(list_found, (size_t)(var_count * rounds));
+    EXPECT_EQ(hash_found, list_found);
+    std::cout << "[ BENCH    ] " << var_count * rounds << " lookups in " << var_count << " variables: list "
+              << std::chrono::duration_cast<std::chrono::microseconds>(list_time).count() << " us, hash "
+              << std::chrono::duration_cast<std::chrono::microseconds>(hash_time).count() << " us" << std::endl;
+}
+
 // ===============================================================
 //                  Variable Expansion Tests
 // ===============================================================
@@ -311,19 +531,15 @@ class DmellVarsExpandTest : public ::testing::Test
 protected:
     void SetUp() override
     {
-        variables = nullptr;
+        variables = {};
     }
 
     void TearDown() override
     {
-        if (variables != nullptr)
-        {
-            dmell_free_variables(variables);
-            variables = nullptr;
-        }
+        dmell_free_variables(&variables);
     }
 
-    dmell_var_t* variables;
+    dmell_vars_t variables;
 };
 
 /**
@@ -331,12 +547,12 @@ protected:
  */
 TEST_F(DmellVarsExpandTest, ExpandSimpleVariable)
 {
-    variables = dmell_add_variable(nullptr, "NAME", "World");
+    ASSERT_EQ(dmell_add_variable(&variables, "NAME", "World"), 0);
     
     const char* input = "Hello $NAME!";
     char output[64];
     
-    int result = dmell_expand_variables(variables, input, strlen(input), output, sizeof(output));
+    int result = dmell_expand_variables(&variables, input, strlen(input), output, sizeof(output));
     
     ASSERT_GT(result, 0);
     output[result] = '\0';
@@ -348,12 +564,12 @@ TEST_F(DmellVarsExpandTest, ExpandSimpleVariable)
  */
 TEST_F(DmellVarsExpandTest, ExpandVariableWithBraces)
 {
-    variables = dmell_add_variable(nullptr, "VAR", "value");
+    ASSERT_EQ(dmell_add_variable(&variables, "VAR", "value"), 0);
     
     const char* input = "${VAR}text";
     char output[64];
     
-    int result = dmell_expand_variables(variables, input, strlen(input), output, sizeof(output));
+    int result = dmell_expand_variables(&variables, input, strlen(input), output, sizeof(output));
     
     ASSERT_GT(result, 0);
     output[result] = '\0';
@@ -365,19 +581,18 @@ TEST_F(DmellVarsExpandTest, ExpandVariableWithBraces)
  */
 TEST_F(DmellVarsExpandTest, ExpandMultipleVariables)
 {
-    variables = dmell_add_variable(nullptr, "FIRST", "Hello");
-    variables = dmell_add_variable(variables, "SECOND", "World");
+    ASSERT_EQ(dmell_add_variable(&variables, "FIRST", "Hello"), 0);
+    ASSERT_EQ(dmell_add_variable(&variables, "SECOND", "World"), 0);
     
     const char* input = "$FIRST $SECOND";
     char output[64];
     
-    int result = dmell_expand_variables(variables, input, strlen(input), output, sizeof(output));
+    int result = dmell_expand_variables(&variables, input, strlen(input), output, sizeof(output));
     
     ASSERT_GT(result, 0);
     output[result] = '\0';
-    // Note: dmell_expand_variables skips leading whitespace in each segment
-    // This is intentional shell behavior
-    EXPECT_STREQ(output, "HelloWorld");
+    // The whitespace between the variables separates the words
+    EXPECT_STREQ(output, "Hello World");
 }
 
 /**
@@ -416,11 +631,11 @@ TEST_F(DmellVarsExpandTest, ExpandNoVariables)
  */
 TEST_F(DmellVarsExpandTest, ExpandCalculateBufferSize)
 {
-    variables = dmell_add_variable(nullptr, "VAR", "value");
+    ASSERT_EQ(dmell_add_variable(&variables, "VAR", "value"), 0);
     
     const char* input = "$VAR";
     
-    int result = dmell_expand_variables(variables, input, strlen(input), nullptr, 0);
+    int result = dmell_expand_variables(&variables, input, strlen(input), nullptr, 0);
     
     EXPECT_EQ(result, 5); // "value" is 5 characters
 }
@@ -456,12 +671,12 @@ TEST_F(DmellVarsExpandTest, ExpandDoubleDollar)
  */
 TEST_F(DmellVarsExpandTest, ExpandVariableWithUnderscore)
 {
-    variables = dmell_add_variable(nullptr, "MY_VAR_NAME", "myvalue");
+    ASSERT_EQ(dmell_add_variable(&variables, "MY_VAR_NAME", "myvalue"), 0);
     
     const char* input = "$MY_VAR_NAME";
     char output[64];
     
-    int result = dmell_expand_variables(variables, input, strlen(input), output, sizeof(output));
+    int result = dmell_expand_variables(&variables, input, strlen(input), output, sizeof(output));
     
     ASSERT_GT(result, 0);
     output[result] = '\0';
@@ -473,14 +688,221 @@ TEST_F(DmellVarsExpandTest, ExpandVariableWithUnderscore)
  */
 TEST_F(DmellVarsExpandTest, ExpandVariableWithNumbers)
 {
-    variables = dmell_add_variable(nullptr, "VAR123", "value123");
+    ASSERT_EQ(dmell_add_variable(&variables, "VAR123", "value123"), 0);
     
     const char* input = "$VAR123";
     char output[64];
     
-    int result = dmell_expand_variables(variables, input, strlen(input), output, sizeof(output));
+    int result = dmell_expand_variables(&variables, input, strlen(input), output, sizeof(output));
     
     ASSERT_GT(result, 0);
     output[result] = '\0';
     EXPECT_STREQ(output, "value123");
 }
+
+/**
+ * @brief Test expanding variables into a growable buffer
+ */
+TEST_F(DmellVarsExpandTest, ExpandToBuffer)
+{
+    ASSERT_EQ(dmell_add_variable(&variables, "NAME", "World"), 0);
+    dmell_buf_t buf = {};
+
+    const char* input = "Hello ${NAME}!";
+    int result = dmell_expand_variables_to_buf(&variables, input, strlen(input), &buf);
+
+    EXPECT_EQ(result, 12);
+    EXPECT_EQ(buf.length, 12u);
+    EXPECT_STREQ(buf.data, "Hello World!");
+
+    dmell_buf_free(&buf);
+}
+
+/**
+ * @brief Test that the buffer grows for long values and keeps its content
+ */
+TEST_F(DmellVarsExpandTest, ExpandToBufferGrows)
+{
+    std::string long_value(300, 'x');
+    ASSERT_EQ(dmell_add_variable(&variables, "LONG", long_value.c_str()), 0);
+    dmell_buf_t buf = {};
+    dmell_buf_append(&buf, "prefix:", 7);
+
+    const char* input = "$LONG$LONG";
+    int result = dmell_expand_variables_to_buf(&variables, input, strlen(input), &buf);
+
+    EXPECT_EQ(result, 600);
+    EXPECT_EQ(buf.length, 607u);
+    EXPECT_EQ(std::string(buf.data), "prefix:" + long_value + long_value);
+
+    dmell_buf_free(&buf);
+}
+
+/**
+ * @brief Test expanding into a null buffer
+ */
+TEST_F(DmellVarsExpandTest, ExpandToBufferInvalidArguments)
+{
+    EXPECT_LT(dmell_expand_variables_to_buf(nullptr, "text", 4, nullptr), 0);
+}
+
+/**
+ * @brief Test expanding the special parameters $? and $#
+ */
+TEST_F(DmellVarsExpandTest, ExpandSpecialParameters)
+{
+    char* argv[] = { (char*)"script", (char*)"a", (char*)"b" };
+    ASSERT_EQ(dmell_add_argv_variables(&variables, 3, argv), 0);
+    dmell_set_status(&variables, -2);
+
+    const char* input = "$?,${?},$#,${#},$1";
+    char output[64];
+    int result = dmell_expand_variables(&variables, input, strlen(input), output, sizeof(output));
+
+    ASSERT_GT(result, 0);
+    output[result] = '\0';
+    EXPECT_STREQ(output, "-2,-2,2,2,a");
+    EXPECT_STREQ(dmell_get_variable_value(&variables, "?"), "-2");
+
+    // The parameters are not variables of the store
+    EXPECT_EQ(dmell_find_variable(&variables, "?"), nullptr);
+    EXPECT_EQ(variables.count, 3u);
+}
+
+// ===============================================================
+//                  Command Substitution Tests
+// ===============================================================
+
+// Commands received by the substitution handler
+static std::vector<std::string> g_substituted;
+
+// Substitution handler that echoes the command in upper case with trailing newlines
+static int upper_substitution_handler(const dmell_vars_t* vars, const char* cmd, size_t len, dmell_buf_t* out)
+{
+    (void)vars;
+    g_substituted.push_back(std::string(cmd, len));
+    for (size_t i = 0; i < len; i++)
+    {
+        char c = (char)toupper((unsigned char)cmd[i]);
+        dmell_buf_append(out, &c, 1);
+    }
+    return dmell_buf_append(out, "\r\n\n", 3);
+}
+
+class DmellVarsSubstitutionTest : public DmellVarsExpandTest
+{
+protected:
+    void SetUp() override
+    {
+        DmellVarsExpandTest::SetUp();
+        g_substituted.clear();
+        dmell_set_substitution_handler(upper_substitution_handler);
+    }
+
+    void TearDown() override
+    {
+        dmell_set_substitution_handler(nullptr);
+        DmellVarsExpandTest::TearDown();
+    }
+
+    std::string expand(const char* input)
+    {
+        dmell_buf_t buf = {};
+        int result = dmell_expand_variables_to_buf(&variables, input, strlen(input), &buf);
+        std::string text = result >= 0 && buf.data != nullptr ? std::string(buf.data, buf.length) : "<error>";
+        EXPECT_TRUE(result < 0 || (size_t)result == buf.length);
+        dmell_buf_free(&buf);
+        return text;
+    }
+};
+
+/**
+ * @brief Test that "$(...)" is replaced with the output of the command without trailing newlines
+ */
+TEST_F(DmellVarsSubstitutionTest, ExpandDollarParentheses)
+{
+    EXPECT_EQ(expand("set X=$(echo hi)!"), "set X=ECHO HI!");
+    ASSERT_EQ(g_substituted.size(), 1u);
+    EXPECT_EQ(g_substituted[0], "echo hi");
+}
+
+/**
+ * @brief Test that line breaks inside the output become spaces
+ */
+TEST_F(DmellVarsSubstitutionTest, LineBreaksBecomeSpaces)
+{
+    EXPECT_EQ(expand("$(a\nb)"), "A B");
+}
+
+/**
+ * @brief Test backtick substitution next to a variable
+ */
+TEST_F(DmellVarsSubstitutionTest, ExpandBackticks)
+{
+    ASSERT_EQ(dmell_add_variable(&variables, "A", "a"), 0);
+
+    EXPECT_EQ(expand("$A`pwd`"), "aPWD");
+}
+
+/**
+ * @brief Test that nested parentheses belong to the substituted command
+ */
+TEST_F(DmellVarsSubstitutionTest, ExpandNestedParentheses)
+{
+    EXPECT_EQ(expand("x$(a (b) c)y"), "xA (B) Cy");
+    ASSERT_EQ(g_substituted.size(), 1u);
+    EXPECT_EQ(g_substituted[0], "a (b) c");
+}
+
+/**
+ * @brief Test that "$((...))" is evaluated instead of running a command
+ */
+TEST_F(DmellVarsSubstitutionTest, ExpandArithmetic)
+{
+    ASSERT_EQ(dmell_add_variable(&variables, "N", "4"), 0);
+    char dst[32] = {};
+    const char* input = "n=$((N * (2 + 1)))";
+
+    EXPECT_EQ(expand("n=$((N * (2 + 1)))!"), "n=12!");
+    EXPECT_EQ(dmell_expand_variables(&variables, input, strlen(input), dst, sizeof(dst)), 4);
+    EXPECT_STREQ(dst, "n=12");
+    EXPECT_EQ(expand("$((1 / 0))"), "<error>");
+    EXPECT_TRUE(g_substituted.empty());
+}
+
+/**
+ * @brief Test that unterminated substitutions are copied unchanged
+ */
+TEST_F(DmellVarsSubstitutionTest, UnterminatedSubstitution)
+{
+    EXPECT_EQ(expand("a $(b"), "a $(b");
+    EXPECT_EQ(expand("`c"), "`c");
+    EXPECT_TRUE(g_substituted.empty());
+}
+
+/**
+ * @brief Test that the fixed buffer expansion does not run commands
+ */
+TEST_F(DmellVarsSubstitutionTest, FixedBufferKeepsSubstitution)
+{
+    char dst[32] = {};
+    const char* input = "$(cmd)";
+
+    EXPECT_EQ(dmell_expand_variables(&variables, input, strlen(input), dst, sizeof(dst)), 6);
+    EXPECT_STREQ(dst, "$(cmd)");
+    EXPECT_TRUE(g_substituted.empty());
+}
+
+/**
+ * @brief Test substitution without a handler
+ */
+TEST_F(DmellVarsSubstitutionTest, SubstitutionWithoutHandler)
+{
+    dmell_set_substitution_handler(nullptr);
+    dmell_buf_t buf = {};
+
+    EXPECT_EQ(dmell_substitute_command(&variables, "cmd", 3, &buf), -ENOTSUP);
+    EXPECT_EQ(expand("$(cmd)"), "<error>");
+
+    dmell_buf_free(&buf);
+}